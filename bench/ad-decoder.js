@@ -0,0 +1,124 @@
+/*
+ * Advertising report decoding through Hci and Gap, native decoder vs JS.
+ *
+ *   node bench/ad-decoder.js [capture.btsnoop]
+ *
+ * LE Meta advertising events are taken from a btsnoop capture (see
+ * NOBLE_HCI_BTSNOOP_FILE), or built from a mix of simulated advertisers. Each
+ * event goes through Hci#onSocketData into Gap, once with the native decoder
+ * (lib/ad-decoder, build it with `npm run rebuild`) and once with the JS
+ * parser. The JS parser decodes service data lazily, so both are also run
+ * with every discovered advertisement read in full.
+ */
+const btsnoop = require('../lib/hci-socket/btsnoop');
+const adDecoder = require('../lib/ad-decoder/bindings');
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const Gap = require('../lib/hci-socket/gap');
+const Hci = require('../lib/hci-socket/hci');
+
+const ITERATIONS = 100000;
+const ROUNDS = 5;
+
+const eventsFromCapture = (file) =>
+  btsnoop
+    .read(file)
+    .filter(
+      ({ packet, received }) =>
+        received &&
+        packet[0] === 0x04 &&
+        packet[1] === 0x3e &&
+        (packet[3] === 0x02 || packet[3] === 0x0d)
+    )
+    .map(({ packet }) => packet);
+
+// one legacy advertising report per event, like most controllers send them
+const advertisingEvent = (type, address, eir, rssi) => {
+  const report = Buffer.concat([
+    Buffer.from([type, 0x01]),
+    Buffer.from(address.split(':').reverse().join(''), 'hex'),
+    Buffer.from([eir.length]),
+    eir,
+    Buffer.from([rssi & 0xff])
+  ]);
+
+  return Buffer.concat([
+    Buffer.from([0x04, 0x3e, report.length + 2, 0x02, 0x01]),
+    report
+  ]);
+};
+
+const simulatedEvents = () => {
+  const events = [];
+
+  for (let i = 0; i < 500; i++) {
+    const serviceData = Buffer.from([0x05, 0x16, 0x0f, 0x18, i & 0xff, 0x64]);
+    const peripheral = new FakePeripheral({
+      localName: `sensor-${i}`,
+      serviceUuids:
+        i % 3 === 0
+          ? ['180d', '180f']
+          : ['6e400001b5a3f393e0a9e50e24dcca9e'],
+      manufacturerData: Buffer.from([0x4c, 0x00, 0x02, 0x15, i & 0xff]),
+      txPowerLevel: -8
+    });
+    const eir =
+      i % 2 === 0
+        ? Buffer.concat([peripheral.advertisingData, serviceData])
+        : peripheral.advertisingData;
+
+    events.push(advertisingEvent(0x00, peripheral.address, eir, -60));
+    events.push(
+      advertisingEvent(0x04, peripheral.address, peripheral.scanResponseData, -60)
+    );
+  }
+
+  return events;
+};
+
+const run = (name, decoder, events, readAll) => {
+  const hci = new Hci({ socket: new FakeController(), adDecoder: decoder });
+  const gap = new Gap(hci);
+  let sink = 0;
+
+  gap.on('discover', (status, address, addressType, connectable, advertisement) => {
+    sink += advertisement.serviceUuids.length;
+    if (readAll) {
+      sink += advertisement.serviceData.length;
+      sink += advertisement.serviceSolicitationUuids.length;
+    }
+  });
+
+  // best of a few rounds, the first ones include JIT warm up
+  let best = Infinity;
+  for (let round = 0; round < ROUNDS; round++) {
+    const start = process.hrtime.bigint();
+    for (let n = 0; n < ITERATIONS; n++) {
+      hci.onSocketData(events[n % events.length]);
+    }
+    best = Math.min(best, Number(process.hrtime.bigint() - start) / 1e9);
+  }
+
+  console.log(
+    `${name.padEnd(36)} ${(ITERATIONS / best / 1000).toFixed(0).padStart(6)} k events/s (${sink})`
+  );
+};
+
+const file = process.argv[2];
+const events = file ? eventsFromCapture(file) : simulatedEvents();
+
+console.log(
+  `${events.length} advertising events from ${file || 'simulated advertisers'}`
+);
+
+if (adDecoder === null) {
+  console.log('native decoder not built, only running the JS parser');
+}
+
+for (const readAll of [false, true]) {
+  const suffix = readAll ? ', all fields read' : '';
+  run(`js${suffix}`, null, events, readAll);
+  if (adDecoder !== null) {
+    run(`native${suffix}`, adDecoder, events, readAll);
+  }
+}
@@ -0,0 +1,115 @@
+/*
+ * Reconnecting to a peripheral whose characteristic needs an encrypted link,
+ * through the whole hci-socket stack against a simulated controller: the time
+ * from connect() to the first value read from it, which the peripheral only
+ * hands out once the link is encrypted.
+ *
+ * "pairing every time" forgets the keys, so each connection goes through
+ * legacy pairing before encrypting. "stored LTK" keeps them in a key store
+ * file and encrypts with the LTK from the second connection on, "restarted"
+ * starts new bindings on the same file.
+ *
+ *   node bench/bond-reconnect.js [rounds=10] [intervalMs=30]
+ */
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+
+const rounds = parseInt(process.argv[2] || '10', 10);
+const interval = parseFloat(process.argv[3] || '30');
+
+const file = path.join(os.tmpdir(), `noble-bond-reconnect-${process.pid}`);
+
+// the bonds it keeps last over all runs, like a real device's
+const fake = new FakePeripheral({
+  localName: 'power meter',
+  serviceUuids: ['1818'],
+  advertisingInterval: 20,
+  services: [
+    {
+      uuid: '1818',
+      characteristics: [
+        {
+          uuid: '2a66',
+          properties: ['read', 'write'],
+          value: Buffer.from([0x01]),
+          encrypt: true
+        }
+      ]
+    }
+  ]
+});
+
+const run = (name, keyStore) =>
+  new Promise((resolve) => {
+    const socket = new FakeController({
+      numCommandPackets: 4,
+      peripherals: [fake]
+    });
+    const bindings = new NobleBindings({ socket, userChannel: true, keyStore });
+    const noble = new Noble(bindings);
+
+    noble.once('discover', async (peripheral) => {
+      await noble.stopScanningAsync();
+
+      const times = [];
+      let pairings = 0;
+
+      for (let round = 0; round < rounds; round++) {
+        const start = process.hrtime.bigint();
+
+        // in units of 1.25 ms
+        await peripheral.connectAsync({
+          minInterval: Math.round(interval / 1.25),
+          maxInterval: Math.round(interval / 1.25)
+        });
+        const { characteristics } =
+          await peripheral.discoverSomeServicesAndCharacteristicsAsync(
+            ['1818'],
+            ['2a66']
+          );
+        await characteristics[0].readAsync();
+
+        times.push(Number(process.hrtime.bigint() - start) / 1e6);
+
+        const session = socket._connections.values().next().value.session;
+        pairings += session.stats.pairings;
+
+        await peripheral.disconnectAsync();
+      }
+
+      times.sort((a, b) => a - b);
+
+      console.log(
+        `${name.padEnd(18)} median ${times[Math.floor(times.length / 2)].toFixed(1)} ms, ` +
+          `min ${times[0].toFixed(1)} ms, max ${times[times.length - 1].toFixed(1)} ms, ` +
+          `${pairings} pairings in ${rounds} connections`
+      );
+
+      noble.removeAllListeners();
+      socket.stop();
+      resolve();
+    });
+
+    noble.on('stateChange', (state) => {
+      if (state === 'poweredOn') {
+        noble.startScanning([], true);
+      }
+    });
+  });
+
+(async () => {
+  console.log(`${rounds} connections each, ${interval} ms connection interval`);
+
+  await run('pairing every time', false);
+  await run('stored LTK', file);
+  await run('restarted', file);
+
+  fs.unlinkSync(file);
+  process.exit(0);
+})();
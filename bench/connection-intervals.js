@@ -0,0 +1,145 @@
+/*
+ * Connection events the controller has to schedule with and without the
+ * interval manager, through the whole hci-socket stack against a simulated
+ * controller: connects to N peripherals at 7.5 ms, discovers a 3 service
+ * database on each and subscribes to a notifying characteristic, then counts
+ * connection events and notifications while they stream.
+ *
+ *   node bench/connection-intervals.js [connections=20] [rateHz=10] [seconds=5]
+ */
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+
+const count = parseInt(process.argv[2] || '20', 10);
+const rate = parseInt(process.argv[3] || '10', 10);
+const seconds = parseFloat(process.argv[4] || '5');
+
+const services = [
+  {
+    uuid: '180d',
+    characteristics: [
+      { uuid: '2a37', properties: ['notify'], notifyRate: rate },
+      { uuid: '2a38', properties: ['read'], value: Buffer.from([0x01]) }
+    ]
+  },
+  {
+    uuid: '180f',
+    characteristics: [
+      { uuid: '2a19', properties: ['read', 'notify'], value: Buffer.from([0x5f]) }
+    ]
+  },
+  {
+    uuid: '180a',
+    characteristics: [
+      { uuid: '2a26', properties: ['read'], value: Buffer.from('4.2.1') },
+      { uuid: '2a29', properties: ['read'], value: Buffer.from('HrmCo') }
+    ]
+  }
+];
+
+const run = (name, intervalManager) =>
+  new Promise((resolve) => {
+    const peripherals = [];
+    for (let i = 0; i < count; i++) {
+      peripherals.push(
+        new FakePeripheral({
+          localName: `hrm-${i}`,
+          serviceUuids: ['180d'],
+          advertisingInterval: 20,
+          services
+        })
+      );
+    }
+
+    const socket = new FakeController({ numCommandPackets: 4, peripherals });
+    const bindings = new NobleBindings({
+      socket,
+      userChannel: true,
+      intervalManager
+    });
+    const noble = new Noble(bindings);
+
+    const discovered = new Map();
+    const decisions = {};
+    let notifications = 0;
+    let discoveryTime = 0;
+
+    if (bindings.intervalManager) {
+      bindings.intervalManager.on('decision', (handle, decision) => {
+        decisions[decision.state] = (decisions[decision.state] || 0) + 1;
+      });
+    }
+
+    const setup = async (peripheral) => {
+      // in units of 1.25 ms
+      await peripheral.connectAsync({ minInterval: 6, maxInterval: 6 });
+
+      const start = Date.now();
+      const { characteristics } =
+        await peripheral.discoverAllServicesAndCharacteristicsAsync();
+      discoveryTime += Date.now() - start;
+
+      const hrm = characteristics.find((c) => c.uuid === '2a37');
+      hrm.on('data', () => notifications++);
+      await hrm.subscribeAsync();
+    };
+
+    const measure = () => {
+      const events = socket.stats.connectionEvents;
+      const start = process.hrtime.bigint();
+      notifications = 0;
+
+      setTimeout(() => {
+        const elapsed = Number(process.hrtime.bigint() - start) / 1e9;
+        const intervals = Array.from(socket._connections.values()).map(
+          (connection) => connection.interval * 1.25
+        );
+
+        console.log(
+          `${name.padEnd(18)} discovery ${(discoveryTime / count)
+            .toFixed(0)
+            .padStart(4)} ms each, ` +
+            `${((socket.stats.connectionEvents - events) / elapsed)
+              .toFixed(0)
+              .padStart(5)} connection events/s, ` +
+            `${(notifications / elapsed).toFixed(0).padStart(4)} notifications/s ` +
+            `(expected ${count * rate}), intervals ${Math.min(...intervals)} - ` +
+            `${Math.max(...intervals)} ms` +
+            (bindings.intervalManager ? ` ${JSON.stringify(decisions)}` : '')
+        );
+
+        noble.removeAllListeners();
+        socket.stop();
+        resolve();
+      }, seconds * 1000);
+    };
+
+    noble.on('discover', async (peripheral) => {
+      discovered.set(peripheral.id, peripheral);
+
+      if (discovered.size === count) {
+        await noble.stopScanningAsync();
+        await Promise.all(Array.from(discovered.values()).map(setup));
+
+        // let the manager see the steady state first
+        setTimeout(measure, bindings.intervalManager ? 3000 : 0);
+      }
+    });
+
+    noble.on('stateChange', (state) => {
+      if (state === 'poweredOn') {
+        noble.startScanning();
+      }
+    });
+  });
+
+(async () => {
+  console.log(`${count} connections, ${rate} Hz each, ${seconds} s`);
+
+  await run('fixed 7.5 ms', false);
+  await run('interval manager', true);
+
+  process.exit(0);
+})();
@@ -0,0 +1,151 @@
+/*
+ * A class of riders connecting at once through the whole hci-socket stack
+ * against a simulated controller: some devices fail their first attempts and
+ * a few went out of range after they were discovered.
+ *
+ * "FIFO" is the plain queue with no deadlines, the app cancelling and
+ * retrying whatever has not connected `appTimeout` ms after it asked, like
+ * apps do without help from the bindings. "scheduled" leaves it to the
+ * connection scheduler: per-attempt deadlines, backoff with jitter and failed
+ * devices requeued behind healthy ones.
+ *
+ *   node bench/connection-scheduler.js [riders=30] [flaky=5] [unreachable=3] [appTimeout=2000]
+ */
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+
+const riders = parseInt(process.argv[2] || '30', 10);
+const flaky = parseInt(process.argv[3] || '5', 10);
+const unreachable = parseInt(process.argv[4] || '3', 10);
+const appTimeout = parseInt(process.argv[5] || '2000', 10);
+
+const RETRIES = 2;
+
+const wait = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+// the app's own connect timeout, cancelling when it expires
+const connectWithin = (peripheral, timeout) =>
+  new Promise((resolve) => {
+    const timer = setTimeout(() => {
+      peripheral.cancelConnect();
+    }, timeout);
+
+    peripheral.connect((error) => {
+      clearTimeout(timer);
+      resolve(!error);
+    });
+  });
+
+const fifo = async (peripheral) => {
+  for (let attempt = 0; attempt <= RETRIES; attempt++) {
+    if (await connectWithin(peripheral, appTimeout)) {
+      return true;
+    }
+    await wait(100);
+  }
+  return false;
+};
+
+const scheduled = (peripheral) =>
+  peripheral.connectAsync().then(
+    () => true,
+    () => false
+  );
+
+const run = (name, connect, connectionScheduler) =>
+  new Promise((resolve) => {
+    const fakes = Array.from(
+      { length: riders },
+      (_, i) =>
+        new FakePeripheral({
+          localName: `rider ${i}`,
+          serviceUuids: ['1826'],
+          advertisingInterval: 20,
+          // spread out so the plain queue meets them early
+          connectFailures: i % Math.floor(riders / flaky) === 1 ? 1 : 0
+        })
+    );
+    const socket = new FakeController({
+      numCommandPackets: 4,
+      peripherals: fakes
+    });
+    const bindings = new NobleBindings({
+      socket,
+      userChannel: true,
+      connectionScheduler
+    });
+    const noble = new Noble(bindings);
+
+    const discovered = new Map();
+
+    noble.on('discover', async (peripheral) => {
+      discovered.set(peripheral.id, peripheral);
+      if (discovered.size < riders) {
+        return;
+      }
+      await noble.stopScanningAsync();
+
+      // out of range by the time the class starts
+      fakes
+        .filter((fake, i) => i % Math.floor(riders / unreachable) === 0)
+        .forEach((fake) => {
+          fake.connectable = false;
+        });
+
+      const times = [];
+      const start = Date.now();
+
+      const results = await Promise.all(
+        Array.from(discovered.values()).map((peripheral) =>
+          connect(peripheral).then((connected) => {
+            if (connected) {
+              times.push(Date.now() - start);
+            }
+            return connected;
+          })
+        )
+      );
+
+      times.sort((a, b) => a - b);
+      const connected = results.filter((result) => result).length;
+      const metrics = bindings.connectionScheduler.metrics();
+
+      console.log(
+        `${name.padEnd(10)} ${connected}/${riders - unreachable} connected, ` +
+          `median ${times[Math.floor(times.length / 2)]} ms, ` +
+          `last ${times[times.length - 1]} ms, ` +
+          `${metrics.attempts} attempts (${metrics.timeouts} timed out), ` +
+          `queue wait mean ${metrics.queueWait.mean.toFixed(0)} ms max ${metrics.queueWait.max} ms, ` +
+          `establishment mean ${metrics.establishmentTime.mean.toFixed(0)} ms`
+      );
+
+      bindings.connectionScheduler.stop();
+      noble.removeAllListeners();
+      socket.stop();
+      resolve();
+    });
+
+    noble.on('stateChange', (state) => {
+      if (state === 'poweredOn') {
+        noble.startScanning([], true);
+      }
+    });
+  });
+
+(async () => {
+  console.log(
+    `${riders} riders, ${flaky} failing their first attempt, ${unreachable} out of range, ` +
+      `${RETRIES} retries, app timeout ${appTimeout} ms`
+  );
+
+  await run('FIFO', fifo, { attemptTimeout: 0, retries: 0 });
+  await run('scheduled', scheduled, {
+    attemptTimeout: 300,
+    retries: RETRIES,
+    backoff: { base: 100, max: 1000 }
+  });
+
+  process.exit(0);
+})();
@@ -0,0 +1,100 @@
+/*
+ * Polling a multi-characteristic peripheral through the whole hci-socket
+ * stack against a simulated controller: every round reads all
+ * characteristics at once and writes a setpoint, over the unenhanced ATT
+ * bearer alone and with Enhanced ATT bearers next to it.
+ *
+ *   node bench/eatt-parallel-reads.js [characteristics=8] [rounds=20] [intervalMs=30]
+ */
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+
+const count = parseInt(process.argv[2] || '8', 10);
+const rounds = parseInt(process.argv[3] || '20', 10);
+const interval = parseFloat(process.argv[4] || '30');
+
+const UUIDS = Array.from({ length: count }, (_, i) => (0xaa01 + i).toString(16));
+
+const run = (name, eattBearers) =>
+  new Promise((resolve) => {
+    const fake = new FakePeripheral({
+      localName: 'trainer',
+      serviceUuids: ['1234'],
+      advertisingInterval: 20,
+      eatt: true,
+      services: [
+        {
+          uuid: '1234',
+          characteristics: UUIDS.map((uuid) => ({
+            uuid,
+            properties: ['read', 'write'],
+            value: Buffer.alloc(20, 0x42)
+          }))
+        }
+      ]
+    });
+    const socket = new FakeController({
+      numCommandPackets: 4,
+      peripherals: [fake]
+    });
+    const noble = new Noble(
+      new NobleBindings({ socket, userChannel: true, eattBearers })
+    );
+
+    noble.once('discover', async (peripheral) => {
+      await noble.stopScanningAsync();
+      // in units of 1.25 ms
+      await peripheral.connectAsync({
+        minInterval: Math.round(interval / 1.25),
+        maxInterval: Math.round(interval / 1.25)
+      });
+
+      const { characteristics } =
+        await peripheral.discoverSomeServicesAndCharacteristicsAsync(
+          ['1234'],
+          UUIDS
+        );
+
+      const start = process.hrtime.bigint();
+
+      for (let round = 0; round < rounds; round++) {
+        await Promise.all(
+          characteristics
+            .map((characteristic) => characteristic.readAsync())
+            .concat(characteristics[0].writeAsync(Buffer.from([round]), false))
+        );
+      }
+
+      const elapsed = Number(process.hrtime.bigint() - start) / 1e6;
+      const session = socket._connections.values().next().value.session;
+
+      console.log(
+        `${name.padEnd(24)} ${(elapsed / rounds).toFixed(0).padStart(5)} ms per round ` +
+          `(${session.stats.eattRequests} of ${session.stats.requests} requests on EATT bearers)`
+      );
+
+      await peripheral.disconnectAsync();
+      noble.removeAllListeners();
+      socket.stop();
+      resolve();
+    });
+
+    noble.on('stateChange', (state) => {
+      if (state === 'poweredOn') {
+        noble.startScanning();
+      }
+    });
+  });
+
+(async () => {
+  console.log(
+    `${count} characteristics read and 1 written per round, ${rounds} rounds, connection interval ${interval} ms`
+  );
+
+  await run('unenhanced bearer', 0);
+  await run('3 Enhanced ATT bearers', 3);
+
+  process.exit(0);
+})();
@@ -0,0 +1,160 @@
+/*
+ * Records an extended scan of N simulated advertisers, each with `size` bytes
+ * of advertising data that the controller reports in fragments of `fragment`
+ * bytes, to a btsnoop capture. Then replays it at maximum speed through Hci
+ * and Gap twice: with the fragments joined before parsing, and with each
+ * fragment parsed as it comes, like before reassembly. Reports the time and
+ * CPU taken, the parses and discover events per advertisement and whether
+ * the advertisements came out whole.
+ *
+ *   node bench/extended-reassembly.js [advertisers=100] [seconds=2] [size=1000] [fragment=100]
+ */
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const Gap = require('../lib/hci-socket/gap');
+const Hci = require('../lib/hci-socket/hci');
+const ReplaySocket = require('../lib/hci-socket/replay-socket');
+
+const count = parseInt(process.argv[2] || '100', 10);
+const seconds = parseFloat(process.argv[3] || '2');
+const size = parseInt(process.argv[4] || '1000', 10);
+const fragment = parseInt(process.argv[5] || '100', 10);
+
+// Manufacturer Specific Data structures of up to 255 bytes filling `size`
+let lastManufacturerData = 0;
+
+const advertisingData = (i) => {
+  const structures = [];
+
+  for (let left = size; left > 4;) {
+    const length = Math.min(left, 256);
+    const structure = Buffer.alloc(length, i & 0xff);
+    structure.writeUInt8(length - 1, 0);
+    structure.writeUInt8(0xff, 1);
+    structure.writeUInt16LE(0x0059, 2);
+    structures.push(structure);
+    lastManufacturerData = length - 2;
+    left -= length;
+  }
+
+  return Buffer.concat(structures);
+};
+
+const record = (file) =>
+  new Promise((resolve) => {
+    const socket = new FakeController({
+      numCommandPackets: 4,
+      extendedFragmentSize: fragment,
+      peripherals: Array.from(
+        { length: count },
+        (_, i) =>
+          new FakePeripheral({
+            connectable: false,
+            sid: i & 0x0f,
+            advertisingInterval: 100,
+            advertisingData: advertisingData(i)
+          })
+      )
+    });
+    const hci = new Hci({ socket, userChannel: true, extended: true, btsnoopFile: file });
+    const gap = new Gap(hci);
+
+    let started = false;
+
+    hci.on('stateChange', (state) => {
+      if (state !== 'poweredOn' || started) {
+        return;
+      }
+
+      started = true;
+      gap.startScanning(true);
+      setTimeout(() => {
+        gap.stopScanning();
+        const advertisements = socket.stats.advertisingReports;
+        hci.closeBtsnoop(() => {
+          socket.stop();
+          resolve(advertisements);
+        });
+      }, seconds * 1000);
+    });
+    hci.init();
+  });
+
+const replay = (file, reassemble) =>
+  new Promise((resolve) => {
+    const socket = new ReplaySocket(file, { speed: 'max' });
+    const hci = new Hci({ socket, userChannel: true, extended: true });
+    const gap = new Gap(hci);
+
+    if (!reassemble) {
+      gap.reassembler.push = (address, sid, scanResponse, dataStatus, data) => data;
+    }
+
+    let parses = 0;
+    const parseServices = gap.parseServices;
+    gap.parseServices = function (...args) {
+      parses++;
+      return parseServices.apply(this, args);
+    };
+
+    let discovers = 0;
+    let whole = 0;
+    gap.on('discover', (status, address, addressType, connectable, advertisement) => {
+      discovers++;
+      // the last structure's, parsed from a fragment only if it fits one
+      if (
+        advertisement.manufacturerData &&
+        advertisement.manufacturerData.length === lastManufacturerData
+      ) {
+        whole++;
+      }
+    });
+
+    const cpu = process.cpuUsage();
+    const start = process.hrtime.bigint();
+
+    socket.once('end', () =>
+      setImmediate(() => {
+        const wall = Number(process.hrtime.bigint() - start) / 1e6;
+        const { user, system } = process.cpuUsage(cpu);
+
+        resolve({ wall, cpu: (user + system) / 1000, parses, discovers, whole, socket });
+      })
+    );
+    hci.init();
+  });
+
+(async () => {
+  const file = path.join(os.tmpdir(), `noble-bench-${process.pid}.btsnoop`);
+  process.on('exit', () => fs.existsSync(file) && fs.unlinkSync(file));
+
+  const advertisements = await record(file);
+  const fragments = advertisements * Math.ceil(size / fragment);
+
+  console.log(
+    `${count} advertisers, ${size} bytes in ${fragment} byte fragments, ` +
+      `${advertisements} advertisements, ${fragments} fragments recorded`
+  );
+
+  // once to warm up
+  await replay(file, true);
+
+  for (const reassemble of [false, true]) {
+    const { wall, cpu, parses, discovers, whole, socket } = await replay(file, reassemble);
+
+    console.log(
+      `${reassemble ? 'reassembled' : 'per fragment'}: ` +
+        `${wall.toFixed(0)} ms, cpu ${cpu.toFixed(0)} ms, ` +
+        `${((socket.stats.packets / wall) * 1000).toFixed(0)} events/s, ` +
+        `${(parses / advertisements).toFixed(2)} parses and ` +
+        `${(discovers / advertisements).toFixed(2)} discovers per advertisement, ` +
+        `${discovers > 0 ? ((whole / discovers) * 100).toFixed(0) : 0}% of discovers whole`
+    );
+  }
+
+  process.exit(0);
+})();
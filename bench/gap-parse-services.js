@@ -0,0 +1,184 @@
+/*
+ * Throughput of Gap#parseServices on a recorded advertising stream.
+ *
+ *   node bench/gap-parse-services.js [capture.btsnoop]
+ *
+ * Advertising reports are taken from the LE Meta events of a btsnoop capture
+ * (see NOBLE_HCI_BTSNOOP_FILE). Without a capture a mix of simulated
+ * advertisers is used. The regex/indexOf based parser Gap used before is kept
+ * below as the baseline.
+ */
+const btsnoop = require('../lib/hci-socket/btsnoop');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const Gap = require('../lib/hci-socket/gap');
+
+const ITERATIONS = 200000;
+
+const reportsFromCapture = (file) => {
+  const reports = [];
+
+  for (const { packet, received } of btsnoop.read(file)) {
+    // HCI event, LE Meta, (extended) advertising report
+    if (!received || packet[0] !== 0x04 || packet[1] !== 0x3e) {
+      continue;
+    }
+
+    const subEvent = packet[3];
+    let offset = 5;
+
+    for (let n = 0; n < packet[4]; n++) {
+      if (subEvent === 0x02) {
+        const length = packet[offset + 8];
+        reports.push({
+          address: packet.slice(offset + 2, offset + 8).toString('hex'),
+          type: packet[offset],
+          eir: packet.slice(offset + 9, offset + 9 + length)
+        });
+        offset += 10 + length;
+      } else if (subEvent === 0x0d) {
+        const length = packet[offset + 23];
+        reports.push({
+          address: packet.slice(offset + 3, offset + 9).toString('hex'),
+          type: packet[offset] & 0x08 ? 0x04 : 0x00,
+          eir: packet.slice(offset + 24, offset + 24 + length)
+        });
+        offset += 24 + length;
+      } else {
+        break;
+      }
+    }
+  }
+
+  return reports;
+};
+
+const simulatedReports = () => {
+  const reports = [];
+
+  for (let i = 0; i < 500; i++) {
+    const serviceData = Buffer.from([0x05, 0x16, 0x0f, 0x18, i & 0xff, 0x64]);
+    const peripheral = new FakePeripheral({
+      localName: `sensor-${i}`,
+      serviceUuids:
+        i % 3 === 0
+          ? ['180d', '180f']
+          : ['6e400001b5a3f393e0a9e50e24dcca9e'],
+      manufacturerData: Buffer.from([0x4c, 0x00, 0x02, 0x15, i & 0xff]),
+      txPowerLevel: -8
+    });
+    const eir =
+      i % 2 === 0
+        ? Buffer.concat([peripheral.advertisingData, serviceData])
+        : peripheral.advertisingData;
+
+    reports.push({ address: peripheral.address, type: 0x00, eir });
+    reports.push({
+      address: peripheral.address,
+      type: 0x04,
+      eir: peripheral.scanResponseData
+    });
+  }
+
+  return reports;
+};
+
+// Gap#parseServices before the table driven parser, for comparison
+const legacyParseServices = function (address, eir, previouslyDiscovered, leMetaEventType) {
+  const advertisement = previouslyDiscovered
+    ? this._discoveries[address].advertisement
+    : { localName: undefined, txPowerLevel: undefined, manufacturerData: undefined, serviceData: [], serviceUuids: [], solicitationServiceUuids: [] };
+
+  if (leMetaEventType !== 0x04) {
+    advertisement.serviceData = [];
+    advertisement.serviceUuids = [];
+    advertisement.serviceSolicitationUuids = [];
+  }
+
+  let i = 0;
+  while (i + 1 < eir.length) {
+    const length = eir.readUInt8(i);
+    if (length < 1 || i + length + 1 > eir.length) {
+      break;
+    }
+    const eirType = eir.readUInt8(i + 1);
+    const bytes = eir.slice(i + 2).slice(0, length - 1);
+    const reversed = (b) => b.toString('hex').match(/.{1,2}/g).reverse().join('');
+
+    switch (eirType) {
+      case 0x02:
+      case 0x03:
+        for (let j = 0; j < bytes.length - 1; j += 2) {
+          const uuid = bytes.readUInt16LE(j).toString(16);
+          if (advertisement.serviceUuids.indexOf(uuid) === -1) {
+            advertisement.serviceUuids.push(uuid);
+          }
+        }
+        break;
+      case 0x06:
+      case 0x07:
+        for (let j = 0; j < bytes.length - 15; j += 16) {
+          const uuid = reversed(bytes.slice(j, j + 16));
+          if (advertisement.serviceUuids.indexOf(uuid) === -1) {
+            advertisement.serviceUuids.push(uuid);
+          }
+        }
+        break;
+      case 0x08:
+      case 0x09:
+        advertisement.localName = bytes.toString('utf8');
+        break;
+      case 0x0a:
+        advertisement.txPowerLevel = bytes.readInt8(0);
+        break;
+      case 0x16:
+        advertisement.serviceData.push({ uuid: reversed(bytes.slice(0, 2)), data: bytes.slice(2, bytes.length) });
+        break;
+      case 0x20:
+        advertisement.serviceData.push({ uuid: reversed(bytes.slice(0, 4)), data: bytes.slice(4, bytes.length) });
+        break;
+      case 0x21:
+        advertisement.serviceData.push({ uuid: reversed(bytes.slice(0, 16)), data: bytes.slice(16, bytes.length) });
+        break;
+      case 0xff:
+        advertisement.manufacturerData = bytes;
+        break;
+    }
+    i += length + 1;
+  }
+
+  return advertisement;
+};
+
+const run = (name, parse, reports, readAll) => {
+  const gap = new Gap({ on: () => {} });
+  let sink = 0;
+
+  const start = process.hrtime.bigint();
+  for (let n = 0; n < ITERATIONS; n++) {
+    const { address, type, eir } = reports[n % reports.length];
+    const previouslyDiscovered = !!gap._discoveries[address];
+    const advertisement = parse.call(gap, address, eir, previouslyDiscovered, type);
+    gap._discoveries[address] = { advertisement };
+
+    sink += advertisement.serviceUuids.length;
+    if (readAll) {
+      sink += advertisement.serviceData.length;
+    }
+  }
+  const elapsed = Number(process.hrtime.bigint() - start) / 1e9;
+
+  console.log(
+    `${name.padEnd(40)} ${(ITERATIONS / elapsed / 1000).toFixed(0).padStart(6)} k reports/s (${sink})`
+  );
+};
+
+const file = process.argv[2];
+const reports = file ? reportsFromCapture(file) : simulatedReports();
+
+console.log(`${reports.length} advertising reports from ${file || 'simulated advertisers'}`);
+
+for (const readAll of [false, true]) {
+  const suffix = readAll ? ', service data read' : '';
+  run(`legacy${suffix}`, legacyParseServices, reports, readAll);
+  run(`table driven${suffix}`, Gap.prototype.parseServices, reports, readAll);
+}
@@ -0,0 +1,127 @@
+/*
+ * Connect to ready time through the whole hci-socket stack against a
+ * simulated peripheral with 10 services of 6 characteristics each: connect
+ * and discover every service, characteristic and descriptor. Runs with the
+ * single pass Peripheral#discoverDatabase and again with the level by level
+ * walk (services, characteristics per service, descriptors per
+ * characteristic).
+ *
+ *   node bench/gatt-discover-database.js [rounds=5] [intervalMs=30]
+ */
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+
+const rounds = parseInt(process.argv[2] || '5', 10);
+const interval = parseFloat(process.argv[3] || '30');
+
+const singlePass = NobleBindings.prototype.discoverDatabase;
+
+const services = [];
+for (let s = 0; s < 10; s++) {
+  const characteristics = [];
+  for (let c = 0; c < 6; c++) {
+    characteristics.push({
+      uuid: `${(0xa000 + s * 16 + c).toString(16)}`,
+      properties: c % 2 === 0 ? ['read', 'notify'] : ['read', 'write'],
+      value: Buffer.from([s, c])
+    });
+  }
+  services.push({ uuid: `${(0xb000 + s).toString(16)}`, characteristics });
+}
+
+// walking the levels leaves the descriptors to one request per characteristic
+const walk = async (peripheral) => {
+  const { characteristics } =
+    await peripheral.discoverAllServicesAndCharacteristicsAsync();
+  for (const characteristic of characteristics) {
+    await characteristic.discoverDescriptorsAsync();
+  }
+  return characteristics;
+};
+
+const tree = async (peripheral) => {
+  const { characteristics } =
+    await peripheral.discoverDatabaseAsync({ descriptors: true });
+  return characteristics;
+};
+
+const connectToReady = (peripheral, socket, discover) =>
+  new Promise((resolve) => {
+    const start = process.hrtime.bigint();
+
+    peripheral.connect(
+      {
+        // in units of 1.25 ms
+        minInterval: Math.round(interval / 1.25),
+        maxInterval: Math.round(interval / 1.25)
+      },
+      async () => {
+        const session = socket._connections.values().next().value.session;
+        const characteristics = await discover(peripheral);
+        const elapsed = Number(process.hrtime.bigint() - start) / 1e6;
+        const descriptors = characteristics.reduce(
+          (count, c) => count + c.descriptors.length,
+          0
+        );
+        const requests = session.stats.requests;
+
+        await peripheral.disconnectAsync();
+        resolve({ elapsed, requests, characteristics, descriptors });
+      }
+    );
+  });
+
+const run = (name, discoverDatabase, discover) =>
+  new Promise((resolve) => {
+    NobleBindings.prototype.discoverDatabase = discoverDatabase;
+
+    const fake = new FakePeripheral({
+      localName: 'hub',
+      serviceUuids: ['b000'],
+      advertisingInterval: 20,
+      services
+    });
+    const socket = new FakeController({
+      numCommandPackets: 4,
+      peripherals: [fake]
+    });
+    const noble = new Noble(new NobleBindings({ socket, userChannel: true }));
+
+    noble.once('discover', async (peripheral) => {
+      await noble.stopScanningAsync();
+
+      let total = 0;
+      let result;
+      for (let i = 0; i < rounds; i++) {
+        result = await connectToReady(peripheral, socket, discover);
+        total += result.elapsed;
+      }
+
+      console.log(
+        `${name.padEnd(20)} ${String(result.requests).padStart(4)} requests ` +
+          `${(total / rounds).toFixed(0).padStart(6)} ms to ready ` +
+          `(${result.characteristics.length} characteristics, ${result.descriptors} descriptors)`
+      );
+
+      noble.removeAllListeners();
+      socket.stop();
+      resolve();
+    });
+
+    noble.on('stateChange', (state) => {
+      if (state === 'poweredOn') {
+        noble.startScanning();
+      }
+    });
+  });
+
+(async () => {
+  console.log(`connection interval ${interval} ms, ${rounds} rounds`);
+
+  await run('single pass', singlePass, tree);
+  await run('level by level', undefined, walk);
+
+  process.exit(0);
+})();
@@ -0,0 +1,109 @@
+/*
+ * Reading and writing a 512 byte characteristic value through the whole
+ * hci-socket stack against a simulated peripheral, at different ATT_MTUs and
+ * with a server that only queues a few Prepare Write Requests.
+ *
+ *   node bench/gatt-long-values.js [rounds=20] [intervalMs=30]
+ */
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+
+const rounds = parseInt(process.argv[2] || '20', 10);
+const interval = parseFloat(process.argv[3] || '30');
+
+const VALUE = Buffer.alloc(512, 0x5a);
+
+const run = (name, mtu, prepareQueueSize) =>
+  new Promise((resolve) => {
+    const fake = new FakePeripheral({
+      localName: 'logger',
+      serviceUuids: ['1234'],
+      advertisingInterval: 20,
+      mtu: 517,
+      prepareQueueSize,
+      services: [
+        {
+          uuid: '1234',
+          characteristics: [
+            { uuid: 'aaa1', properties: ['read', 'write'], value: VALUE }
+          ]
+        }
+      ]
+    });
+    const socket = new FakeController({
+      numCommandPackets: 4,
+      peripherals: [fake]
+    });
+    const noble = new Noble(new NobleBindings({ socket, userChannel: true }));
+
+    noble.once('discover', async (peripheral) => {
+      await noble.stopScanningAsync();
+      // in units of 1.25 ms
+      await peripheral.connectAsync({
+        minInterval: Math.round(interval / 1.25),
+        maxInterval: Math.round(interval / 1.25),
+        mtu
+      });
+
+      const { characteristics } =
+        await peripheral.discoverSomeServicesAndCharacteristicsAsync(
+          ['1234'],
+          ['aaa1']
+        );
+      const characteristic = characteristics[0];
+      const session = socket._connections.values().next().value.session;
+
+      const measure = async (operation) => {
+        const requests = session.stats.requests;
+        const start = process.hrtime.bigint();
+        for (let i = 0; i < rounds; i++) {
+          await operation();
+        }
+        return {
+          elapsed: Number(process.hrtime.bigint() - start) / 1e6 / rounds,
+          requests: (session.stats.requests - requests) / rounds
+        };
+      };
+
+      const read = await measure(async () => {
+        const value = await characteristic.readAsync();
+        if (!value.equals(VALUE)) {
+          throw new Error('short read');
+        }
+      });
+      const write = await measure(() => characteristic.writeAsync(VALUE, false));
+
+      console.log(
+        `${name.padEnd(28)} MTU ${String(peripheral.mtu).padStart(3)} ` +
+          `read ${String(read.requests).padStart(2)} requests ${read.elapsed.toFixed(0).padStart(4)} ms ` +
+          `write ${String(write.requests).padStart(2)} requests ${write.elapsed.toFixed(0).padStart(4)} ms`
+      );
+
+      await peripheral.disconnectAsync();
+      noble.removeAllListeners();
+      socket.stop();
+      resolve();
+    });
+
+    noble.on('stateChange', (state) => {
+      if (state === 'poweredOn') {
+        noble.startScanning();
+      }
+    });
+  });
+
+(async () => {
+  console.log(
+    `${VALUE.length} byte value, connection interval ${interval} ms, ${rounds} rounds`
+  );
+
+  await run('mtu: 23', 23);
+  await run('mtu: 256 (previous default)', 256);
+  await run('mtu: 517 (default)', 517);
+  await run('mtu: 185', 185);
+  await run('mtu: 185, 2 queued writes', 185, 2);
+
+  process.exit(0);
+})();
@@ -0,0 +1,101 @@
+/*
+ * Notifications from a multi-sensor peripheral through the whole hci-socket
+ * stack against a simulated controller: 6 characteristics notifying at the
+ * same rate, sent one PDU per value and again bundled in Multiple Handle
+ * Value Notifications once the client sets Client Supported Features.
+ *
+ *   node bench/gatt-multiple-notifications.js [rateHz=50] [seconds=3] [intervalMs=30]
+ */
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+
+const rate = parseInt(process.argv[2] || '50', 10);
+const seconds = parseFloat(process.argv[3] || '3');
+const interval = parseFloat(process.argv[4] || '30');
+
+const SENSORS = ['2a37', '2a53', '2a5b', '2a63', '2a6d', '2a6e'];
+
+const run = (name, multipleNotifications) =>
+  new Promise((resolve) => {
+    const fake = new FakePeripheral({
+      localName: 'sensors',
+      serviceUuids: ['1234'],
+      advertisingInterval: 20,
+      multipleNotifications,
+      services: [
+        {
+          uuid: '1234',
+          characteristics: SENSORS.map((uuid) => ({
+            uuid,
+            properties: ['notify'],
+            notifyRate: rate,
+            notifySize: 20
+          }))
+        }
+      ]
+    });
+    const socket = new FakeController({
+      numCommandPackets: 4,
+      peripherals: [fake]
+    });
+    const noble = new Noble(new NobleBindings({ socket, userChannel: true }));
+
+    noble.once('discover', async (peripheral) => {
+      await noble.stopScanningAsync();
+      // in units of 1.25 ms
+      await peripheral.connectAsync({
+        minInterval: Math.round(interval / 1.25),
+        maxInterval: Math.round(interval / 1.25)
+      });
+
+      const { characteristics } =
+        await peripheral.discoverSomeServicesAndCharacteristicsAsync(
+          ['1234'],
+          SENSORS
+        );
+
+      let notifications = 0;
+      for (const characteristic of characteristics) {
+        characteristic.on('data', () => notifications++);
+        await characteristic.subscribeAsync();
+      }
+
+      const packets = socket.stats.aclPacketsSent;
+      const start = process.hrtime.bigint();
+      notifications = 0;
+
+      setTimeout(async () => {
+        const elapsed = Number(process.hrtime.bigint() - start) / 1e9;
+
+        console.log(
+          `${name.padEnd(22)} ${(notifications / elapsed).toFixed(0).padStart(5)} notifications/s ` +
+            `(expected ${SENSORS.length * rate}) in ` +
+            `${((socket.stats.aclPacketsSent - packets) / elapsed).toFixed(0).padStart(5)} ACL packets/s`
+        );
+
+        await peripheral.disconnectAsync();
+        noble.removeAllListeners();
+        socket.stop();
+        resolve();
+      }, seconds * 1000);
+    });
+
+    noble.on('stateChange', (state) => {
+      if (state === 'poweredOn') {
+        noble.startScanning();
+      }
+    });
+  });
+
+(async () => {
+  console.log(
+    `${SENSORS.length} sensors at ${rate} Hz, connection interval ${interval} ms, ${seconds} s`
+  );
+
+  await run('one PDU per value', false);
+  await run('multiple notifications', true);
+
+  process.exit(0);
+})();
@@ -0,0 +1,99 @@
+/*
+ * Notification routing throughput of Gatt#onAclStreamData for one connection.
+ *
+ *   node bench/gatt-notify-routing.js [services=10] [characteristics=10]
+ *
+ * Handle Value Notifications for every discovered characteristic are fed
+ * through a fake ACL stream while a request is outstanding, so each PDU is
+ * also checked against the current command. The service/characteristic scan
+ * and hex comparison Gatt used before are kept below as the baseline.
+ */
+const events = require('events');
+
+const Gatt = require('../lib/hci-socket/gatt');
+
+const ITERATIONS = 500000;
+
+const serviceCount = parseInt(process.argv[2] || '10', 10);
+const characteristicCount = parseInt(process.argv[3] || '10', 10);
+
+// Gatt#onAclStreamData notification path before the value handle index
+const legacyOnAclStreamData = function (cid, data) {
+  if (this._currentCommand && (data.toString('hex') === this._currentCommand.buffer.toString('hex'))) {
+    return;
+  }
+
+  const valueHandle = data.readUInt16LE(1);
+  const valueData = data.slice(3);
+
+  this.emit('handleNotify', this._address, valueHandle, valueData);
+
+  for (const serviceUuid in this._services) {
+    for (const characteristicUuid in this._characteristics[serviceUuid]) {
+      if (this._characteristics[serviceUuid][characteristicUuid].valueHandle === valueHandle) {
+        this.emit('notification', this._address, serviceUuid, characteristicUuid, valueData);
+      }
+    }
+  }
+};
+
+const setup = () => {
+  const aclStream = new events.EventEmitter();
+  aclStream.write = () => {};
+
+  const gatt = new Gatt('00:11:22:33:44:55', aclStream);
+  const pdus = [];
+  let handle = 1;
+
+  for (let s = 0; s < serviceCount; s++) {
+    const serviceUuid = (0x1800 + s).toString(16);
+    const characteristics = [];
+
+    gatt.addService({ uuid: serviceUuid, startHandle: handle, endHandle: handle + characteristicCount * 3 });
+    handle++;
+
+    for (let c = 0; c < characteristicCount; c++) {
+      const valueHandle = handle + 1;
+      characteristics.push({ uuid: (0x2a00 + c).toString(16), startHandle: handle, valueHandle, properties: 0x10 });
+      handle += 3;
+
+      const pdu = Buffer.alloc(3 + 20);
+      pdu[0] = 0x1b;
+      pdu.writeUInt16LE(valueHandle, 1);
+      pdus.push(pdu);
+    }
+
+    gatt.addCharacteristics(serviceUuid, characteristics);
+  }
+
+  // a read request waiting for its response
+  gatt._currentCommand = { buffer: Buffer.from([0x0a, 0x03, 0x00]), callback: () => {} };
+
+  return { gatt, aclStream, pdus };
+};
+
+const run = (name, onAclStreamData) => {
+  const { gatt, aclStream, pdus } = setup();
+  let notifications = 0;
+
+  if (onAclStreamData) {
+    aclStream.removeAllListeners('data');
+    aclStream.on('data', onAclStreamData.bind(gatt));
+  }
+  gatt.on('notification', () => notifications++);
+
+  const start = process.hrtime.bigint();
+  for (let n = 0; n < ITERATIONS; n++) {
+    aclStream.emit('data', 0x0004, pdus[n % pdus.length]);
+  }
+  const elapsed = Number(process.hrtime.bigint() - start) / 1e9;
+
+  console.log(
+    `${name.padEnd(24)} ${(ITERATIONS / elapsed / 1000).toFixed(0).padStart(6)} k notifications/s (${notifications})`
+  );
+};
+
+console.log(`${serviceCount} services x ${characteristicCount} characteristics`);
+
+run('service scan', legacyOnAclStreamData);
+run('value handle index');
@@ -0,0 +1,113 @@
+/*
+ * Reading a handful of characteristics at once through the whole hci-socket
+ * stack against a simulated peripheral: one awaited read after the other,
+ * Peripheral#readMultiple on a server without Read Multiple Variable Length
+ * (queued single reads), and readMultiple on a server with it.
+ *
+ *   node bench/gatt-read-multiple.js [rounds=20] [intervalMs=30]
+ */
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+
+const rounds = parseInt(process.argv[2] || '20', 10);
+const interval = parseFloat(process.argv[3] || '30');
+
+// battery level, firmware revision, manufacturer name, model number
+const UUIDS = ['2a19', '2a26', '2a29', '2a24'];
+
+const sequential = async (peripheral, characteristics) => {
+  const values = [];
+  for (const characteristic of characteristics) {
+    values.push(await characteristic.readAsync());
+  }
+  return values;
+};
+
+const bulk = (peripheral, characteristics) =>
+  peripheral.readMultipleAsync(characteristics);
+
+const run = (name, readMultipleVariable, read) =>
+  new Promise((resolve) => {
+    const fake = new FakePeripheral({
+      localName: 'trainer',
+      serviceUuids: ['180a'],
+      advertisingInterval: 20,
+      readMultipleVariable,
+      services: [
+        {
+          uuid: '180f',
+          characteristics: [
+            { uuid: '2a19', properties: ['read'], value: Buffer.from([0x5f]) }
+          ]
+        },
+        {
+          uuid: '180a',
+          characteristics: [
+            { uuid: '2a26', properties: ['read'], value: Buffer.from('4.2.1') },
+            { uuid: '2a29', properties: ['read'], value: Buffer.from('TrainerCo') },
+            { uuid: '2a24', properties: ['read'], value: Buffer.from('T-1000') }
+          ]
+        }
+      ]
+    });
+    const socket = new FakeController({
+      numCommandPackets: 4,
+      peripherals: [fake]
+    });
+    const noble = new Noble(new NobleBindings({ socket, userChannel: true }));
+
+    noble.once('discover', async (peripheral) => {
+      await noble.stopScanningAsync();
+      // in units of 1.25 ms
+      await peripheral.connectAsync({
+        minInterval: Math.round(interval / 1.25),
+        maxInterval: Math.round(interval / 1.25)
+      });
+
+      const { characteristics } =
+        await peripheral.discoverSomeServicesAndCharacteristicsAsync(
+          [],
+          UUIDS
+        );
+      const ordered = UUIDS.map((uuid) =>
+        characteristics.find((c) => c.uuid === uuid)
+      );
+      const session = socket._connections.values().next().value.session;
+
+      const requests = session.stats.requests;
+      const start = process.hrtime.bigint();
+      for (let i = 0; i < rounds; i++) {
+        await read(peripheral, ordered);
+      }
+      const elapsed = Number(process.hrtime.bigint() - start) / 1e6;
+
+      console.log(
+        `${name.padEnd(32)} ${((session.stats.requests - requests) / rounds)
+          .toFixed(1)
+          .padStart(4)} requests ${(elapsed / rounds).toFixed(1).padStart(6)} ms per read of ${UUIDS.length}`
+      );
+
+      await peripheral.disconnectAsync();
+      noble.removeAllListeners();
+      socket.stop();
+      resolve();
+    });
+
+    noble.on('stateChange', (state) => {
+      if (state === 'poweredOn') {
+        noble.startScanning();
+      }
+    });
+  });
+
+(async () => {
+  console.log(`connection interval ${interval} ms, ${rounds} rounds`);
+
+  await run('awaited reads', true, sequential);
+  await run('readMultiple, single reads', false, bulk);
+  await run('readMultiple, variable length', true, bulk);
+
+  process.exit(0);
+})();
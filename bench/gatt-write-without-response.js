@@ -0,0 +1,134 @@
+/*
+ * Write without response throughput while requests are outstanding, through
+ * the whole hci-socket stack against a simulated peripheral.
+ *
+ *   node bench/gatt-write-without-response.js [seconds=3] [intervalMs=7.5]
+ *
+ * One loop streams 20 byte Write Commands, awaiting each write, while another
+ * keeps a Read Request outstanding at all times, like an upload running next
+ * to status polling. Runs with the ATT command lane and again with the single
+ * queue Gatt had before, where commands waited behind the current request.
+ */
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const Gatt = require('../lib/hci-socket/gatt');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+
+const seconds = parseFloat(process.argv[2] || '3');
+const interval = parseFloat(process.argv[3] || '7.5');
+
+const commandLane = Gatt.prototype._queueCommand;
+
+// every PDU in one FIFO behind _currentCommand
+const singleQueue = function (buffer, callback, writeCallback) {
+  this._commandQueue.push({ buffer, callback, writeCallback });
+
+  if (this._currentCommand === null) {
+    this._writeNextCommand();
+  }
+};
+
+const run = (name, queueCommand) =>
+  new Promise((resolve) => {
+    Gatt.prototype._queueCommand = queueCommand;
+
+    const peripheral = new FakePeripheral({
+      localName: 'uploader',
+      serviceUuids: ['1234'],
+      advertisingInterval: 20,
+      services: [
+        {
+          uuid: '1234',
+          characteristics: [
+            { uuid: 'aaa1', properties: ['writeWithoutResponse'] },
+            { uuid: 'aaa2', properties: ['read'], value: Buffer.from([0x01]) }
+          ]
+        }
+      ]
+    });
+    const socket = new FakeController({
+      numCommandPackets: 4,
+      packetsPerEvent: 6,
+      peripherals: [peripheral]
+    });
+    const noble = new Noble(new NobleBindings({ socket, userChannel: true }));
+
+    let commands = 0;
+    let reads = 0;
+    let running = true;
+
+    peripheral.on('write', (uuid) => {
+      if (uuid === 'aaa1') {
+        commands++;
+      }
+    });
+
+    const measure = async (device, data, status) => {
+      const chunk = Buffer.alloc(20);
+      const start = process.hrtime.bigint();
+
+      const upload = (async () => {
+        while (running) {
+          await data.writeAsync(chunk, true);
+        }
+      })();
+      const poll = (async () => {
+        while (running) {
+          await status.readAsync();
+          reads++;
+        }
+      })();
+
+      setTimeout(() => {
+        running = false;
+      }, seconds * 1000);
+      await Promise.all([upload, poll]);
+
+      const elapsed = Number(process.hrtime.bigint() - start) / 1e9;
+
+      console.log(
+        `${name.padEnd(14)} ${(commands / elapsed).toFixed(0).padStart(6)} writes/s ` +
+          `${(reads / elapsed).toFixed(0).padStart(5)} reads/s`
+      );
+
+      await device.disconnectAsync();
+      noble.removeAllListeners();
+      socket.stop();
+      resolve();
+    };
+
+    noble.once('discover', async (device) => {
+      await noble.stopScanningAsync();
+      // in units of 1.25 ms
+      await device.connectAsync({
+        minInterval: Math.round(interval / 1.25),
+        maxInterval: Math.round(interval / 1.25)
+      });
+
+      const { characteristics } =
+        await device.discoverSomeServicesAndCharacteristicsAsync(
+          ['1234'],
+          ['aaa1', 'aaa2']
+        );
+      const data = characteristics.find((c) => c.uuid === 'aaa1');
+      const status = characteristics.find((c) => c.uuid === 'aaa2');
+
+      measure(device, data, status);
+    });
+
+    noble.on('stateChange', (state) => {
+      if (state === 'poweredOn') {
+        noble.startScanning();
+      }
+    });
+  });
+
+(async () => {
+  console.log(`connection interval ${interval} ms, ${seconds} s per run`);
+
+  await run('command lane', commandLane);
+  await run('single queue', singleQueue);
+
+  process.exit(0);
+})();
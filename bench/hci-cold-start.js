@@ -0,0 +1,53 @@
+/*
+ * Measures the time from Hci#init() to 'poweredOn' against the fake
+ * controller, for different command credit counts and per command latency.
+ *
+ *   node bench/hci-cold-start.js [latencyMs]
+ */
+const Hci = require('../lib/hci-socket/hci');
+const FakeController = require('../lib/hci-socket/fake-controller');
+
+const latency = parseInt(process.argv[2] || '5', 10);
+const runs = 5;
+
+const coldStart = (numCommandPackets) =>
+  new Promise((resolve) => {
+    const socket = new FakeController({
+      numCommandPackets,
+      commandLatency: latency
+    });
+    const hci = new Hci({ socket, userChannel: true });
+    const start = process.hrtime.bigint();
+
+    hci.on('stateChange', (state) => {
+      if (state === 'poweredOn') {
+        resolve({
+          ms: Number(process.hrtime.bigint() - start) / 1e6,
+          commands: socket.stats.commands,
+          violations: socket.stats.creditViolations
+        });
+      }
+    });
+    hci.init();
+  });
+
+const main = async () => {
+  console.log(`command latency: ${latency} ms, ${runs} runs each`);
+
+  for (const credits of [1, 2, 4, 8]) {
+    let total = 0;
+    let last;
+    for (let i = 0; i < runs; i++) {
+      last = await coldStart(credits);
+      total += last.ms;
+    }
+    console.log(
+      `credits ${credits}: ${(total / runs).toFixed(1)} ms to poweredOn ` +
+        `(${last.commands} commands, ${last.violations} credit violations)`
+    );
+  }
+
+  process.exit(0);
+};
+
+main();
@@ -0,0 +1,112 @@
+/*
+ * Connects to N simulated peripherals through the whole hci-socket stack,
+ * subscribes to a notifying characteristic on each and reports notification
+ * throughput, CPU time and controller buffer usage.
+ *
+ *   node bench/hci-notify-load.js [connections=40] [rateHz=50] [seconds=5]
+ */
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+
+const count = parseInt(process.argv[2] || '40', 10);
+const rate = parseInt(process.argv[3] || '50', 10);
+const seconds = parseFloat(process.argv[4] || '5');
+
+const peripherals = [];
+for (let i = 0; i < count; i++) {
+  peripherals.push(
+    new FakePeripheral({
+      localName: `hrm-${i}`,
+      serviceUuids: ['180d'],
+      advertisingInterval: 20,
+      services: [
+        {
+          uuid: '180d',
+          characteristics: [
+            {
+              uuid: '2a37',
+              properties: ['notify'],
+              notifyRate: rate,
+              notifySize: 20
+            },
+            { uuid: '2a38', properties: ['read'], value: Buffer.from([0x01]) }
+          ]
+        }
+      ]
+    })
+  );
+}
+
+const socket = new FakeController({ numCommandPackets: 4, peripherals });
+const noble = new Noble(new NobleBindings({ socket, userChannel: true }));
+
+const discovered = new Map();
+let notifications = 0;
+
+const measure = () => {
+  const cpu = process.cpuUsage();
+  const start = process.hrtime.bigint();
+  notifications = 0;
+
+  setTimeout(() => {
+    const elapsed = Number(process.hrtime.bigint() - start) / 1e9;
+    const { user, system } = process.cpuUsage(cpu);
+
+    console.log(`${count} connections, ${rate} Hz each, ${seconds} s`);
+    console.log(
+      `notifications: ${notifications} (${(notifications / elapsed).toFixed(
+        0
+      )}/s, expected ${count * rate}/s)`
+    );
+    console.log(
+      `cpu: ${((user + system) / 1000).toFixed(0)} ms (${(
+        ((user + system) / 1e6 / elapsed) *
+        100
+      ).toFixed(1)}%)`
+    );
+    console.log(
+      `acl packets: ${socket.stats.aclPacketsSent} in, ${socket.stats.aclPacketsReceived} out, ` +
+        `max controller buffers in use ${socket.stats.maxAclBuffersInUse}, ` +
+        `${socket.stats.aclBufferViolations} buffer violations`
+    );
+
+    process.exit(0);
+  }, seconds * 1000);
+};
+
+const connectAll = async () => {
+  const setupStart = Date.now();
+
+  await Promise.all(
+    Array.from(discovered.values()).map(async (peripheral) => {
+      await peripheral.connectAsync();
+      const { characteristics } =
+        await peripheral.discoverSomeServicesAndCharacteristicsAsync(
+          ['180d'],
+          ['2a37']
+        );
+      characteristics[0].on('data', () => notifications++);
+      await characteristics[0].subscribeAsync();
+    })
+  );
+
+  console.log(`connected and subscribed in ${Date.now() - setupStart} ms`);
+  measure();
+};
+
+noble.on('discover', async (peripheral) => {
+  discovered.set(peripheral.id, peripheral);
+
+  if (discovered.size === count) {
+    await noble.stopScanningAsync();
+    connectAll();
+  }
+});
+
+noble.on('stateChange', (state) => {
+  if (state === 'poweredOn') {
+    noble.startScanning();
+  }
+});
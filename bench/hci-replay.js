@@ -0,0 +1,75 @@
+/*
+ * Replays the controller side of a btsnoop capture through Hci, Gap, Gatt and
+ * noble.js and reports wall clock and CPU time.
+ *
+ *   node bench/hci-replay.js <capture.btsnoop> [original|max|<factor>]
+ *
+ * Captures are recorded with NOBLE_HCI_BTSNOOP_FILE=<file> (or the
+ * btsnoopFile option of the HCI bindings). Without a capture, a cold start
+ * against the fake controller is recorded first.
+ */
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const Hci = require('../lib/hci-socket/hci');
+const FakeController = require('../lib/hci-socket/fake-controller');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+const ReplaySocket = require('../lib/hci-socket/replay-socket');
+
+const speedArg = process.argv[3] || 'max';
+const speed = isNaN(speedArg) ? speedArg : parseFloat(speedArg);
+
+const recordColdStart = (file) =>
+  new Promise((resolve) => {
+    const hci = new Hci({
+      socket: new FakeController({ numCommandPackets: 4, commandLatency: 2 }),
+      userChannel: true,
+      btsnoopFile: file
+    });
+    hci.on('stateChange', (state) => {
+      if (state === 'poweredOn') {
+        hci.closeBtsnoop(resolve);
+      }
+    });
+    hci.init();
+  });
+
+const main = async () => {
+  let file = process.argv[2];
+
+  if (!file) {
+    file = path.join(os.tmpdir(), `noble-bench-${process.pid}.btsnoop`);
+    await recordColdStart(file);
+    process.on('exit', () => fs.unlinkSync(file));
+  }
+
+  const socket = new ReplaySocket(file, { speed });
+  const noble = new Noble(new NobleBindings({ socket, userChannel: true }));
+
+  let discovers = 0;
+  noble.on('discover', () => discovers++);
+  noble.on('stateChange', (state) => {
+    if (state === 'poweredOn') {
+      noble.startScanning([], true);
+    }
+  });
+
+  const cpu = process.cpuUsage();
+  const start = process.hrtime.bigint();
+
+  socket.once('end', () => {
+    const elapsed = Number(process.hrtime.bigint() - start) / 1e6;
+    const { user, system } = process.cpuUsage(cpu);
+
+    console.log(`replayed ${socket.stats.packets} packets at ${speed} speed`);
+    console.log(`wall: ${elapsed.toFixed(1)} ms`);
+    console.log(`cpu: ${((user + system) / 1000).toFixed(1)} ms`);
+    console.log(`discover events: ${discovers}`);
+
+    process.exit(0);
+  });
+};
+
+main();
@@ -0,0 +1,70 @@
+/*
+ * Scans N simulated advertisers through the whole hci-socket stack and
+ * reports discover throughput and CPU time.
+ *
+ *   node bench/hci-scan-load.js [advertisers=500] [seconds=5] [intervalMs=100]
+ */
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+
+const count = parseInt(process.argv[2] || '500', 10);
+const seconds = parseFloat(process.argv[3] || '5');
+const interval = parseInt(process.argv[4] || '100', 10);
+
+const peripherals = [];
+for (let i = 0; i < count; i++) {
+  peripherals.push(
+    new FakePeripheral({
+      localName: `sensor-${i}`,
+      serviceUuids: ['180d', '180f'],
+      manufacturerData: Buffer.from([0x59, 0x00, i & 0xff, i >> 8]),
+      txPowerLevel: -8,
+      advertisingInterval: interval
+    })
+  );
+}
+
+const socket = new FakeController({ numCommandPackets: 4, peripherals });
+const noble = new Noble(new NobleBindings({ socket, userChannel: true }));
+
+let discovers = 0;
+const unique = new Set();
+
+noble.on('discover', (peripheral) => {
+  discovers++;
+  unique.add(peripheral.id);
+});
+
+noble.on('stateChange', (state) => {
+  if (state !== 'poweredOn') {
+    return;
+  }
+
+  noble.startScanning([], true);
+
+  const cpu = process.cpuUsage();
+  const start = process.hrtime.bigint();
+
+  setTimeout(() => {
+    const elapsed = Number(process.hrtime.bigint() - start) / 1e9;
+    const { user, system } = process.cpuUsage(cpu);
+
+    console.log(`${count} advertisers, ${interval} ms interval, ${seconds} s`);
+    console.log(`advertising reports: ${socket.stats.advertisingReports}`);
+    console.log(
+      `discover events: ${discovers} (${(discovers / elapsed).toFixed(0)}/s), ${
+        unique.size
+      } unique`
+    );
+    console.log(
+      `cpu: ${((user + system) / 1000).toFixed(0)} ms (${(
+        ((user + system) / 1e6 / elapsed) *
+        100
+      ).toFixed(1)}%)`
+    );
+
+    process.exit(0);
+  }, seconds * 1000);
+});
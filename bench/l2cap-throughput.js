@@ -0,0 +1,125 @@
+/*
+ * Uploading a firmware image through the whole hci-socket stack against a
+ * simulated peripheral: as GATT long writes of 512 bytes (Prepare and Execute
+ * Write Requests), and over an LE credit based L2CAP channel in 2048 byte
+ * SDUs.
+ *
+ *   node bench/l2cap-throughput.js [kilobytes=64] [intervalMs=15]
+ */
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+
+const kilobytes = parseInt(process.argv[2] || '64', 10);
+const interval = parseFloat(process.argv[3] || '15');
+
+const PSM = 0x0080;
+const IMAGE = Buffer.alloc(kilobytes * 1024);
+for (let i = 0; i < IMAGE.length; i++) {
+  IMAGE[i] = i & 0xff;
+}
+
+const gattLongWrites = async (peripheral, fake) => {
+  const { characteristics } =
+    await peripheral.discoverSomeServicesAndCharacteristicsAsync(
+      ['1234'],
+      ['aaa1']
+    );
+  let received = 0;
+  fake.on('write', (uuid, value) => {
+    received += value.length;
+  });
+
+  for (let offset = 0; offset < IMAGE.length; offset += 512) {
+    await characteristics[0].writeAsync(
+      IMAGE.slice(offset, offset + 512),
+      false
+    );
+  }
+
+  return received;
+};
+
+const l2capChannel = async (peripheral, fake) => {
+  const channel = await peripheral.openL2capChannelAsync(PSM);
+  const chunks = [];
+  fake.on('l2capData', (psm, sdu) => chunks.push(sdu));
+
+  await new Promise((resolve, reject) => {
+    channel.on('error', reject);
+    channel.end(IMAGE, resolve);
+  });
+
+  // the last SDUs are on the air once the controller has them
+  while (chunks.reduce((length, chunk) => length + chunk.length, 0) < IMAGE.length) {
+    await new Promise((resolve) => setTimeout(resolve, interval));
+  }
+
+  if (!Buffer.concat(chunks).equals(IMAGE)) {
+    throw new Error('corrupted upload');
+  }
+  return IMAGE.length;
+};
+
+const run = (name, upload) =>
+  new Promise((resolve) => {
+    const fake = new FakePeripheral({
+      localName: 'bike',
+      serviceUuids: ['1234'],
+      advertisingInterval: 20,
+      mtu: 517,
+      l2capChannels: [{ psm: PSM, mtu: 2048, mps: 247, credits: 10 }],
+      services: [
+        {
+          uuid: '1234',
+          characteristics: [{ uuid: 'aaa1', properties: ['write'] }]
+        }
+      ]
+    });
+    const socket = new FakeController({
+      numCommandPackets: 4,
+      aclBuffers: { length: 251, num: 8 },
+      packetsPerEvent: 8,
+      peripherals: [fake]
+    });
+    const noble = new Noble(new NobleBindings({ socket, userChannel: true }));
+
+    noble.once('discover', async (peripheral) => {
+      await noble.stopScanningAsync();
+      // in units of 1.25 ms
+      await peripheral.connectAsync({
+        minInterval: Math.round(interval / 1.25),
+        maxInterval: Math.round(interval / 1.25)
+      });
+
+      const start = process.hrtime.bigint();
+      const bytes = await upload(peripheral, fake);
+      const elapsed = Number(process.hrtime.bigint() - start) / 1e9;
+
+      console.log(
+        `${name.padEnd(18)} ${(elapsed * 1000).toFixed(0).padStart(6)} ms ` +
+          `${(bytes / 1024 / elapsed).toFixed(1).padStart(6)} kB/s`
+      );
+
+      await peripheral.disconnectAsync();
+      noble.removeAllListeners();
+      socket.stop();
+      resolve();
+    });
+
+    noble.on('stateChange', (state) => {
+      if (state === 'poweredOn') {
+        noble.startScanning();
+      }
+    });
+  });
+
+(async () => {
+  console.log(`${kilobytes} kB image, connection interval ${interval} ms`);
+
+  await run('GATT long writes', gattLongWrites);
+  await run('L2CAP channel', l2capChannel);
+
+  process.exit(0);
+})();
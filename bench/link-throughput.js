@@ -0,0 +1,118 @@
+/*
+ * Link throughput with and without LE Data Length Extension and the LE 2M
+ * PHY, through the whole hci-socket stack against a simulated controller
+ * with 251 byte ACL buffers and connection events of about 5 ms.
+ *
+ *   node bench/link-throughput.js [seconds=2] [intervalMs=15]
+ *
+ * Reads a 512 byte characteristic over and over (ATT MTU 517), then streams
+ * 244 byte Write Commands, each for the given time.
+ */
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+
+const seconds = parseFloat(process.argv[2] || '2');
+const interval = parseFloat(process.argv[3] || '15');
+
+const VALUE = Buffer.alloc(512, 0x5a);
+
+const forSeconds = async (operation) => {
+  const start = process.hrtime.bigint();
+  const end = start + BigInt(Math.round(seconds * 1e9));
+  let bytes = 0;
+
+  while (process.hrtime.bigint() < end) {
+    bytes += await operation();
+  }
+
+  return bytes / (Number(process.hrtime.bigint() - start) / 1e9) / 1024;
+};
+
+const run = (name, linkOptions) =>
+  new Promise((resolve) => {
+    const fake = new FakePeripheral({
+      localName: 'logger',
+      serviceUuids: ['1234'],
+      advertisingInterval: 20,
+      mtu: 517,
+      services: [
+        {
+          uuid: '1234',
+          characteristics: [
+            {
+              uuid: 'aaa1',
+              properties: ['read', 'writeWithoutResponse'],
+              value: VALUE
+            }
+          ]
+        }
+      ]
+    });
+    const socket = new FakeController({
+      numCommandPackets: 4,
+      aclBuffers: { length: 251, num: 8 },
+      packetsPerEvent: 8,
+      peripherals: [fake]
+    });
+    const noble = new Noble(new NobleBindings({ socket, userChannel: true }));
+
+    noble.once('discover', async (peripheral) => {
+      await noble.stopScanningAsync();
+      await peripheral.connectAsync(
+        Object.assign(
+          {
+            // in units of 1.25 ms
+            minInterval: Math.round(interval / 1.25),
+            maxInterval: Math.round(interval / 1.25)
+          },
+          linkOptions
+        )
+      );
+
+      const { characteristics } =
+        await peripheral.discoverSomeServicesAndCharacteristicsAsync(
+          ['1234'],
+          ['aaa1']
+        );
+      const characteristic = characteristics[0];
+      const connection = socket._connections.values().next().value;
+      const chunk = Buffer.alloc(244);
+
+      const read = await forSeconds(
+        async () => (await characteristic.readAsync()).length
+      );
+      const write = await forSeconds(async () => {
+        await characteristic.writeAsync(chunk, true);
+        return chunk.length;
+      });
+
+      console.log(
+        `${name.padEnd(26)} ${String(connection.txOctets).padStart(3)} octets ` +
+          `${connection.phy === 0x02 ? '2M' : '1M'}  ` +
+          `read ${read.toFixed(1).padStart(5)} kB/s  write ${write.toFixed(1).padStart(5)} kB/s`
+      );
+
+      await peripheral.disconnectAsync();
+      noble.removeAllListeners();
+      socket.stop();
+      resolve();
+    });
+
+    noble.on('stateChange', (state) => {
+      if (state === 'poweredOn') {
+        noble.startScanning();
+      }
+    });
+  });
+
+(async () => {
+  console.log(`connection interval ${interval} ms, ${seconds} s per run`);
+
+  await run("dataLength: false, '1m'", { dataLength: false, phy: '1m' });
+  await run("dataLength: 251, '1m'", { dataLength: 251, phy: '1m' });
+  await run("dataLength: 251, '2m'", {});
+
+  process.exit(0);
+})();
@@ -0,0 +1,137 @@
+/*
+ * Connects to N notifying trainers through one Noble instance on 1, 2 and 3
+ * simulated adapters of `maxConnections` links each, and reports how many
+ * connected, the time to connect and subscribe to all of them and the
+ * notification throughput.
+ *
+ *   node bench/multi-adapter.js [trainers=20] [maxConnections=8] [seconds=3]
+ */
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const ShardedBindings = require('../lib/hci-socket/sharded-bindings');
+const Noble = require('../lib/noble');
+
+const count = parseInt(process.argv[2] || '20', 10);
+const maxConnections = parseInt(process.argv[3] || '8', 10);
+const seconds = parseFloat(process.argv[4] || '3');
+
+const RATE = 20; // notifications per second and trainer
+
+const run = (adapters) =>
+  new Promise((resolve) => {
+    const trainers = Array.from(
+      { length: count },
+      (_, i) =>
+        new FakePeripheral({
+          localName: `trainer ${i}`,
+          serviceUuids: ['1826'],
+          advertisingInterval: 50,
+          services: [
+            {
+              uuid: '1826',
+              characteristics: [
+                {
+                  uuid: '2ad2',
+                  properties: ['notify'],
+                  notifyRate: RATE,
+                  notifySize: 20
+                }
+              ]
+            }
+          ]
+        })
+    );
+    const sockets = Array.from(
+      { length: adapters },
+      () =>
+        new FakeController({
+          numCommandPackets: 4,
+          maxConnections,
+          peripherals: trainers
+        })
+    );
+    const bindings = new ShardedBindings({
+      userChannel: true,
+      keyStore: false,
+      connectionScheduler: { retries: 0 },
+      adapters: sockets.map((socket) => ({ socket }))
+    });
+    const noble = new Noble(bindings);
+
+    const discovered = new Map();
+    let subscribed = 0;
+    let failed = 0;
+    let notifications = 0;
+    let setupStart = 0;
+
+    const measure = () => {
+      const setupTime = Date.now() - setupStart;
+      notifications = 0;
+
+      setTimeout(() => {
+        console.log(
+          `${adapters} adapter${adapters > 1 ? 's' : ' '} ${subscribed}/${count} trainers ` +
+            `(${failed} refused) in ${setupTime} ms, ` +
+            `${(notifications / seconds).toFixed(0)} notifications/s of ${subscribed * RATE}/s, ` +
+            `per adapter ${bindings.adapters.map((_, index) => bindings.load(index)).join(' / ')}`
+        );
+
+        noble.removeAllListeners();
+        for (const adapter of bindings.adapters) {
+          adapter.connectionScheduler.stop();
+        }
+        for (const socket of sockets) {
+          socket.stop();
+        }
+        resolve();
+      }, seconds * 1000);
+    };
+
+    const setUp = async (peripheral) => {
+      try {
+        await peripheral.connectAsync();
+      } catch (error) {
+        failed++;
+        return;
+      }
+
+      const { characteristics } =
+        await peripheral.discoverSomeServicesAndCharacteristicsAsync(
+          ['1826'],
+          ['2ad2']
+        );
+      characteristics[0].on('data', () => notifications++);
+      await characteristics[0].subscribeAsync();
+      subscribed++;
+    };
+
+    noble.on('discover', async (peripheral) => {
+      discovered.set(peripheral.id, peripheral);
+
+      if (discovered.size === count) {
+        await noble.stopScanningAsync();
+
+        setupStart = Date.now();
+        await Promise.all(Array.from(discovered.values()).map(setUp));
+        measure();
+      }
+    });
+
+    noble.on('stateChange', (state) => {
+      if (state === 'poweredOn') {
+        noble.startScanning();
+      }
+    });
+  });
+
+(async () => {
+  console.log(
+    `${count} trainers at ${RATE} Hz, ${maxConnections} connections per adapter, ${seconds} s`
+  );
+
+  for (const adapters of [1, 2, 3]) {
+    await run(adapters);
+  }
+
+  process.exit(0);
+})();
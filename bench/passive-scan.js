@@ -0,0 +1,92 @@
+/*
+ * Scans N simulated connectable advertisers, whose local name is in their
+ * scan response, actively and passively through the whole hci-socket stack.
+ * Reports the time from scanStart to each device's first discover event, the
+ * advertising reports and discover events per second and the CPU time.
+ *
+ *   node bench/passive-scan.js [advertisers=200] [seconds=3] [intervalMs=100]
+ */
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+
+const count = parseInt(process.argv[2] || '200', 10);
+const seconds = parseFloat(process.argv[3] || '3');
+const interval = parseInt(process.argv[4] || '100', 10);
+
+const percentile = (values, p) =>
+  values.length === 0
+    ? NaN
+    : values[Math.min(values.length - 1, Math.floor(values.length * p))];
+
+const run = (passive) =>
+  new Promise((resolve) => {
+    const peripherals = Array.from(
+      { length: count },
+      (_, i) =>
+        new FakePeripheral({
+          localName: `trainer-${i}`,
+          serviceUuids: ['1826'],
+          manufacturerData: Buffer.from([0x59, 0x00, i & 0xff, i >> 8]),
+          advertisingInterval: interval
+        })
+    );
+    const socket = new FakeController({ numCommandPackets: 4, peripherals });
+    const noble = new Noble(
+      new NobleBindings({ socket, userChannel: true, keyStore: false })
+    );
+
+    const firstSeen = new Map();
+    let discovers = 0;
+    let start = 0;
+
+    noble.on('scanStart', () => {
+      start = performance.now();
+    });
+
+    noble.on('discover', (peripheral) => {
+      discovers++;
+      if (!firstSeen.has(peripheral.id)) {
+        firstSeen.set(peripheral.id, performance.now() - start);
+      }
+    });
+
+    noble.on('stateChange', (state) => {
+      if (state !== 'poweredOn') {
+        return;
+      }
+
+      noble.startScanning({ passive }, true);
+
+      const cpu = process.cpuUsage();
+      const reports = socket.stats.advertisingReports;
+
+      setTimeout(() => {
+        const { user, system } = process.cpuUsage(cpu);
+        const latencies = Array.from(firstSeen.values()).sort((a, b) => a - b);
+
+        console.log(
+          `${passive ? 'passive' : 'active '}: ${firstSeen.size}/${count} discovered, ` +
+            `first discover median ${percentile(latencies, 0.5).toFixed(0)} ms, ` +
+            `p95 ${percentile(latencies, 0.95).toFixed(0)} ms, ` +
+            `${((socket.stats.advertisingReports - reports) / seconds).toFixed(0)} reports/s, ` +
+            `${(discovers / seconds).toFixed(0)} discovers/s, ` +
+            `cpu ${((user + system) / 1000).toFixed(0)} ms`
+        );
+
+        noble.removeAllListeners();
+        socket.stop();
+        resolve();
+      }, seconds * 1000);
+    });
+  });
+
+(async () => {
+  console.log(`${count} advertisers, ${interval} ms interval, ${seconds} s`);
+
+  await run(false);
+  await run(true);
+
+  process.exit(0);
+})();
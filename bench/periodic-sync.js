@@ -0,0 +1,113 @@
+/*
+ * Follows the periodic advertising trains of N simulated sensors from one
+ * adapter through the whole hci-socket stack, without connecting: syncs to
+ * each as it is discovered, then stops scanning. Reports how long it took to
+ * follow them all, the periodic reports per second delivered against what the
+ * trains sent, the latency from a train's event to its periodicAdvertisement
+ * and the CPU time.
+ *
+ *   node bench/periodic-sync.js [sensors=300] [seconds=3] [intervalMs=100] [size=20]
+ */
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+
+const count = parseInt(process.argv[2] || '300', 10);
+const seconds = parseFloat(process.argv[3] || '3');
+const interval = parseInt(process.argv[4] || '100', 10);
+const size = parseInt(process.argv[5] || '20', 10);
+
+const percentile = (values, p) =>
+  values.length === 0
+    ? NaN
+    : values[Math.min(values.length - 1, Math.floor(values.length * p))];
+
+const now = () => performance.timeOrigin + performance.now();
+
+const peripherals = Array.from(
+  { length: count },
+  (_, i) =>
+    new FakePeripheral({
+      connectable: false,
+      manufacturerData: Buffer.from([0x59, 0x00, i & 0xff, i >> 8]),
+      advertisingInterval: 50,
+      periodicAdvertising: { sid: i & 0x0f, interval, size }
+    })
+);
+const socket = new FakeController({ numCommandPackets: 4, peripherals });
+const bindings = new NobleBindings({
+  socket,
+  userChannel: true,
+  keyStore: false,
+  extended: true
+});
+const noble = new Noble(bindings);
+
+const synced = new Set();
+const failed = new Set();
+let start = 0;
+
+const measure = () => {
+  const latencies = [];
+  const reports = socket.stats.periodicReports;
+  const cpu = process.cpuUsage();
+
+  for (const peripheral of Object.values(noble._peripherals)) {
+    peripheral.on('periodicAdvertisement', (data) => {
+      latencies.push(now() - data.readDoubleLE(4));
+    });
+  }
+
+  setTimeout(() => {
+    const { user, system } = process.cpuUsage(cpu);
+    latencies.sort((a, b) => a - b);
+
+    console.log(
+      `${(latencies.length / seconds).toFixed(0)} periodicAdvertisement/s of ` +
+        `${((socket.stats.periodicReports - reports) / seconds).toFixed(0)} reports/s sent, ` +
+        `latency median ${percentile(latencies, 0.5).toFixed(2)} ms, ` +
+        `p99 ${percentile(latencies, 0.99).toFixed(2)} ms, ` +
+        `cpu ${((user + system) / 1000).toFixed(0)} ms ` +
+        `(${(((user + system) / 1000 / (seconds * 1000)) * 100).toFixed(1)}%)`
+    );
+
+    noble.removeAllListeners();
+    socket.stop();
+    process.exit(0);
+  }, seconds * 1000);
+};
+
+const done = () => {
+  if (synced.size + failed.size < count) {
+    return;
+  }
+
+  console.log(
+    `${synced.size}/${count} followed in ${(performance.now() - start).toFixed(0)} ms ` +
+      `(${failed.size} failed), no connections`
+  );
+  noble.stopScanning();
+  measure();
+};
+
+noble.on('discover', (peripheral) => {
+  if (synced.has(peripheral.id) || peripheral.listenerCount('periodicSync') > 0) {
+    return;
+  }
+
+  peripheral.syncPeriodicAdvertising((error) => {
+    (error ? failed : synced).add(peripheral.id);
+    done();
+  });
+});
+
+noble.on('stateChange', (state) => {
+  if (state === 'poweredOn') {
+    console.log(
+      `${count} sensors, ${interval} ms trains of ${size} bytes, ${seconds} s`
+    );
+    start = performance.now();
+    noble.startScanning([], true);
+  }
+});
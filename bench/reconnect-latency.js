@@ -0,0 +1,151 @@
+/*
+ * Trainers dropping out of range and coming back, through the whole
+ * hci-socket stack against a simulated controller. Each round every trainer
+ * loses its link, stays away for 200 - 600 ms and advertises again; the time
+ * from its first advertising event back to the 'connect' event is measured.
+ *
+ * "scan and connect" is what apps do today: scan again on disconnect and
+ * connect from the discover callback. "accept list" leaves it to the
+ * controller: the bindings keep the disconnected trainers on the Filter
+ * Accept List with a Create Connection pending.
+ *
+ *   node bench/reconnect-latency.js [trainers=8] [rounds=5] [advertisingIntervalMs=100]
+ */
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+
+const count = parseInt(process.argv[2] || '8', 10);
+const rounds = parseInt(process.argv[3] || '5', 10);
+const advertisingInterval = parseInt(process.argv[4] || '100', 10);
+
+const wait = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+const percentile = (values, p) =>
+  values[Math.min(values.length - 1, Math.floor(values.length * p))];
+
+const run = (name, acceptList) =>
+  new Promise((resolve) => {
+    const fakes = Array.from(
+      { length: count },
+      (_, i) =>
+        new FakePeripheral({
+          localName: `trainer ${i}`,
+          serviceUuids: ['1826'],
+          advertisingInterval
+        })
+    );
+    const socket = new FakeController({
+      numCommandPackets: 4,
+      acceptListSize: count,
+      peripherals: fakes
+    });
+    const bindings = new NobleBindings({ socket, userChannel: true });
+
+    // address -> when the trainer came back: its first advertising event
+    const away = new Set();
+    const returned = new Map();
+    const initiate = socket.initiate.bind(socket);
+    socket.initiate = (fake) => {
+      if (away.delete(fake.address)) {
+        returned.set(fake.address, Date.now());
+      }
+      initiate(fake);
+    };
+
+    const noble = new Noble(bindings);
+
+    const peripherals = new Map();
+    const latencies = [];
+    const missing = new Set();
+
+    const onDiscover = (peripheral) => {
+      if (!peripherals.has(peripheral.address)) {
+        peripherals.set(peripheral.address, peripheral);
+        peripheral.on('connect', (error) => {
+          if (!error && returned.has(peripheral.address)) {
+            latencies.push(Date.now() - returned.get(peripheral.address));
+            returned.delete(peripheral.address);
+          }
+        });
+      }
+
+      if (!acceptList && missing.has(peripheral.address)) {
+        missing.delete(peripheral.address);
+        if (missing.size === 0) {
+          noble.stopScanning();
+        }
+        peripheral.connect();
+      }
+    };
+
+    noble.on('discover', onDiscover);
+
+    noble.on('stateChange', async (state) => {
+      if (state !== 'poweredOn') {
+        return;
+      }
+
+      await noble.startScanningAsync([], true);
+      while (peripherals.size < count) {
+        await wait(advertisingInterval);
+      }
+      await noble.stopScanningAsync();
+
+      for (const peripheral of peripherals.values()) {
+        await peripheral.connectAsync();
+        if (acceptList) {
+          bindings.autoReconnect(peripheral.id);
+        }
+      }
+
+      for (let round = 0; round < rounds; round++) {
+        for (const fake of fakes) {
+          socket.dropConnection(fake);
+          socket.removePeripheral(fake);
+          missing.add(fake.address);
+        }
+        if (!acceptList) {
+          noble.startScanning([], true);
+        }
+
+        await Promise.all(
+          fakes.map(async (fake) => {
+            await wait(200 + Math.random() * 400);
+            away.add(fake.address);
+            socket.addPeripheral(fake);
+          })
+        );
+
+        while (away.size > 0 || returned.size > 0) {
+          await wait(10);
+        }
+        missing.clear();
+      }
+
+      latencies.sort((a, b) => a - b);
+
+      console.log(
+        `${name.padEnd(17)} median ${percentile(latencies, 0.5)} ms, ` +
+          `p90 ${percentile(latencies, 0.9)} ms, max ${latencies[latencies.length - 1]} ms ` +
+          `(${latencies.length} reconnections)`
+      );
+
+      bindings.connectionScheduler.stop();
+      noble.removeAllListeners();
+      socket.stop();
+      resolve();
+    });
+  });
+
+(async () => {
+  console.log(
+    `${count} trainers, ${rounds} rounds, advertising every ${advertisingInterval} ms`
+  );
+
+  await run('scan and connect', false);
+  await run('accept list', true);
+
+  process.exit(0);
+})();
@@ -0,0 +1,110 @@
+/*
+ * CPU time per 10k advertising reports with and without a scan filter, on a
+ * replayed capture of a crowded scan: one advertiser in 20 carries the
+ * manufacturer ID the filter asks for. Each case runs with the JS advertising
+ * data parser and with the native decoder.
+ *
+ *   node bench/scan-filter.js [reports=20000] [advertisers=500]
+ */
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+const ReplaySocket = require('../lib/hci-socket/replay-socket');
+
+const reports = parseInt(process.argv[2] || '20000', 10);
+const count = parseInt(process.argv[3] || '500', 10);
+
+const FILTER = { manufacturerId: 0x0059 };
+
+const record = (file) =>
+  new Promise((resolve) => {
+    const peripherals = [];
+    for (let i = 0; i < count; i++) {
+      peripherals.push(
+        new FakePeripheral({
+          localName: `sensor-${i}`,
+          serviceUuids: ['180d', '180f'],
+          manufacturerData: Buffer.from([i % 20 === 0 ? 0x59 : 0x4c, 0x00, i & 0xff, i >> 8]),
+          txPowerLevel: -8,
+          advertisingInterval: 20
+        })
+      );
+    }
+
+    const socket = new FakeController({ numCommandPackets: 4, peripherals });
+    const bindings = new NobleBindings({ socket, userChannel: true, btsnoopFile: file });
+    const noble = new Noble(bindings);
+
+    noble.on('stateChange', (state) => {
+      if (state === 'poweredOn') {
+        noble.startScanning([], true);
+      }
+    });
+
+    const poll = setInterval(() => {
+      if (socket.stats.advertisingReports >= reports) {
+        clearInterval(poll);
+        noble.stopScanning();
+        bindings._hci.closeBtsnoop(() => {
+          socket.stop();
+          resolve(socket.stats.advertisingReports);
+        });
+      }
+    }, 10);
+  });
+
+const replay = (file, filter, adDecoder) =>
+  new Promise((resolve) => {
+    const socket = new ReplaySocket(file, { speed: 'max' });
+    const options = { socket, userChannel: true };
+    if (adDecoder === null) {
+      options.adDecoder = null;
+    }
+    const noble = new Noble(new NobleBindings(options));
+
+    let discovers = 0;
+    let cpu = null;
+
+    noble.on('discover', () => discovers++);
+    noble.on('stateChange', (state) => {
+      if (state === 'poweredOn') {
+        noble.startScanning(filter || [], true);
+      }
+    });
+    noble.once('scanStart', () => {
+      cpu = process.cpuUsage();
+    });
+
+    socket.once('end', () => {
+      const { user, system } = process.cpuUsage(cpu);
+      resolve({ cpu: (user + system) / 1000, discovers });
+    });
+  });
+
+(async () => {
+  const file = path.join(os.tmpdir(), `noble-scan-filter-${process.pid}.btsnoop`);
+  const recorded = await record(file);
+
+  console.log(`${recorded} advertising reports from ${count} advertisers`);
+
+  for (const [name, adDecoder] of [['JS parser', null], ['native decoder', undefined]]) {
+    for (const [label, filter] of [['no filter', null], ['manufacturer ID', FILTER]]) {
+      // warm up, then measure
+      await replay(file, filter, adDecoder);
+      const { cpu, discovers } = await replay(file, filter, adDecoder);
+
+      console.log(
+        `${name.padEnd(15)} ${label.padEnd(16)} ${((cpu * 10000) / recorded).toFixed(1)} ms cpu / 10k reports, ` +
+          `${discovers} discover events`
+      );
+    }
+  }
+
+  fs.unlinkSync(file);
+  process.exit(0);
+})();
@@ -0,0 +1,179 @@
+/*
+ * Scanning for new devices while connected to notifying trainers, through
+ * the whole hci-socket stack against a simulated controller whose scanner,
+ * initiator and connections share one radio. For each scan policy: the time
+ * to connect the trainers, once all are discovered, while the scan goes on,
+ * then, with them connected, the time from a new device showing up to its
+ * discover event, the connection events the scan took, the links lost to
+ * supervision timeouts and the notifications that made it. Trainers get 5 s
+ * to connect and subscribe, lost links are not reconnected.
+ *
+ *   node bench/scan-scheduler.js [trainers=6] [seconds=5] [scanPriority=0.9]
+ */
+const FakeController = require('../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../lib/hci-socket/fake-peripheral');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const Noble = require('../lib/noble');
+
+const count = parseInt(process.argv[2] || '6', 10);
+const seconds = parseFloat(process.argv[3] || '5');
+const scanPriority = parseFloat(process.argv[4] || '0.9');
+
+const RATE = 20; // notifications per second and trainer
+const NEWCOMER_INTERVAL = 250; // ms between new devices showing up
+const SETUP_TIMEOUT = 5000;
+
+const percentile = (values, p) =>
+  values.length === 0
+    ? NaN
+    : values[Math.min(values.length - 1, Math.floor(values.length * p))];
+
+const run = (policy) =>
+  new Promise((resolve) => {
+    const trainers = Array.from(
+      { length: count },
+      (_, i) =>
+        new FakePeripheral({
+          localName: `trainer ${i}`,
+          serviceUuids: ['1826'],
+          advertisingInterval: 100,
+          services: [
+            {
+              uuid: '1826',
+              characteristics: [
+                {
+                  uuid: '2ad2',
+                  properties: ['notify'],
+                  notifyRate: RATE,
+                  notifySize: 20
+                }
+              ]
+            }
+          ]
+        })
+    );
+    const socket = new FakeController({
+      numCommandPackets: 4,
+      sharedRadio: true,
+      scanPriority,
+      peripherals: trainers
+    });
+    const bindings = new NobleBindings({
+      socket,
+      userChannel: true,
+      scanPolicy: policy
+    });
+    const noble = new Noble(bindings);
+
+    const trainerAddresses = new Set(trainers.map((fake) => fake.address));
+    const connectTimes = [];
+    let subscribed = 0;
+    let notifications = 0;
+    let setupTimer = null;
+
+    // address -> when it first advertised
+    const added = new Map();
+    const latencies = [];
+    let newcomers = null;
+
+    const report = () => {
+      clearInterval(newcomers);
+
+      const { connectionEvents, missedConnectionEvents, supervisionTimeouts } =
+        socket.stats;
+      connectTimes.sort((a, b) => a - b);
+      latencies.sort((a, b) => a - b);
+
+      console.log(
+        `${policy.padEnd(20)} ${subscribed}/${count} trainers set up, ` +
+          `connect median ${percentile(connectTimes, 0.5)} ms, ` +
+          `discovery median ${percentile(latencies, 0.5)} ms, p90 ${percentile(latencies, 0.9)} ms, ` +
+          `${added.size - latencies.length}/${added.size} not found, ` +
+          `${((missedConnectionEvents * 100) / connectionEvents).toFixed(1)}% connection events missed, ` +
+          `${supervisionTimeouts} supervision timeouts, ` +
+          `${((notifications * 100) / (count * RATE * seconds)).toFixed(0)}% notifications`
+      );
+
+      noble.removeAllListeners();
+      bindings.scanScheduler.stop();
+      bindings.connectionScheduler.stop();
+      socket.stop();
+      resolve();
+    };
+
+    const measure = () => {
+      clearTimeout(setupTimer);
+      setupTimer = null;
+
+      notifications = 0;
+      socket.stats.connectionEvents = 0;
+      socket.stats.missedConnectionEvents = 0;
+
+      newcomers = setInterval(() => {
+        const fake = new FakePeripheral({
+          localName: 'newcomer',
+          serviceUuids: ['180d'],
+          advertisingInterval: 100
+        });
+        added.set(fake.address, Date.now());
+        socket.addPeripheral(fake);
+      }, NEWCOMER_INTERVAL);
+
+      setTimeout(report, seconds * 1000);
+    };
+
+    const setUp = async (peripheral) => {
+      const start = Date.now();
+
+      await peripheral.connectAsync();
+      connectTimes.push(Date.now() - start);
+
+      const { characteristics } =
+        await peripheral.discoverSomeServicesAndCharacteristicsAsync(
+          ['1826'],
+          ['2ad2']
+        );
+      characteristics[0].on('data', () => notifications++);
+      await characteristics[0].subscribeAsync();
+
+      if (++subscribed === count && setupTimer !== null) {
+        measure();
+      }
+    };
+
+    const discovered = [];
+
+    noble.on('discover', (peripheral) => {
+      if (trainerAddresses.delete(peripheral.address)) {
+        discovered.push(peripheral);
+
+        if (discovered.length === count) {
+          setupTimer = setTimeout(measure, SETUP_TIMEOUT);
+          for (const trainer of discovered) {
+            setUp(trainer).catch(() => {});
+          }
+        }
+      } else if (added.has(peripheral.address)) {
+        latencies.push(Date.now() - added.get(peripheral.address));
+      }
+    });
+
+    noble.on('stateChange', (state) => {
+      if (state === 'poweredOn') {
+        noble.startScanning();
+      }
+    });
+  });
+
+(async () => {
+  console.log(
+    `${count} trainers at ${RATE} Hz, a new device every ${NEWCOMER_INTERVAL} ms ` +
+      `for ${seconds} s, scan priority ${scanPriority}`
+  );
+
+  for (const policy of ['continuous', 'aggressive', 'background', 'pausedWhenConnected']) {
+    await run(policy);
+  }
+
+  process.exit(0);
+})();
@@ -0,0 +1,219 @@
+/*
+ * Notification latency with a main thread that is busy `block` ms out of
+ * every 100, like an app rendering or crunching numbers: from the simulated
+ * peripheral stamping a notification to its data event, with the hci-socket
+ * stack on the main thread and in a worker (`worker: true`). The simulated
+ * controller runs in a thread of its own in both cases, so a blocked main
+ * thread doesn't stop the radio, only the host. Reports the median and p99
+ * latency and the notifications delivered, and the indications delivered from
+ * a second characteristic, which the peripheral holds back until the previous
+ * one is confirmed.
+ *
+ *   node bench/worker-notify-latency.js [trainers=4] [seconds=5] [block=50]
+ */
+const events = require('events');
+const util = require('util');
+const { Worker, isMainThread, parentPort, workerData } = require('worker_threads');
+
+const FakeController = require('../lib/hci-socket/fake-controller');
+
+const RATE = 50; // notifications per second and trainer
+const PERIOD = 100; // ms between the main thread's busy spells
+
+const trainerOptions = (count) =>
+  Array.from({ length: count }, (_, i) => ({
+    localName: `trainer ${i}`,
+    serviceUuids: ['1826'],
+    advertisingInterval: 20,
+    services: [
+      {
+        uuid: '1826',
+        characteristics: [
+          {
+            uuid: '2ad2',
+            properties: ['notify'],
+            notifyRate: RATE,
+            notifySize: 20
+          },
+          {
+            uuid: '2ada',
+            properties: ['indicate'],
+            notifyRate: RATE,
+            notifySize: 20
+          }
+        ]
+      }
+    ]
+  }));
+
+const socketOptions = (count) => ({
+  numCommandPackets: 4,
+  peripherals: trainerOptions(count)
+});
+
+if (!isMainThread) {
+  // the simulated controller for the main thread mode, over messages
+  const controller = new FakeController(workerData);
+  controller.on('data', (data) => parentPort.postMessage(data));
+  parentPort.on('message', ([method, args]) =>
+    controller[method](...args.map((arg) => (arg instanceof Uint8Array ? Buffer.from(arg) : arg)))
+  );
+  return;
+}
+
+// a socket whose controller is in another thread
+const ThreadSocket = function (count) {
+  this._worker = new Worker(__filename, { workerData: socketOptions(count) });
+  this._worker.on('message', (data) => this.emit('data', Buffer.from(data)));
+};
+
+util.inherits(ThreadSocket, events.EventEmitter);
+
+for (const method of ['bindRaw', 'bindUser', 'start', 'setFilter', 'write']) {
+  ThreadSocket.prototype[method] = function (...args) {
+    this._worker.postMessage([method, args]);
+  };
+}
+
+ThreadSocket.prototype.isDevUp = function () {
+  return true;
+};
+
+ThreadSocket.prototype.close = function () {
+  return this._worker.terminate();
+};
+
+const Noble = require('../lib/noble');
+const NobleBindings = require('../lib/hci-socket/bindings');
+const WorkerBindings = require('../lib/hci-socket/worker-bindings');
+
+const count = parseInt(process.argv[2] || '4', 10);
+const seconds = parseFloat(process.argv[3] || '5');
+const block = parseFloat(process.argv[4] || '50');
+
+const percentile = (values, p) =>
+  values.length === 0
+    ? NaN
+    : values[Math.min(values.length - 1, Math.floor(values.length * p))];
+
+const now = () => performance.timeOrigin + performance.now();
+
+const busy = (ms) => {
+  const end = Date.now() + ms;
+  while (Date.now() < end);
+};
+
+const run = (worker, blockFor) =>
+  new Promise((resolve) => {
+    const options = { userChannel: true, keyStore: false };
+    let socket = null;
+    let bindings;
+
+    if (worker) {
+      bindings = new WorkerBindings(
+        Object.assign(options, {
+          socketModule: require.resolve('../lib/hci-socket/fake-controller'),
+          socketOptions: socketOptions(count)
+        })
+      );
+    } else {
+      socket = new ThreadSocket(count);
+      bindings = new NobleBindings(Object.assign(options, { socket }));
+    }
+
+    const noble = new Noble(bindings);
+    const discovered = new Map();
+    let latencies = [];
+    let indications = 0;
+    let measuring = false;
+    let blocker = null;
+
+    const onData = (data) => {
+      if (measuring) {
+        latencies.push(now() - data.readDoubleLE(4));
+      }
+    };
+
+    const onIndication = () => {
+      if (measuring) {
+        indications++;
+      }
+    };
+
+    const setUp = async (peripheral) => {
+      await peripheral.connectAsync();
+      const { characteristics } =
+        await peripheral.discoverSomeServicesAndCharacteristicsAsync(
+          ['1826'],
+          ['2ad2', '2ada']
+        );
+      for (const characteristic of characteristics) {
+        characteristic.on('data', characteristic.uuid === '2ad2' ? onData : onIndication);
+        await characteristic.subscribeAsync();
+      }
+    };
+
+    const measure = () => {
+      latencies = [];
+      indications = 0;
+      measuring = true;
+
+      if (blockFor > 0) {
+        blocker = setInterval(() => busy(blockFor), PERIOD);
+      }
+
+      setTimeout(async () => {
+        clearInterval(blocker);
+        measuring = false;
+        latencies.sort((a, b) => a - b);
+
+        console.log(
+          `${worker ? 'worker     ' : 'main thread'} block ${blockFor} ms: ` +
+            `latency median ${percentile(latencies, 0.5).toFixed(2)} ms, ` +
+            `p99 ${percentile(latencies, 0.99).toFixed(2)} ms, ` +
+            `${latencies.length}/${count * RATE * seconds} notifications, ` +
+            `${indications}/${count * RATE * seconds} indications`
+        );
+
+        noble.removeAllListeners();
+        if (worker) {
+          bindings.stop();
+          await new Promise((resolve) => bindings._worker.once('exit', resolve));
+        } else {
+          bindings.onExit();
+          await socket.close();
+        }
+        resolve();
+      }, seconds * 1000);
+    };
+
+    noble.on('discover', async (peripheral) => {
+      discovered.set(peripheral.id, peripheral);
+
+      if (discovered.size === count) {
+        await noble.stopScanningAsync();
+        await Promise.all(Array.from(discovered.values()).map(setUp));
+        measure();
+      }
+    });
+
+    noble.on('stateChange', (state) => {
+      if (state === 'poweredOn') {
+        noble.startScanning();
+      }
+    });
+  });
+
+(async () => {
+  console.log(
+    `${count} trainers at ${RATE} Hz, main thread busy ${block} ms of every ${PERIOD}, ${seconds} s`
+  );
+
+  for (const blockFor of [0, block]) {
+    for (const worker of [false, true]) {
+      await run(worker, blockFor);
+    }
+  }
+
+  process.exit(0);
+})();
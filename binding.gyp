@@ -2,6 +2,9 @@
   'targets': [
     {
       'target_name': 'noble',
+      'dependencies': [
+        'lib/ad-decoder/binding.gyp:ad_decoder',
+      ],
       'conditions': [
         ['OS=="mac"', {
           'dependencies': [
@@ -0,0 +1,42 @@
+# This file is generated by gyp; do not edit.
+
+TOOLSET := target
+TARGET := noble
+### Rules for final target.
+LDFLAGS_Debug := \
+	-pthread \
+	-rdynamic \
+	-m64
+
+LDFLAGS_Release := \
+	-pthread \
+	-rdynamic \
+	-m64
+
+LIBS :=
+
+$(obj).target/noble.node: GYP_LDFLAGS := $(LDFLAGS_$(BUILDTYPE))
+$(obj).target/noble.node: LIBS := $(LIBS)
+$(obj).target/noble.node: TOOLSET := $(TOOLSET)
+$(obj).target/noble.node:  FORCE_DO_CMD
+	$(call do_cmd,solink_module)
+
+all_deps += $(obj).target/noble.node
+# Add target alias
+.PHONY: noble
+noble: $(builddir)/noble.node
+
+# Copy this to the executable output path.
+$(builddir)/noble.node: TOOLSET := $(TOOLSET)
+$(builddir)/noble.node: $(obj).target/noble.node FORCE_DO_CMD
+	$(call do_cmd,copy)
+
+all_deps += $(builddir)/noble.node
+# Short alias for building this executable.
+.PHONY: noble.node
+noble.node: $(obj).target/noble.node $(builddir)/noble.node
+
+# Add executable to "all" target.
+.PHONY: all
+all: $(builddir)/noble.node
+
@@ -12,6 +12,7 @@
 /// <reference types="node" />
 
 import events = require("events");
+import stream = require("stream");
 
 /**
  * @deprecated
@@ -21,8 +22,8 @@ export declare function startScanning(callback?: (error?: Error) => void): void;
  * @deprecated
  */
 export declare function startScanning(serviceUUIDs: string[], callback?: (error?: Error) => void): void;
-export declare function startScanning(serviceUUIDs?: string[], allowDuplicates?: boolean, callback?: (error?: Error) => void): void;
-export declare function startScanningAsync(serviceUUIDs?: string[], allowDuplicates?: boolean): Promise<void>;
+export declare function startScanning(serviceUUIDs?: string[] | ScanFilter, allowDuplicates?: boolean, callback?: (error?: Error) => void): void;
+export declare function startScanningAsync(serviceUUIDs?: string[] | ScanFilter, allowDuplicates?: boolean): Promise<void>;
 export declare function stopScanning(callback?: () => void): void;
 export declare function stopScanningAsync(): Promise<void>;
 export declare function cancelConnect(peripheralUuid: string, options?: object): void;
@@ -52,6 +53,42 @@ export declare var state: string;
 
 export var _bindings: any;
 
+export interface ScanFilter {
+  serviceUuids?: string[];
+  // any of them
+  manufacturerId?: number | number[];
+  serviceData?: { uuid: string; prefix?: Buffer } | { uuid: string; prefix?: Buffer }[];
+  namePrefix?: string;
+  // floor, in dBm
+  rssi?: number;
+}
+
+export interface ConnectOptions {
+  // connection parameters, in units of 1.25 ms / 10 ms (hci-socket)
+  minInterval?: number;
+  maxInterval?: number;
+  latency?: number;
+  timeout?: number;
+  // ATT MTU to ask for, up to 517 (hci-socket)
+  mtu?: number;
+  // link layer packet size to ask for, false to keep 27 (hci-socket)
+  dataLength?: number | false;
+  phy?: '1m' | '2m' | 'coded';
+}
+
+export interface L2capChannelOptions {
+  // SDUs and K-frames this side takes, and the credits it starts with
+  mtu?: number;
+  mps?: number;
+  credits?: number;
+}
+
+// an LE credit based channel, one SDU per chunk (hci-socket)
+export interface L2capChannel extends stream.Duplex {
+  psm: number;
+  close(): void;
+}
+
 export interface ServicesAndCharacteristics {
   services: Service[];
   characteristics: Characteristic[];
@@ -66,11 +103,13 @@ export declare class Peripheral extends events.EventEmitter {
     advertisement: Advertisement;
     rssi: number;
     mtu: number | null;
+    periodicInterval: number | null;
     services: Service[];
     state: 'error' | 'connecting' | 'connected' | 'disconnecting' | 'disconnected';
 
     connect(callback?: (error: string) => void): void;
-    connectAsync(): Promise<void>;
+    connect(options: ConnectOptions, callback?: (error: string) => void): void;
+    connectAsync(options?: ConnectOptions): Promise<void>;
     disconnect(callback?: () => void): void;
     disconnectAsync(): Promise<void>;
     updateRssi(callback?: (error: string, rssi: number) => void): void;
@@ -81,26 +120,45 @@ export declare class Peripheral extends events.EventEmitter {
     discoverServicesAsync(serviceUUIDs: string[]): Promise<Service[]>;
     discoverAllServicesAndCharacteristics(callback?: (error: string, services: Service[], characteristics: Characteristic[]) => void): void;
     discoverAllServicesAndCharacteristicsAsync(): Promise<ServicesAndCharacteristics>;
+    discoverDatabase(callback?: (error: string, services: Service[], characteristics: Characteristic[]) => void): void;
+    discoverDatabase(options: { descriptors?: boolean }, callback?: (error: string, services: Service[], characteristics: Characteristic[]) => void): void;
+    discoverDatabaseAsync(options?: { descriptors?: boolean }): Promise<ServicesAndCharacteristics>;
     discoverSomeServicesAndCharacteristics(serviceUUIDs: string[], characteristicUUIDs: string[], callback?: (error: string, services: Service[], characteristics: Characteristic[]) => void): void;
     discoverSomeServicesAndCharacteristicsAsync(serviceUUIDs: string[], characteristicUUIDs: string[]): Promise<ServicesAndCharacteristics>;
     cancelConnect(options?: object): void;
 
+    readMultiple(characteristics: Characteristic[], callback?: (error: string, values: Buffer[]) => void): void;
+    readMultipleAsync(characteristics: Characteristic[]): Promise<Buffer[]>;
     readHandle(handle: number, callback: (error: string, data: Buffer) => void): void;
     readHandleAsync(handle: number): Promise<Buffer>;
     writeHandle(handle: number, data: Buffer, withoutResponse: boolean, callback: (error: string) => void): void;
     writeHandleAsync(handle: number, data: Buffer, withoutResponse: boolean): Promise<void>;
+    openL2capChannel(psm: number, options?: L2capChannelOptions, callback?: (error: Error | null, channel: L2capChannel) => void): void;
+    openL2capChannel(psm: number, callback?: (error: Error | null, channel: L2capChannel) => void): void;
+    openL2capChannelAsync(psm: number, options?: L2capChannelOptions): Promise<L2capChannel>;
+    syncPeriodicAdvertising(callback?: (error: Error | null) => void): void;
+    syncPeriodicAdvertisingAsync(): Promise<void>;
+    stopPeriodicSync(): void;
     toString(): string;
 
     on(event: "connect", listener: (error: string) => void): this;
     on(event: "disconnect", listener: (error: string) => void): this;
     on(event: "rssiUpdate", listener: (rssi: number) => void): this;
     on(event: "servicesDiscover", listener: (services: Service[]) => void): this;
+    on(event: "databaseDiscover", listener: (services: Service[]) => void): this;
+    on(event: "periodicSync", listener: (error: Error | null, interval: number) => void): this;
+    on(event: "periodicAdvertisement", listener: (data: Buffer, rssi: number, txPower: number) => void): this;
+    on(event: "periodicSyncLost", listener: (reason: 'timeout' | 'terminated') => void): this;
     on(event: string, listener: Function): this;
 
     once(event: "connect", listener: (error: string) => void): this;
     once(event: "disconnect", listener: (error: string) => void): this;
     once(event: "rssiUpdate", listener: (rssi: number) => void): this;
     once(event: "servicesDiscover", listener: (services: Service[]) => void): this;
+    once(event: "databaseDiscover", listener: (services: Service[]) => void): this;
+    once(event: "periodicSync", listener: (error: Error | null, interval: number) => void): this;
+    once(event: "periodicAdvertisement", listener: (data: Buffer, rssi: number, txPower: number) => void): this;
+    once(event: "periodicSyncLost", listener: (reason: 'timeout' | 'terminated') => void): this;
     once(event: string, listener: Function): this;
 }
 
@@ -0,0 +1,17 @@
+{
+  'targets': [
+    {
+      'target_name': 'ad_decoder',
+      'sources': [ 'src/ad_decoder.cc', 'src/napi_ad_decoder.cc' ],
+      'cflags_cc': [ '-std=c++17' ],
+      'xcode_settings': {
+        'CLANG_CXX_LANGUAGE_STANDARD': 'c++17',
+      },
+      'msvs_settings': {
+        'VCCLCompilerTool': {
+          'AdditionalOptions': ['/std:c++17'],
+        },
+      },
+    }
+  ]
+}
@@ -0,0 +1,116 @@
+const debug = require('debug')('ad-decoder');
+
+// field kinds and record sizes written by src/napi_ad_decoder.cc
+const FIELD_LOCAL_NAME = 1;
+const FIELD_TX_POWER_LEVEL = 2;
+const FIELD_MANUFACTURER_DATA = 3;
+const FIELD_SERVICE_UUID = 4;
+const FIELD_SOLICITATION_UUID = 5;
+const FIELD_SERVICE_DATA = 6;
+
+const REPORT_SIZE = 8;
+const FIELD_SIZE = 5;
+
+// an LE Meta event has at most 255 parameter bytes, so fewer than 128 fields
+const fields = new Int32Array(1 + 128 * (REPORT_SIZE + FIELD_SIZE));
+
+// Decodes every report of an H4 LE (extended) advertising report event:
+//
+//   [{ type, address, addressType, rssi, txPower, eirOffset, eirLength,
+//      advertisement: { localName, txPowerLevel, manufacturerData,
+//                       serviceData, serviceUuids, serviceSolicitationUuids } }]
+//
+// txPower is only set for extended reports and advertisement only has the
+// fields present in the data. Returns null for other events.
+const decodeAdvertisingEvent = function (native, packet) {
+  const text = native.decodeAdvertisingEvent(packet, fields);
+
+  if (text === null) {
+    return null;
+  }
+
+  const reports = [];
+  let i = 1;
+
+  for (let n = fields[0]; n > 0; n--) {
+    const advertisement = {};
+    const report = {
+      type: fields[i],
+      address: text.substring(fields[i + 6], fields[i + 6] + 17),
+      addressType: fields[i + 1] === 0x01 ? 'random' : 'public',
+      rssi: fields[i + 2],
+      eirOffset: fields[i + 4],
+      eirLength: fields[i + 5],
+      advertisement
+    };
+    const count = fields[i + 7];
+
+    if (fields[i + 3] !== -1) {
+      report.txPower = fields[i + 3];
+    }
+
+    i += REPORT_SIZE;
+
+    for (let f = 0; f < count; f++, i += FIELD_SIZE) {
+      const a = fields[i + 1];
+      const b = fields[i + 2];
+
+      switch (fields[i]) {
+        case FIELD_LOCAL_NAME:
+          advertisement.localName = packet.toString('utf8', a, b);
+          break;
+
+        case FIELD_TX_POWER_LEVEL:
+          advertisement.txPowerLevel = a;
+          break;
+
+        case FIELD_MANUFACTURER_DATA:
+          advertisement.manufacturerData = packet.subarray(a, b);
+          break;
+
+        case FIELD_SERVICE_UUID:
+          (advertisement.serviceUuids || (advertisement.serviceUuids = [])).push(
+            text.substring(a, b)
+          );
+          break;
+
+        case FIELD_SOLICITATION_UUID:
+          (
+            advertisement.serviceSolicitationUuids ||
+            (advertisement.serviceSolicitationUuids = [])
+          ).push(text.substring(a, b));
+          break;
+
+        case FIELD_SERVICE_DATA:
+          (advertisement.serviceData || (advertisement.serviceData = [])).push({
+            uuid: text.substring(a, b),
+            data: packet.subarray(fields[i + 3], fields[i + 4])
+          });
+          break;
+      }
+    }
+
+    reports.push(report);
+  }
+
+  return reports;
+};
+
+// The native decoder (src/ad_decoder.cc) is optional: when it has not been
+// built, or NOBLE_HCI_JS_AD_DECODER is set, null is exported and Hci / Gap
+// decode advertisements in JS.
+let decoder = null;
+
+if (!process.env.NOBLE_HCI_JS_AD_DECODER) {
+  try {
+    const native = require('bindings')('ad_decoder.node');
+
+    decoder = {
+      decodeAdvertisingEvent: decodeAdvertisingEvent.bind(null, native)
+    };
+  } catch (e) {
+    debug(`native decoder not available: ${e.message}`);
+  }
+}
+
+module.exports = decoder;
@@ -0,0 +1,260 @@
+#include "ad_decoder.h"
+
+namespace addecoder
+{
+    namespace
+    {
+        const char HEX[] = "0123456789abcdef";
+
+        const uint8_t EVT_LE_META_EVENT = 0x3e;
+        const uint8_t EVT_LE_ADVERTISING_REPORT = 0x02;
+        const uint8_t EVT_LE_EXTENDED_ADVERTISING_REPORT = 0x0d;
+
+        // Number#toString(16), no leading zeros
+        std::string ShortHex(uint32_t value)
+        {
+            char digits[8];
+            size_t count = 0;
+            do
+            {
+                digits[count++] = HEX[value & 0xf];
+                value >>= 4;
+            } while (value);
+
+            std::string hex;
+            hex.reserve(count);
+            while (count)
+            {
+                hex.push_back(digits[--count]);
+            }
+            return hex;
+        }
+
+        // bytes [start, end) in reverse order, two digits each
+        std::string ReverseHex(const uint8_t* data, size_t start, size_t end)
+        {
+            std::string hex;
+            hex.reserve((end - start) * 2);
+            for (size_t j = end; j > start; j--)
+            {
+                hex.push_back(HEX[data[j - 1] >> 4]);
+                hex.push_back(HEX[data[j - 1] & 0xf]);
+            }
+            return hex;
+        }
+
+        uint16_t ReadUInt16LE(const uint8_t* data)
+        {
+            return static_cast<uint16_t>(data[0] | (data[1] << 8));
+        }
+
+        uint32_t ReadUInt32LE(const uint8_t* data)
+        {
+            return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+                (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+        }
+
+        void AddUnique(std::vector<std::string>& list, std::string uuid)
+        {
+            for (const auto& existing : list)
+            {
+                if (existing == uuid)
+                {
+                    return;
+                }
+            }
+            list.push_back(std::move(uuid));
+        }
+    }
+
+    void DecodeAdvertisingData(const uint8_t* data, size_t length, AdvertisingData& out, size_t base)
+    {
+        size_t i = 0;
+
+        while (i + 1 < length)
+        {
+            const size_t structureLength = data[i];
+            // https://www.bluetooth.com/specifications/assigned-numbers/ (Common Data Types)
+            const uint8_t type = data[i + 1];
+
+            if (structureLength < 1 || i + structureLength + 1 > length)
+            {
+                break;
+            }
+
+            const size_t start = i + 2;
+            const size_t end = i + structureLength + 1;
+
+            switch (type)
+            {
+            case 0x02: // Incomplete List of 16-bit Service Class UUIDs
+            case 0x03: // Complete List of 16-bit Service Class UUIDs
+                for (size_t j = start; j + 1 < end; j += 2)
+                {
+                    AddUnique(out.serviceUuids, ShortHex(ReadUInt16LE(data + j)));
+                }
+                break;
+
+            case 0x06: // Incomplete List of 128-bit Service Class UUIDs
+            case 0x07: // Complete List of 128-bit Service Class UUIDs
+                for (size_t j = start; j + 15 < end; j += 16)
+                {
+                    AddUnique(out.serviceUuids, ReverseHex(data, j, j + 16));
+                }
+                break;
+
+            case 0x08: // Shortened Local Name
+            case 0x09: // Complete Local Name
+                out.hasLocalName = true;
+                out.localName = { base + start, end - start };
+                break;
+
+            case 0x0a: // Tx Power Level
+                if (end > start)
+                {
+                    out.hasTxPowerLevel = true;
+                    out.txPowerLevel = static_cast<int8_t>(data[start]);
+                }
+                break;
+
+            case 0x14: // List of 16-bit Service Solicitation UUIDs
+                for (size_t j = start; j + 1 < end; j += 2)
+                {
+                    AddUnique(out.serviceSolicitationUuids, ShortHex(ReadUInt16LE(data + j)));
+                }
+                break;
+
+            case 0x1f: // List of 32-bit Service Solicitation UUIDs
+                for (size_t j = start; j + 3 < end; j += 4)
+                {
+                    AddUnique(out.serviceSolicitationUuids, ShortHex(ReadUInt32LE(data + j)));
+                }
+                break;
+
+            case 0x15: // List of 128-bit Service Solicitation UUIDs
+                for (size_t j = start; j + 15 < end; j += 16)
+                {
+                    AddUnique(out.serviceSolicitationUuids, ReverseHex(data, j, j + 16));
+                }
+                break;
+
+            case 0x16: // Service Data - 16-bit UUID
+            case 0x20: // Service Data - 32-bit UUID
+            case 0x21: // Service Data - 128-bit UUID
+            {
+                const size_t uuidLength = type == 0x16 ? 2 : type == 0x20 ? 4 : 16;
+                // like the JS parser, skipped when too short for its UUID
+                if (end - start < uuidLength)
+                {
+                    break;
+                }
+                const size_t uuidEnd = start + uuidLength;
+
+                ServiceData serviceData;
+                serviceData.uuid = ReverseHex(data, start, uuidEnd);
+                serviceData.data = { base + uuidEnd, end - uuidEnd };
+                out.serviceData.push_back(std::move(serviceData));
+                break;
+            }
+
+            case 0xff: // Manufacturer Specific Data
+                out.hasManufacturerData = true;
+                out.manufacturerData = { base + start, end - start };
+                break;
+            }
+
+            i += structureLength + 1;
+        }
+    }
+
+    bool DecodeAdvertisingEvent(const uint8_t* packet, size_t length,
+                                std::vector<AdvertisingReport>& reports)
+    {
+        reports.clear();
+
+        // packet type, event code, parameter length, subevent, number of reports
+        if (length < 5 || packet[0] != 0x04 || packet[1] != EVT_LE_META_EVENT)
+        {
+            return false;
+        }
+
+        const uint8_t subevent = packet[3];
+        const uint8_t numReports = packet[4];
+        size_t offset = 5;
+
+        if (subevent != EVT_LE_ADVERTISING_REPORT &&
+            subevent != EVT_LE_EXTENDED_ADVERTISING_REPORT)
+        {
+            return false;
+        }
+
+        for (uint8_t n = 0; n < numReports; n++)
+        {
+            AdvertisingReport report;
+            const uint8_t* data = packet + offset;
+
+            if (subevent == EVT_LE_ADVERTISING_REPORT)
+            {
+                // event type, address type, address, data length, data, rssi
+                if (offset + 9 > length || offset + 10 + data[8] > length)
+                {
+                    return false;
+                }
+
+                report.type = data[0];
+                report.addressType = data[1];
+                for (size_t j = 0; j < 6; j++)
+                {
+                    report.address[j] = data[2 + j];
+                }
+                report.eir = { offset + 9, data[8] };
+                report.rssi = static_cast<int8_t>(data[9 + data[8]]);
+                offset += 10 + data[8];
+            }
+            else
+            {
+                // event type, address type, address, primary phy, secondary phy,
+                // sid, tx power, rssi, periodic interval, direct address type,
+                // direct address, data length, data
+                if (offset + 24 > length || offset + 24 + data[23] > length)
+                {
+                    return false;
+                }
+
+                report.extended = true;
+                report.type = ReadUInt16LE(data);
+                report.addressType = data[2];
+                for (size_t j = 0; j < 6; j++)
+                {
+                    report.address[j] = data[3 + j];
+                }
+                report.txPower = data[12];
+                report.rssi = static_cast<int8_t>(data[13]);
+                report.eir = { offset + 24, data[23] };
+                offset += 24 + data[23];
+            }
+
+            DecodeAdvertisingData(packet + report.eir.offset, report.eir.length,
+                                  report.advertisement, report.eir.offset);
+            reports.push_back(std::move(report));
+        }
+
+        return true;
+    }
+
+    std::string FormatAddress(const uint8_t address[6])
+    {
+        std::string formatted;
+        formatted.reserve(17);
+        for (size_t j = 6; j > 0; j--)
+        {
+            formatted.push_back(HEX[address[j - 1] >> 4]);
+            formatted.push_back(HEX[address[j - 1] & 0xf]);
+            if (j > 1)
+            {
+                formatted.push_back(':');
+            }
+        }
+        return formatted;
+    }
+}
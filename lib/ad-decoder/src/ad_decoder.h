@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Portable decoder for Bluetooth LE advertising data (AD structures) and the
+// LE Meta advertising report events carrying it. Shared by the hci-socket
+// addon and the native backends; it has no Node or platform dependencies.
+namespace addecoder
+{
+    // [offset, offset + length) of the buffer handed to the decoder
+    struct Range
+    {
+        size_t offset = 0;
+        size_t length = 0;
+    };
+
+    struct ServiceData
+    {
+        std::string uuid;
+        Range data;
+    };
+
+    // Fields are only meaningful when the matching has* flag (or list) is set.
+    // UUIDs use the same lower case hex rendering as the JS parser in Gap.
+    struct AdvertisingData
+    {
+        bool hasLocalName = false;
+        Range localName;
+        bool hasTxPowerLevel = false;
+        int8_t txPowerLevel = 0;
+        bool hasManufacturerData = false;
+        Range manufacturerData;
+        std::vector<std::string> serviceUuids;
+        std::vector<std::string> serviceSolicitationUuids;
+        std::vector<ServiceData> serviceData;
+    };
+
+    struct AdvertisingReport
+    {
+        bool extended = false;
+        uint16_t type = 0;
+        uint8_t addressType = 0;
+        uint8_t address[6] = {};
+        int8_t rssi = 0;
+        uint8_t txPower = 0;
+        Range eir;
+        AdvertisingData advertisement;
+    };
+
+    // Decodes the AD structures in data[0, length). Ranges in `out` are relative
+    // to `data` plus `base`. Decoding stops at the first malformed structure.
+    void DecodeAdvertisingData(const uint8_t* data, size_t length, AdvertisingData& out,
+                               size_t base = 0);
+
+    // Decodes an H4 LE Meta event packet (0x04 0x3e ...) holding an LE
+    // Advertising Report or LE Extended Advertising Report. Reports decoded
+    // before a malformed one are kept in `reports`; returns false if the packet
+    // is not an advertising event or is truncated.
+    bool DecodeAdvertisingEvent(const uint8_t* packet, size_t length,
+                                std::vector<AdvertisingReport>& reports);
+
+    // "aa:bb:cc:dd:ee:ff" from a little endian device address
+    std::string FormatAddress(const uint8_t address[6]);
+}
@@ -0,0 +1,212 @@
+#define NAPI_VERSION 6
+#include <node_api.h>
+
+#include "ad_decoder.h"
+
+using namespace addecoder;
+
+#define NAPI_CALL(env, call)                                                                       \
+    if ((call) != napi_ok)                                                                         \
+    {                                                                                              \
+        napi_throw_error(env, nullptr, #call " failed");                                           \
+        return nullptr;                                                                            \
+    }
+
+namespace
+{
+    // Creating JS objects through N-API costs far more than decoding, so the
+    // decoded reports are written as numbers into an Int32Array owned by the
+    // caller, with all hex text (addresses and UUIDs) in one returned string.
+    // lib/ad-decoder/bindings.js turns this back into objects. Keep both in sync.
+    //
+    //   fields[0]   number of reports
+    //   per report  type, address type, rssi, tx power (-1 for legacy reports),
+    //               eir offset, eir length, address text offset, field count
+    //   per field   kind, a, b, c, d
+    enum Field
+    {
+        FIELD_LOCAL_NAME = 1,    // a, b: packet range
+        FIELD_TX_POWER_LEVEL,    // a: value
+        FIELD_MANUFACTURER_DATA, // a, b: packet range
+        FIELD_SERVICE_UUID,      // a, b: text range
+        FIELD_SOLICITATION_UUID, // a, b: text range
+        FIELD_SERVICE_DATA,      // a, b: text range of the uuid, c, d: packet range
+    };
+
+    const size_t REPORT_SIZE = 8;
+    const size_t FIELD_SIZE = 5;
+
+    class Writer
+    {
+    public:
+        Writer(int32_t* fields, size_t capacity) : fields(fields), capacity(capacity)
+        {
+            fields[0] = 0;
+        }
+
+        bool Report(const AdvertisingReport& report)
+        {
+            const auto& data = report.advertisement;
+            const size_t count = (data.hasLocalName ? 1 : 0) + (data.hasTxPowerLevel ? 1 : 0) +
+                (data.hasManufacturerData ? 1 : 0) + data.serviceUuids.size() +
+                data.serviceSolicitationUuids.size() + data.serviceData.size();
+
+            if (size + REPORT_SIZE + count * FIELD_SIZE > capacity)
+            {
+                return false;
+            }
+
+            const size_t address = Text(FormatAddress(report.address));
+            Put(report.type, report.addressType, report.rssi, report.extended ? report.txPower : -1,
+                report.eir.offset, report.eir.length, address, count);
+
+            if (data.hasLocalName)
+            {
+                PutRange(FIELD_LOCAL_NAME, data.localName);
+            }
+            if (data.hasTxPowerLevel)
+            {
+                Put(FIELD_TX_POWER_LEVEL, data.txPowerLevel, 0, 0, 0);
+            }
+            if (data.hasManufacturerData)
+            {
+                PutRange(FIELD_MANUFACTURER_DATA, data.manufacturerData);
+            }
+            for (const auto& uuid : data.serviceUuids)
+            {
+                const size_t start = Text(uuid);
+                Put(FIELD_SERVICE_UUID, start, text.size(), 0, 0);
+            }
+            for (const auto& uuid : data.serviceSolicitationUuids)
+            {
+                const size_t start = Text(uuid);
+                Put(FIELD_SOLICITATION_UUID, start, text.size(), 0, 0);
+            }
+            for (const auto& serviceData : data.serviceData)
+            {
+                const size_t start = Text(serviceData.uuid);
+                Put(FIELD_SERVICE_DATA, start, text.size(), serviceData.data.offset,
+                    serviceData.data.offset + serviceData.data.length);
+            }
+
+            fields[0]++;
+            return true;
+        }
+
+        std::string text;
+
+    private:
+        template <typename... Values> void Put(Values... values)
+        {
+            for (int32_t value : { static_cast<int32_t>(values)... })
+            {
+                fields[size++] = value;
+            }
+        }
+
+        void PutRange(Field field, const Range& range)
+        {
+            Put(field, range.offset, range.offset + range.length, 0, 0);
+        }
+
+        size_t Text(const std::string& string)
+        {
+            const size_t start = text.size();
+            text += string;
+            return start;
+        }
+
+        int32_t* fields;
+        size_t capacity;
+        size_t size = 1;
+    };
+
+    // decodeAdvertisingEvent(packet, fields) -> text | null
+    //
+    // `packet` is an H4 LE Meta event, null is returned for anything other than
+    // an (extended) advertising report or when `fields` is too small. When the
+    // event is truncated the reports before the malformed one are written.
+    napi_value DecodeAdvertisingEventJs(napi_env env, napi_callback_info info)
+    {
+        size_t argc = 2;
+        napi_value argv[2];
+        NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, nullptr, nullptr));
+
+        bool isBuffer = false;
+        if (argc < 1 || napi_is_buffer(env, argv[0], &isBuffer) != napi_ok || !isBuffer)
+        {
+            napi_throw_type_error(env, nullptr, "packet must be a Buffer");
+            return nullptr;
+        }
+
+        bool isTypedArray = false;
+        napi_typedarray_type arrayType = napi_uint8_array;
+        size_t capacity = 0;
+        void* fields = nullptr;
+        if (argc > 1)
+        {
+            NAPI_CALL(env, napi_is_typedarray(env, argv[1], &isTypedArray));
+        }
+        if (isTypedArray)
+        {
+            NAPI_CALL(env, napi_get_typedarray_info(env, argv[1], &arrayType, &capacity, &fields,
+                                                    nullptr, nullptr));
+        }
+        if (!isTypedArray || arrayType != napi_int32_array || capacity < 1)
+        {
+            napi_throw_type_error(env, nullptr, "fields must be an Int32Array");
+            return nullptr;
+        }
+
+        void* data;
+        size_t length;
+        NAPI_CALL(env, napi_get_buffer_info(env, argv[0], &data, &length));
+
+        std::vector<AdvertisingReport>* reports;
+        NAPI_CALL(env, napi_get_instance_data(env, reinterpret_cast<void**>(&reports)));
+
+        napi_value result;
+        const bool complete =
+            DecodeAdvertisingEvent(static_cast<const uint8_t*>(data), length, *reports);
+
+        Writer writer(static_cast<int32_t*>(fields), capacity);
+        for (const auto& report : *reports)
+        {
+            if (!writer.Report(report))
+            {
+                NAPI_CALL(env, napi_get_null(env, &result));
+                return result;
+            }
+        }
+
+        if (!complete && reports->empty())
+        {
+            NAPI_CALL(env, napi_get_null(env, &result));
+            return result;
+        }
+
+        NAPI_CALL(env,
+                  napi_create_string_latin1(env, writer.text.data(), writer.text.size(), &result));
+        return result;
+    }
+
+    void DeleteReports(napi_env env, void* data, void* hint)
+    {
+        delete static_cast<std::vector<AdvertisingReport>*>(data);
+    }
+}
+
+NAPI_MODULE_INIT()
+{
+    // decoded reports are kept between calls to reuse their storage, per
+    // environment so that worker threads each get their own
+    auto reports = new std::vector<AdvertisingReport>();
+    NAPI_CALL(env, napi_set_instance_data(env, reports, DeleteReports, nullptr));
+
+    napi_value decode;
+    NAPI_CALL(env, napi_create_function(env, "decodeAdvertisingEvent", NAPI_AUTO_LENGTH,
+                                        DecodeAdvertisingEventJs, nullptr, &decode));
+    NAPI_CALL(env, napi_set_named_property(env, exports, "decodeAdvertisingEvent", decode));
+
+    return exports;
+}
@@ -3,40 +3,95 @@ const util = require('util');
 
 const Smp = require('./smp');
 
-const AclStream = function (hci, handle, localAddressType, localAddress, remoteAddressType, remoteAddress) {
+// Encryption Change status of a peripheral that has no LTK for us
+const PIN_OR_KEY_MISSING = 0x06;
+
+const AclStream = function (hci, handle, localAddressType, localAddress, remoteAddressType, remoteAddress, keyStore) {
   this._hci = hci;
   this._handle = handle;
+  this._remoteAddressType = remoteAddressType;
+  this._remoteAddress = remoteAddress;
+  this._keyStore = keyStore || null;
+
+  // pairing or encrypting with a stored LTK, which falls back to pairing if
+  // the peripheral has lost the bond
+  this._encrypting = false;
+  this._bond = null;
+
+  // L2CAP payload bytes each way, for the interval manager
+  this.txBytes = 0;
+  this.rxBytes = 0;
 
   this._smp = new Smp(this, localAddressType, localAddress, remoteAddressType, remoteAddress);
 
   this.onSmpStkBinded = this.onSmpStk.bind(this);
   this.onSmpFailBinded = this.onSmpFail.bind(this);
+  this.onSmpKeysBinded = this.onSmpKeys.bind(this);
+  this.onSmpSecurityRequestBinded = this.onSmpSecurityRequest.bind(this);
   this.onSmpEndBinded = this.onSmpEnd.bind(this);
 
   this._smp.on('stk', this.onSmpStkBinded);
   this._smp.on('fail', this.onSmpFailBinded);
+  this._smp.on('keys', this.onSmpKeysBinded);
+  this._smp.on('securityRequest', this.onSmpSecurityRequestBinded);
   this._smp.on('end', this.onSmpEndBinded);
 };
 
 util.inherits(AclStream, events.EventEmitter);
 
 AclStream.prototype.encrypt = function () {
-  this._smp.sendPairingRequest();
+  if (this._encrypting) {
+    return;
+  }
+  this._encrypting = true;
+
+  this._bond = this._keyStore
+    ? this._keyStore.get(this._remoteAddress, this._remoteAddressType)
+    : null;
+
+  if (this._bond) {
+    this.startEncryption(this._bond.rand, this._bond.ediv, this._bond.ltk);
+  } else {
+    this._smp.sendPairingRequest();
+  }
 };
 
-AclStream.prototype.write = function (cid, data) {
-  this._hci.writeAclDataPkt(this._handle, cid, data);
+// no Encryption Change follows a refused LE Start Encryption
+AclStream.prototype.startEncryption = function (random, diversifier, key) {
+  this._hci
+    .startLeEncryption(this._handle, random, diversifier, key)
+    .catch((error) => {
+      this._encrypting = false;
+      this._bond = null;
+      this.emit('encryptFail', error);
+    });
+};
+
+AclStream.prototype.write = function (cid, data, callback) {
+  this.txBytes += data.length;
+  this._hci.writeAclDataPkt(this._handle, cid, data, callback);
 };
 
 AclStream.prototype.push = function (cid, data) {
   if (data) {
+    this.rxBytes += data.length;
     this.emit('data', cid, data);
   } else {
     this.emit('end');
   }
 };
 
-AclStream.prototype.pushEncrypt = function (encrypt) {
+AclStream.prototype.pushEncrypt = function (encrypt, status) {
+  if (!encrypt && this._bond && status === PIN_OR_KEY_MISSING) {
+    // the peripheral forgot us, pair from scratch
+    this._keyStore.delete(this._remoteAddress, this._remoteAddressType);
+    this._bond = null;
+    this._smp.sendPairingRequest();
+    return;
+  }
+
+  this._encrypting = false;
+  this._bond = null;
   this.emit('encrypt', encrypt);
 };
 
@@ -44,16 +99,29 @@ AclStream.prototype.onSmpStk = function (stk) {
   const random = Buffer.from('0000000000000000', 'hex');
   const diversifier = Buffer.from('0000', 'hex');
 
-  this._hci.startLeEncryption(this._handle, random, diversifier, stk);
+  this.startEncryption(random, diversifier, stk);
 };
 
 AclStream.prototype.onSmpFail = function () {
+  this._encrypting = false;
   this.emit('encryptFail');
 };
 
+AclStream.prototype.onSmpKeys = function (keys) {
+  if (this._keyStore) {
+    this._keyStore.set(this._remoteAddress, this._remoteAddressType, keys);
+  }
+};
+
+AclStream.prototype.onSmpSecurityRequest = function () {
+  this.encrypt();
+};
+
 AclStream.prototype.onSmpEnd = function () {
   this._smp.removeListener('stk', this.onSmpStkBinded);
   this._smp.removeListener('fail', this.onSmpFailBinded);
+  this._smp.removeListener('keys', this.onSmpKeysBinded);
+  this._smp.removeListener('securityRequest', this.onSmpSecurityRequestBinded);
   this._smp.removeListener('end', this.onSmpEndBinded);
 };
 
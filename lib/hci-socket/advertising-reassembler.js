@@ -0,0 +1,134 @@
+const debug = require('debug')('advertising-reassembler');
+
+// extended advertising report data status (Vol 4 Part E 7.7.65.13)
+const DATA_COMPLETE = 0x00;
+const DATA_INCOMPLETE = 0x01;
+
+// the most data one advertising set carries (Vol 6 Part B 2.3.4.9)
+const MAX_DATA_LENGTH = 1650;
+
+/*
+ * Puts extended advertising data the controller reported in several
+ * fragments back together, per advertiser, advertising set (SID) and PDU kind
+ * (advertisement or scan response), so it is parsed once, complete.
+ *
+ * Fragments are collected in buffers of 1650 bytes, the most an advertising
+ * set carries, taken from a pool and returned to it, up to `maxPending` (32)
+ * chains at a time; a new chain beyond that takes the buffer of the oldest.
+ * A chain not completed within `timeout` ms (1000) is dropped. Truncated data
+ * is given out as far as it got.
+ */
+const AdvertisingReassembler = function (options) {
+  options = options || {};
+
+  this._timeout = options.timeout || 1000;
+  this._maxPending = options.maxPending || 32;
+
+  // key -> { buffer, length, started }, oldest first
+  this._pending = new Map();
+  this._pool = [];
+
+  this.stats = {
+    fragments: 0,
+    reassembled: 0,
+    truncated: 0,
+    expired: 0,
+    evicted: 0
+  };
+};
+
+/*
+ * Takes the data of one report, whose data status is bits 5 and 6 of its
+ * event type. Returns the data to parse: `data` itself when it came in one
+ * piece, a copy of every fragment joined once the last is in, or null while
+ * more are to come.
+ */
+AdvertisingReassembler.prototype.push = function (address, sid, scanResponse, dataStatus, data) {
+  // the common case, nothing fragmented
+  if (dataStatus === DATA_COMPLETE && this._pending.size === 0) {
+    return data;
+  }
+
+  const now = Date.now();
+  this.expire(now);
+
+  const key = `${address}/${sid}/${scanResponse ? 1 : 0}`;
+  let chain = this._pending.get(key);
+
+  if (chain === undefined) {
+    if (dataStatus !== DATA_INCOMPLETE) {
+      if (dataStatus !== DATA_COMPLETE) {
+        this.stats.truncated++;
+      }
+      return data;
+    }
+
+    chain = { buffer: this.acquire(), length: 0, started: now };
+    this._pending.set(key, chain);
+  }
+
+  this.stats.fragments++;
+
+  const length = Math.min(data.length, MAX_DATA_LENGTH - chain.length);
+  data.copy(chain.buffer, chain.length, 0, length);
+  chain.length += length;
+
+  if (dataStatus === DATA_INCOMPLETE && chain.length < MAX_DATA_LENGTH) {
+    return null;
+  }
+
+  if (dataStatus === DATA_COMPLETE) {
+    this.stats.reassembled++;
+  } else {
+    this.stats.truncated++;
+  }
+
+  // parsed advertisements keep slices of the data, so it can't be pooled
+  const joined = Buffer.from(chain.buffer.subarray(0, chain.length));
+  this.release(key, chain);
+
+  return joined;
+};
+
+AdvertisingReassembler.prototype.acquire = function () {
+  if (this._pool.length > 0) {
+    return this._pool.pop();
+  }
+
+  if (this._pending.size < this._maxPending) {
+    return Buffer.allocUnsafe(MAX_DATA_LENGTH);
+  }
+
+  const [key, oldest] = this._pending.entries().next().value;
+  debug(`evicting ${key}`);
+  this.stats.evicted++;
+  this._pending.delete(key);
+  return oldest.buffer;
+};
+
+AdvertisingReassembler.prototype.release = function (key, chain) {
+  this._pending.delete(key);
+  this._pool.push(chain.buffer);
+};
+
+// drops chains older than the timeout, the oldest come first
+AdvertisingReassembler.prototype.expire = function (now) {
+  for (const [key, chain] of this._pending) {
+    if (now - chain.started < this._timeout) {
+      break;
+    }
+
+    debug(`dropping ${key}, ${chain.length} bytes`);
+    this.stats.expired++;
+    this.release(key, chain);
+  }
+};
+
+// forgets every chain, when scanning stops
+AdvertisingReassembler.prototype.reset = function () {
+  for (const [key, chain] of this._pending) {
+    this.release(key, chain);
+  }
+};
+
+module.exports = AdvertisingReassembler;
@@ -1,12 +1,33 @@
+const debug = require('debug')('bindings');
+
 const events = require('events');
 const util = require('util');
 
 const AclStream = require('./acl-stream');
+const ConnectionScheduler = require('./connection-scheduler');
 const Gatt = require('./gatt');
 const Gap = require('./gap');
 const Hci = require('./hci');
+const IntervalManager = require('./interval-manager');
+const KeyStore = require('./key-store');
+const PeriodicSync = require('./periodic-sync');
+const ScanScheduler = require('./scan-scheduler');
 const Signaling = require('./signaling');
 
+const LE_MAX_DATA_LENGTH = 251;
+
+// Enhanced ATT bearers are L2CAP channels on this PSM (Assigned Numbers 2.5)
+const EATT_PSM = 0x0027;
+// results refusing the channels until the link is encrypted (Vol 3, Part A, 4.26)
+const EATT_SECURITY_RESULTS = [0x0005, 0x0007, 0x0008];
+
+// LE Set PHY preferences (Vol 4 Part E 7.8.49)
+const PHYS = {
+  '1m': 0x01,
+  '2m': 0x02,
+  coded: 0x04
+};
+
 const NobleBindings = function (options) {
   this._state = null;
 
@@ -14,18 +35,73 @@ const NobleBindings = function (options) {
   this._addresseTypes = {};
   this._connectable = {};
   this._isExtended = 'extended' in options && options.extended;
+  // asked for on each connection, connect parameters may override them: the
+  // ATT_MTU, the link layer PDU payload (false to keep 27) and the PHY
+  this._mtu = options.mtu;
+  this._dataLength =
+    options.dataLength !== undefined ? options.dataLength : LE_MAX_DATA_LENGTH;
+  this._phy = options.phy || '2m';
+  // Enhanced ATT bearers opened next to the unenhanced one where the peer
+  // supports them, none unless asked for
+  this._eattBearers = options.eattBearers || 0;
+  this._connectOptions = {};
   this.scannable = {};
 
-  this._pendingConnectionUuid = null;
-  this._connectionQueue = [];
-
   this._handles = {};
   this._gatts = {};
   this._aclStreams = {};
   this._signalings = {};
 
   this._hci = new Hci(options);
-  this._gap = new Gap(this._hci);
+  this._gap = new Gap(this._hci, options.advertisingReassembly);
+
+  // picks connection parameters from each connection's traffic when asked to
+  this.intervalManager = options.intervalManager
+    ? new IntervalManager(
+      this._hci,
+      options.intervalManager === true ? {} : options.intervalManager
+    )
+    : null;
+
+  // one LE Create Connection at a time, by priority, with deadlines and retries
+  this.connectionScheduler = new ConnectionScheduler(
+    this._hci,
+    options.connectionScheduler
+  );
+
+  // scan interval and window by policy, paused around connection setup
+  this.scanScheduler = new ScanScheduler(
+    this._gap,
+    Object.assign(
+      { policy: options.scanPolicy || process.env.NOBLE_HCI_SCAN_POLICY },
+      options.scanScheduler
+    )
+  );
+  this.connectionScheduler.on('attempt', () =>
+    this.scanScheduler.onConnecting()
+  );
+
+  // periodic advertising trains followed without connecting, one Create
+  // Sync at a time
+  this.periodicSync = new PeriodicSync(this._hci, options.periodicSync);
+  this.periodicSync.on('established', (uuid, error, interval) =>
+    this.emit('periodicSync', uuid, error, interval)
+  );
+  this.periodicSync.on('report', (uuid, data, rssi, txPower) =>
+    this.emit('periodicAdvertisement', uuid, data, rssi, txPower)
+  );
+  this.periodicSync.on('lost', (uuid, reason) =>
+    this.emit('periodicSyncLost', uuid, reason)
+  );
+
+  // bonds kept across connections, and across runs with a file; false pairs
+  // on every connection, a KeyStore is shared with other bindings
+  this.keyStore =
+    options.keyStore === false
+      ? null
+      : options.keyStore instanceof KeyStore
+        ? options.keyStore
+        : new KeyStore(options.keyStore || process.env.NOBLE_HCI_KEY_STORE);
 };
 
 util.inherits(NobleBindings, events.EventEmitter);
@@ -34,30 +110,85 @@ NobleBindings.prototype.setScanParameters = function (interval, window) {
   this._gap.setScanParameters(interval, window);
 };
 
+// Gap applies the scan filter to raw advertising reports
+NobleBindings.prototype.supportsScanFilter = true;
+
 NobleBindings.prototype.startScanning = function (
   serviceUuids,
-  allowDuplicates
+  allowDuplicates,
+  filter
 ) {
   this._scanServiceUuids = serviceUuids || [];
 
-  this._gap.startScanning(allowDuplicates);
+  if (filter) {
+    this._gap.startScanning(allowDuplicates, filter);
+  } else {
+    this._gap.startScanning(allowDuplicates);
+  }
 };
 
 NobleBindings.prototype.stopScanning = function () {
   this._gap.stopScanning();
 };
 
+// see ScanScheduler for the policies
+NobleBindings.prototype.setScanPolicy = function (policy) {
+  this.scanScheduler.setPolicy(policy);
+};
+
+NobleBindings.prototype.setConnectOptions = function (
+  peripheralUuid,
+  parameters
+) {
+  this._connectOptions[peripheralUuid] = {
+    mtu: parameters.mtu || this._mtu,
+    dataLength:
+      parameters.dataLength !== undefined
+        ? parameters.dataLength
+        : this._dataLength,
+    phy: parameters.phy || this._phy
+  };
+};
+
 NobleBindings.prototype.connect = function (peripheralUuid, parameters) {
   const address = this._addresses[peripheralUuid];
   const addressType = this._addresseTypes[peripheralUuid];
 
-  if (!this._pendingConnectionUuid) {
-    this._pendingConnectionUuid = peripheralUuid;
+  if (address === undefined) {
+    this.emit('connect', peripheralUuid, new Error('Peripheral not discovered'));
+    return;
+  }
 
-    this._hci.createLeConn(address, addressType, parameters);
-  } else {
-    this._connectionQueue.push({ id: peripheralUuid, params: parameters });
+  parameters = parameters || {};
+  this.setConnectOptions(peripheralUuid, parameters);
+
+  this.connectionScheduler.connect(
+    peripheralUuid,
+    address,
+    addressType,
+    parameters
+  );
+};
+
+// connects to the peripheral whenever the controller hears it advertising
+// while disconnected, reported as 'connect' events, until stopped
+NobleBindings.prototype.autoReconnect = function (peripheralUuid, parameters) {
+  if (this._addresses[peripheralUuid] === undefined) {
+    this.emit('connect', peripheralUuid, new Error('Peripheral not discovered'));
+    return;
   }
+
+  this.setConnectOptions(peripheralUuid, parameters || {});
+
+  this.connectionScheduler.reconnect(
+    peripheralUuid,
+    this._addresses[peripheralUuid],
+    this._addresseTypes[peripheralUuid]
+  );
+};
+
+NobleBindings.prototype.stopAutoReconnect = function (peripheralUuid) {
+  this.connectionScheduler.stopReconnect(peripheralUuid);
 };
 
 NobleBindings.prototype.disconnect = function (peripheralUuid) {
@@ -65,14 +196,34 @@ NobleBindings.prototype.disconnect = function (peripheralUuid) {
 };
 
 NobleBindings.prototype.cancelConnect = function (peripheralUuid) {
-  // TODO: check if it was not in the queue and only then issue cancel on hci
-  this._connectionQueue = this._connectionQueue.filter(
-    (c) => c.id !== peripheralUuid
+  // LE Create Connection Cancel only goes out for the attempt in flight
+  this.connectionScheduler.cancel(peripheralUuid);
+};
+
+// periodic advertising is only reported by extended scans
+NobleBindings.prototype.syncPeriodicAdvertising = function (peripheralUuid) {
+  if (!this._isExtended) {
+    this.emit(
+      'periodicSync',
+      peripheralUuid,
+      new Error('Periodic advertising needs the extended option')
+    );
+    return;
+  }
+
+  this.periodicSync.sync(
+    peripheralUuid,
+    this._addresses[peripheralUuid],
+    this._addresseTypes[peripheralUuid]
   );
-  this._hci.cancelConnect(this._handles[peripheralUuid]);
+};
+
+NobleBindings.prototype.stopPeriodicSync = function (peripheralUuid) {
+  this.periodicSync.stop(peripheralUuid);
 };
 
 NobleBindings.prototype.reset = function () {
+  this.scanScheduler.stop();
   this._hci.reset();
 };
 
@@ -96,6 +247,23 @@ NobleBindings.prototype.init = function () {
   this._hci.on('disconnComplete', this.onDisconnComplete.bind(this));
   this._hci.on('encryptChange', this.onEncryptChange.bind(this));
   this._hci.on('aclDataPkt', this.onAclDataPkt.bind(this));
+  // ahead of Gap, so a train is known by the time its device is discovered
+  this._hci.prependListener(
+    'leExtendedAdvertisingReport',
+    this.onExtendedAdvertisingReport.bind(this)
+  );
+  this._hci.on(
+    'lePeriodicSyncEstablished',
+    this.periodicSync.onSyncEstablished.bind(this.periodicSync)
+  );
+  this._hci.on(
+    'lePeriodicAdvertisingReport',
+    this.periodicSync.onReport.bind(this.periodicSync)
+  );
+  this._hci.on(
+    'lePeriodicSyncLost',
+    this.periodicSync.onSyncLost.bind(this.periodicSync)
+  );
 
   this._hci.init();
 
@@ -118,6 +286,7 @@ NobleBindings.prototype.onSigInt = function () {
 
 NobleBindings.prototype.onExit = function () {
   this.stopScanning();
+  this.scanScheduler.stop();
 
   for (const handle in this._aclStreams) {
     this._hci.disconnect(handle);
@@ -130,6 +299,10 @@ NobleBindings.prototype.onStateChange = function (state) {
   }
   this._state = state;
 
+  if (state !== 'poweredOn') {
+    this.periodicSync.reset();
+  }
+
   if (state === 'unauthorized') {
     console.log(
       'noble warning: adapter state unauthorized, please run as root or with sudo'
@@ -160,10 +333,12 @@ NobleBindings.prototype.onScanParametersSet = function () {
 };
 
 NobleBindings.prototype.onScanStart = function (filterDuplicates) {
+  this.scanScheduler.onScanStart();
   this.emit('scanStart', filterDuplicates);
 };
 
 NobleBindings.prototype.onScanStop = function () {
+  this.scanScheduler.onScanStop();
   this.emit('scanStop');
 };
 
@@ -176,6 +351,8 @@ NobleBindings.prototype.onDiscover = function (
   rssi,
   scannable
 ) {
+  this.scanScheduler.onDiscover(address);
+
   if (this._scanServiceUuids === undefined) {
     return;
   }
@@ -223,6 +400,22 @@ NobleBindings.prototype.onDiscover = function (
   }
 };
 
+// the SID and interval of periodic trains, for syncPeriodicAdvertising
+NobleBindings.prototype.onExtendedAdvertisingReport = function (
+  status,
+  type,
+  address,
+  addressType,
+  txPower,
+  rssi,
+  eir,
+  decoded,
+  sid,
+  periodicInterval
+) {
+  this.periodicSync.onAdvertisingReport(address, sid, periodicInterval);
+};
+
 NobleBindings.prototype.onLeConnComplete = function (
   status,
   handle,
@@ -251,9 +444,15 @@ NobleBindings.prototype.onLeConnComplete = function (
       this._hci.addressType,
       this._hci.address,
       addressType,
-      address
+      address,
+      this.keyStore
     );
-    const gatt = new Gatt(address, aclStream);
+    const connectOptions = this._connectOptions[uuid] || {
+      mtu: this._mtu,
+      dataLength: this._dataLength,
+      phy: this._phy
+    };
+    const gatt = new Gatt(address, aclStream, connectOptions.mtu);
     const signaling = new Signaling(handle, aclStream);
 
     this._gatts[uuid] = this._gatts[handle] = gatt;
@@ -271,6 +470,10 @@ NobleBindings.prototype.onLeConnComplete = function (
       'servicesDiscovered',
       this.onServicesDiscoveredEX.bind(this)
     );
+    this._gatts[handle].on(
+      'databaseDiscover',
+      this.onDatabaseDiscover.bind(this)
+    );
     this._gatts[handle].on(
       'includedServicesDiscover',
       this.onIncludedServicesDiscovered.bind(this)
@@ -284,6 +487,7 @@ NobleBindings.prototype.onLeConnComplete = function (
       this.onCharacteristicsDiscoveredEX.bind(this)
     );
     this._gatts[handle].on('read', this.onRead.bind(this));
+    this._gatts[handle].on('readMultiple', this.onReadMultiple.bind(this));
     this._gatts[handle].on('write', this.onWrite.bind(this));
     this._gatts[handle].on('broadcast', this.onBroadcast.bind(this));
     this._gatts[handle].on('notify', this.onNotify.bind(this));
@@ -297,51 +501,74 @@ NobleBindings.prototype.onLeConnComplete = function (
     this._gatts[handle].on('handleRead', this.onHandleRead.bind(this));
     this._gatts[handle].on('handleWrite', this.onHandleWrite.bind(this));
     this._gatts[handle].on('handleNotify', this.onHandleNotify.bind(this));
+    this._gatts[handle].on('timeout', this.onAttTimeout.bind(this));
+    this._gatts[handle].on('eattSupported', this.onEattSupported.bind(this));
 
     this._signalings[handle].on(
       'connectionParameterUpdateRequest',
       this.onConnectionParameterUpdateRequest.bind(this)
     );
+    this._signalings[handle].on(
+      'channelOpen',
+      this.onL2capChannelOpen.bind(this)
+    );
 
     this._gatts[handle].exchangeMtu();
-  } else {
-    uuid = this._pendingConnectionUuid;
-    let statusMessage = Hci.STATUS_MAPPER[status] || 'HCI Error: Unknown';
+    this._gatts[handle].writeClientFeatures(this._eattBearers > 0);
+    this.tuneLink(handle, connectOptions);
+
+    if (this.intervalManager) {
+      this.intervalManager.addConnection(handle, aclStream, gatt, interval);
+    }
+  }
+
+  const attempt = this.connectionScheduler.onConnComplete(status, uuid);
+  this.scanScheduler.onConnComplete(status);
+
+  if (status !== 0) {
+    uuid = attempt.uuid;
+    let statusMessage = attempt.timedOut
+      ? 'Connection attempt timed out'
+      : Hci.STATUS_MAPPER[status] || 'HCI Error: Unknown';
     const errorCode = ` (0x${status.toString(16)})`;
     statusMessage = statusMessage + errorCode;
     error = new Error(statusMessage);
   }
 
-  this.emit('connect', uuid, error);
-
-  if (this._connectionQueue.length > 0) {
-    const queueItem = this._connectionQueue.shift();
-    const peripheralUuid = queueItem.id;
-
-    address = this._addresses[peripheralUuid];
-    addressType = this._addresseTypes[peripheralUuid];
-
-    this._pendingConnectionUuid = peripheralUuid;
-
-    this._hci.createLeConn(address, addressType, queueItem.params);
-  } else {
-    this._pendingConnectionUuid = null;
+  // attempts being retried stay pending
+  if (status === 0 || attempt.done) {
+    this.emit('connect', uuid, error);
   }
+
+  this.connectionScheduler.next();
 };
 
 NobleBindings.prototype.onLeConnUpdateComplete = function (
+  status,
   handle,
   interval,
   latency,
   supervisionTimeout
 ) {
-  // no-op
+  if (this.intervalManager) {
+    this.intervalManager.onConnectionUpdate(
+      status,
+      handle,
+      interval,
+      latency,
+      supervisionTimeout
+    );
+  }
 };
 
 NobleBindings.prototype.onDisconnComplete = function (handle, reason) {
   const uuid = this._handles[handle];
 
   if (uuid) {
+    if (this.intervalManager) {
+      this.intervalManager.removeConnection(handle);
+    }
+
     this._aclStreams[handle].push(null, null);
     this._gatts[handle].removeAllListeners();
     this._signalings[handle].removeAllListeners();
@@ -355,16 +582,34 @@ NobleBindings.prototype.onDisconnComplete = function (handle, reason) {
     delete this._handles[handle];
 
     this.emit('disconnect', uuid, reason);
+
+    this.connectionScheduler.onDisconnect(uuid);
+    this.scanScheduler.onDisconnect();
   } else {
     console.warn(`noble warning: unknown handle ${handle} disconnected!`);
   }
 };
 
-NobleBindings.prototype.onEncryptChange = function (handle, encrypt) {
+// Longer link layer PDUs (Bluetooth 4.2) and the 2M PHY (5.0) where the
+// controller has them. The controller works out with the peer what both
+// support, and Hci fragments ACL data by the outcome.
+NobleBindings.prototype.tuneLink = function (handle, { dataLength, phy }) {
+  const hciVersion = this._hci.hciVersion;
+
+  if (dataLength && hciVersion >= 0x08) {
+    this._hci.setDataLength(handle, Math.min(dataLength, LE_MAX_DATA_LENGTH));
+  }
+
+  if (PHYS[phy] > PHYS['1m'] && hciVersion >= 0x09) {
+    this._hci.setPhy(handle, PHYS['1m'] | PHYS[phy]);
+  }
+};
+
+NobleBindings.prototype.onEncryptChange = function (handle, encrypt, status) {
   const aclStream = this._aclStreams[handle];
 
   if (aclStream) {
-    aclStream.pushEncrypt(encrypt);
+    aclStream.pushEncrypt(encrypt, status);
   }
 };
 
@@ -374,6 +619,59 @@ NobleBindings.prototype.onMtu = function (address, mtu) {
   this.emit('onMtu', uuid, mtu);
 };
 
+// Opens the Enhanced ATT bearers, again once the link is encrypted if the
+// peer wants that first
+NobleBindings.prototype.onEattSupported = function (address, mtu) {
+  const uuid = address.split(':').join('').toLowerCase();
+  const handle = this._handles[uuid];
+  const signaling = this._signalings[handle];
+
+  if (!signaling) {
+    return;
+  }
+
+  signaling.openEnhancedChannels(EATT_PSM, this._eattBearers, { mtu }, (error, channels) => {
+    const gatt = this._gatts[handle];
+    const aclStream = this._aclStreams[handle];
+
+    if (!gatt) {
+      return;
+    }
+
+    if (error) {
+      debug(`${uuid}: no Enhanced ATT bearers, ${error.message}`);
+
+      if (EATT_SECURITY_RESULTS.indexOf(error.result) !== -1) {
+        aclStream.once('encrypt', (encrypt) => {
+          if (encrypt && this._gatts[handle] === gatt) {
+            this.onEattSupported(address, mtu);
+          }
+        });
+      }
+      return;
+    }
+
+    debug(`${uuid}: ${channels.length} Enhanced ATT bearers`);
+
+    for (const channel of channels) {
+      gatt.addBearer(channel);
+    }
+  });
+};
+
+// the ATT bearer is unusable after a transaction timed out, disconnecting is
+// the only way to recover and lets the pending operations fail
+NobleBindings.prototype.onAttTimeout = function (address, opcode) {
+  const uuid = address.split(':').join('').toLowerCase();
+  const handle = this._handles[uuid];
+
+  debug(`${uuid}: ATT request 0x${opcode.toString(16)} timed out, disconnecting`);
+
+  if (handle !== undefined) {
+    this._hci.disconnect(handle);
+  }
+};
+
 NobleBindings.prototype.onRssiRead = function (handle, rssi) {
   this.emit('rssiUpdate', this._handles[handle], rssi);
 };
@@ -423,6 +721,23 @@ NobleBindings.prototype.onServicesDiscoveredEX = function (address, services) {
   this.emit('servicesDiscovered', uuid, services);
 };
 
+NobleBindings.prototype.discoverDatabase = function (peripheralUuid, descriptors) {
+  const handle = this._handles[peripheralUuid];
+  const gatt = this._gatts[handle];
+
+  if (gatt) {
+    gatt.discoverDatabase(descriptors);
+  } else {
+    console.warn(`noble warning: unknown peripheral ${peripheralUuid}`);
+  }
+};
+
+NobleBindings.prototype.onDatabaseDiscover = function (address, services) {
+  const uuid = address.split(':').join('').toLowerCase();
+
+  this.emit('databaseDiscover', uuid, services);
+};
+
 NobleBindings.prototype.discoverIncludedServices = function (
   peripheralUuid,
   serviceUuid,
@@ -722,6 +1037,24 @@ NobleBindings.prototype.onValueWrite = function (
   );
 };
 
+NobleBindings.prototype.readMultiple = function (peripheralUuid, characteristics, requestId) {
+  const handle = this._handles[peripheralUuid];
+  const gatt = this._gatts[handle];
+
+  if (gatt) {
+    gatt.readMultiple(characteristics, requestId);
+  } else {
+    console.warn(`noble warning: unknown peripheral ${peripheralUuid}`);
+    this.emit('readMultiple', peripheralUuid, requestId, new Error('Peripheral not connected'));
+  }
+};
+
+NobleBindings.prototype.onReadMultiple = function (address, requestId, error, values) {
+  const uuid = address.split(':').join('').toLowerCase();
+
+  this.emit('readMultiple', uuid, requestId, error, values);
+};
+
 NobleBindings.prototype.readHandle = function (peripheralUuid, attHandle) {
   const handle = this._handles[peripheralUuid];
   const gatt = this._gatts[handle];
@@ -783,4 +1116,30 @@ NobleBindings.prototype.onConnectionParameterUpdateRequest = function (
   );
 };
 
+NobleBindings.prototype.openL2capChannel = function (
+  peripheralUuid,
+  psm,
+  options
+) {
+  const handle = this._handles[peripheralUuid];
+  const signaling = this._signalings[handle];
+
+  if (signaling) {
+    signaling.openChannel(psm, options);
+  } else {
+    console.warn(`noble warning: unknown peripheral ${peripheralUuid}`);
+  }
+};
+
+NobleBindings.prototype.onL2capChannelOpen = function (
+  handle,
+  psm,
+  error,
+  channel
+) {
+  const uuid = this._handles[handle];
+
+  this.emit('l2capChannelOpen', uuid, psm, error, channel);
+};
+
 module.exports = NobleBindings;
@@ -0,0 +1,177 @@
+const debug = require('debug')('btsnoop');
+
+const fs = require('fs');
+
+// RFC 1761, with the datalink type Wireshark and btmon use for H4 framed packets
+const BTSNOOP_MAGIC = Buffer.from('btsnoop\0', 'ascii');
+const BTSNOOP_VERSION = 1;
+const BTSNOOP_DATALINK_H4 = 1002;
+
+const HEADER_SIZE = 16;
+const RECORD_HEADER_SIZE = 24;
+
+// microseconds between 0000-01-01 and 1970-01-01
+const BTSNOOP_EPOCH_OFFSET = 0x00dcddb30f2f8000n;
+
+const FLAG_RECEIVED = 0x01;
+const FLAG_COMMAND_OR_EVENT = 0x02;
+
+const HCI_COMMAND_PKT = 0x01;
+const HCI_EVENT_PKT = 0x04;
+
+const DEFAULT_FLUSH_SIZE = 64 * 1024;
+
+// Date.now() only has millisecond resolution, advance it with the hrtime clock
+const clockBase =
+  BigInt(Date.now()) * 1000n -
+  process.hrtime.bigint() / 1000n +
+  BTSNOOP_EPOCH_OFFSET;
+
+const now = () => clockBase + process.hrtime.bigint() / 1000n;
+
+const header = () => {
+  const buffer = Buffer.alloc(HEADER_SIZE);
+
+  BTSNOOP_MAGIC.copy(buffer, 0);
+  buffer.writeUInt32BE(BTSNOOP_VERSION, 8);
+  buffer.writeUInt32BE(BTSNOOP_DATALINK_H4, 12);
+
+  return buffer;
+};
+
+/*
+ * Appends HCI packets to a btsnoop file. Records are copied into a chunk
+ * buffer and handed to the file stream once per event loop turn (or when the
+ * chunk is full), so capturing never blocks the caller on file I/O.
+ */
+const BtsnoopWriter = function (path, options) {
+  options = options || {};
+
+  this._flushSize = options.flushSize || DEFAULT_FLUSH_SIZE;
+  this._chunk = Buffer.allocUnsafe(this._flushSize);
+  this._offset = 0;
+  this._flushScheduled = false;
+
+  this._stream = fs.createWriteStream(path);
+  this._stream.on('error', (error) => debug(`write error: ${error.message}`));
+  this._stream.write(header());
+};
+
+BtsnoopWriter.prototype.write = function (packet, received) {
+  if (this._stream === null) {
+    return;
+  }
+
+  const size = RECORD_HEADER_SIZE + packet.length;
+
+  if (this._offset + size > this._chunk.length) {
+    this.flush();
+
+    if (size > this._chunk.length) {
+      this._chunk = Buffer.allocUnsafe(size);
+    }
+  }
+
+  const type = packet.readUInt8(0);
+  let flags = received ? FLAG_RECEIVED : 0;
+  if (type === HCI_COMMAND_PKT || type === HCI_EVENT_PKT) {
+    flags |= FLAG_COMMAND_OR_EVENT;
+  }
+
+  const chunk = this._chunk;
+  let offset = this._offset;
+
+  chunk.writeUInt32BE(packet.length, offset); // original length
+  chunk.writeUInt32BE(packet.length, offset + 4); // included length
+  chunk.writeUInt32BE(flags, offset + 8);
+  chunk.writeUInt32BE(0, offset + 12); // cumulative drops
+  chunk.writeBigInt64BE(now(), offset + 16);
+  offset += RECORD_HEADER_SIZE;
+
+  packet.copy(chunk, offset);
+  this._offset = offset + packet.length;
+
+  if (!this._flushScheduled) {
+    this._flushScheduled = true;
+    setImmediate(() => this.flush());
+  }
+};
+
+BtsnoopWriter.prototype.flush = function () {
+  this._flushScheduled = false;
+
+  if (this._offset === 0 || this._stream === null) {
+    return;
+  }
+
+  // the stream keeps a reference to the written buffer, start a fresh chunk
+  this._stream.write(this._chunk.slice(0, this._offset));
+  this._chunk = Buffer.allocUnsafe(this._flushSize);
+  this._offset = 0;
+};
+
+BtsnoopWriter.prototype.close = function (callback) {
+  this.flush();
+
+  const stream = this._stream;
+  this._stream = null;
+
+  if (stream) {
+    stream.end(callback);
+  } else if (callback) {
+    callback();
+  }
+};
+
+/*
+ * Parses a btsnoop (H4) capture into
+ * [{ packet, received, timestamp }], timestamp in microseconds since 1970.
+ */
+const parse = function (buffer) {
+  if (
+    buffer.length < HEADER_SIZE ||
+    !buffer.slice(0, BTSNOOP_MAGIC.length).equals(BTSNOOP_MAGIC)
+  ) {
+    throw new Error('Not a btsnoop file');
+  }
+
+  const datalink = buffer.readUInt32BE(12);
+  if (datalink !== BTSNOOP_DATALINK_H4) {
+    throw new Error(`Unsupported btsnoop datalink type ${datalink}`);
+  }
+
+  const records = [];
+  let offset = HEADER_SIZE;
+
+  while (offset + RECORD_HEADER_SIZE <= buffer.length) {
+    const includedLength = buffer.readUInt32BE(offset + 4);
+    const flags = buffer.readUInt32BE(offset + 8);
+    const timestamp = buffer.readBigInt64BE(offset + 16) - BTSNOOP_EPOCH_OFFSET;
+    const start = offset + RECORD_HEADER_SIZE;
+
+    if (start + includedLength > buffer.length) {
+      debug('truncated record at end of capture');
+      break;
+    }
+
+    records.push({
+      packet: buffer.slice(start, start + includedLength),
+      received: (flags & FLAG_RECEIVED) !== 0,
+      timestamp: Number(timestamp)
+    });
+
+    offset = start + includedLength;
+  }
+
+  return records;
+};
+
+const read = function (path) {
+  return parse(fs.readFileSync(path));
+};
+
+module.exports = {
+  BtsnoopWriter,
+  parse,
+  read
+};
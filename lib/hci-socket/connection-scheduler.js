@@ -0,0 +1,460 @@
+const debug = require('debug')('connection-scheduler');
+
+const events = require('events');
+const util = require('util');
+
+// statuses a later attempt may get past (Vol 1, Part F): Memory Capacity
+// Exceeded, Connection Timeout, Limited Resources, Connection Failed to be
+// Established
+const RETRYABLE_STATUSES = [0x07, 0x08, 0x0d, 0x3e];
+
+const aggregate = () => ({ count: 0, total: 0, max: 0 });
+
+const record = (aggregate, value) => {
+  aggregate.count++;
+  aggregate.total += value;
+  aggregate.max = Math.max(aggregate.max, value);
+};
+
+const mean = (aggregate) =>
+  aggregate.count > 0 ? aggregate.total / aggregate.count : 0;
+
+/*
+ * Controllers take one LE Create Connection at a time, so connect intents
+ * wait here and go out one after the other: highest `priority` first, then
+ * the ones with the fewest failed attempts (devices that failed go behind
+ * healthy ones), then in the order they were asked for.
+ *
+ * An attempt still pending after `attemptTimeout` ms (0 for none) is
+ * cancelled with LE Create Connection Cancel. Timed out and failed attempts
+ * are retried up to `retries` times, each after an exponential backoff of
+ * `backoff.base` ms doubling up to `backoff.max` ms, with equal jitter so
+ * devices that failed together don't come back in lockstep.
+ *
+ * Devices given to reconnect() are loaded into the controller's Filter
+ * Accept List, and while any of them is disconnected and no directed attempt
+ * is waiting an LE Create Connection using the list is left pending, so the
+ * controller connects to the first of them it hears advertising without
+ * waiting for the host. Connected devices stay on the list, they don't
+ * advertise connectable, so connections and disconnections don't reload it.
+ * Directed attempts and changes to the list cancel the attempt first, the
+ * list can't change while it is in use.
+ *
+ * Emits 'attempt' (uuid) when a directed LE Create Connection goes out,
+ * 'retry' (uuid, { attempt, delay, status, timedOut }) when an attempt
+ * is requeued, 'established' (uuid, { attempts, queueWait,
+ * establishmentTime }) once connected, 'failed' (uuid, { attempts, status,
+ * timedOut }) once out of attempts and 'reconnected' (uuid, { latency }) when
+ * a device comes back through the accept list, latency counted from its
+ * disconnection.
+ */
+const ConnectionScheduler = function (hci, options) {
+  options = options || {};
+
+  this._hci = hci;
+
+  this._attemptTimeout =
+    options.attemptTimeout !== undefined ? options.attemptTimeout : 10000;
+  this._retries = options.retries !== undefined ? options.retries : 2;
+  this._backoff = Object.assign({ base: 250, max: 10000 }, options.backoff);
+  this._random = options.random || Math.random;
+  // connection parameters of the attempts through the accept list
+  this._reconnectParameters = options.reconnectParameters || {};
+
+  this._queue = [];
+  this._current = null;
+  this._seq = 0;
+  this._wakeTimer = null;
+
+  this._connected = new Set();
+  // uuid -> { address, addressType, disconnectedAt }
+  this._reconnect = new Map();
+  // uuids in the controller's accept list
+  this._acceptList = [];
+  this._reconnectReadyAt = 0;
+
+  this.stats = {
+    queued: 0,
+    attempts: 0,
+    established: 0,
+    failed: 0,
+    timeouts: 0,
+    retries: 0,
+    cancelled: 0,
+    reconnects: 0
+  };
+  // in ms
+  this._queueWait = aggregate();
+  this._establishment = aggregate();
+  this._reconnectLatency = aggregate();
+};
+
+util.inherits(ConnectionScheduler, events.EventEmitter);
+
+ConnectionScheduler.prototype.connect = function (
+  uuid,
+  address,
+  addressType,
+  parameters
+) {
+  parameters = parameters || {};
+
+  // asking again for a device already waiting just updates its intent
+  this._queue = this._queue.filter((intent) => intent.uuid !== uuid);
+
+  this._queue.push({
+    uuid,
+    address,
+    addressType,
+    parameters,
+    priority: parameters.priority || 0,
+    attemptTimeout:
+      parameters.attemptTimeout !== undefined
+        ? parameters.attemptTimeout
+        : this._attemptTimeout,
+    retries:
+      parameters.retries !== undefined ? parameters.retries : this._retries,
+    attempts: 0,
+    queuedAt: Date.now(),
+    readyAt: 0,
+    seq: this._seq++
+  });
+  this.stats.queued++;
+
+  this.next();
+};
+
+// true if the device was waiting or being connected to
+ConnectionScheduler.prototype.cancel = function (uuid) {
+  const length = this._queue.length;
+  this._queue = this._queue.filter((intent) => intent.uuid !== uuid);
+
+  if (this._queue.length !== length) {
+    this.stats.cancelled++;
+    this.next();
+    return true;
+  }
+
+  if (this._current && this._current.uuid === uuid) {
+    this.stats.cancelled++;
+    this.cancelAttempt(false);
+    return true;
+  }
+
+  return false;
+};
+
+ConnectionScheduler.prototype.isPending = function (uuid) {
+  return (
+    (this._current !== null && this._current.uuid === uuid) ||
+    this._queue.some((intent) => intent.uuid === uuid)
+  );
+};
+
+ConnectionScheduler.prototype.reconnect = function (
+  uuid,
+  address,
+  addressType
+) {
+  this._reconnect.set(uuid, {
+    address,
+    addressType,
+    disconnectedAt: Date.now()
+  });
+
+  this.next();
+};
+
+ConnectionScheduler.prototype.stopReconnect = function (uuid) {
+  if (this._reconnect.delete(uuid)) {
+    this.next();
+  }
+};
+
+ConnectionScheduler.prototype.onDisconnect = function (uuid) {
+  this._connected.delete(uuid);
+
+  const device = this._reconnect.get(uuid);
+  if (device) {
+    device.disconnectedAt = Date.now();
+    this.next();
+  }
+};
+
+// the devices to reconnect that aren't waiting for a directed attempt
+ConnectionScheduler.prototype.reconnectCandidates = function () {
+  const size = this._hci.filterAcceptListSize || Infinity;
+
+  return Array.from(this._reconnect.keys())
+    .filter((uuid) => !this.isPending(uuid))
+    .slice(0, size);
+};
+
+ConnectionScheduler.prototype.next = function () {
+  clearTimeout(this._wakeTimer);
+  this._wakeTimer = null;
+
+  const now = Date.now();
+  const ready = this._queue.filter((intent) => intent.readyAt <= now);
+  const candidates = this.reconnectCandidates();
+  const disconnected = candidates.some((uuid) => !this._connected.has(uuid));
+
+  // wake up for intents backing off, or to try the accept list again
+  const wakeAt = Math.min(
+    ...this._queue
+      .filter((intent) => intent.readyAt > now)
+      .map((intent) => intent.readyAt),
+    disconnected && this._reconnectReadyAt > now
+      ? this._reconnectReadyAt
+      : Infinity
+  );
+  if (wakeAt !== Infinity) {
+    this._wakeTimer = setTimeout(() => {
+      this._wakeTimer = null;
+      this.next();
+    }, wakeAt - now);
+  }
+
+  if (this._current) {
+    // the accept list attempt makes way for directed ones and list changes,
+    // and stops once nobody on the list is missing
+    if (
+      this._current.background &&
+      !this._current.cancelled &&
+      (ready.length > 0 ||
+        !disconnected ||
+        candidates.join() !== this._acceptList.join())
+    ) {
+      this.cancelAttempt(false);
+    }
+    return;
+  }
+
+  if (ready.length > 0) {
+    const intent = ready.reduce((best, intent) =>
+      intent.priority > best.priority ||
+      (intent.priority === best.priority &&
+        (intent.attempts < best.attempts ||
+          (intent.attempts === best.attempts && intent.seq < best.seq)))
+        ? intent
+        : best
+    );
+
+    this._queue.splice(this._queue.indexOf(intent), 1);
+    this.startAttempt(intent, now);
+  } else if (disconnected && this._reconnectReadyAt <= now) {
+    this.startReconnect(candidates, now);
+  }
+};
+
+ConnectionScheduler.prototype.startReconnect = function (candidates, now) {
+  if (candidates.join() !== this._acceptList.join()) {
+    this._hci.clearFilterAcceptList();
+    for (const uuid of candidates) {
+      const { address, addressType } = this._reconnect.get(uuid);
+      this._hci.addToFilterAcceptList(address, addressType);
+    }
+    this._acceptList = candidates;
+  }
+
+  debug(`waiting on an accept list of ${candidates.length} devices`);
+
+  this._current = {
+    background: true,
+    uuid: null,
+    startedAt: now,
+    cancelled: false,
+    timedOut: false,
+    timer: null
+  };
+
+  // no peer address: connect to whoever on the accept list advertises first
+  this._hci.createLeConn(null, null, this._reconnectParameters, true);
+};
+
+ConnectionScheduler.prototype.startAttempt = function (intent, now) {
+  intent.attempts++;
+  intent.startedAt = now;
+  intent.cancelled = false;
+  intent.timedOut = false;
+  intent.timer = null;
+
+  this._current = intent;
+  this.stats.attempts++;
+
+  debug(
+    `${intent.uuid}: attempt ${intent.attempts}, ${this._queue.length} waiting`
+  );
+
+  if (intent.attemptTimeout > 0) {
+    intent.timer = setTimeout(() => {
+      debug(`${intent.uuid}: attempt timed out`);
+      this.stats.timeouts++;
+      this.cancelAttempt(true);
+    }, intent.attemptTimeout);
+  }
+
+  this._hci.createLeConn(intent.address, intent.addressType, intent.parameters);
+  this.emit('attempt', intent.uuid);
+};
+
+ConnectionScheduler.prototype.cancelAttempt = function (timedOut) {
+  const intent = this._current;
+
+  clearTimeout(intent.timer);
+  intent.timer = null;
+
+  // LE Create Connection Cancel goes out once per attempt
+  const sent = intent.cancelled || intent.timedOut;
+
+  if (timedOut) {
+    intent.timedOut = true;
+  } else {
+    intent.cancelled = true;
+  }
+
+  if (!sent) {
+    this._hci.cancelConnect();
+  }
+};
+
+/*
+ * The LE Connection Complete for the attempt in flight, with the uuid of the
+ * device connected to on success. Returns its uuid (null if none was in
+ * flight) and whether it is done: connected, cancelled or out of attempts.
+ * Retries are requeued and not done, nor are failed or cancelled attempts
+ * through the accept list. The next attempt starts on next().
+ */
+ConnectionScheduler.prototype.onConnComplete = function (status, uuid) {
+  const intent = this._current;
+  const now = Date.now();
+
+  if (status === 0) {
+    this._connected.add(uuid);
+  }
+
+  if (!intent) {
+    return { uuid: null, done: true, timedOut: false };
+  }
+
+  clearTimeout(intent.timer);
+  this._current = null;
+
+  if (intent.background) {
+    return this.onReconnectComplete(intent, status, uuid, now);
+  }
+
+  const result = {
+    uuid: intent.uuid,
+    done: true,
+    timedOut: status !== 0 && intent.timedOut
+  };
+
+  if (status === 0) {
+    const queueWait = intent.startedAt - intent.queuedAt;
+    const establishmentTime = now - intent.startedAt;
+
+    this.stats.established++;
+    record(this._queueWait, queueWait);
+    record(this._establishment, establishmentTime);
+
+    this.emit('established', intent.uuid, {
+      attempts: intent.attempts,
+      queueWait,
+      establishmentTime
+    });
+  } else if (
+    !intent.cancelled &&
+    (intent.timedOut || RETRYABLE_STATUSES.includes(status)) &&
+    intent.attempts <= intent.retries
+  ) {
+    const delay = this.backoff(intent.attempts);
+
+    intent.readyAt = now + delay;
+    this._queue.push(intent);
+    this.stats.retries++;
+    result.done = false;
+
+    debug(`${intent.uuid}: retrying in ${delay.toFixed(0)} ms`);
+    this.emit('retry', intent.uuid, {
+      attempt: intent.attempts,
+      delay,
+      status,
+      timedOut: intent.timedOut
+    });
+  } else if (!intent.cancelled) {
+    this.stats.failed++;
+
+    this.emit('failed', intent.uuid, {
+      attempts: intent.attempts,
+      status,
+      timedOut: intent.timedOut
+    });
+  }
+
+  return result;
+};
+
+ConnectionScheduler.prototype.onReconnectComplete = function (
+  intent,
+  status,
+  uuid,
+  now
+) {
+  if (status !== 0) {
+    if (!intent.cancelled) {
+      // the controller gave up on the list, don't hammer it
+      this._reconnectReadyAt = now + this.backoff(1);
+    }
+    return { uuid: null, done: false, timedOut: false };
+  }
+
+  const device = this._reconnect.get(uuid);
+  if (device) {
+    const latency = now - device.disconnectedAt;
+
+    this.stats.reconnects++;
+    record(this._reconnectLatency, latency);
+
+    debug(`${uuid}: reconnected after ${latency} ms`);
+    this.emit('reconnected', uuid, { latency });
+  }
+
+  return { uuid, done: true, timedOut: false };
+};
+
+// equal jitter: half the capped exponential delay, plus up to as much again
+ConnectionScheduler.prototype.backoff = function (attempts) {
+  const cap = Math.min(
+    this._backoff.max,
+    this._backoff.base * Math.pow(2, attempts - 1)
+  );
+
+  return cap / 2 + (this._random() * cap) / 2;
+};
+
+ConnectionScheduler.prototype.metrics = function () {
+  return Object.assign({}, this.stats, {
+    waiting: this._queue.length + (this._current ? 1 : 0),
+    queueWait: Object.assign({ mean: mean(this._queueWait) }, this._queueWait),
+    establishmentTime: Object.assign(
+      { mean: mean(this._establishment) },
+      this._establishment
+    ),
+    reconnectLatency: Object.assign(
+      { mean: mean(this._reconnectLatency) },
+      this._reconnectLatency
+    )
+  });
+};
+
+ConnectionScheduler.prototype.stop = function () {
+  clearTimeout(this._wakeTimer);
+  this._wakeTimer = null;
+
+  if (this._current) {
+    clearTimeout(this._current.timer);
+  }
+};
+
+module.exports = ConnectionScheduler;
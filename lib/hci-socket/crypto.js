@@ -33,6 +33,11 @@ function s1 (k, r1, r2) {
   ]));
 }
 
+// the random address hash, for resolvable private addresses
+function ah (k, r) {
+  return e(k, Buffer.concat([r, Buffer.alloc(13)])).slice(0, 3);
+}
+
 function e (key, data) {
   key = swap(key);
   data = swap(data);
@@ -70,5 +75,6 @@ module.exports = {
   r,
   c1,
   s1,
+  ah,
   e
 };
@@ -0,0 +1,356 @@
+// header, Int32 slots: bytes written and read so far (wrapping at 2^32), a
+// counter bumped on every write for the reader to wait on, and whether the
+// reader waits for the doorbell
+const HEAD = 0;
+const TAIL = 1;
+const SIGNAL = 2;
+const WAITING = 3;
+const HEADER_SIZE = 16;
+
+// frame length marking the rest of the buffer as unused
+const WRAP = 0xffffffff;
+
+const TYPE_UNDEFINED = 0;
+const TYPE_NULL = 1;
+const TYPE_FALSE = 2;
+const TYPE_TRUE = 3;
+const TYPE_NUMBER = 4;
+const TYPE_STRING = 5;
+const TYPE_BUFFER = 6;
+const TYPE_ARRAY = 7;
+const TYPE_OBJECT = 8;
+const TYPE_ERROR = 9;
+
+/*
+ * A single producer, single consumer queue of events on a SharedArrayBuffer,
+ * for a worker thread to hand events to the main thread without a message
+ * per event. Each frame is the event name and its arguments, encoded as
+ * tagged values: undefined, null, booleans, numbers, strings, Buffers, arrays,
+ * objects (own enumerable properties) and Errors (their message).
+ *
+ *   const ring = EventRing.create(1 << 20); // capacity, a power of 2
+ *   new Worker(file, { workerData: ring.buffer });
+ *
+ *   // worker
+ *   const ring = new EventRing(workerData);
+ *   ring.send('read', [uuid, serviceUuid, characteristicUuid, data, true]);
+ *
+ *   // main thread
+ *   const { async, value } = ring.wait(signal);
+ *   for (let event; (event = ring.shift()) !== null;) emit(...event);
+ *
+ * push returns false when the frame doesn't fit, send keeps it until the
+ * consumer catches up.
+ *
+ * Without Atomics.waitAsync (Node < 16) wait resolves once the consumer's
+ * onDoorbell is called, which the producer asks for through its doorbell
+ * function, at most once per wait:
+ *
+ *   ring.doorbell = () => parentPort.postMessage(null); // worker
+ *   worker.on('message', () => ring.onDoorbell()); // main thread
+ */
+const EventRing = function (buffer) {
+  this.buffer = buffer;
+
+  this._header = new Int32Array(buffer, 0, HEADER_SIZE / 4);
+  this._data = Buffer.from(buffer, HEADER_SIZE);
+  this._capacity = this._data.length;
+  this._mask = this._capacity - 1;
+
+  this._scratch = Buffer.alloc(256);
+  this._length = 0;
+
+  // events sent while the ring was full, in order
+  this._queue = [];
+  this._retryTimer = null;
+
+  this.doorbell = null;
+  this._waiter = null;
+
+  this.stats = {
+    events: 0,
+    queued: 0
+  };
+};
+
+EventRing.create = function (capacity) {
+  if (capacity < 64 || (capacity & (capacity - 1)) !== 0) {
+    throw new Error(`ring capacity ${capacity} is not a power of 2`);
+  }
+
+  return new EventRing(new SharedArrayBuffer(HEADER_SIZE + capacity));
+};
+
+EventRing.prototype.reserve = function (length) {
+  if (this._length + length > this._scratch.length) {
+    const scratch = Buffer.alloc(
+      Math.max(this._scratch.length * 2, this._length + length)
+    );
+    this._scratch.copy(scratch, 0, 0, this._length);
+    this._scratch = scratch;
+  }
+
+  const offset = this._length;
+  this._length += length;
+  return offset;
+};
+
+EventRing.prototype.encode = function (value) {
+  if (value === undefined) {
+    this._scratch[this.reserve(1)] = TYPE_UNDEFINED;
+  } else if (value === null) {
+    this._scratch[this.reserve(1)] = TYPE_NULL;
+  } else if (typeof value === 'boolean') {
+    this._scratch[this.reserve(1)] = value ? TYPE_TRUE : TYPE_FALSE;
+  } else if (typeof value === 'number') {
+    const offset = this.reserve(9);
+    this._scratch[offset] = TYPE_NUMBER;
+    this._scratch.writeDoubleLE(value, offset + 1);
+  } else if (typeof value === 'string') {
+    this.encodeString(TYPE_STRING, value);
+  } else if (Buffer.isBuffer(value) || value instanceof Uint8Array) {
+    const offset = this.reserve(5 + value.length);
+    this._scratch[offset] = TYPE_BUFFER;
+    this._scratch.writeUInt32LE(value.length, offset + 1);
+    this._scratch.set(value, offset + 5);
+  } else if (Array.isArray(value)) {
+    const offset = this.reserve(5);
+    this._scratch[offset] = TYPE_ARRAY;
+    this._scratch.writeUInt32LE(value.length, offset + 1);
+
+    for (const item of value) {
+      this.encode(item);
+    }
+  } else if (value instanceof Error) {
+    this.encodeString(TYPE_ERROR, value.message);
+  } else {
+    const keys = Object.keys(value);
+    const offset = this.reserve(5);
+    this._scratch[offset] = TYPE_OBJECT;
+    this._scratch.writeUInt32LE(keys.length, offset + 1);
+
+    for (const key of keys) {
+      this.encodeString(TYPE_STRING, key);
+      this.encode(value[key]);
+    }
+  }
+};
+
+EventRing.prototype.encodeString = function (type, value) {
+  const length = Buffer.byteLength(value);
+  const offset = this.reserve(5 + length);
+
+  this._scratch[offset] = type;
+  this._scratch.writeUInt32LE(length, offset + 1);
+  this._scratch.write(value, offset + 5, length);
+};
+
+// the value at `state.offset` of `data`, moving past it
+const decode = function (data, state) {
+  const type = data[state.offset++];
+
+  switch (type) {
+    case TYPE_UNDEFINED:
+      return undefined;
+    case TYPE_NULL:
+      return null;
+    case TYPE_FALSE:
+      return false;
+    case TYPE_TRUE:
+      return true;
+    case TYPE_NUMBER:
+      state.offset += 8;
+      return data.readDoubleLE(state.offset - 8);
+  }
+
+  const length = data.readUInt32LE(state.offset);
+  state.offset += 4;
+
+  switch (type) {
+    case TYPE_STRING:
+    case TYPE_ERROR: {
+      const string = data.toString('utf8', state.offset, state.offset + length);
+      state.offset += length;
+      return type === TYPE_ERROR ? new Error(string) : string;
+    }
+
+    case TYPE_BUFFER: {
+      // copied out, the ring reuses the bytes
+      const buffer = Buffer.from(data.subarray(state.offset, state.offset + length));
+      state.offset += length;
+      return buffer;
+    }
+
+    case TYPE_ARRAY: {
+      const array = new Array(length);
+      for (let i = 0; i < length; i++) {
+        array[i] = decode(data, state);
+      }
+      return array;
+    }
+
+    case TYPE_OBJECT: {
+      const object = {};
+      for (let i = 0; i < length; i++) {
+        const key = decode(data, state);
+        object[key] = decode(data, state);
+      }
+      return object;
+    }
+  }
+
+  throw new Error(`unknown value type ${type}`);
+};
+
+// writes [event, args] as one frame, false if it doesn't fit
+EventRing.prototype.push = function (event, args) {
+  this._length = 0;
+  this.reserve(4); // frame length
+  this.encodeString(TYPE_STRING, event);
+  this.encode(args);
+
+  if (this._length > this._capacity) {
+    throw new Error(`${event} of ${this._length} bytes doesn't fit the ring`);
+  }
+
+  return this.write(this._scratch.subarray(0, this._length));
+};
+
+// pushes [event, args], or keeps it to push every ms until there is room
+EventRing.prototype.send = function (event, args) {
+  this.stats.events++;
+
+  if (this._queue.length === 0 && this.push(event, args)) {
+    return;
+  }
+
+  this.stats.queued++;
+  this._queue.push([event, args]);
+
+  if (this._retryTimer === null) {
+    this._retryTimer = setTimeout(() => this.flush(), 1);
+  }
+};
+
+EventRing.prototype.flush = function () {
+  this._retryTimer = null;
+
+  while (this._queue.length > 0 && this.push(...this._queue[0])) {
+    this._queue.shift();
+  }
+
+  if (this._queue.length > 0) {
+    this._retryTimer = setTimeout(() => this.flush(), 1);
+  }
+};
+
+EventRing.prototype.close = function () {
+  clearTimeout(this._retryTimer);
+  this._retryTimer = null;
+  this._queue = [];
+};
+
+// writes a frame whose first 4 bytes are left for its length
+EventRing.prototype.write = function (frame) {
+  const head = Atomics.load(this._header, HEAD) >>> 0;
+  const tail = Atomics.load(this._header, TAIL) >>> 0;
+  const free = this._capacity - ((head - tail) >>> 0);
+
+  const index = head & this._mask;
+  const contiguous = this._capacity - index;
+  // a frame that doesn't fit before the end starts over at the beginning
+  const skip = contiguous < frame.length ? contiguous : 0;
+
+  if (skip + frame.length > free) {
+    return false;
+  }
+
+  if (skip >= 4) {
+    this._data.writeUInt32LE(WRAP, index);
+  }
+
+  frame.writeUInt32LE(frame.length - 4, 0);
+  frame.copy(this._data, (head + skip) & this._mask);
+
+  Atomics.store(this._header, HEAD, (head + skip + frame.length) | 0);
+  Atomics.add(this._header, SIGNAL, 1);
+  Atomics.notify(this._header, SIGNAL);
+
+  if (this.doorbell !== null && Atomics.exchange(this._header, WAITING, 0)) {
+    this.doorbell();
+  }
+
+  return true;
+};
+
+// the oldest [event, args], null if there are none
+EventRing.prototype.shift = function () {
+  const head = Atomics.load(this._header, HEAD) >>> 0;
+  let tail = Atomics.load(this._header, TAIL) >>> 0;
+
+  if (head === tail) {
+    return null;
+  }
+
+  let index = tail & this._mask;
+  const contiguous = this._capacity - index;
+
+  if (contiguous < 4 || this._data.readUInt32LE(index) === WRAP) {
+    tail = (tail + contiguous) >>> 0;
+    index = 0;
+  }
+
+  const length = this._data.readUInt32LE(index);
+  const state = { offset: index + 4 };
+  const event = decode(this._data, state);
+  const args = decode(this._data, state);
+
+  Atomics.store(this._header, TAIL, (tail + 4 + length) | 0);
+
+  return [event, args];
+};
+
+// the write counter, to wait for it to change from
+EventRing.prototype.signal = function () {
+  return Atomics.load(this._header, SIGNAL);
+};
+
+// resolves once something was written after `signal`, like Atomics.waitAsync
+EventRing.prototype.wait = function (signal) {
+  if (typeof Atomics.waitAsync === 'function') {
+    return Atomics.waitAsync(this._header, SIGNAL, signal);
+  }
+
+  // set before checking the signal, so a write after the check rings
+  Atomics.store(this._header, WAITING, 1);
+  if (Atomics.load(this._header, SIGNAL) !== signal) {
+    Atomics.store(this._header, WAITING, 0);
+    return { async: false, value: 'not-equal' };
+  }
+
+  return {
+    async: true,
+    value: new Promise((resolve) => {
+      this._waiter = resolve;
+    })
+  };
+};
+
+// the producer rang the doorbell
+EventRing.prototype.onDoorbell = function () {
+  const waiter = this._waiter;
+
+  if (waiter !== null) {
+    this._waiter = null;
+    waiter('ok');
+  }
+};
+
+// wakes a consumer waiting without anything written, to stop it
+EventRing.prototype.wake = function () {
+  Atomics.add(this._header, SIGNAL, 1);
+  Atomics.notify(this._header, SIGNAL);
+  this.onDoorbell();
+};
+
+module.exports = EventRing;
@@ -0,0 +1,1441 @@
+const debug = require('debug')('fake-controller');
+
+const events = require('events');
+const util = require('util');
+
+const FakePeripheral = require('./fake-peripheral');
+
+const HCI_COMMAND_PKT = 0x01;
+const HCI_ACLDATA_PKT = 0x02;
+const HCI_EVENT_PKT = 0x04;
+
+const ACL_START_NO_FLUSH = 0x00;
+const ACL_CONT = 0x01;
+const ACL_START = 0x02;
+
+const EVT_DISCONN_COMPLETE = 0x05;
+const EVT_ENCRYPT_CHANGE = 0x08;
+const EVT_CMD_COMPLETE = 0x0e;
+const EVT_CMD_STATUS = 0x0f;
+const EVT_NUMBER_OF_COMPLETED_PACKETS = 0x13;
+const EVT_LE_META_EVENT = 0x3e;
+
+const EVT_LE_CONN_COMPLETE = 0x01;
+const EVT_LE_ADVERTISING_REPORT = 0x02;
+const EVT_LE_CONN_UPDATE_COMPLETE = 0x03;
+const EVT_LE_DATA_LENGTH_CHANGE = 0x07;
+const EVT_LE_ENHANCED_CONN_COMPLETE = 0x0a;
+const EVT_LE_PHY_UPDATE_COMPLETE = 0x0c;
+const EVT_LE_EXTENDED_ADVERTISING_REPORT = 0x0d;
+const EVT_LE_PERIODIC_ADVERTISING_SYNC_ESTABLISHED = 0x0e;
+const EVT_LE_PERIODIC_ADVERTISING_REPORT = 0x0f;
+const EVT_LE_PERIODIC_ADVERTISING_SYNC_LOST = 0x10;
+
+const ADV_IND = 0x00;
+const ADV_SCAN_IND = 0x02;
+const ADV_NONCONN_IND = 0x03;
+const SCAN_RSP = 0x04;
+
+// extended report event types for legacy PDUs (Vol 4 Part E 7.7.65.13)
+const EXT_ADV_IND = 0x13;
+const EXT_ADV_SCAN_IND = 0x12;
+const EXT_ADV_NONCONN_IND = 0x10;
+const EXT_SCAN_RSP_ADV_IND = 0x1b;
+const EXT_SCAN_RSP_ADV_SCAN_IND = 0x1a;
+// non-connectable, non-scannable, not legacy: what periodic advertisers use
+const EXT_ADV_NONCONN = 0x00;
+// extended (not legacy) advertising, for data that doesn't fit a legacy PDU
+const EXT_ADV_CONNECTABLE = 0x01;
+const EXT_ADV_SCANNABLE = 0x02;
+const EXT_ADV_SCAN_RSP = 0x08;
+// data status: incomplete, more data to come
+const EXT_ADV_INCOMPLETE = 0x20;
+
+const LEGACY_ADV_DATA = 31;
+// the most advertising data one extended advertising report carries
+const EXT_REPORT_DATA = 229;
+
+// the most periodic advertising data one report carries
+const PERIODIC_REPORT_DATA = 247;
+
+const HCI_SUCCESS = 0x00;
+const HCI_UNKNOWN_COMMAND = 0x01;
+const HCI_UNKNOWN_CONNECTION_ID = 0x02;
+const HCI_PIN_OR_KEY_MISSING = 0x06;
+const HCI_MEMORY_CAPACITY_EXCEEDED = 0x07;
+const HCI_CONNECTION_LIMIT_EXCEEDED = 0x09;
+const HCI_COMMAND_DISALLOWED = 0x0c;
+const HCI_CONNECTION_FAILED_TO_BE_ESTABLISHED = 0x3e;
+const HCI_CONNECTION_TIMEOUT = 0x08;
+const HCI_LOCAL_HOST_TERMINATED = 0x16;
+const HCI_MIC_FAILURE = 0x3d;
+const HCI_UNKNOWN_ADVERTISING_IDENTIFIER = 0x42;
+const HCI_OPERATION_CANCELLED_BY_HOST = 0x44;
+
+const ATT_CID = 0x0004;
+const SIGNALING_CID = 0x0005;
+const SMP_CID = 0x0006;
+const LE_DYNAMIC_CID_FIRST = 0x0040;
+
+const DISCONNECT_CMD = 0x0406;
+
+const SET_EVENT_MASK_CMD = 0x0c01;
+const RESET_CMD = 0x0c03;
+const READ_LE_HOST_SUPPORTED_CMD = 0x0c6c;
+const WRITE_LE_HOST_SUPPORTED_CMD = 0x0c6d;
+const READ_LOCAL_VERSION_CMD = 0x1001;
+const READ_SUPPORTED_COMMANDS_CMD = 0x1002;
+const READ_BUFFER_SIZE_CMD = 0x1005;
+const READ_BD_ADDR_CMD = 0x1009;
+const READ_RSSI_CMD = 0x1405;
+const LE_SET_EVENT_MASK_CMD = 0x2001;
+const LE_READ_BUFFER_SIZE_CMD = 0x2002;
+const LE_SET_RANDOM_ADDRESS_CMD = 0x2005;
+const LE_SET_SCAN_PARAMETERS_CMD = 0x200b;
+const LE_SET_SCAN_ENABLE_CMD = 0x200c;
+const LE_CREATE_CONN_CMD = 0x200d;
+const LE_CANCEL_CONN_CMD = 0x200e;
+const LE_READ_FILTER_ACCEPT_LIST_SIZE_CMD = 0x200f;
+const LE_CLEAR_FILTER_ACCEPT_LIST_CMD = 0x2010;
+const LE_ADD_DEVICE_TO_FILTER_ACCEPT_LIST_CMD = 0x2011;
+const LE_CONN_UPDATE_CMD = 0x2013;
+const LE_START_ENCRYPTION_CMD = 0x2019;
+const LE_SET_DATA_LENGTH_CMD = 0x2022;
+const LE_SET_DEFAULT_PHY_CMD = 0x2031;
+const LE_SET_PHY_CMD = 0x2032;
+const LE_SET_EXTENDED_SCAN_PARAMETERS_CMD = 0x2041;
+const LE_SET_EXTENDED_SCAN_ENABLE_CMD = 0x2042;
+const LE_CREATE_EXTENDED_CONN_CMD = 0x2043;
+const LE_PERIODIC_ADVERTISING_CREATE_SYNC_CMD = 0x2044;
+const LE_PERIODIC_ADVERTISING_CREATE_SYNC_CANCEL_CMD = 0x2045;
+const LE_PERIODIC_ADVERTISING_TERMINATE_SYNC_CMD = 0x2046;
+
+const FIRST_CONNECTION_HANDLE = 0x0040;
+
+const LE_DEFAULT_DATA_LENGTH = 27;
+
+const PHY_1M = 0x01;
+const PHY_2M = 0x02;
+
+// air time in us of a data PDU with `length` payload bytes, the empty PDU
+// answering it and the two inter frame spaces (Vol 6 Part B 2.1, 4.1.1)
+const exchangeTime = (length, phy) =>
+  phy === PHY_2M ? (11 + length) * 4 + 44 + 300 : (10 + length) * 8 + 80 + 300;
+
+/*
+ * A stand-in for BluetoothHciSocket that answers HCI commands the way a
+ * controller would, so the hci-socket stack can be driven without hardware:
+ *
+ *   const hci = new Hci({ socket: new FakeController({ numCommandPackets: 8 }) });
+ *
+ * The controller buffers at most `numCommandPackets` commands and reports the
+ * free slots in every Command Complete/Status event, like real hardware does.
+ * Commands written while no slot is free are counted in `stats.creditViolations`.
+ *
+ * Peripherals (see fake-peripheral.js, or their options, so the controller
+ * can be set up in a worker thread) advertise while scanning is enabled and
+ * can be connected to. Every connection interval, each direction of a
+ * connection gets the air time of `packetsPerEvent` 27 byte link layer PDUs
+ * on LE 1M. ACL data goes out in PDUs of up to the connection's data length,
+ * 27 bytes until LE Set Data Length raises it (up to `maxDataLength` and the
+ * peripheral's), and LE Set PHY can move the connection to LE 2M where both
+ * sides support it. The host's packets are reported with Number Of Completed
+ * Packets events once sent. ACL packets written while all `aclBuffers.num`
+ * controller buffers are in use count as `stats.aclBufferViolations`.
+ *
+ * A Create Connection for an address that isn't advertising, or one using the
+ * Filter Accept List (of up to `acceptListSize` devices), connects on the
+ * first connectable advertisement it hears from a device it is waiting for.
+ * Beyond `maxConnections` links, connections fail with Connection Limit
+ * Exceeded.
+ *
+ * LE Start Encryption takes a link layer procedure and succeeds when the
+ * peripheral has the same key for the EDIV and Rand, otherwise Encryption
+ * Change reports PIN or Key Missing or a MIC failure (the link stays up).
+ *
+ * Under an extended scan, advertising data longer than a legacy PDU takes is
+ * reported as extended advertising of the peripheral's advertising set, in
+ * fragments of up to `extendedFragmentSize` bytes (229, what fits a report).
+ *
+ * An LE Periodic Advertising Create Sync is established the next time the
+ * scanner hears the advertiser, and reports every event of its train from
+ * then on, whether scanning or not, up to `maxPeriodicSyncs` trains. A sync
+ * whose advertiser is removed is lost after its sync timeout.
+ *
+ * With `sharedRadio`, scanning, initiating and connections take turns on one
+ * radio: advertisements are only heard in scan windows (LE Set Scan
+ * Parameters) and while no connection event, of `connectionEventLength` ms
+ * each, is going on. Within scan windows, the scanner wins the radio over an
+ * initiator or a connection event with `scanPriority` probability. Connections
+ * that miss their events for longer than the supervision timeout are lost.
+ */
+const FakeController = function (options) {
+  options = options || {};
+
+  this._numCommandPackets = options.numCommandPackets || 1;
+  this._commandLatency =
+    options.commandLatency !== undefined ? options.commandLatency : 1;
+  this._hciVersion =
+    options.hciVersion !== undefined ? options.hciVersion : 0x09;
+  this._aclBuffers = options.aclBuffers || { length: 27, num: 8 };
+
+  this._packetsPerEvent = options.packetsPerEvent || 4;
+  this._maxDataLength = options.maxDataLength || 251;
+  this._le2mPhy = options.le2mPhy !== false;
+  this._connectLatency =
+    options.connectLatency !== undefined ? options.connectLatency : 10;
+  this._acceptListSize = options.acceptListSize || 8;
+  this._maxConnections = options.maxConnections || Infinity;
+  this._maxPeriodicSyncs = options.maxPeriodicSyncs || Infinity;
+  this._extendedFragmentSize = Math.min(
+    options.extendedFragmentSize || EXT_REPORT_DATA,
+    EXT_REPORT_DATA
+  );
+  this._sharedRadio = !!options.sharedRadio;
+  this._connectionEventLength = options.connectionEventLength || 2.5;
+  this._scanPriority =
+    options.scanPriority !== undefined ? options.scanPriority : 0.5;
+  // added to every peripheral's RSSI, as if the antenna were further away
+  this._rssiOffset = options.rssiOffset || 0;
+
+  this.address = options.address || '00:11:22:33:44:55';
+
+  this._isDevUp = options.isDevUp !== undefined ? options.isDevUp : true;
+  this._started = false;
+  this._commandsInFlight = 0;
+
+  this._peripherals = new Map();
+  this._scanning = false;
+  this._activeScan = true;
+  this._extendedScan = false;
+  // in ms, the scan windows start when scanning is enabled
+  this._scanInterval = 11.25;
+  this._scanWindow = 11.25;
+  this._scanEnabledAt = 0;
+  this._filterDuplicates = false;
+  this._reported = new Set();
+  this._advertisingTimers = new Map();
+
+  this._pendingConnection = null;
+  this._acceptList = new Set();
+  this._connections = new Map();
+  this._nextHandle = FIRST_CONNECTION_HANDLE;
+  this._aclBuffersInUse = 0;
+
+  // { sid, address, timeout } of the Create Sync waiting for its advertiser
+  this._pendingSync = null;
+  // sync handle -> { peripheral, timeout, lastHeard, timer }
+  this._periodicSyncs = new Map();
+  this._nextSyncHandle = 0;
+
+  this.stats = {
+    commands: 0,
+    creditViolations: 0,
+    maxCommandsInFlight: 0,
+    advertisingReports: 0,
+    aclPacketsReceived: 0,
+    aclPacketsSent: 0,
+    aclBufferViolations: 0,
+    maxAclBuffersInUse: 0,
+    connectionEvents: 0,
+    missedConnectionEvents: 0,
+    supervisionTimeouts: 0,
+    periodicReports: 0
+  };
+
+  for (const peripheral of options.peripherals || []) {
+    this.addPeripheral(
+      peripheral instanceof FakePeripheral
+        ? peripheral
+        : new FakePeripheral(peripheral)
+    );
+  }
+};
+
+util.inherits(FakeController, events.EventEmitter);
+
+FakeController.prototype.bindRaw = function (deviceId) {
+  this._deviceId = deviceId;
+};
+
+FakeController.prototype.bindUser = function (deviceId) {
+  this._deviceId = deviceId;
+};
+
+FakeController.prototype.start = function () {
+  this._started = true;
+};
+
+FakeController.prototype.stop = function () {
+  this._started = false;
+
+  this.resetState();
+};
+
+FakeController.prototype.resetState = function () {
+  this._scanning = false;
+  this.stopAdvertising();
+  for (const handle of Array.from(this._connections.keys())) {
+    this.closeConnection(handle);
+  }
+  clearTimeout(this._pendingConnection && this._pendingConnection.timer);
+  this._pendingConnection = null;
+
+  this._pendingSync = null;
+  for (const sync of this._periodicSyncs.values()) {
+    clearInterval(sync.timer);
+  }
+  this._periodicSyncs.clear();
+};
+
+FakeController.prototype.addPeripheral = function (peripheral) {
+  this._peripherals.set(peripheral.address, peripheral);
+
+  if (this._scanning || this.isInitiating()) {
+    this.scheduleAdvertisement(peripheral);
+  }
+};
+
+FakeController.prototype.removePeripheral = function (peripheral) {
+  this._peripherals.delete(peripheral.address);
+
+  clearTimeout(this._advertisingTimers.get(peripheral.address));
+  this._advertisingTimers.delete(peripheral.address);
+};
+
+FakeController.prototype.isDevUp = function () {
+  return this._isDevUp;
+};
+
+FakeController.prototype.setFilter = function (filter) {};
+
+FakeController.prototype.write = function (data) {
+  const packetType = data.readUInt8(0);
+
+  if (packetType === HCI_COMMAND_PKT) {
+    this.onCommand(data.readUInt16LE(1), data.slice(4, 4 + data.readUInt8(3)));
+  } else if (packetType === HCI_ACLDATA_PKT) {
+    this.onAclData(data);
+  }
+};
+
+FakeController.prototype.onCommand = function (opcode, params) {
+  debug(`command 0x${opcode.toString(16)}: ${params.toString('hex')}`);
+
+  this.stats.commands++;
+  if (this._commandsInFlight >= this._numCommandPackets) {
+    this.stats.creditViolations++;
+  }
+  this._commandsInFlight++;
+  this.stats.maxCommandsInFlight = Math.max(
+    this.stats.maxCommandsInFlight,
+    this._commandsInFlight
+  );
+
+  setTimeout(() => {
+    this._commandsInFlight--;
+    this.processCommand(opcode, params);
+  }, this._commandLatency);
+};
+
+FakeController.prototype.processCommand = function (opcode, params) {
+  switch (opcode) {
+    case RESET_CMD:
+      this.resetState();
+      this.commandComplete(opcode, Buffer.from([HCI_SUCCESS]));
+      break;
+
+    case SET_EVENT_MASK_CMD:
+    case WRITE_LE_HOST_SUPPORTED_CMD:
+    case LE_SET_EVENT_MASK_CMD:
+    case LE_SET_RANDOM_ADDRESS_CMD:
+    case LE_SET_DEFAULT_PHY_CMD:
+      this.commandComplete(opcode, Buffer.from([HCI_SUCCESS]));
+      break;
+
+    case LE_SET_SCAN_PARAMETERS_CMD:
+      this._activeScan = params.readUInt8(0) === 0x01;
+      this._scanInterval = params.readUInt16LE(1) * 0.625;
+      this._scanWindow = params.readUInt16LE(3) * 0.625;
+      this.commandComplete(opcode, Buffer.from([HCI_SUCCESS]));
+      break;
+
+    case LE_SET_EXTENDED_SCAN_PARAMETERS_CMD:
+      this._activeScan = params.readUInt8(3) === 0x01;
+      this._scanInterval = params.readUInt16LE(4) * 0.625;
+      this._scanWindow = params.readUInt16LE(6) * 0.625;
+      this.commandComplete(opcode, Buffer.from([HCI_SUCCESS]));
+      break;
+
+    case LE_SET_SCAN_ENABLE_CMD:
+    case LE_SET_EXTENDED_SCAN_ENABLE_CMD:
+      this.commandComplete(opcode, Buffer.from([HCI_SUCCESS]));
+      this.setScanEnabled(
+        params.readUInt8(0) === 0x01,
+        params.readUInt8(1) === 0x01,
+        opcode === LE_SET_EXTENDED_SCAN_ENABLE_CMD
+      );
+      break;
+
+    case LE_CREATE_CONN_CMD:
+    case LE_CREATE_EXTENDED_CONN_CMD:
+      this.createConnection(opcode, params);
+      break;
+
+    case LE_CANCEL_CONN_CMD:
+      this.cancelConnection();
+      break;
+
+    case LE_PERIODIC_ADVERTISING_CREATE_SYNC_CMD:
+      this.createSync(opcode, params);
+      break;
+
+    case LE_PERIODIC_ADVERTISING_CREATE_SYNC_CANCEL_CMD:
+      this.cancelSync(opcode);
+      break;
+
+    case LE_PERIODIC_ADVERTISING_TERMINATE_SYNC_CMD:
+      this.terminateSync(opcode, params.readUInt16LE(0));
+      break;
+
+    case LE_READ_FILTER_ACCEPT_LIST_SIZE_CMD:
+      this.commandComplete(
+        opcode,
+        Buffer.from([HCI_SUCCESS, this._acceptListSize])
+      );
+      break;
+
+    case LE_CLEAR_FILTER_ACCEPT_LIST_CMD:
+    case LE_ADD_DEVICE_TO_FILTER_ACCEPT_LIST_CMD:
+      this.updateAcceptList(opcode, params);
+      break;
+
+    case LE_CONN_UPDATE_CMD:
+      this.updateConnection(params);
+      break;
+
+    case LE_START_ENCRYPTION_CMD:
+      this.startEncryption(params);
+      break;
+
+    case LE_SET_DATA_LENGTH_CMD:
+      this.setDataLength(params);
+      break;
+
+    case LE_SET_PHY_CMD:
+      this.setPhy(params);
+      break;
+
+    case DISCONNECT_CMD:
+      this.disconnect(params.readUInt16LE(0));
+      break;
+
+    case READ_RSSI_CMD: {
+      const handle = params.readUInt16LE(0);
+      const connection = this._connections.get(handle);
+      const result = Buffer.alloc(4);
+      result.writeUInt8(
+        connection ? HCI_SUCCESS : HCI_UNKNOWN_CONNECTION_ID,
+        0
+      );
+      result.writeUInt16LE(handle, 1);
+      result.writeInt8(connection ? this.rssi(connection.peripheral) : 0, 3);
+      this.commandComplete(opcode, result);
+      break;
+    }
+
+    case READ_LE_HOST_SUPPORTED_CMD:
+      this.commandComplete(opcode, Buffer.from([HCI_SUCCESS, 0x01, 0x00]));
+      break;
+
+    case READ_LOCAL_VERSION_CMD: {
+      const result = Buffer.alloc(9);
+      result.writeUInt8(HCI_SUCCESS, 0);
+      result.writeUInt8(this._hciVersion, 1); // hci version
+      result.writeUInt16LE(0x0000, 2); // hci revision
+      result.writeUInt8(this._hciVersion, 4); // lmp version
+      result.writeUInt16LE(0xffff, 5); // manufacturer
+      result.writeUInt16LE(0x0000, 7); // lmp subversion
+      this.commandComplete(opcode, result);
+      break;
+    }
+
+    case READ_SUPPORTED_COMMANDS_CMD:
+      this.commandComplete(
+        opcode,
+        Buffer.concat([Buffer.from([HCI_SUCCESS]), Buffer.alloc(64)])
+      );
+      break;
+
+    case READ_BUFFER_SIZE_CMD: {
+      const result = Buffer.alloc(8);
+      result.writeUInt8(HCI_SUCCESS, 0);
+      result.writeUInt16LE(this._aclBuffers.length, 1);
+      result.writeUInt8(0, 3); // sco length
+      result.writeUInt16LE(this._aclBuffers.num, 4);
+      result.writeUInt16LE(0, 6); // sco num
+      this.commandComplete(opcode, result);
+      break;
+    }
+
+    case READ_BD_ADDR_CMD:
+      this.commandComplete(
+        opcode,
+        Buffer.concat([
+          Buffer.from([HCI_SUCCESS]),
+          Buffer.from(this.address.split(':').reverse().join(''), 'hex')
+        ])
+      );
+      break;
+
+    case LE_READ_BUFFER_SIZE_CMD: {
+      const result = Buffer.alloc(4);
+      result.writeUInt8(HCI_SUCCESS, 0);
+      result.writeUInt16LE(this._aclBuffers.length, 1);
+      result.writeUInt8(this._aclBuffers.num, 3);
+      this.commandComplete(opcode, result);
+      break;
+    }
+
+    default:
+      debug(`unknown command 0x${opcode.toString(16)}`);
+      this.commandStatus(opcode, HCI_UNKNOWN_COMMAND);
+      break;
+  }
+};
+
+FakeController.prototype.freeCommandSlots = function () {
+  return Math.max(this._numCommandPackets - this._commandsInFlight, 0);
+};
+
+FakeController.prototype.commandComplete = function (opcode, result) {
+  const params = Buffer.alloc(3 + result.length);
+
+  params.writeUInt8(this.freeCommandSlots(), 0);
+  params.writeUInt16LE(opcode, 1);
+  result.copy(params, 3);
+
+  this.sendEvent(EVT_CMD_COMPLETE, params);
+};
+
+FakeController.prototype.commandStatus = function (opcode, status) {
+  const params = Buffer.alloc(4);
+
+  params.writeUInt8(status, 0);
+  params.writeUInt8(this.freeCommandSlots(), 1);
+  params.writeUInt16LE(opcode, 2);
+
+  this.sendEvent(EVT_CMD_STATUS, params);
+};
+
+FakeController.prototype.sendEvent = function (eventCode, params) {
+  const packet = Buffer.alloc(3 + params.length);
+
+  packet.writeUInt8(HCI_EVENT_PKT, 0);
+  packet.writeUInt8(eventCode, 1);
+  packet.writeUInt8(params.length, 2);
+  params.copy(packet, 3);
+
+  this.push(packet);
+};
+
+FakeController.prototype.push = function (packet) {
+  if (!this._started) {
+    return;
+  }
+
+  debug(`event: ${packet.toString('hex')}`);
+  this.emit('data', packet);
+};
+
+FakeController.prototype.leMetaEvent = function (subEventCode, params) {
+  this.sendEvent(
+    EVT_LE_META_EVENT,
+    Buffer.concat([Buffer.from([subEventCode]), params])
+  );
+};
+
+FakeController.prototype.setScanEnabled = function (
+  enabled,
+  filterDuplicates,
+  extended
+) {
+  this._filterDuplicates = filterDuplicates;
+  this._extendedScan = extended;
+  this._reported.clear();
+
+  if (enabled === this._scanning) {
+    return;
+  }
+
+  this._scanning = enabled;
+
+  if (enabled) {
+    this._scanEnabledAt = Date.now();
+    this.startAdvertising();
+  } else if (!this.isInitiating()) {
+    this.stopAdvertising();
+  }
+};
+
+// advertisements are heard while scanning, and while a Create Connection
+// waits for one
+FakeController.prototype.startAdvertising = function () {
+  for (const peripheral of this._peripherals.values()) {
+    if (!this._advertisingTimers.has(peripheral.address)) {
+      this.scheduleAdvertisement(peripheral);
+    }
+  }
+};
+
+FakeController.prototype.isInitiating = function () {
+  return this._pendingConnection !== null && !this._pendingConnection.timer;
+};
+
+FakeController.prototype.stopAdvertising = function () {
+  for (const timer of this._advertisingTimers.values()) {
+    clearTimeout(timer);
+  }
+  this._advertisingTimers.clear();
+};
+
+FakeController.prototype.isConnected = function (peripheral) {
+  for (const connection of this._connections.values()) {
+    if (connection.peripheral === peripheral) {
+      return true;
+    }
+  }
+  return false;
+};
+
+// advInterval plus the 0 - 10 ms advDelay every advertising event gets
+FakeController.prototype.scheduleAdvertisement = function (peripheral) {
+  const delay = peripheral.advertisingInterval + Math.random() * 10;
+
+  this._advertisingTimers.set(
+    peripheral.address,
+    setTimeout(() => {
+      if (!this._scanning && !this.isInitiating()) {
+        this._advertisingTimers.delete(peripheral.address);
+        return;
+      }
+      if (!this.isConnected(peripheral)) {
+        if (this._scanning && this.scannerHears()) {
+          this.advertise(peripheral);
+        }
+        if (!this.scannerHasRadio()) {
+          this.initiate(peripheral);
+        }
+      }
+      this.scheduleAdvertisement(peripheral);
+    }, delay)
+  );
+};
+
+FakeController.prototype.rssi = function (peripheral) {
+  return Math.max(-127, peripheral.rssi + this._rssiOffset);
+};
+
+FakeController.prototype.inScanWindow = function () {
+  return (
+    this._scanning &&
+    (Date.now() - this._scanEnabledAt) % this._scanInterval < this._scanWindow
+  );
+};
+
+// the share of air time connection events take
+FakeController.prototype.connectionLoad = function () {
+  let load = 0;
+  for (const connection of this._connections.values()) {
+    load += this._connectionEventLength / Math.max(connection.interval * 1.25, 1);
+  }
+  return Math.min(load, 1);
+};
+
+// whether an advertisement sent now reaches the scanner
+FakeController.prototype.scannerHears = function () {
+  return (
+    !this._sharedRadio ||
+    (this.inScanWindow() && Math.random() >= this.connectionLoad())
+  );
+};
+
+// whether the scanner takes the radio away from an initiator or a connection
+// event now
+FakeController.prototype.scannerHasRadio = function () {
+  return (
+    this._sharedRadio && this.inScanWindow() && Math.random() < this._scanPriority
+  );
+};
+
+FakeController.prototype.initiate = function (peripheral) {
+  const pending = this._pendingConnection;
+
+  if (
+    this.isInitiating() &&
+    peripheral.connectable &&
+    (pending.acceptList
+      ? this._acceptList.has(peripheral.address)
+      : pending.address === peripheral.address)
+  ) {
+    pending.address = peripheral.address;
+    this.completeConnection(peripheral);
+  }
+};
+
+FakeController.prototype.updateAcceptList = function (opcode, params) {
+  let status = HCI_SUCCESS;
+
+  if (this._pendingConnection && this._pendingConnection.acceptList) {
+    status = HCI_COMMAND_DISALLOWED;
+  } else if (opcode === LE_CLEAR_FILTER_ACCEPT_LIST_CMD) {
+    this._acceptList.clear();
+  } else if (this._acceptList.size >= this._acceptListSize) {
+    status = HCI_MEMORY_CAPACITY_EXCEEDED;
+  } else {
+    this._acceptList.add(
+      params.slice(1, 7).toString('hex').match(/.{1,2}/g).reverse().join(':')
+    );
+  }
+
+  this.commandComplete(opcode, Buffer.from([status]));
+};
+
+FakeController.prototype.advertise = function (peripheral) {
+  const pending = this._pendingSync;
+  if (
+    pending &&
+    pending.address === peripheral.address &&
+    peripheral.periodicAdvertising &&
+    peripheral.periodicAdvertising.sid === pending.sid
+  ) {
+    this.establishSync(peripheral);
+  }
+
+  const scannable =
+    peripheral.scanResponseData !== null &&
+    !(peripheral.periodicAdvertising && this._extendedScan);
+  const type = peripheral.connectable
+    ? ADV_IND
+    : scannable
+      ? ADV_SCAN_IND
+      : ADV_NONCONN_IND;
+
+  this.advertisingReport(peripheral, type, peripheral.advertisingData);
+
+  if (scannable && this._activeScan) {
+    this.advertisingReport(peripheral, SCAN_RSP, peripheral.scanResponseData);
+  }
+};
+
+FakeController.prototype.advertisingReport = function (peripheral, type, data) {
+  if (this._filterDuplicates) {
+    const key = `${peripheral.address}/${type}`;
+    if (this._reported.has(key)) {
+      return;
+    }
+    this._reported.add(key);
+  }
+
+  this.stats.advertisingReports++;
+
+  if (this._extendedScan) {
+    const periodic = peripheral.periodicAdvertising;
+    const legacy = !periodic && data.length <= LEGACY_ADV_DATA;
+    let eventType;
+
+    if (periodic) {
+      eventType = EXT_ADV_NONCONN;
+    } else if (!legacy) {
+      eventType =
+        type === SCAN_RSP
+          ? EXT_ADV_SCAN_RSP |
+            (peripheral.connectable ? EXT_ADV_CONNECTABLE : EXT_ADV_SCANNABLE)
+          : type === ADV_IND
+            ? EXT_ADV_CONNECTABLE
+            : type === ADV_SCAN_IND
+              ? EXT_ADV_SCANNABLE
+              : EXT_ADV_NONCONN;
+    } else if (type === SCAN_RSP) {
+      eventType = peripheral.connectable
+        ? EXT_SCAN_RSP_ADV_IND
+        : EXT_SCAN_RSP_ADV_SCAN_IND;
+    } else {
+      eventType = [EXT_ADV_IND, 0, EXT_ADV_SCAN_IND, EXT_ADV_NONCONN_IND][type];
+    }
+
+    let offset = 0;
+    do {
+      const length = Math.min(data.length - offset, this._extendedFragmentSize);
+      const more = offset + length < data.length;
+
+      this.extendedAdvertisingReport(
+        peripheral,
+        more ? eventType | EXT_ADV_INCOMPLETE : eventType,
+        legacy ? 0xff : periodic ? periodic.sid : peripheral.sid,
+        data.subarray(offset, offset + length)
+      );
+      offset += length;
+    } while (offset < data.length);
+  } else {
+    const params = Buffer.alloc(11 + data.length);
+
+    params.writeUInt8(1, 0); // num reports
+    params.writeUInt8(type, 1);
+    params.writeUInt8(peripheral.addressType === 'random' ? 0x01 : 0x00, 2);
+    Buffer.from(peripheral.address.split(':').reverse().join(''), 'hex').copy(params, 3);
+    params.writeUInt8(data.length, 9);
+    data.copy(params, 10);
+    params.writeInt8(this.rssi(peripheral), 10 + data.length);
+
+    this.leMetaEvent(EVT_LE_ADVERTISING_REPORT, params);
+  }
+};
+
+FakeController.prototype.extendedAdvertisingReport = function (
+  peripheral,
+  eventType,
+  sid,
+  data
+) {
+  const periodic = peripheral.periodicAdvertising;
+  const params = Buffer.alloc(25 + data.length);
+
+  params.writeUInt8(1, 0); // num reports
+  params.writeUInt16LE(eventType, 1);
+  params.writeUInt8(peripheral.addressType === 'random' ? 0x01 : 0x00, 3);
+  Buffer.from(peripheral.address.split(':').reverse().join(''), 'hex').copy(params, 4);
+  params.writeUInt8(0x01, 10); // primary phy: LE 1M
+  params.writeUInt8(sid !== 0xff ? 0x01 : 0x00, 11); // secondary phy: LE 1M or none
+  params.writeUInt8(sid, 12); // SID, 0xff: not available
+  params.writeInt8(0x7f, 13); // tx power: not available
+  params.writeInt8(this.rssi(peripheral), 14);
+  // periodic advertising interval, 1.25 ms units
+  params.writeUInt16LE(periodic ? Math.round(periodic.interval / 1.25) : 0x0000, 15);
+  params.writeUInt8(0x00, 17); // direct address type
+  params.writeUInt8(data.length, 24);
+  data.copy(params, 25);
+
+  this.leMetaEvent(EVT_LE_EXTENDED_ADVERTISING_REPORT, params);
+};
+
+FakeController.prototype.createSync = function (opcode, params) {
+  if (this._pendingSync) {
+    this.commandStatus(opcode, HCI_COMMAND_DISALLOWED);
+    return;
+  }
+  if (this._periodicSyncs.size >= this._maxPeriodicSyncs) {
+    this.commandStatus(opcode, HCI_MEMORY_CAPACITY_EXCEEDED);
+    return;
+  }
+
+  this.commandStatus(opcode, HCI_SUCCESS);
+  this._pendingSync = {
+    sid: params.readUInt8(1),
+    address: params.slice(3, 9).toString('hex').match(/.{1,2}/g).reverse().join(':'),
+    timeout: params.readUInt16LE(11) * 10
+  };
+};
+
+FakeController.prototype.cancelSync = function (opcode) {
+  const pending = this._pendingSync;
+
+  if (!pending) {
+    this.commandComplete(opcode, Buffer.from([HCI_COMMAND_DISALLOWED]));
+    return;
+  }
+
+  this._pendingSync = null;
+  this.commandComplete(opcode, Buffer.from([HCI_SUCCESS]));
+  this.syncEstablished(HCI_OPERATION_CANCELLED_BY_HOST, 0, pending.sid, null);
+};
+
+FakeController.prototype.terminateSync = function (opcode, handle) {
+  const sync = this._periodicSyncs.get(handle);
+
+  if (sync) {
+    clearInterval(sync.timer);
+    this._periodicSyncs.delete(handle);
+  }
+
+  this.commandComplete(
+    opcode,
+    Buffer.from([sync ? HCI_SUCCESS : HCI_UNKNOWN_ADVERTISING_IDENTIFIER])
+  );
+};
+
+FakeController.prototype.syncEstablished = function (status, handle, sid, peripheral) {
+  const params = Buffer.alloc(15);
+
+  params.writeUInt8(status, 0);
+  params.writeUInt16LE(handle, 1);
+  params.writeUInt8(sid, 3);
+  if (peripheral) {
+    params.writeUInt8(peripheral.addressType === 'random' ? 0x01 : 0x00, 4);
+    Buffer.from(peripheral.address.split(':').reverse().join(''), 'hex').copy(params, 5);
+    params.writeUInt8(0x01, 11); // advertiser phy: LE 1M
+    params.writeUInt16LE(Math.round(peripheral.periodicAdvertising.interval / 1.25), 12);
+  }
+  params.writeUInt8(0x00, 14); // advertiser clock accuracy
+
+  this.leMetaEvent(EVT_LE_PERIODIC_ADVERTISING_SYNC_ESTABLISHED, params);
+};
+
+FakeController.prototype.establishSync = function (peripheral) {
+  const { timeout } = this._pendingSync;
+  const handle = this._nextSyncHandle;
+
+  this._nextSyncHandle = (this._nextSyncHandle + 1) & 0x0eff;
+  this._pendingSync = null;
+  this.syncEstablished(HCI_SUCCESS, handle, peripheral.periodicAdvertising.sid, peripheral);
+
+  const sync = { peripheral, timeout, lastHeard: Date.now(), timer: null };
+  sync.timer = setInterval(
+    () => this.periodicEvent(handle, sync),
+    peripheral.periodicAdvertising.interval
+  );
+  this._periodicSyncs.set(handle, sync);
+};
+
+// one event of a followed train, in reports of up to 247 bytes
+FakeController.prototype.periodicEvent = function (handle, sync) {
+  const peripheral = sync.peripheral;
+
+  if (this._peripherals.get(peripheral.address) !== peripheral) {
+    if (Date.now() - sync.lastHeard >= sync.timeout) {
+      clearInterval(sync.timer);
+      this._periodicSyncs.delete(handle);
+
+      const params = Buffer.alloc(2);
+      params.writeUInt16LE(handle, 0);
+      this.leMetaEvent(EVT_LE_PERIODIC_ADVERTISING_SYNC_LOST, params);
+    }
+    return;
+  }
+
+  sync.lastHeard = Date.now();
+
+  const data = peripheral.periodicData();
+  let offset = 0;
+
+  do {
+    const length = Math.min(data.length - offset, PERIODIC_REPORT_DATA);
+    const params = Buffer.alloc(7 + length);
+
+    params.writeUInt16LE(handle, 0);
+    params.writeInt8(0x7f, 2); // tx power: not available
+    params.writeInt8(this.rssi(peripheral), 3);
+    params.writeUInt8(0xff, 4); // CTE type: none
+    // data status: complete, or more to come
+    params.writeUInt8(offset + length < data.length ? 0x01 : 0x00, 5);
+    params.writeUInt8(length, 6);
+    data.copy(params, 7, offset, offset + length);
+
+    this.stats.periodicReports++;
+    this.leMetaEvent(EVT_LE_PERIODIC_ADVERTISING_REPORT, params);
+
+    offset += length;
+  } while (offset < data.length);
+};
+
+FakeController.prototype.createConnection = function (opcode, params) {
+  if (this._pendingConnection) {
+    this.commandStatus(opcode, HCI_COMMAND_DISALLOWED);
+    return;
+  }
+
+  const extended = opcode === LE_CREATE_EXTENDED_CONN_CMD;
+  const acceptList = params.readUInt8(extended ? 0 : 4) === 0x01;
+  const addressOffset = extended ? 3 : 6;
+  const intervalOffset = extended ? 14 : 13;
+
+  const address = params
+    .slice(addressOffset, addressOffset + 6)
+    .toString('hex')
+    .match(/.{1,2}/g)
+    .reverse()
+    .join(':');
+
+  this.commandStatus(opcode, HCI_SUCCESS);
+
+  this._pendingConnection = {
+    address: acceptList ? null : address,
+    acceptList,
+    extended,
+    interval: params.readUInt16LE(intervalOffset + 2), // max interval
+    latency: params.readUInt16LE(intervalOffset + 4),
+    timeout: params.readUInt16LE(intervalOffset + 6),
+    timer: null
+  };
+
+  const peripheral = this._peripherals.get(address);
+
+  // an absent or non-connectable peripheral leaves the attempt pending until
+  // it advertises or the host cancels it, like a real controller. On a shared
+  // radio every attempt waits for an advertisement.
+  if (
+    !this._sharedRadio &&
+    !acceptList &&
+    peripheral &&
+    peripheral.connectable &&
+    !this.isConnected(peripheral)
+  ) {
+    this._pendingConnection.timer = setTimeout(
+      () => this.completeConnection(peripheral),
+      this._connectLatency
+    );
+  } else {
+    this.startAdvertising();
+  }
+};
+
+FakeController.prototype.cancelConnection = function () {
+  const pending = this._pendingConnection;
+
+  if (!pending) {
+    this.commandComplete(
+      LE_CANCEL_CONN_CMD,
+      Buffer.from([HCI_COMMAND_DISALLOWED])
+    );
+    return;
+  }
+
+  clearTimeout(pending.timer);
+  this._pendingConnection = null;
+
+  this.commandComplete(LE_CANCEL_CONN_CMD, Buffer.from([HCI_SUCCESS]));
+  this.connectionComplete(HCI_UNKNOWN_CONNECTION_ID, pending, null);
+};
+
+FakeController.prototype.completeConnection = function (peripheral) {
+  const pending = this._pendingConnection;
+  this._pendingConnection = null;
+
+  if (this._connections.size >= this._maxConnections) {
+    this.connectionComplete(HCI_CONNECTION_LIMIT_EXCEEDED, pending, null);
+    return;
+  }
+
+  if (peripheral.connectFailures > 0) {
+    peripheral.connectFailures--;
+    this.connectionComplete(
+      HCI_CONNECTION_FAILED_TO_BE_ESTABLISHED,
+      pending,
+      null
+    );
+    return;
+  }
+
+  const connection = {
+    handle: this._nextHandle++,
+    peripheral,
+    interval: pending.interval,
+    latency: pending.latency,
+    timeout: pending.timeout,
+    txQueue: [], // host -> peripheral ACL packets held in controller buffers
+    txSent: 0, // bytes of the first one already sent
+    rxQueue: [], // peripheral -> host L2CAP PDUs
+    rxSent: 0, // bytes of the first one already sent
+    txOctets: LE_DEFAULT_DATA_LENGTH,
+    rxOctets: LE_DEFAULT_DATA_LENGTH,
+    phy: PHY_1M,
+    reassembly: null,
+    session: null,
+    timer: null,
+    lastEventAt: Date.now()
+  };
+
+  connection.session = peripheral.createSession((pdu, cid) => {
+    const l2cap = Buffer.alloc(4 + pdu.length);
+    l2cap.writeUInt16LE(pdu.length, 0);
+    l2cap.writeUInt16LE(cid || ATT_CID, 2);
+    pdu.copy(l2cap, 4);
+    connection.rxQueue.push(l2cap);
+  }, { address: this.address, addressType: 'public' });
+  this._connections.set(connection.handle, connection);
+  this.scheduleConnectionEvents(connection);
+
+  debug(`connected ${peripheral.address} as handle ${connection.handle}`);
+
+  this.connectionComplete(HCI_SUCCESS, pending, connection);
+};
+
+FakeController.prototype.connectionComplete = function (
+  status,
+  pending,
+  connection
+) {
+  // a cancelled attempt through the accept list has no peer
+  const address = pending.address || '00:00:00:00:00:00';
+  const peripheral = this._peripherals.get(address);
+  const params = Buffer.alloc(pending.extended ? 30 : 18);
+
+  params.writeUInt8(status, 0);
+  params.writeUInt16LE(connection ? connection.handle : 0, 1);
+  params.writeUInt8(0x00, 3); // role: central
+  params.writeUInt8(
+    peripheral && peripheral.addressType === 'random' ? 0x01 : 0x00,
+    4
+  );
+  Buffer.from(address.split(':').reverse().join(''), 'hex').copy(params, 5);
+
+  // the enhanced event carries the local and peer RPA in between
+  const offset = pending.extended ? 23 : 11;
+  params.writeUInt16LE(pending.interval, offset);
+  params.writeUInt16LE(pending.latency, offset + 2);
+  params.writeUInt16LE(pending.timeout, offset + 4);
+  params.writeUInt8(0x00, offset + 6); // central clock accuracy
+
+  this.leMetaEvent(
+    pending.extended ? EVT_LE_ENHANCED_CONN_COMPLETE : EVT_LE_CONN_COMPLETE,
+    params
+  );
+};
+
+FakeController.prototype.updateConnection = function (params) {
+  const handle = params.readUInt16LE(0);
+  const connection = this._connections.get(handle);
+
+  if (!connection) {
+    this.commandStatus(LE_CONN_UPDATE_CMD, HCI_UNKNOWN_CONNECTION_ID);
+    return;
+  }
+
+  this.commandStatus(LE_CONN_UPDATE_CMD, HCI_SUCCESS);
+
+  connection.interval = params.readUInt16LE(4); // max interval
+  connection.latency = params.readUInt16LE(6);
+  connection.timeout = params.readUInt16LE(8);
+
+  clearInterval(connection.timer);
+  this.scheduleConnectionEvents(connection);
+
+  const update = Buffer.alloc(9);
+  update.writeUInt8(HCI_SUCCESS, 0);
+  update.writeUInt16LE(handle, 1);
+  update.writeUInt16LE(connection.interval, 3);
+  update.writeUInt16LE(connection.latency, 5);
+  update.writeUInt16LE(connection.timeout, 7);
+
+  this.leMetaEvent(EVT_LE_CONN_UPDATE_COMPLETE, update);
+};
+
+// the link layer procedures take a few connection events
+FakeController.prototype.afterLinkProcedure = function (connection, callback) {
+  setTimeout(() => {
+    if (this._connections.get(connection.handle) === connection) {
+      callback();
+    }
+  }, Math.max(connection.interval * 1.25 * 2, 1));
+};
+
+FakeController.prototype.setDataLength = function (params) {
+  const handle = params.readUInt16LE(0);
+  const connection = this._connections.get(handle);
+  const result = Buffer.alloc(3);
+
+  result.writeUInt8(connection ? HCI_SUCCESS : HCI_UNKNOWN_CONNECTION_ID, 0);
+  result.writeUInt16LE(handle, 1);
+  this.commandComplete(LE_SET_DATA_LENGTH_CMD, result);
+
+  if (!connection) {
+    return;
+  }
+
+  // the peripheral asks for its longest PDUs in return
+  const supported = Math.min(
+    this._maxDataLength,
+    connection.peripheral.maxDataLength
+  );
+  const txOctets = Math.max(
+    LE_DEFAULT_DATA_LENGTH,
+    Math.min(params.readUInt16LE(2), supported)
+  );
+
+  this.afterLinkProcedure(connection, () => {
+    if (
+      txOctets === connection.txOctets &&
+      supported === connection.rxOctets
+    ) {
+      return;
+    }
+
+    connection.txOctets = txOctets;
+    connection.rxOctets = supported;
+
+    const change = Buffer.alloc(10);
+    change.writeUInt16LE(handle, 0);
+    change.writeUInt16LE(connection.txOctets, 2);
+    change.writeUInt16LE((connection.txOctets + 14) * 8, 4);
+    change.writeUInt16LE(connection.rxOctets, 6);
+    change.writeUInt16LE((connection.rxOctets + 14) * 8, 8);
+
+    this.leMetaEvent(EVT_LE_DATA_LENGTH_CHANGE, change);
+  });
+};
+
+// the peripheral answers with the key it has for the EDIV and Rand, the link
+// only encrypts if it is the same one
+FakeController.prototype.startEncryption = function (params) {
+  const handle = params.readUInt16LE(0);
+  const connection = this._connections.get(handle);
+
+  if (!connection) {
+    this.commandStatus(LE_START_ENCRYPTION_CMD, HCI_UNKNOWN_CONNECTION_ID);
+    return;
+  }
+
+  this.commandStatus(LE_START_ENCRYPTION_CMD, HCI_SUCCESS);
+
+  const rand = Buffer.from(params.slice(2, 10));
+  const ediv = Buffer.from(params.slice(10, 12));
+  const ltk = Buffer.from(params.slice(12, 28));
+
+  this.afterLinkProcedure(connection, () => {
+    const key = connection.session.encryptionKey(rand, ediv);
+    let status = HCI_SUCCESS;
+
+    if (!key) {
+      status = HCI_PIN_OR_KEY_MISSING;
+    } else if (!key.equals(ltk)) {
+      status = HCI_MIC_FAILURE;
+    }
+
+    const change = Buffer.alloc(4);
+    change.writeUInt8(status, 0);
+    change.writeUInt16LE(handle, 1);
+    change.writeUInt8(status === HCI_SUCCESS ? 0x01 : 0x00, 3);
+
+    this.sendEvent(EVT_ENCRYPT_CHANGE, change);
+
+    if (status === HCI_SUCCESS) {
+      connection.session.onEncrypted();
+    }
+  });
+};
+
+FakeController.prototype.setPhy = function (params) {
+  const handle = params.readUInt16LE(0);
+  const connection = this._connections.get(handle);
+
+  if (!connection) {
+    this.commandStatus(LE_SET_PHY_CMD, HCI_UNKNOWN_CONNECTION_ID);
+    return;
+  }
+
+  this.commandStatus(LE_SET_PHY_CMD, HCI_SUCCESS);
+
+  // LE Coded is not simulated
+  const phys = params.readUInt8(3) & params.readUInt8(4);
+  const phy =
+    phys & PHY_2M && this._le2mPhy && connection.peripheral.le2mPhy
+      ? PHY_2M
+      : PHY_1M;
+
+  this.afterLinkProcedure(connection, () => {
+    connection.phy = phy;
+
+    const update = Buffer.alloc(5);
+    update.writeUInt8(HCI_SUCCESS, 0);
+    update.writeUInt16LE(handle, 1);
+    update.writeUInt8(phy, 3); // tx phy
+    update.writeUInt8(phy, 4); // rx phy
+
+    this.leMetaEvent(EVT_LE_PHY_UPDATE_COMPLETE, update);
+  });
+};
+
+FakeController.prototype.disconnect = function (handle) {
+  if (!this._connections.has(handle)) {
+    this.commandStatus(DISCONNECT_CMD, HCI_UNKNOWN_CONNECTION_ID);
+    return;
+  }
+
+  this.commandStatus(DISCONNECT_CMD, HCI_SUCCESS);
+  this.closeConnection(handle);
+
+  const params = Buffer.alloc(4);
+  params.writeUInt8(HCI_SUCCESS, 0);
+  params.writeUInt16LE(handle, 1);
+  params.writeUInt8(HCI_LOCAL_HOST_TERMINATED, 3);
+
+  this.sendEvent(EVT_DISCONN_COMPLETE, params);
+};
+
+// the link to a peripheral is lost, as if it went out of range
+FakeController.prototype.dropConnection = function (peripheral) {
+  for (const [handle, connection] of this._connections) {
+    if (connection.peripheral === peripheral) {
+      this.closeConnection(handle);
+
+      const params = Buffer.alloc(4);
+      params.writeUInt8(HCI_SUCCESS, 0);
+      params.writeUInt16LE(handle, 1);
+      params.writeUInt8(HCI_CONNECTION_TIMEOUT, 3);
+
+      this.sendEvent(EVT_DISCONN_COMPLETE, params);
+    }
+  }
+};
+
+FakeController.prototype.closeConnection = function (handle) {
+  const connection = this._connections.get(handle);
+
+  clearInterval(connection.timer);
+  connection.session.close();
+  this._aclBuffersInUse -= connection.txQueue.length;
+  this._connections.delete(handle);
+};
+
+// interval in units of 1.25 ms
+FakeController.prototype.scheduleConnectionEvents = function (connection) {
+  connection.timer = setInterval(
+    () => this.connectionEvent(connection),
+    Math.max(connection.interval * 1.25, 1)
+  );
+};
+
+FakeController.prototype.onAclData = function (data) {
+  const handle = data.readUInt16LE(1) & 0x0fff;
+  const connection = this._connections.get(handle);
+
+  this.stats.aclPacketsReceived++;
+
+  if (this._aclBuffersInUse >= this._aclBuffers.num) {
+    this.stats.aclBufferViolations++;
+  }
+
+  if (!connection) {
+    debug(`acl data for unknown handle ${handle}`);
+    return;
+  }
+
+  this._aclBuffersInUse++;
+  this.stats.maxAclBuffersInUse = Math.max(
+    this.stats.maxAclBuffersInUse,
+    this._aclBuffersInUse
+  );
+
+  connection.txQueue.push(data);
+};
+
+FakeController.prototype.connectionEvent = function (connection) {
+  this.stats.connectionEvents++;
+
+  if (this.scannerHasRadio()) {
+    this.stats.missedConnectionEvents++;
+
+    // supervision timeout in units of 10 ms
+    if (Date.now() - connection.lastEventAt > connection.timeout * 10) {
+      this.stats.supervisionTimeouts++;
+      this.dropConnection(connection.peripheral);
+    }
+    return;
+  }
+  connection.lastEventAt = Date.now();
+
+  const budget =
+    this._packetsPerEvent * exchangeTime(LE_DEFAULT_DATA_LENGTH, PHY_1M);
+
+  // the host's ACL packets, each in PDUs of up to txOctets
+  let airTime = 0;
+  let completed = 0;
+  while (connection.txQueue.length > 0) {
+    const packet = connection.txQueue[0];
+    const remaining = packet.length - 5 - connection.txSent;
+    const length = Math.min(remaining, connection.txOctets);
+    const time = exchangeTime(length, connection.phy);
+
+    // one PDU per event at least, however long
+    if (airTime > 0 && airTime + time > budget) {
+      break;
+    }
+    airTime += time;
+    connection.txSent += length;
+
+    if (connection.txSent === packet.length - 5) {
+      connection.txQueue.shift();
+      connection.txSent = 0;
+      completed++;
+      this.receiveAcl(connection, packet);
+    }
+  }
+
+  if (completed > 0) {
+    this._aclBuffersInUse -= completed;
+
+    const params = Buffer.alloc(5);
+    params.writeUInt8(1, 0); // number of handles
+    params.writeUInt16LE(connection.handle, 1);
+    params.writeUInt16LE(completed, 3);
+    this.sendEvent(EVT_NUMBER_OF_COMPLETED_PACKETS, params);
+  }
+
+  // the peripheral's PDUs, passed on to the host as they arrive over the air
+  airTime = 0;
+  while (connection.rxQueue.length > 0) {
+    const l2cap = connection.rxQueue[0];
+    const offset = connection.rxSent;
+    const length = Math.min(l2cap.length - offset, connection.rxOctets);
+    const time = exchangeTime(length, connection.phy);
+
+    if (airTime > 0 && airTime + time > budget) {
+      break;
+    }
+    airTime += time;
+
+    const fragment = l2cap.slice(offset, offset + length);
+    const packet = Buffer.alloc(5 + fragment.length);
+    const flags = offset === 0 ? ACL_START : ACL_CONT;
+
+    packet.writeUInt8(HCI_ACLDATA_PKT, 0);
+    packet.writeUInt16LE(connection.handle | (flags << 12), 1);
+    packet.writeUInt16LE(fragment.length, 3);
+    fragment.copy(packet, 5);
+
+    this.stats.aclPacketsSent++;
+    this.push(packet);
+
+    connection.rxSent += length;
+    if (connection.rxSent === l2cap.length) {
+      connection.rxQueue.shift();
+      connection.rxSent = 0;
+    }
+  }
+};
+
+FakeController.prototype.receiveAcl = function (connection, packet) {
+  const flags = packet.readUInt16LE(1) >> 12;
+  const data = packet.slice(5, 5 + packet.readUInt16LE(3));
+
+  if (flags === ACL_START_NO_FLUSH || flags === ACL_START) {
+    connection.reassembly = {
+      length: data.readUInt16LE(0),
+      cid: data.readUInt16LE(2),
+      data: data.slice(4)
+    };
+  } else if (flags === ACL_CONT && connection.reassembly) {
+    connection.reassembly.data = Buffer.concat([
+      connection.reassembly.data,
+      data
+    ]);
+  }
+
+  const reassembly = connection.reassembly;
+  if (!reassembly || reassembly.data.length < reassembly.length) {
+    return;
+  }
+  connection.reassembly = null;
+
+  if (reassembly.cid === ATT_CID) {
+    connection.session.onAtt(reassembly.data);
+  } else if (reassembly.cid === SIGNALING_CID) {
+    connection.session.onSignaling(reassembly.data);
+  } else if (reassembly.cid === SMP_CID) {
+    connection.session.onSmp(reassembly.data);
+  } else if (reassembly.cid >= LE_DYNAMIC_CID_FIRST) {
+    connection.session.onChannelData(reassembly.cid, reassembly.data);
+  }
+};
+
+module.exports = FakeController;
@@ -0,0 +1,1223 @@
+const debug = require('debug')('fake-peripheral');
+
+const events = require('events');
+const util = require('util');
+
+const crypto = require('./crypto');
+
+const ATT_OP_ERROR = 0x01;
+const ATT_OP_MTU_REQ = 0x02;
+const ATT_OP_MTU_RESP = 0x03;
+const ATT_OP_FIND_INFO_REQ = 0x04;
+const ATT_OP_FIND_INFO_RESP = 0x05;
+const ATT_OP_READ_BY_TYPE_REQ = 0x08;
+const ATT_OP_READ_BY_TYPE_RESP = 0x09;
+const ATT_OP_READ_REQ = 0x0a;
+const ATT_OP_READ_RESP = 0x0b;
+const ATT_OP_READ_BLOB_REQ = 0x0c;
+const ATT_OP_READ_BLOB_RESP = 0x0d;
+const ATT_OP_READ_MULTI_REQ = 0x0e;
+const ATT_OP_READ_MULTI_RESP = 0x0f;
+const ATT_OP_READ_BY_GROUP_REQ = 0x10;
+const ATT_OP_READ_BY_GROUP_RESP = 0x11;
+const ATT_OP_WRITE_REQ = 0x12;
+const ATT_OP_WRITE_RESP = 0x13;
+const ATT_OP_PREPARE_WRITE_REQ = 0x16;
+const ATT_OP_PREPARE_WRITE_RESP = 0x17;
+const ATT_OP_EXECUTE_WRITE_REQ = 0x18;
+const ATT_OP_EXECUTE_WRITE_RESP = 0x19;
+const ATT_OP_HANDLE_NOTIFY = 0x1b;
+const ATT_OP_HANDLE_IND = 0x1d;
+const ATT_OP_HANDLE_CNF = 0x1e;
+const ATT_OP_READ_MULTI_VAR_REQ = 0x20;
+const ATT_OP_READ_MULTI_VAR_RESP = 0x21;
+const ATT_OP_MULTI_HANDLE_NOTIFY = 0x23;
+const ATT_OP_WRITE_CMD = 0x52;
+
+const ATT_ECODE_INVALID_HANDLE = 0x01;
+const ATT_ECODE_AUTHENTICATION = 0x05;
+const ATT_ECODE_REQ_NOT_SUPP = 0x06;
+const ATT_ECODE_INVALID_OFFSET = 0x07;
+const ATT_ECODE_PREP_QUEUE_FULL = 0x09;
+const ATT_ECODE_ATTR_NOT_FOUND = 0x0a;
+
+const GATT_PRIM_SVC_UUID = '2800';
+const GATT_CHARAC_UUID = '2803';
+const GATT_CLIENT_CHARAC_CFG_UUID = '2902';
+const GATT_CLIENT_SUPPORTED_FEATURES_UUID = '2b29';
+const GATT_SERVER_SUPPORTED_FEATURES_UUID = '2b3a';
+
+const CLIENT_FEATURE_MULTIPLE_NOTIFICATIONS = 0x04;
+
+const ATT_DEFAULT_MTU = 23;
+
+const SIGNALING_CID = 0x0005;
+const SMP_CID = 0x0006;
+const LE_DYNAMIC_CID_FIRST = 0x0040;
+
+const L2CAP_COMMAND_REJECT = 0x01;
+const L2CAP_DISCONNECTION_REQUEST = 0x06;
+const L2CAP_DISCONNECTION_RESPONSE = 0x07;
+const L2CAP_CONNECTION_PARAMETER_UPDATE_RESPONSE = 0x13;
+const L2CAP_LE_CREDIT_BASED_CONNECTION_REQUEST = 0x14;
+const L2CAP_LE_CREDIT_BASED_CONNECTION_RESPONSE = 0x15;
+const L2CAP_FLOW_CONTROL_CREDIT_IND = 0x16;
+const L2CAP_CREDIT_BASED_CONNECTION_REQUEST = 0x17;
+const L2CAP_CREDIT_BASED_CONNECTION_RESPONSE = 0x18;
+
+const EATT_PSM = 0x0027;
+
+const SMP_PAIRING_REQUEST = 0x01;
+const SMP_PAIRING_RESPONSE = 0x02;
+const SMP_PAIRING_CONFIRM = 0x03;
+const SMP_PAIRING_RANDOM = 0x04;
+const SMP_PAIRING_FAILED = 0x05;
+const SMP_ENCRYPT_INFO = 0x06;
+const SMP_MASTER_IDENT = 0x07;
+const SMP_IDENTITY_INFO = 0x08;
+const SMP_IDENTITY_ADDR_INFO = 0x09;
+
+const SMP_DIST_ENC_KEY = 0x01;
+const SMP_DIST_ID_KEY = 0x02;
+
+const SMP_CONFIRM_VALUE_FAILED = 0x04;
+const SMP_COMMAND_NOT_SUPPORTED = 0x07;
+
+const L2CAP_LE_PSM_NOT_SUPPORTED = 0x0002;
+
+const PROPERTIES = {
+  broadcast: 0x01,
+  read: 0x02,
+  writeWithoutResponse: 0x04,
+  write: 0x08,
+  notify: 0x10,
+  indicate: 0x20
+};
+
+let nextAddress = 1;
+
+// static random addresses, c0:00:00:00:00:01 onwards
+const allocateAddress = () => {
+  const address = Buffer.alloc(6);
+  address.writeUIntBE(0xc00000000000 + nextAddress++, 0, 6);
+  return address.toString('hex').match(/.{1,2}/g).join(':');
+};
+
+const addressToBuffer = (address) =>
+  Buffer.from(address.split(':').reverse().join(''), 'hex');
+
+const uuidToBuffer = (uuid) =>
+  Buffer.from(uuid.replace(/-/g, ''), 'hex').reverse();
+
+const uuidFromBuffer = (buffer) =>
+  Buffer.from(buffer).reverse().toString('hex');
+
+const eirField = (type, data) =>
+  Buffer.concat([Buffer.from([data.length + 1, type]), data]);
+
+/*
+ * A simulated peripheral for the fake controller: what it advertises and the
+ * GATT database it serves once connected.
+ *
+ *   new FakePeripheral({
+ *     localName: 'hrm',
+ *     serviceUuids: ['180d'],
+ *     advertisingInterval: 100, // ms
+ *     services: [{
+ *       uuid: '180d',
+ *       characteristics: [{
+ *         uuid: '2a37',
+ *         properties: ['read', 'notify'],
+ *         value: Buffer.from([0x00, 0x48]),
+ *         notifyRate: 50, // notifications per second once subscribed
+ *         notifySize: 20
+ *       }]
+ *     }]
+ *   });
+ *
+ * `readMultipleVariable: false` makes the server reject Read Multiple Variable
+ * Length Requests, like servers from before Bluetooth 5.2. `mtu` is the
+ * server's Rx MTU (247) and `prepareQueueSize` the number of Prepare Write
+ * Requests it queues before answering Prepare Queue Full (unlimited).
+ * `maxDataLength` (251) and `le2mPhy` (true) are what its link layer supports.
+ *
+ * With `multipleNotifications: true` the database starts with a Generic
+ * Attribute service holding Client Supported Features, and once a client sets
+ * the Multiple Handle Value Notifications bit there, notifications of
+ * characteristics with the same `notifyRate` go out bundled in one PDU.
+ * Notifications carry a 32 bit counter, then, where `notifySize` leaves room,
+ * the time they were sent as a double in ms since the epoch.
+ *
+ * `l2capChannels: [{ psm: 0x0080, mtu: 2048, mps: 247, credits: 10 }]` are
+ * the LE_PSMs it accepts LE credit based channels on. Every SDU received is
+ * emitted as 'l2capData' (psm, sdu, reply), reply(data) sends one back.
+ *
+ * With `eatt: true` the Generic Attribute service has Server Supported
+ * Features with the Enhanced ATT bit set, and the server takes requests on
+ * channels opened on the EATT PSM, answering each on the channel it came on.
+ *
+ * Advertising data longer than 31 bytes (`advertisingData` or
+ * `scanResponseData`) goes out as extended advertising of advertising set
+ * `sid` (0).
+ *
+ * `periodicAdvertising: { sid: 1, interval: 100, size: 20 }` (interval in
+ * ms) gives it a periodic advertising train, announced in its extended
+ * advertisements, with data of `size` bytes: a counter and the time it was
+ * sent, like notifications.
+ *
+ * The first `connectFailures` (0) connection attempts to it fail with
+ * Connection Failed to be Established, like a device at the edge of range.
+ *
+ * Characteristics with `encrypt: true` answer Insufficient Authentication
+ * until the link is encrypted. The peripheral pairs with legacy Just Works,
+ * distributes its LTK, EDIV, Rand and IRK and remembers them in `bonds` by
+ * central address, so a central that kept them can encrypt straight away on
+ * the next connection.
+ */
+const FakePeripheral = function (options) {
+  options = options || {};
+
+  this.address = options.address || allocateAddress();
+  this.addressType = options.addressType || 'random';
+  this.connectable = options.connectable !== false;
+  this.rssi = options.rssi !== undefined ? options.rssi : -60;
+  this.advertisingInterval = options.advertisingInterval || 100;
+  this.mtu = options.mtu || 247;
+  this.readMultipleVariable = options.readMultipleVariable !== false;
+  this.prepareQueueSize = options.prepareQueueSize || Infinity;
+  this.maxDataLength = options.maxDataLength || 251;
+  this.le2mPhy = options.le2mPhy !== false;
+  this.multipleNotifications = options.multipleNotifications === true;
+  this.l2capChannels = options.l2capChannels || [];
+  this.eatt = options.eatt === true;
+  this.connectFailures = options.connectFailures || 0;
+  this.sid = options.sid || 0;
+  this.periodicAdvertising = options.periodicAdvertising
+    ? Object.assign({ sid: 0, interval: 100, size: 20 }, options.periodicAdvertising)
+    : null;
+  this._periodicCounter = 0;
+  this.irk = options.irk || crypto.r();
+  // central address -> { ltk, ediv, rand }
+  this.bonds = new Map();
+
+  this.advertisingData =
+    options.advertisingData || this.buildAdvertisingData(options);
+  this.scanResponseData =
+    options.scanResponseData !== undefined
+      ? options.scanResponseData
+      : this.buildScanResponseData(options);
+
+  const services = options.services || [];
+
+  const gattCharacteristics = [];
+
+  if (this.multipleNotifications || this.eatt) {
+    gattCharacteristics.push({
+      uuid: GATT_CLIENT_SUPPORTED_FEATURES_UUID,
+      properties: ['read', 'write'],
+      value: Buffer.from([0x00])
+    });
+  }
+  if (this.eatt) {
+    gattCharacteristics.push({
+      uuid: GATT_SERVER_SUPPORTED_FEATURES_UUID,
+      properties: ['read'],
+      value: Buffer.from([0x01])
+    });
+  }
+
+  this.buildDatabase(
+    gattCharacteristics.length > 0
+      ? [{ uuid: '1801', characteristics: gattCharacteristics }].concat(services)
+      : services
+  );
+};
+
+util.inherits(FakePeripheral, events.EventEmitter);
+
+FakePeripheral.prototype.buildAdvertisingData = function (options) {
+  const fields = [eirField(0x01, Buffer.from([0x06]))]; // flags: LE general discoverable, BR/EDR not supported
+
+  const serviceUuids = options.serviceUuids || [];
+  const uuids16 = serviceUuids.filter((uuid) => uuid.length === 4);
+  const uuids128 = serviceUuids.filter((uuid) => uuid.length !== 4);
+
+  if (uuids16.length) {
+    fields.push(eirField(0x03, Buffer.concat(uuids16.map(uuidToBuffer))));
+  }
+  if (uuids128.length) {
+    fields.push(eirField(0x07, Buffer.concat(uuids128.map(uuidToBuffer))));
+  }
+  if (options.manufacturerData) {
+    fields.push(eirField(0xff, options.manufacturerData));
+  }
+  if (options.txPowerLevel !== undefined) {
+    fields.push(eirField(0x0a, Buffer.from([options.txPowerLevel & 0xff])));
+  }
+
+  return Buffer.concat(fields);
+};
+
+FakePeripheral.prototype.buildScanResponseData = function (options) {
+  if (!options.localName) {
+    return null;
+  }
+
+  return eirField(0x09, Buffer.from(options.localName));
+};
+
+// the data of its next periodic advertising event
+FakePeripheral.prototype.periodicData = function () {
+  const data = Buffer.alloc(this.periodicAdvertising.size);
+
+  if (data.length >= 4) {
+    data.writeUInt32LE(this._periodicCounter++, 0);
+  }
+  if (data.length >= 12) {
+    data.writeDoubleLE(performance.timeOrigin + performance.now(), 4);
+  }
+
+  return data;
+};
+
+FakePeripheral.prototype.buildDatabase = function (services) {
+  const attributes = [null]; // handles start at 1
+
+  const add = (attribute) => {
+    attribute.handle = attributes.length;
+    attributes.push(attribute);
+    return attribute;
+  };
+
+  for (const service of services) {
+    const declaration = add({
+      type: GATT_PRIM_SVC_UUID,
+      value: uuidToBuffer(service.uuid)
+    });
+
+    for (const characteristic of service.characteristics || []) {
+      const properties = (characteristic.properties || ['read']).reduce(
+        (flags, property) => flags | PROPERTIES[property],
+        0
+      );
+
+      const characteristicDeclaration = add({
+        type: GATT_CHARAC_UUID,
+        value: null
+      });
+      const encrypt = characteristic.encrypt === true;
+
+      const value = add({
+        type: characteristic.uuid,
+        value: characteristic.value || Buffer.alloc(0),
+        encrypt,
+        properties,
+        notifyRate: characteristic.notifyRate || 0,
+        notifySize: characteristic.notifySize || 20
+      });
+
+      characteristicDeclaration.value = Buffer.concat([
+        Buffer.from([properties, value.handle & 0xff, value.handle >> 8]),
+        uuidToBuffer(characteristic.uuid)
+      ]);
+
+      if (properties & (PROPERTIES.notify | PROPERTIES.indicate)) {
+        add({
+          type: GATT_CLIENT_CHARAC_CFG_UUID,
+          value: Buffer.from([0x00, 0x00]),
+          encrypt,
+          cccdFor: value
+        });
+      }
+
+      for (const descriptor of characteristic.descriptors || []) {
+        add({ type: descriptor.uuid, value: descriptor.value || Buffer.alloc(0) });
+      }
+    }
+
+    declaration.endHandle = attributes.length - 1;
+  }
+
+  // the last service runs to the end of the handle range
+  const last = attributes
+    .filter((attribute) => attribute && attribute.endHandle)
+    .pop();
+  if (last) {
+    last.endHandle = 0xffff;
+  }
+
+  this._attributes = attributes;
+};
+
+FakePeripheral.prototype.createSession = function (send, central) {
+  return new AttSession(this, this._attributes, send, central);
+};
+
+/*
+ * The peripheral's side of one connection: the ATT server, the L2CAP
+ * channels and pairing. `send` (pdu, cid) is called with every PDU the
+ * peripheral transmits, cid is left out for ATT. `central` is the
+ * { address, addressType } of the other side.
+ */
+const AttSession = function (peripheral, attributes, send, central) {
+  this._peripheral = peripheral;
+  this._attributes = attributes;
+  this._send = send;
+  this._central = central || { address: '00:00:00:00:00:00', addressType: 'public' };
+  this.encrypted = false;
+  // the legacy pairing in progress, and the STK once it is done
+  this._pairing = null;
+  this._mtu = ATT_DEFAULT_MTU;
+  // the Enhanced ATT channel of the request being handled, null for the
+  // unenhanced bearer
+  this._bearer = null;
+  this._cccds = new Map();
+  // notifyRate -> timer, and the subscribed characteristics by value handle
+  this._notifyTimers = new Map();
+  this._subscriptions = new Map();
+  this._clientFeatures = 0x00;
+  this._preparedWrites = [];
+  this._indicationPending = false;
+  // our CID -> LE credit based channel
+  this._channels = new Map();
+  this._identifier = 0;
+
+  this.stats = {
+    pairings: 0,
+    requests: 0,
+    eattRequests: 0,
+    notifications: 0,
+    kFrames: 0,
+    sdus: 0
+  };
+};
+
+AttSession.prototype.close = function () {
+  for (const timer of this._notifyTimers.values()) {
+    clearInterval(timer);
+  }
+  this._notifyTimers.clear();
+  this._subscriptions.clear();
+};
+
+AttSession.prototype.onAtt = function (pdu, bearer) {
+  this._bearer = bearer || null;
+  this.handleAtt(pdu);
+  this._bearer = null;
+};
+
+AttSession.prototype.handleAtt = function (pdu) {
+  const opcode = pdu.readUInt8(0);
+
+  this.stats.requests++;
+  if (this._bearer) {
+    this.stats.eattRequests++;
+  }
+
+  switch (opcode) {
+    case ATT_OP_MTU_REQ:
+      // only on the unenhanced bearer
+      if (this._bearer) {
+        this.error(opcode, 0x0000, ATT_ECODE_REQ_NOT_SUPP);
+        break;
+      }
+      this._mtu = Math.max(
+        ATT_DEFAULT_MTU,
+        Math.min(pdu.readUInt16LE(1), this._peripheral.mtu)
+      );
+      this.reply(
+        Buffer.from([ATT_OP_MTU_RESP, this._peripheral.mtu & 0xff, this._peripheral.mtu >> 8])
+      );
+      break;
+
+    case ATT_OP_READ_BY_GROUP_REQ:
+      this.handleReadByGroup(pdu);
+      break;
+
+    case ATT_OP_READ_BY_TYPE_REQ:
+      this.handleReadByType(pdu);
+      break;
+
+    case ATT_OP_FIND_INFO_REQ:
+      this.handleFindInfo(pdu);
+      break;
+
+    case ATT_OP_READ_REQ:
+    case ATT_OP_READ_BLOB_REQ:
+      this.handleRead(pdu);
+      break;
+
+    case ATT_OP_READ_MULTI_REQ:
+      this.handleReadMultiple(pdu);
+      break;
+
+    case ATT_OP_READ_MULTI_VAR_REQ:
+      if (this._peripheral.readMultipleVariable) {
+        this.handleReadMultiple(pdu);
+      } else {
+        this.error(opcode, 0x0000, ATT_ECODE_REQ_NOT_SUPP);
+      }
+      break;
+
+    case ATT_OP_WRITE_REQ:
+    case ATT_OP_WRITE_CMD:
+      this.handleWrite(pdu);
+      break;
+
+    case ATT_OP_PREPARE_WRITE_REQ:
+      this.handlePrepareWrite(pdu);
+      break;
+
+    case ATT_OP_EXECUTE_WRITE_REQ:
+      this.handleExecuteWrite(pdu);
+      break;
+
+    case ATT_OP_HANDLE_CNF:
+      this._indicationPending = false;
+      break;
+
+    default:
+      // commands (bit 6) never get a response
+      if (!(opcode & 0x40)) {
+        this.error(opcode, 0x0000, ATT_ECODE_REQ_NOT_SUPP);
+      }
+      break;
+  }
+};
+
+// responses go back on the bearer the request came on, within its MTU
+AttSession.prototype.reply = function (pdu) {
+  if (this._bearer) {
+    this.writeChannel(this._bearer, pdu);
+  } else {
+    this._send(pdu);
+  }
+};
+
+AttSession.prototype.attMtu = function () {
+  return this._bearer
+    ? Math.min(this._bearer.mtu, this._bearer.remote.mtu)
+    : this._mtu;
+};
+
+AttSession.prototype.error = function (opcode, handle, code) {
+  const pdu = Buffer.alloc(5);
+
+  pdu.writeUInt8(ATT_OP_ERROR, 0);
+  pdu.writeUInt8(opcode, 1);
+  pdu.writeUInt16LE(handle, 2);
+  pdu.writeUInt8(code, 4);
+
+  this.reply(pdu);
+};
+
+AttSession.prototype.attributeValue = function (attribute) {
+  if (attribute.type === GATT_CLIENT_SUPPORTED_FEATURES_UUID) {
+    return Buffer.from([this._clientFeatures]);
+  }
+
+  return this._cccds.get(attribute.handle) || attribute.value;
+};
+
+AttSession.prototype.findAttributes = function (pdu) {
+  const start = pdu.readUInt16LE(1);
+  const end = Math.min(pdu.readUInt16LE(3), this._attributes.length - 1);
+  const type = pdu.length > 5 ? uuidFromBuffer(pdu.slice(5)) : null;
+  const found = [];
+
+  for (let handle = start; handle <= end; handle++) {
+    const attribute = this._attributes[handle];
+    if (attribute && (type === null || attribute.type === type)) {
+      found.push(attribute);
+    }
+  }
+
+  return { start, found };
+};
+
+// packs [header][entry]..., all entries as long as the first one, up to the MTU
+AttSession.prototype.sendList = function (opcode, entries, withLength) {
+  const headerLength = withLength ? 2 : 1;
+  const entryLength = entries[0].length;
+  const count = Math.min(
+    entries.filter((entry) => entry.length === entryLength).length,
+    Math.floor((this.attMtu() - headerLength) / entryLength)
+  );
+  const pdu = Buffer.alloc(headerLength + count * entryLength);
+
+  pdu.writeUInt8(opcode, 0);
+  if (withLength) {
+    pdu.writeUInt8(entryLength, 1);
+  }
+  for (let i = 0; i < count; i++) {
+    entries[i].copy(pdu, headerLength + i * entryLength);
+  }
+
+  this.reply(pdu);
+};
+
+AttSession.prototype.handleReadByGroup = function (pdu) {
+  const { start, found } = this.findAttributes(pdu);
+
+  if (found.length === 0 || found[0].type !== GATT_PRIM_SVC_UUID) {
+    return this.error(ATT_OP_READ_BY_GROUP_REQ, start, ATT_ECODE_ATTR_NOT_FOUND);
+  }
+
+  const entries = found.map((attribute) => {
+    const entry = Buffer.alloc(4 + attribute.value.length);
+    entry.writeUInt16LE(attribute.handle, 0);
+    entry.writeUInt16LE(attribute.endHandle, 2);
+    attribute.value.copy(entry, 4);
+    return entry;
+  });
+
+  this.sendList(ATT_OP_READ_BY_GROUP_RESP, entries, true);
+};
+
+AttSession.prototype.handleReadByType = function (pdu) {
+  const { start, found } = this.findAttributes(pdu);
+
+  if (found.length === 0) {
+    return this.error(ATT_OP_READ_BY_TYPE_REQ, start, ATT_ECODE_ATTR_NOT_FOUND);
+  }
+
+  const maxValueLength = Math.min(this.attMtu() - 4, 253);
+  const entries = found.map((attribute) => {
+    const value = this.attributeValue(attribute).slice(0, maxValueLength);
+    const entry = Buffer.alloc(2 + value.length);
+    entry.writeUInt16LE(attribute.handle, 0);
+    value.copy(entry, 2);
+    return entry;
+  });
+
+  this.sendList(ATT_OP_READ_BY_TYPE_RESP, entries, true);
+};
+
+AttSession.prototype.handleFindInfo = function (pdu) {
+  const { start, found } = this.findAttributes(pdu.slice(0, 5));
+
+  if (found.length === 0) {
+    return this.error(ATT_OP_FIND_INFO_REQ, start, ATT_ECODE_ATTR_NOT_FOUND);
+  }
+
+  const entries = found.map((attribute) => {
+    const uuid = uuidToBuffer(attribute.type);
+    const entry = Buffer.alloc(2 + uuid.length);
+    entry.writeUInt16LE(attribute.handle, 0);
+    uuid.copy(entry, 2);
+    return entry;
+  });
+
+  // format: 0x01 - 16-bit UUIDs, 0x02 - 128-bit UUIDs
+  const format = entries[0].length === 4 ? 0x01 : 0x02;
+  const count = Math.min(
+    entries.filter((entry) => entry.length === entries[0].length).length,
+    Math.floor((this.attMtu() - 2) / entries[0].length)
+  );
+
+  this.reply(
+    Buffer.concat([
+      Buffer.from([ATT_OP_FIND_INFO_RESP, format]),
+      ...entries.slice(0, count)
+    ])
+  );
+};
+
+AttSession.prototype.handleRead = function (pdu) {
+  const opcode = pdu.readUInt8(0);
+  const handle = pdu.readUInt16LE(1);
+  const offset = opcode === ATT_OP_READ_BLOB_REQ ? pdu.readUInt16LE(3) : 0;
+  const attribute = this._attributes[handle];
+
+  if (!attribute) {
+    return this.error(opcode, handle, ATT_ECODE_INVALID_HANDLE);
+  }
+  if (attribute.encrypt && !this.encrypted) {
+    return this.error(opcode, handle, ATT_ECODE_AUTHENTICATION);
+  }
+
+  const value = this.attributeValue(attribute);
+  if (offset > value.length) {
+    return this.error(opcode, handle, ATT_ECODE_INVALID_OFFSET);
+  }
+
+  this.reply(
+    Buffer.concat([
+      Buffer.from([
+        opcode === ATT_OP_READ_REQ ? ATT_OP_READ_RESP : ATT_OP_READ_BLOB_RESP
+      ]),
+      value.slice(offset, offset + this.attMtu() - 1)
+    ])
+  );
+};
+
+AttSession.prototype.handleReadMultiple = function (pdu) {
+  const opcode = pdu.readUInt8(0);
+  const variable = opcode === ATT_OP_READ_MULTI_VAR_REQ;
+  const values = [];
+
+  for (let i = 1; i + 1 < pdu.length; i += 2) {
+    const handle = pdu.readUInt16LE(i);
+    const attribute = this._attributes[handle];
+
+    if (!attribute) {
+      return this.error(opcode, handle, ATT_ECODE_INVALID_HANDLE);
+    }
+    if (attribute.encrypt && !this.encrypted) {
+      return this.error(opcode, handle, ATT_ECODE_AUTHENTICATION);
+    }
+
+    const value = this.attributeValue(attribute);
+    if (variable) {
+      const length = Buffer.alloc(2);
+      length.writeUInt16LE(value.length, 0);
+      values.push(length);
+    }
+    values.push(value);
+  }
+
+  // cut off at the MTU like every other read
+  this.reply(
+    Buffer.concat([
+      Buffer.from([variable ? ATT_OP_READ_MULTI_VAR_RESP : ATT_OP_READ_MULTI_RESP]),
+      ...values
+    ]).slice(0, this.attMtu())
+  );
+};
+
+AttSession.prototype.handleWrite = function (pdu) {
+  const opcode = pdu.readUInt8(0);
+  const handle = pdu.readUInt16LE(1);
+  const attribute = this._attributes[handle];
+
+  if (!attribute || (attribute.encrypt && !this.encrypted)) {
+    if (opcode === ATT_OP_WRITE_REQ) {
+      this.error(
+        opcode,
+        handle,
+        attribute ? ATT_ECODE_AUTHENTICATION : ATT_ECODE_INVALID_HANDLE
+      );
+    }
+    return;
+  }
+
+  this.writeAttribute(attribute, Buffer.from(pdu.slice(3)));
+
+  if (opcode === ATT_OP_WRITE_REQ) {
+    this.reply(Buffer.from([ATT_OP_WRITE_RESP]));
+  }
+};
+
+AttSession.prototype.handlePrepareWrite = function (pdu) {
+  const handle = pdu.readUInt16LE(1);
+
+  if (!this._attributes[handle]) {
+    return this.error(ATT_OP_PREPARE_WRITE_REQ, handle, ATT_ECODE_INVALID_HANDLE);
+  }
+  if (this._attributes[handle].encrypt && !this.encrypted) {
+    return this.error(ATT_OP_PREPARE_WRITE_REQ, handle, ATT_ECODE_AUTHENTICATION);
+  }
+
+  if (this._preparedWrites.length >= this._peripheral.prepareQueueSize) {
+    return this.error(ATT_OP_PREPARE_WRITE_REQ, handle, ATT_ECODE_PREP_QUEUE_FULL);
+  }
+
+  this._preparedWrites.push({
+    handle,
+    offset: pdu.readUInt16LE(3),
+    data: Buffer.from(pdu.slice(5))
+  });
+
+  const response = Buffer.from(pdu);
+  response.writeUInt8(ATT_OP_PREPARE_WRITE_RESP, 0);
+  this.reply(response);
+};
+
+AttSession.prototype.handleExecuteWrite = function (pdu) {
+  const execute = pdu.readUInt8(1) === 0x01;
+
+  if (execute) {
+    for (const { handle, offset, data } of this._preparedWrites) {
+      const attribute = this._attributes[handle];
+      const value = Buffer.alloc(Math.max(attribute.value.length, offset + data.length));
+      attribute.value.copy(value);
+      data.copy(value, offset);
+      this.writeAttribute(attribute, value);
+    }
+  }
+  this._preparedWrites = [];
+
+  this.reply(Buffer.from([ATT_OP_EXECUTE_WRITE_RESP]));
+};
+
+AttSession.prototype.writeAttribute = function (attribute, value) {
+  if (attribute.cccdFor) {
+    this._cccds.set(attribute.handle, value);
+    this.subscribe(attribute.cccdFor, value.readUInt16LE(0));
+  } else if (attribute.type === GATT_CLIENT_SUPPORTED_FEATURES_UUID) {
+    // per client, and bits can't be cleared
+    this._clientFeatures |= value[0];
+  } else {
+    attribute.value = value;
+    this._peripheral.emit('write', attribute.type, value);
+  }
+};
+
+AttSession.prototype.subscribe = function (characteristic, cccd) {
+  this._subscriptions.delete(characteristic.handle);
+
+  if (cccd !== 0 && characteristic.notifyRate !== 0) {
+    debug(
+      `${this._peripheral.address}: ${characteristic.type} ${characteristic.notifyRate} Hz`
+    );
+
+    this._subscriptions.set(characteristic.handle, {
+      characteristic,
+      indicate: (cccd & 0x0001) === 0,
+      counter: 0
+    });
+  }
+
+  // one timer per rate, so values sampled together can go out together
+  const rate = characteristic.notifyRate;
+  const subscribed = Array.from(this._subscriptions.values()).some(
+    (subscription) => subscription.characteristic.notifyRate === rate
+  );
+  const timer = this._notifyTimers.get(rate);
+
+  if (subscribed && !timer) {
+    this._notifyTimers.set(
+      rate,
+      setInterval(() => this.notify(rate), 1000 / rate)
+    );
+  } else if (!subscribed && timer) {
+    clearInterval(timer);
+    this._notifyTimers.delete(rate);
+  }
+};
+
+AttSession.prototype.notify = function (rate) {
+  const values = [];
+
+  for (const subscription of this._subscriptions.values()) {
+    const { characteristic, indicate } = subscription;
+
+    if (characteristic.notifyRate !== rate) {
+      continue;
+    }
+
+    if (indicate && this._indicationPending) {
+      continue;
+    }
+
+    const payload = Buffer.alloc(
+      Math.min(characteristic.notifySize, this._mtu - 3)
+    );
+    if (payload.length >= 4) {
+      payload.writeUInt32LE(subscription.counter++, 0);
+    }
+    if (payload.length >= 12) {
+      payload.writeDoubleLE(performance.timeOrigin + performance.now(), 4);
+    }
+
+    this.stats.notifications++;
+
+    if (indicate) {
+      this._indicationPending = true;
+      this.sendValue(ATT_OP_HANDLE_IND, characteristic.handle, payload);
+    } else {
+      values.push({ handle: characteristic.handle, payload });
+    }
+  }
+
+  if (
+    values.length < 2 ||
+    !(this._clientFeatures & CLIENT_FEATURE_MULTIPLE_NOTIFICATIONS)
+  ) {
+    for (const { handle, payload } of values) {
+      this.sendValue(ATT_OP_HANDLE_NOTIFY, handle, payload);
+    }
+    return;
+  }
+
+  // handle, length, value tuples, as many as fit in the MTU
+  let tuples = [];
+  let length = 1;
+
+  const flush = () => {
+    if (tuples.length === 1) {
+      this.sendValue(ATT_OP_HANDLE_NOTIFY, tuples[0].handle, tuples[0].payload);
+    } else if (tuples.length > 1) {
+      this._send(
+        Buffer.concat(
+          [Buffer.from([ATT_OP_MULTI_HANDLE_NOTIFY])].concat(
+            tuples.map(({ handle, payload }) => {
+              const header = Buffer.alloc(4);
+              header.writeUInt16LE(handle, 0);
+              header.writeUInt16LE(payload.length, 2);
+              return Buffer.concat([header, payload]);
+            })
+          )
+        )
+      );
+    }
+    tuples = [];
+    length = 1;
+  };
+
+  for (const value of values) {
+    if (length + 4 + value.payload.length > this._mtu) {
+      flush();
+    }
+    tuples.push(value);
+    length += 4 + value.payload.length;
+  }
+  flush();
+};
+
+AttSession.prototype.sendValue = function (opcode, handle, payload) {
+  const pdu = Buffer.alloc(3 + payload.length);
+  pdu.writeUInt8(opcode, 0);
+  pdu.writeUInt16LE(handle, 1);
+  payload.copy(pdu, 3);
+
+  this._send(pdu);
+};
+
+AttSession.prototype.signal = function (code, identifier, data) {
+  const command = Buffer.alloc(4 + data.length);
+
+  command.writeUInt8(code, 0);
+  command.writeUInt8(identifier, 1);
+  command.writeUInt16LE(data.length, 2);
+  data.copy(command, 4);
+
+  this._send(command, SIGNALING_CID);
+};
+
+AttSession.prototype.onSignaling = function (pdu) {
+  const code = pdu.readUInt8(0);
+  const identifier = pdu.readUInt8(1);
+  const data = pdu.slice(4);
+
+  switch (code) {
+    case L2CAP_LE_CREDIT_BASED_CONNECTION_REQUEST:
+      this.openChannel(identifier, data);
+      break;
+
+    case L2CAP_CREDIT_BASED_CONNECTION_REQUEST:
+      this.openEnhancedChannels(identifier, data);
+      break;
+
+    case L2CAP_FLOW_CONTROL_CREDIT_IND: {
+      // the central's CID
+      const cid = data.readUInt16LE(0);
+
+      for (const channel of this._channels.values()) {
+        if (channel.remote.cid === cid) {
+          channel.remote.credits += data.readUInt16LE(2);
+          this.drainChannel(channel);
+        }
+      }
+      break;
+    }
+
+    case L2CAP_DISCONNECTION_REQUEST: {
+      const cid = data.readUInt16LE(0);
+
+      if (this._channels.delete(cid)) {
+        this.signal(L2CAP_DISCONNECTION_RESPONSE, identifier, data.slice(0, 4));
+      } else {
+        this.signal(
+          L2CAP_COMMAND_REJECT,
+          identifier,
+          Buffer.concat([Buffer.from([0x02, 0x00]), data.slice(0, 4)])
+        );
+      }
+      break;
+    }
+
+    case L2CAP_CONNECTION_PARAMETER_UPDATE_RESPONSE:
+    case L2CAP_DISCONNECTION_RESPONSE:
+      break;
+
+    default:
+      // command not understood
+      this.signal(L2CAP_COMMAND_REJECT, identifier, Buffer.from([0x00, 0x00]));
+      break;
+  }
+};
+
+// legacy Just Works as the responder, the TK is all zeros
+AttSession.prototype.onSmp = function (pdu) {
+  const code = pdu.readUInt8(0);
+  const tk = Buffer.alloc(16);
+  const pairing = this._pairing;
+
+  const confirm = (r) =>
+    crypto.c1(
+      tk,
+      r,
+      pairing.pres,
+      pairing.preq,
+      Buffer.from([this._central.addressType === 'random' ? 0x01 : 0x00]),
+      addressToBuffer(this._central.address),
+      Buffer.from([this._peripheral.addressType === 'random' ? 0x01 : 0x00]),
+      addressToBuffer(this._peripheral.address)
+    );
+
+  if (code === SMP_PAIRING_REQUEST) {
+    const pres = Buffer.from([
+      SMP_PAIRING_RESPONSE,
+      0x03, // IO capability: NoInputNoOutput
+      0x00, // OOB data: not present
+      0x01, // Bonding - No MITM
+      0x10, // Max encryption key size
+      0x00, // Initiator key distribution: <none>
+      pdu.readUInt8(6) & (SMP_DIST_ENC_KEY | SMP_DIST_ID_KEY)
+    ]);
+
+    this._pairing = { preq: Buffer.from(pdu), pres, srand: crypto.r(), stk: null };
+    this._send(pres, SMP_CID);
+  } else if (code === SMP_PAIRING_CONFIRM && pairing) {
+    pairing.mconfirm = Buffer.from(pdu.slice(1));
+    this._send(
+      Buffer.concat([Buffer.from([SMP_PAIRING_CONFIRM]), confirm(pairing.srand)]),
+      SMP_CID
+    );
+  } else if (code === SMP_PAIRING_RANDOM && pairing) {
+    const mrand = Buffer.from(pdu.slice(1));
+
+    if (!confirm(mrand).equals(pairing.mconfirm)) {
+      this._pairing = null;
+      this._send(Buffer.from([SMP_PAIRING_FAILED, SMP_CONFIRM_VALUE_FAILED]), SMP_CID);
+      return;
+    }
+
+    pairing.stk = crypto.s1(tk, pairing.srand, mrand);
+    this._send(Buffer.concat([Buffer.from([SMP_PAIRING_RANDOM]), pairing.srand]), SMP_CID);
+  } else if (code !== SMP_PAIRING_FAILED) {
+    this._send(Buffer.from([SMP_PAIRING_FAILED, SMP_COMMAND_NOT_SUPPORTED]), SMP_CID);
+  }
+};
+
+// the key the link layer encrypts with when the central starts encryption
+// with this EDIV and Rand: the STK of the pairing just done, or the LTK of an
+// earlier bond. null when there is none, PIN or Key Missing.
+AttSession.prototype.encryptionKey = function (rand, ediv) {
+  const pairing = this._pairing;
+  const bond = this._peripheral.bonds.get(this._central.address);
+
+  if (pairing && pairing.stk && rand.equals(Buffer.alloc(8)) && ediv.equals(Buffer.alloc(2))) {
+    return pairing.stk;
+  }
+  if (bond && bond.rand.equals(rand) && bond.ediv.equals(ediv)) {
+    return bond.ltk;
+  }
+  return null;
+};
+
+AttSession.prototype.onEncrypted = function () {
+  const pairing = this._pairing;
+
+  this.encrypted = true;
+
+  // encrypted with the STK, time to hand out the keys
+  if (pairing && pairing.stk) {
+    this._pairing = null;
+    this.stats.pairings++;
+    this.distributeKeys(pairing.pres.readUInt8(6));
+  }
+};
+
+AttSession.prototype.distributeKeys = function (keys) {
+  if (keys & SMP_DIST_ENC_KEY) {
+    const bond = { ltk: crypto.r(), ediv: crypto.r().slice(0, 2), rand: crypto.r().slice(0, 8) };
+    this._peripheral.bonds.set(this._central.address, bond);
+
+    this._send(Buffer.concat([Buffer.from([SMP_ENCRYPT_INFO]), bond.ltk]), SMP_CID);
+    this._send(
+      Buffer.concat([Buffer.from([SMP_MASTER_IDENT]), bond.ediv, bond.rand]),
+      SMP_CID
+    );
+  }
+
+  if (keys & SMP_DIST_ID_KEY) {
+    this._send(Buffer.concat([Buffer.from([SMP_IDENTITY_INFO]), this._peripheral.irk]), SMP_CID);
+    this._send(
+      Buffer.concat([
+        Buffer.from([
+          SMP_IDENTITY_ADDR_INFO,
+          this._peripheral.addressType === 'random' ? 0x01 : 0x00
+        ]),
+        addressToBuffer(this._peripheral.address)
+      ]),
+      SMP_CID
+    );
+  }
+};
+
+AttSession.prototype.openChannel = function (identifier, request) {
+  const psm = request.readUInt16LE(0);
+  const server = this._peripheral.l2capChannels.find(
+    (channel) => channel.psm === psm
+  );
+  const response = Buffer.alloc(10);
+
+  if (!server) {
+    response.writeUInt16LE(L2CAP_LE_PSM_NOT_SUPPORTED, 8);
+    this.signal(L2CAP_LE_CREDIT_BASED_CONNECTION_RESPONSE, identifier, response);
+    return;
+  }
+
+  let cid = LE_DYNAMIC_CID_FIRST;
+  while (this._channels.has(cid)) {
+    cid++;
+  }
+
+  const channel = {
+    psm,
+    cid,
+    mtu: server.mtu || 2048,
+    mps: server.mps || 247,
+    credits: server.credits || 10,
+    initialCredits: server.credits || 10,
+    remote: {
+      cid: request.readUInt16LE(2),
+      mtu: request.readUInt16LE(4),
+      mps: request.readUInt16LE(6),
+      credits: request.readUInt16LE(8)
+    },
+    reassembly: null,
+    txQueue: []
+  };
+
+  this._channels.set(cid, channel);
+
+  response.writeUInt16LE(channel.cid, 0);
+  response.writeUInt16LE(channel.mtu, 2);
+  response.writeUInt16LE(channel.mps, 4);
+  response.writeUInt16LE(channel.credits, 6);
+  this.signal(L2CAP_LE_CREDIT_BASED_CONNECTION_RESPONSE, identifier, response);
+};
+
+// the EATT PSM when enabled, and the LE_PSMs of l2capChannels
+AttSession.prototype.openEnhancedChannels = function (identifier, request) {
+  const psm = request.readUInt16LE(0);
+  const eatt = psm === EATT_PSM && this._peripheral.eatt;
+  const server = eatt
+    ? { psm, mtu: this._peripheral.mtu, mps: 247, credits: 10 }
+    : this._peripheral.l2capChannels.find((channel) => channel.psm === psm);
+  const count = (request.length - 8) / 2;
+  const response = Buffer.alloc(8 + count * 2);
+
+  if (!server) {
+    response.writeUInt16LE(L2CAP_LE_PSM_NOT_SUPPORTED, 6);
+    this.signal(L2CAP_CREDIT_BASED_CONNECTION_RESPONSE, identifier, response);
+    return;
+  }
+
+  const mtu = server.mtu || 2048;
+  const mps = server.mps || 247;
+  const credits = server.credits || 10;
+
+  for (let i = 0; i < count; i++) {
+    let cid = LE_DYNAMIC_CID_FIRST;
+    while (this._channels.has(cid)) {
+      cid++;
+    }
+
+    this._channels.set(cid, {
+      psm,
+      att: eatt,
+      cid,
+      mtu,
+      mps,
+      credits,
+      initialCredits: credits,
+      remote: {
+        cid: request.readUInt16LE(8 + i * 2),
+        mtu: request.readUInt16LE(2),
+        mps: request.readUInt16LE(4),
+        credits: request.readUInt16LE(6)
+      },
+      reassembly: null,
+      txQueue: []
+    });
+
+    response.writeUInt16LE(cid, 8 + i * 2);
+  }
+
+  response.writeUInt16LE(mtu, 0);
+  response.writeUInt16LE(mps, 2);
+  response.writeUInt16LE(credits, 4);
+  this.signal(L2CAP_CREDIT_BASED_CONNECTION_RESPONSE, identifier, response);
+};
+
+AttSession.prototype.onChannelData = function (cid, frame) {
+  const channel = this._channels.get(cid);
+
+  if (!channel) {
+    return;
+  }
+
+  this.stats.kFrames++;
+  channel.credits--;
+
+  if (channel.reassembly === null) {
+    channel.reassembly = {
+      length: frame.readUInt16LE(0),
+      data: [Buffer.from(frame.slice(2))]
+    };
+  } else {
+    channel.reassembly.data.push(Buffer.from(frame));
+  }
+
+  const sdu = Buffer.concat(channel.reassembly.data);
+  if (sdu.length >= channel.reassembly.length) {
+    channel.reassembly = null;
+    this.stats.sdus++;
+
+    if (channel.att) {
+      this.onAtt(sdu, channel);
+    } else {
+      this._peripheral.emit('l2capData', channel.psm, sdu, (data) =>
+        this.writeChannel(channel, data)
+      );
+    }
+  }
+
+  // credits back once half are used
+  const used = channel.initialCredits - channel.credits;
+  if (used >= channel.initialCredits / 2) {
+    channel.credits += used;
+
+    const ind = Buffer.alloc(4);
+    ind.writeUInt16LE(channel.cid, 0);
+    ind.writeUInt16LE(used, 2);
+    this._identifier = (this._identifier % 0xff) + 1;
+    this.signal(L2CAP_FLOW_CONTROL_CREDIT_IND, this._identifier, ind);
+  }
+};
+
+AttSession.prototype.writeChannel = function (channel, sdu) {
+  const first = Math.min(sdu.length, channel.remote.mps - 2);
+  const header = Buffer.alloc(2);
+  header.writeUInt16LE(sdu.length, 0);
+
+  channel.txQueue.push(Buffer.concat([header, sdu.slice(0, first)]));
+  for (let i = first; i < sdu.length; i += channel.remote.mps) {
+    channel.txQueue.push(sdu.slice(i, i + channel.remote.mps));
+  }
+
+  this.drainChannel(channel);
+};
+
+AttSession.prototype.drainChannel = function (channel) {
+  while (channel.txQueue.length > 0 && channel.remote.credits > 0) {
+    channel.remote.credits--;
+    this._send(channel.txQueue.shift(), channel.remote.cid);
+  }
+};
+
+module.exports = FakePeripheral;
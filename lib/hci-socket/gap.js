@@ -4,6 +4,9 @@ const events = require('events');
 const os = require('os');
 const util = require('util');
 
+const ScanFilter = require('../scan-filter');
+const AdvertisingReassembler = require('./advertising-reassembler');
+
 const isChip = os.platform() === 'linux' && os.release().indexOf('-ntc') !== -1;
 
 const LE_META_EVENT_TYPE_CONNECTABLE = 0x3;
@@ -13,15 +16,38 @@ const LE_META_EVENT_TYPE_SCANNABLE = 0x6;
 const LE_META_EXTENDED_EVENT_TYPE_CONNECTABLE_MASK = 0x1;
 const LE_META_EXTENDED_EVENT_TYPE_SCANNABLE_MASK = 0x2;
 const LE_META_EXTENDED_EVENT_TYPE_SCAN_RESPONSE_MASK = 0x8;
-const LE_META_EXTENDED_EVENT_TYPE_INCOMPLETE_MASK = 0x20;
+const LE_META_EXTENDED_EVENT_TYPE_DATA_STATUS_SHIFT = 5;
+const LE_META_EXTENDED_EVENT_TYPE_DATA_STATUS_MASK = 0x3;
+
+// scan states while the app scans, with the scan going or paused
+const SCANNING_STATES = ['starting', 'started', 'resuming'];
+const PAUSED_STATES = ['pausing', 'paused'];
+
+// devices the scan filter tracks are forgotten when not heard for this long,
+// the longest first beyond the cap
+const FILTERED_TIMEOUT = 5000;
+const MAX_FILTERED = 1024;
 
-const Gap = function (hci) {
+// `reassembly` are the options of the AdvertisingReassembler
+const Gap = function (hci, reassembly) {
   this._hci = hci;
 
   this._scanState = null;
   this._scanFilterDuplicates = null;
+  // { interval, window } in units of 0.625 ms, the controller default if null
+  this._scanParameters = null;
+  // no scan requests, so nothing to wait for before reporting a device
+  this._scanPassive = false;
   this._discoveries = {};
 
+  this._scanFilter = null;
+  // address -> { satisfied, advertisement, scanResponse, heard, refreshed }
+  // for devices heard while scanning with a filter, least recently heard first
+  this._filtered = new Map();
+
+  // extended advertising data reported in fragments, joined before parsing
+  this.reassembler = new AdvertisingReassembler(reassembly);
+
   this._hci.on('error', this.onHciError.bind(this));
   this._hci.on('leScanParametersSet', this.onHciLeScanParametersSet.bind(this));
   this._hci.on('leScanEnableSet', this.onHciLeScanEnableSet.bind(this));
@@ -37,18 +63,22 @@ const Gap = function (hci) {
 util.inherits(Gap, events.EventEmitter);
 
 Gap.prototype.setScanParameters = function (interval, window) {
-  this._hci.setScanParameters(interval, window);
+  this._hci.setScanParameters(interval, window, this._scanPassive);
 };
 
-Gap.prototype.startScanning = function (allowDuplicates) {
+// `filter` may also ask for a passive scan, with `passive: true`
+Gap.prototype.startScanning = function (allowDuplicates, filter) {
   this._scanState = 'starting';
   this._scanFilterDuplicates = !allowDuplicates;
+  this._scanPassive = !!(filter && filter.passive);
+  this._scanFilter = ScanFilter.from(filter);
+  this._filtered.clear();
 
   // Always set scan parameters before scanning
   // https://www.bluetooth.org/docman/handlers/downloaddoc.ashx?doc_id=229737
   // p106 - p107
   this._hci.setScanEnabled(false, true);
-  this._hci.setScanParameters();
+  this.writeScanParameters();
 
   if (isChip) {
     // work around for Next Thing Co. C.H.I.P, always allow duplicates, to get scan response
@@ -64,6 +94,55 @@ Gap.prototype.stopScanning = function () {
   this._hci.setScanEnabled(false, true);
 };
 
+Gap.prototype.writeScanParameters = function () {
+  if (this._scanParameters) {
+    this._hci.setScanParameters(
+      this._scanParameters.interval,
+      this._scanParameters.window,
+      this._scanPassive
+    );
+  } else {
+    this._hci.setScanParameters(undefined, undefined, this._scanPassive);
+  }
+};
+
+// true while the app scans, if paused too
+Gap.prototype.isScanning = function () {
+  return (
+    SCANNING_STATES.includes(this._scanState) ||
+    PAUSED_STATES.includes(this._scanState)
+  );
+};
+
+// Pausing, resuming and changing the parameters of a scan the app started are
+// not reported as scanStop and scanStart. Scan parameters can only change
+// while scanning is disabled, so a scan in progress is restarted with them.
+// Without an interval, the controller default is used again.
+Gap.prototype.setScanDutyCycle = function (interval, window) {
+  this._scanParameters = interval !== undefined ? { interval, window } : null;
+
+  if (SCANNING_STATES.includes(this._scanState)) {
+    this._scanState = 'resuming';
+    this._hci.setScanEnabled(false, true);
+    this.resumeScanning();
+  }
+};
+
+Gap.prototype.pauseScanning = function () {
+  if (SCANNING_STATES.includes(this._scanState)) {
+    this._scanState = 'pausing';
+    this._hci.setScanEnabled(false, true);
+  }
+};
+
+Gap.prototype.resumeScanning = function () {
+  if (PAUSED_STATES.includes(this._scanState) || this._scanState === 'resuming') {
+    this._scanState = 'resuming';
+    this.writeScanParameters();
+    this._hci.setScanEnabled(true, this._scanFilterDuplicates);
+  }
+};
+
 Gap.prototype.onHciError = function (error) {
   console.warn(error); // TODO: Better error handling
 };
@@ -87,8 +166,13 @@ Gap.prototype.onHciLeScanEnableSet = function (status) {
     this.emit('scanStart', this._scanFilterDuplicates);
   } else if (this._scanState === 'stopping') {
     this._scanState = 'stopped';
+    this.reassembler.reset();
 
     this.emit('scanStop');
+  } else if (this._scanState === 'pausing') {
+    this._scanState = 'paused';
+  } else if (this._scanState === 'resuming') {
+    this._scanState = 'started';
   }
 };
 
@@ -115,13 +199,114 @@ Gap.prototype.onLeScanEnableSetCmd = function (enable, filterDuplicates) {
   }
 };
 
+// With a scan filter, reports are matched on their raw AD structures and only
+// parsed once the device has met every criterion. Until then the last
+// advertisement or scan response of the device is held back, while the other
+// kind, not heard yet, may still complete the match, to be reported along
+// with it. `scannable` advertisements may be followed by a scan response.
+Gap.prototype.filterReport = function (address, eir, rssi, scanResponse, scannable, report) {
+  const filter = this._scanFilter;
+
+  // nothing to remember for an RSSI floor alone
+  if (filter.criteria === 0) {
+    if (filter.rssiMatched(rssi)) {
+      report();
+    }
+    return;
+  }
+
+  const now = Date.now();
+  this.expireFiltered(now);
+
+  let state = this._filtered.get(address);
+
+  if (state === undefined) {
+    state = { satisfied: 0, advertisement: null, scanResponse: null, heard: 0, refreshed: now };
+  } else {
+    this._filtered.delete(address);
+  }
+  state.refreshed = now;
+  this._filtered.set(address, state);
+
+  const kind = scanResponse ? 2 : 1;
+  const otherKind = scanResponse ? 1 : 2;
+  state.heard |= kind;
+
+  if (!filter.matched(state.satisfied)) {
+    state.satisfied |= filter.matchEir(eir);
+  }
+
+  if (!filter.matched(state.satisfied)) {
+    const otherToCome =
+      (state.heard & otherKind) === 0 &&
+      (scanResponse || (scannable && !this._scanPassive));
+
+    state.advertisement = !scanResponse && otherToCome ? report : null;
+    state.scanResponse = scanResponse && otherToCome ? report : null;
+    return;
+  }
+
+  if (!filter.rssiMatched(rssi)) {
+    return;
+  }
+
+  const held = scanResponse ? state.advertisement : state.scanResponse;
+  state.advertisement = null;
+  state.scanResponse = null;
+
+  if (held !== null && scanResponse) {
+    held();
+  }
+  report();
+  if (held !== null && !scanResponse) {
+    held();
+  }
+};
+
+Gap.prototype.expireFiltered = function (now) {
+  for (const [address, state] of this._filtered) {
+    if (now - state.refreshed < FILTERED_TIMEOUT && this._filtered.size < MAX_FILTERED) {
+      break;
+    }
+
+    this._filtered.delete(address);
+  }
+};
+
 Gap.prototype.onHciLeAdvertisingReport = function (
   status,
   type,
   address,
   addressType,
   eir,
-  rssi
+  rssi,
+  decoded
+) {
+  if (this._scanFilter !== null) {
+    this.filterReport(
+      address,
+      eir,
+      rssi,
+      type === LE_META_EVENT_TYPE_SCAN_RESPONSE,
+      // ADV_IND and ADV_SCAN_IND
+      type === 0x00 || type === 0x02,
+      () =>
+        this.reportAdvertising(status, type, address, addressType, eir, rssi, decoded)
+    );
+    return;
+  }
+
+  this.reportAdvertising(status, type, address, addressType, eir, rssi, decoded);
+};
+
+Gap.prototype.reportAdvertising = function (
+  status,
+  type,
+  address,
+  addressType,
+  eir,
+  rssi,
+  decoded
 ) {
   const previouslyDiscovered = !!this._discoveries[address];
 
@@ -142,10 +327,12 @@ Gap.prototype.onHciLeAdvertisingReport = function (
     address,
     eir,
     previouslyDiscovered,
-    type
+    type,
+    undefined,
+    decoded
   );
 
-  if (process.env.DEBUG === 'gap') {
+  if (debug.enabled) {
     debug(`advertisement = ${JSON.stringify(advertisement, null, 0)}`);
   }
 
@@ -169,6 +356,7 @@ Gap.prototype.onHciLeAdvertisingReport = function (
   if (
     type === LE_META_EVENT_TYPE_SCAN_RESPONSE ||
     !connectable ||
+    this._scanPassive ||
     (discoveryCount > 1 && !hasScanResponse) ||
     process.env.NOBLE_REPORT_ALL_HCI_EVENTS
   ) {
@@ -192,7 +380,74 @@ Gap.prototype.onHciLeExtendedAdvertisingReport = function (
   addressType,
   txpower,
   rssi,
-  eir
+  eir,
+  decoded,
+  sid
+) {
+  const scanResponse = (type & LE_META_EXTENDED_EVENT_TYPE_SCAN_RESPONSE_MASK) !== 0;
+  const data = this.reassembler.push(
+    address,
+    sid,
+    scanResponse,
+    (type >> LE_META_EXTENDED_EVENT_TYPE_DATA_STATUS_SHIFT) &
+      LE_META_EXTENDED_EVENT_TYPE_DATA_STATUS_MASK,
+    eir
+  );
+
+  // more fragments to come
+  if (data === null) {
+    return;
+  }
+
+  // the native decoder only saw the last fragment
+  if (data !== eir) {
+    eir = data;
+    decoded = undefined;
+  }
+
+  if (this._scanFilter !== null) {
+    this.filterReport(
+      address,
+      eir,
+      rssi,
+      scanResponse,
+      (type & LE_META_EXTENDED_EVENT_TYPE_SCANNABLE_MASK) !== 0,
+      () =>
+        this.reportExtendedAdvertising(
+          status,
+          type,
+          address,
+          addressType,
+          txpower,
+          rssi,
+          eir,
+          decoded
+        )
+    );
+    return;
+  }
+
+  this.reportExtendedAdvertising(
+    status,
+    type,
+    address,
+    addressType,
+    txpower,
+    rssi,
+    eir,
+    decoded
+  );
+};
+
+Gap.prototype.reportExtendedAdvertising = function (
+  status,
+  type,
+  address,
+  addressType,
+  txpower,
+  rssi,
+  eir,
+  decoded
 ) {
   const previouslyDiscovered = !!this._discoveries[address];
 
@@ -214,10 +469,11 @@ Gap.prototype.onHciLeExtendedAdvertisingReport = function (
     eir,
     previouslyDiscovered,
     type,
-    txpower
+    txpower,
+    decoded
   );
 
-  if (process.env.DEBUG === 'gap') {
+  if (debug.enabled) {
     debug(`advertisement = ${JSON.stringify(advertisement, null, 0)}`);
   }
 
@@ -226,7 +482,6 @@ Gap.prototype.onHciLeExtendedAdvertisingReport = function (
       ? this._discoveries[address].connectable
       : type & LE_META_EXTENDED_EVENT_TYPE_CONNECTABLE_MASK;
   const scannable = type & LE_META_EXTENDED_EVENT_TYPE_SCANNABLE_MASK ? 1 : 0;
-  const incomplete = type & LE_META_EXTENDED_EVENT_TYPE_INCOMPLETE_MASK ? 1 : 0;
 
   this._discoveries[address] = {
     address,
@@ -241,7 +496,8 @@ Gap.prototype.onHciLeExtendedAdvertisingReport = function (
   // only report after a scan response event or if non-connectable or more than one discovery without a scan response, so more data can be collected
   if (
     type & LE_META_EXTENDED_EVENT_TYPE_SCAN_RESPONSE_MASK ||
-    (!connectable && !incomplete) ||
+    !connectable ||
+    this._scanPassive ||
     (discoveryCount > 1 && !hasScanResponse) ||
     process.env.NOBLE_REPORT_ALL_HCI_EVENTS
   ) {
@@ -258,172 +514,286 @@ Gap.prototype.onHciLeExtendedAdvertisingReport = function (
   }
 };
 
+// byte -> two digit lower case hex, for rendering little endian UUIDs
+const HEX = [];
+for (let b = 0; b < 256; b++) {
+  HEX.push(b.toString(16).padStart(2, '0'));
+}
+
+// lower case hex of eir[start, end) in reverse byte order
+const reverseHex = function (eir, start, end) {
+  let hex = '';
+  for (let j = end - 1; j >= start; j--) {
+    hex += HEX[eir[j]];
+  }
+  return hex;
+};
+
+const addUnique = function (list, seen, uuid) {
+  if (!seen.has(uuid)) {
+    seen.add(uuid);
+    list.push(uuid);
+  }
+};
+
+// most advertisements carry a single UUID, only build a Set for the second
+const addServiceUuid = function (advertisement, seen, uuid) {
+  const list = advertisement.serviceUuids;
+
+  if (list.length === 0) {
+    list.push(uuid);
+    return seen;
+  }
+
+  seen = seen || new Set(list);
+  addUnique(list, seen, uuid);
+  return seen;
+};
+
+// Service data and solicitation UUIDs are rarely read, so only the location
+// of their AD structures is recorded while parsing. They are decoded on first
+// access and then kept like any other field.
+const LAZY = Symbol('lazy');
+
+// by AD type
+const SERVICE_DATA_UUID_LENGTHS = { 0x16: 2, 0x20: 4, 0x21: 16 };
+
+const decodeServiceData = function (serviceData, structures) {
+  for (const { eir, start, end, type } of structures) {
+    const uuidEnd = start + SERVICE_DATA_UUID_LENGTHS[type];
+
+    serviceData.push({
+      uuid: reverseHex(eir, start, uuidEnd),
+      data: eir.subarray(uuidEnd, end)
+    });
+  }
+};
+
+const decodeSolicitationUuids = function (uuids, structures) {
+  const seen = new Set(uuids);
+
+  for (const { eir, start, end, type } of structures) {
+    if (type === 0x14) {
+      for (let j = start; j + 1 < end; j += 2) {
+        addUnique(uuids, seen, eir.readUInt16LE(j).toString(16));
+      }
+    } else if (type === 0x1f) {
+      for (let j = start; j + 3 < end; j += 4) {
+        addUnique(uuids, seen, eir.readUInt32LE(j).toString(16));
+      }
+    } else {
+      for (let j = start; j + 15 < end; j += 16) {
+        addUnique(uuids, seen, reverseHex(eir, j, j + 16));
+      }
+    }
+  }
+};
+
+const DECODERS = {
+  serviceData: decodeServiceData,
+  serviceSolicitationUuids: decodeSolicitationUuids
+};
+
+// turns `field` into an enumerable accessor that decodes pending structures
+const lazyField = function (advertisement, field) {
+  let lazy = advertisement[LAZY];
+
+  if (!lazy) {
+    lazy = { values: {}, pending: {} };
+    Object.defineProperty(advertisement, LAZY, { value: lazy });
+  }
+
+  if (field in lazy.pending) {
+    return lazy.pending[field];
+  }
+
+  lazy.pending[field] = [];
+
+  Object.defineProperty(advertisement, field, {
+    enumerable: true,
+    configurable: true,
+    get () {
+      const pending = lazy.pending[field];
+
+      if (pending.length > 0) {
+        lazy.values[field] = lazy.values[field] || [];
+        DECODERS[field](lazy.values[field], pending);
+        lazy.pending[field] = [];
+      }
+      return lazy.values[field];
+    },
+    set (value) {
+      lazy.values[field] = value;
+      lazy.pending[field] = [];
+    }
+  });
+
+  return lazy.pending[field];
+};
+
+// Merges fields already decoded by the native advertising report decoder
+// (see Hci#processLeAdvertisingEvent), only fields present in the data are set.
+const mergeAdvertisement = function (advertisement, decoded) {
+  if (decoded.localName !== undefined) {
+    advertisement.localName = decoded.localName;
+  }
+
+  if (decoded.txPowerLevel !== undefined) {
+    advertisement.txPowerLevel = decoded.txPowerLevel;
+  }
+
+  if (decoded.manufacturerData !== undefined) {
+    advertisement.manufacturerData = decoded.manufacturerData;
+  }
+
+  if (decoded.serviceUuids !== undefined) {
+    let seen = null;
+    for (const uuid of decoded.serviceUuids) {
+      seen = addServiceUuid(advertisement, seen, uuid);
+    }
+  }
+
+  if (decoded.serviceData !== undefined) {
+    const serviceData = advertisement.serviceData;
+    for (const entry of decoded.serviceData) {
+      serviceData.push(entry);
+    }
+  }
+
+  if (decoded.serviceSolicitationUuids !== undefined) {
+    lazyField(advertisement, 'serviceSolicitationUuids');
+
+    const uuids =
+      advertisement.serviceSolicitationUuids ||
+      (advertisement.serviceSolicitationUuids = []);
+    const seen = new Set(uuids);
+    for (const uuid of decoded.serviceSolicitationUuids) {
+      addUnique(uuids, seen, uuid);
+    }
+  }
+};
+
 Gap.prototype.parseServices = function (
   address,
   eir,
   previouslyDiscovered,
   leMetaEventType,
-  txpower
+  txpower,
+  decoded
 ) {
-  let i = 0;
-  const advertisement = previouslyDiscovered
-    ? this._discoveries[address].advertisement
-    : {
-        localName: undefined,
-        txPowerLevel: txpower,
-        manufacturerData: undefined,
-        serviceData: [],
-        serviceUuids: [],
-        solicitationServiceUuids: []
-      };
+  let advertisement;
+
+  if (previouslyDiscovered) {
+    advertisement = this._discoveries[address].advertisement;
+  } else {
+    advertisement = {
+      localName: undefined,
+      txPowerLevel: txpower,
+      manufacturerData: undefined,
+      serviceData: undefined,
+      serviceUuids: [],
+      solicitationServiceUuids: []
+    };
+    lazyField(advertisement, 'serviceData');
+    advertisement.serviceData = [];
+  }
 
   if (leMetaEventType !== LE_META_EVENT_TYPE_SCAN_RESPONSE) {
     // reset service data every non-scan response event
     advertisement.serviceData = [];
     advertisement.serviceUuids = [];
+    lazyField(advertisement, 'serviceSolicitationUuids');
     advertisement.serviceSolicitationUuids = [];
   }
 
+  if (decoded) {
+    mergeAdvertisement(advertisement, decoded);
+    return advertisement;
+  }
+
+  let serviceUuidsSeen = null;
+  let i = 0;
+
   while (i + 1 < eir.length) {
-    const length = eir.readUInt8(i);
+    const length = eir[i];
 
     if (length < 1) {
       debug(`invalid EIR data, length = ${length}`);
       break;
     }
 
-    const eirType = eir.readUInt8(i + 1); // https://www.bluetooth.org/en-us/specification/assigned-numbers/generic-access-profile
+    const eirType = eir[i + 1]; // https://www.bluetooth.org/en-us/specification/assigned-numbers/generic-access-profile
 
     if (i + length + 1 > eir.length) {
       debug('invalid EIR data, out of range of buffer length');
       break;
     }
 
-    const bytes = eir.slice(i + 2).slice(0, length - 1);
+    const start = i + 2;
+    const end = i + length + 1;
 
     switch (eirType) {
       case 0x02: // Incomplete List of 16-bit Service Class UUID
       case 0x03: // Complete List of 16-bit Service Class UUIDs
-        for (let j = 0; j < bytes.length - 1; j += 2) {
-          const serviceUuid = bytes.readUInt16LE(j).toString(16);
-          if (advertisement.serviceUuids.indexOf(serviceUuid) === -1) {
-            advertisement.serviceUuids.push(serviceUuid);
-          }
+        for (let j = start; j + 1 < end; j += 2) {
+          serviceUuidsSeen = addServiceUuid(
+            advertisement,
+            serviceUuidsSeen,
+            (eir[j] | (eir[j + 1] << 8)).toString(16)
+          );
         }
         break;
 
       case 0x06: // Incomplete List of 128-bit Service Class UUIDs
       case 0x07: // Complete List of 128-bit Service Class UUIDs
-        for (let j = 0; j < bytes.length - 15; j += 16) {
-          const serviceUuid = bytes
-            .slice(j, j + 16)
-            .toString('hex')
-            .match(/.{1,2}/g)
-            .reverse()
-            .join('');
-          if (advertisement.serviceUuids.indexOf(serviceUuid) === -1) {
-            advertisement.serviceUuids.push(serviceUuid);
-          }
+        for (let j = start; j + 15 < end; j += 16) {
+          serviceUuidsSeen = addServiceUuid(
+            advertisement,
+            serviceUuidsSeen,
+            reverseHex(eir, j, j + 16)
+          );
         }
         break;
 
       case 0x08: // Shortened Local Name
       case 0x09: // Complete Local Name»
-        advertisement.localName = bytes.toString('utf8');
+        advertisement.localName = eir.toString('utf8', start, end);
         break;
 
       case 0x0a: // Tx Power Level
-        advertisement.txPowerLevel = bytes.readInt8(0);
-        break;
-
-      case 0x14: // List of 16 bit solicitation UUIDs
-        for (let j = 0; j < bytes.length - 1; j += 2) {
-          const serviceSolicitationUuid = bytes.readUInt16LE(j).toString(16);
-          if (
-            advertisement.serviceSolicitationUuids.indexOf(
-              serviceSolicitationUuid
-            ) === -1
-          ) {
-            advertisement.serviceSolicitationUuids.push(
-              serviceSolicitationUuid
-            );
-          }
+        if (end > start) {
+          advertisement.txPowerLevel = eir.readInt8(start);
         }
         break;
 
+      case 0x14: // List of 16 bit solicitation UUIDs
       case 0x15: // List of 128 bit solicitation UUIDs
-        for (let j = 0; j < bytes.length - 15; j += 16) {
-          const serviceSolicitationUuid = bytes
-            .slice(j, j + 16)
-            .toString('hex')
-            .match(/.{1,2}/g)
-            .reverse()
-            .join('');
-          if (
-            advertisement.serviceSolicitationUuids.indexOf(
-              serviceSolicitationUuid
-            ) === -1
-          ) {
-            advertisement.serviceSolicitationUuids.push(
-              serviceSolicitationUuid
-            );
-          }
-        }
-        break;
-
-      case 0x16: // 16-bit Service Data, there can be multiple occurences
-        advertisement.serviceData.push({
-          uuid: bytes
-            .slice(0, 2)
-            .toString('hex')
-            .match(/.{1,2}/g)
-            .reverse()
-            .join(''),
-          data: bytes.slice(2, bytes.length)
+      case 0x1f: // List of 32 bit solicitation UUIDs
+        lazyField(advertisement, 'serviceSolicitationUuids').push({
+          eir,
+          start,
+          end,
+          type: eirType
         });
         break;
 
+      case 0x16: // 16-bit Service Data, there can be multiple occurences
       case 0x20: // 32-bit Service Data, there can be multiple occurences
-        advertisement.serviceData.push({
-          uuid: bytes
-            .slice(0, 4)
-            .toString('hex')
-            .match(/.{1,2}/g)
-            .reverse()
-            .join(''),
-          data: bytes.slice(4, bytes.length)
-        });
-        break;
-
       case 0x21: // 128-bit Service Data, there can be multiple occurences
-        advertisement.serviceData.push({
-          uuid: bytes
-            .slice(0, 16)
-            .toString('hex')
-            .match(/.{1,2}/g)
-            .reverse()
-            .join(''),
-          data: bytes.slice(16, bytes.length)
-        });
-        break;
-
-      case 0x1f: // List of 32 bit solicitation UUIDs
-        for (let j = 0; j < bytes.length - 3; j += 4) {
-          const serviceSolicitationUuid = bytes.readUInt32LE(j).toString(16);
-          if (
-            advertisement.serviceSolicitationUuids.indexOf(
-              serviceSolicitationUuid
-            ) === -1
-          ) {
-            advertisement.serviceSolicitationUuids.push(
-              serviceSolicitationUuid
-            );
-          }
+        // too short for its UUID
+        if (end - start < SERVICE_DATA_UUID_LENGTHS[eirType]) {
+          break;
         }
+        lazyField(advertisement, 'serviceData').push({
+          eir,
+          start,
+          end,
+          type: eirType
+        });
         break;
 
       case 0xff: // Manufacturer Specific Data
-        advertisement.manufacturerData = bytes;
+        advertisement.manufacturerData = eir.subarray(start, end);
         break;
     }
 
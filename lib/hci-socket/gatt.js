@@ -15,6 +15,7 @@ const ATT_OP_READ_REQ = 0x0a;
 const ATT_OP_READ_RESP = 0x0b;
 const ATT_OP_READ_BLOB_REQ = 0x0c;
 const ATT_OP_READ_BLOB_RESP = 0x0d;
+const ATT_OP_READ_MULTI_REQ = 0x0e;
 const ATT_OP_READ_BY_GROUP_REQ = 0x10;
 const ATT_OP_READ_BY_GROUP_RESP = 0x11;
 const ATT_OP_WRITE_REQ = 0x12;
@@ -26,6 +27,9 @@ const ATT_OP_EXECUTE_WRITE_RESP = 0x19;
 const ATT_OP_HANDLE_NOTIFY = 0x1b;
 const ATT_OP_HANDLE_IND = 0x1d;
 const ATT_OP_HANDLE_CNF = 0x1e;
+const ATT_OP_READ_MULTI_VAR_REQ = 0x20;
+const ATT_OP_READ_MULTI_VAR_RESP = 0x21;
+const ATT_OP_MULTI_HANDLE_NOTIFY = 0x23;
 const ATT_OP_WRITE_CMD = 0x52;
 
 const ATT_ECODE_SUCCESS = 0x00;
@@ -53,23 +57,81 @@ const GATT_CHARAC_UUID = 0x2803;
 
 const GATT_CLIENT_CHARAC_CFG_UUID = 0x2902;
 const GATT_SERVER_CHARAC_CFG_UUID = 0x2903;
+const GATT_CLIENT_SUPPORTED_FEATURES_UUID = 0x2b29;
+const GATT_SERVER_SUPPORTED_FEATURES_UUID = 0x2b3a;
+
+// Client and Server Supported Features bits (Vol 3, Part G, 7.2 and 7.4)
+const CLIENT_FEATURE_EATT = 0x02;
+const CLIENT_FEATURE_MULTIPLE_NOTIFICATIONS = 0x04;
+const SERVER_FEATURE_EATT = 0x01;
 
 const ATT_CID = 0x0004;
+
+// a request without response within 30 s fails, and no more PDUs may be sent
+// on the bearer (Core Spec Vol 3, Part F, 3.3.3)
+const ATT_TIMEOUT = 30000;
+
+// ATT_MTU bounds on LE, and the longest attribute value (Vol 3, Part F, 3.2.9)
+const ATT_DEFAULT_MTU = 23;
+const ATT_MAX_MTU = 517;
+const ATT_MAX_VALUE_LENGTH = 512;
 /* eslint-enable no-unused-vars */
 
-const Gatt = function (address, aclStream) {
+// characteristic properties bits, lowest first
+const PROPERTIES = [
+  'broadcast',
+  'read',
+  'writeWithoutResponse',
+  'write',
+  'notify',
+  'indicate',
+  'authenticatedSignedWrites',
+  'extendedProperties'
+];
+
+const propertyNames = (properties) =>
+  PROPERTIES.filter((name, bit) => properties & (1 << bit));
+
+// 16 bit UUIDs as short hex, 128 bit ones in full
+const readUuid = (data, offset, length) =>
+  length === 2
+    ? data.readUInt16LE(offset).toString(16)
+    : Buffer.from(data.slice(offset, offset + 16)).reverse().toString('hex');
+
+// mtu is the ATT_MTU to ask for in exchangeMtu, 517 when not given
+const Gatt = function (address, aclStream, mtu) {
   this._address = address;
   this._aclStream = aclStream;
 
   this._services = {};
   this._characteristics = {};
   this._descriptors = {};
+  // valueHandle -> [{ serviceUuid, characteristicUuid }], to route notifications
+  this._valueHandles = new Map();
 
+  // Requests wait in _commandQueue for the response to _currentCommand,
+  // commands (no response) are written right away and paced by ACL credits.
   this._currentCommand = null;
   this._commandQueue = [];
+  this._timeout = ATT_TIMEOUT;
+  this._timer = null;
+  this._timedOut = false;
+  // set when the request on the unenhanced bearer failed for lack of security
+  this._encrypting = false;
+
+  // Enhanced ATT bearers, each an L2CAP channel with a request of its own
+  // outstanding: [{ channel, mtu, command, timer, encrypting }]
+  this._bearers = [];
+
+  // cleared once the server rejects Read Multiple Variable Length
+  this._readMultipleVariable = true;
 
-  this._mtu = 23;
-  this._desired_mtu = 256;
+  // Prepare Write Requests the server queued before answering Prepare Queue
+  // Full, long writes are split into Execute Writes of this many once known
+  this._prepareQueueSize = 0;
+
+  this._mtu = ATT_DEFAULT_MTU;
+  this._desired_mtu = Math.max(ATT_DEFAULT_MTU, Math.min(mtu || ATT_MAX_MTU, ATT_MAX_MTU));
   this._security = 'low';
 
   this.onAclStreamDataBinded = this.onAclStreamData.bind(this);
@@ -90,46 +152,70 @@ Gatt.prototype.onAclStreamData = function (cid, data) {
     return;
   }
 
-  if (this._currentCommand && (data.toString('hex') === this._currentCommand.buffer.toString('hex'))) {
+  this.onAttData(null, data);
+};
+
+// a PDU from the server on an Enhanced ATT bearer, or the unenhanced one (null)
+Gatt.prototype.onAttData = function (bearer, data) {
+  const currentCommand = bearer ? bearer.command : this._currentCommand;
+
+  if (currentCommand && data.equals(currentCommand.buffer)) {
     debug(`${this._address}: echo ... echo ... echo ...`);
   } else if (data[0] % 2 === 0) {
     if (process.env.NOBLE_MULTI_ROLE) {
       debug(`${this._address}: multi-role flag in use, ignoring command meant for peripheral role.`);
     } else {
       const requestType = data[0];
-      if (requestType === ATT_OP_MTU_REQ) {
+      // the MTU of an Enhanced ATT bearer is its channel's
+      if (requestType === ATT_OP_MTU_REQ && !bearer) {
         debug(`${this._address}: replying to MTU request`);
         this.writeAtt(this.mtuResponse(this._desired_mtu));
       } else {
         debug(`${this._address}: replying with REQ_NOT_SUPP to 0x${requestType.toString(16)}`);
-        this.writeAtt(this.errorResponse(requestType, 0x0000, ATT_ECODE_REQ_NOT_SUPP));
+        this._writeBearer(bearer, this.errorResponse(requestType, 0x0000, ATT_ECODE_REQ_NOT_SUPP));
       }
     }
   } else if (data[0] === ATT_OP_HANDLE_NOTIFY || data[0] === ATT_OP_HANDLE_IND) {
     const valueHandle = data.readUInt16LE(1);
-    const valueData = data.slice(3);
 
-    this.emit('handleNotify', this._address, valueHandle, valueData);
+    this._deliverNotification(valueHandle, data.slice(3));
 
     if (data[0] === ATT_OP_HANDLE_IND) {
-      this._queueCommand(this.handleConfirmation(), null, () => {
+      const confirmed = () => {
         this.emit('handleConfirmation', this._address, valueHandle);
-      });
-    }
+      };
 
-    for (const serviceUuid in this._services) {
-      for (const characteristicUuid in this._characteristics[serviceUuid]) {
-        if (this._characteristics[serviceUuid][characteristicUuid].valueHandle === valueHandle) {
-          this.emit('notification', this._address, serviceUuid, characteristicUuid, valueData);
-        }
+      // confirmed on the bearer the indication came on
+      if (bearer) {
+        this._writeBearer(bearer, this.handleConfirmation(), confirmed);
+      } else {
+        this._queueCommand(this.handleConfirmation(), null, confirmed);
       }
     }
-  } else if (!this._currentCommand) {
+  } else if (data[0] === ATT_OP_MULTI_HANDLE_NOTIFY) {
+    // handle, length and value tuples, all delivered before returning
+    let offset = 1;
+
+    while (offset + 4 <= data.length) {
+      const valueHandle = data.readUInt16LE(offset);
+      const length = data.readUInt16LE(offset + 2);
+
+      this._deliverNotification(valueHandle, data.slice(offset + 4, offset + 4 + length));
+
+      offset += 4 + length;
+    }
+  } else if (!currentCommand) {
     debug(`${this._address}: uh oh, no current command`);
   } else {
     if (data[0] === ATT_OP_ERROR &&
         (data[4] === ATT_ECODE_AUTHENTICATION || data[4] === ATT_ECODE_AUTHORIZATION || data[4] === ATT_ECODE_INSUFF_ENC) &&
-        this._security !== 'medium') {
+        this._security !== 'medium' && currentCommand.encrypt !== false) {
+      // the request goes again once the link is encrypted
+      if (bearer) {
+        bearer.encrypting = true;
+      } else {
+        this._encrypting = true;
+      }
       this._aclStream.encrypt();
       return;
     }
@@ -141,23 +227,25 @@ Gatt.prototype.onAclStreamData = function (cid, data) {
 
     debug(`${this._address}: read: ${data.toString('hex')}`);
 
-    this._currentCommand.callback(data);
+    // the callback runs while its request still holds the bearer, so what it
+    // queues next can't be overtaken by requests in the same sequence
+    if (bearer) {
+      clearTimeout(bearer.timer);
+      bearer.timer = null;
 
-    this._currentCommand = null;
+      bearer.command.callback(data, bearer.mtu);
 
-    while (this._commandQueue.length) {
-      this._currentCommand = this._commandQueue.shift();
+      bearer.command = null;
+    } else {
+      clearTimeout(this._timer);
+      this._timer = null;
 
-      this.writeAtt(this._currentCommand.buffer);
+      this._currentCommand.callback(data);
 
-      if (this._currentCommand.callback) {
-        break;
-      } else if (this._currentCommand.writeCallback) {
-        this._currentCommand.writeCallback();
-
-        this._currentCommand = null;
-      }
+      this._currentCommand = null;
     }
+
+    this._writeNextCommand();
   }
 };
 
@@ -165,7 +253,21 @@ Gatt.prototype.onAclStreamEncrypt = function (encrypt) {
   if (encrypt) {
     this._security = 'medium';
 
-    this.writeAtt(this._currentCommand.buffer);
+    // only the requests refused for security go again, the others still
+    // have their responses coming
+    if (this._encrypting && this._currentCommand) {
+      this._encrypting = false;
+      this.writeAtt(this._currentCommand.buffer);
+      this._startTimer();
+    }
+
+    for (const bearer of this._bearers) {
+      if (bearer.encrypting && bearer.command) {
+        bearer.encrypting = false;
+        this._writeBearer(bearer, bearer.command.buffer);
+        this._startTimer(bearer);
+      }
+    }
   }
 };
 
@@ -174,6 +276,15 @@ Gatt.prototype.onAclStreamEncryptFail = function () {
 };
 
 Gatt.prototype.onAclStreamEnd = function () {
+  clearTimeout(this._timer);
+  this._timer = null;
+
+  // the channels end with the ACL stream themselves
+  for (const bearer of this._bearers) {
+    clearTimeout(bearer.timer);
+  }
+  this._bearers = [];
+
   this._aclStream.removeListener('data', this.onAclStreamDataBinded);
   this._aclStream.removeListener('encrypt', this.onAclStreamEncryptBinded);
   this._aclStream.removeListener('encryptFail', this.onAclStreamEncryptFailBinded);
@@ -186,6 +297,64 @@ Gatt.prototype.writeAtt = function (data) {
   this._aclStream.write(ATT_CID, data);
 };
 
+Gatt.prototype._writeBearer = function (bearer, data, callback) {
+  if (!bearer) {
+    if (callback) {
+      this._writeCommand(data, callback);
+    } else {
+      this.writeAtt(data);
+    }
+    return;
+  }
+
+  debug(`${this._address}: write on 0x${bearer.channel.local.cid.toString(16)}: ${data.toString('hex')}`);
+
+  bearer.channel.write(data, callback);
+};
+
+// Takes an L2CAP channel opened on the Enhanced ATT PSM as one more bearer.
+// Queued requests go out on whichever bearer is free, so requests to
+// different attributes run in parallel.
+Gatt.prototype.addBearer = function (channel) {
+  const bearer = {
+    channel,
+    // the ATT_MTU of an Enhanced ATT bearer is the smaller of the channel MTUs
+    mtu: Math.min(channel.local.mtu, channel.remote.mtu),
+    command: null,
+    timer: null,
+    encrypting: false
+  };
+
+  debug(`${this._address}: Enhanced ATT bearer 0x${channel.local.cid.toString(16)}, MTU ${bearer.mtu}`);
+
+  channel.on('data', (data) => this.onAttData(bearer, data));
+  // writes still queued when the channel closes fail, the request with them
+  channel.on('error', (error) => debug(`${this._address}: ${error.message}`));
+  channel.on('end', () => this.removeBearer(bearer));
+
+  this._bearers.push(bearer);
+  this._writeNextCommand();
+};
+
+Gatt.prototype.removeBearer = function (bearer) {
+  const index = this._bearers.indexOf(bearer);
+
+  if (index === -1) {
+    return;
+  }
+  this._bearers.splice(index, 1);
+
+  clearTimeout(bearer.timer);
+  bearer.timer = null;
+
+  // the request outstanding goes again on another bearer
+  if (bearer.command) {
+    this._commandQueue.unshift(bearer.command);
+    bearer.command = null;
+    this._writeNextCommand();
+  }
+};
+
 Gatt.prototype.errorResponse = function (opcode, handle, status) {
   const buf = Buffer.alloc(5);
 
@@ -197,30 +366,167 @@ Gatt.prototype.errorResponse = function (opcode, handle, status) {
   return buf;
 };
 
-Gatt.prototype._queueCommand = function (buffer, callback, writeCallback) {
+Gatt.prototype._deliverNotification = function (valueHandle, valueData) {
+  this.emit('handleNotify', this._address, valueHandle, valueData);
+
+  const routes = this._valueHandles.get(valueHandle);
+
+  if (routes !== undefined) {
+    for (let i = 0; i < routes.length; i++) {
+      this.emit('notification', this._address, routes[i].serviceUuid, routes[i].characteristicUuid, valueData);
+    }
+  }
+};
+
+// Requests (with a callback) are queued, commands written at once with
+// writeCallback. A request refused for security encrypts the link and goes
+// again, unless encrypt is false and its callback gets the error.
+Gatt.prototype._queueCommand = function (
+  buffer,
+  callback,
+  writeCallback,
+  encrypt = true
+) {
+  if (this._timedOut) {
+    debug(`${this._address}: dropping 0x${buffer[0].toString(16)}, ATT timed out`);
+    return;
+  }
+
+  // ATT allows commands while a request is outstanding, only requests have to
+  // wait for the previous response
+  if (!callback) {
+    this._writeCommand(buffer, writeCallback);
+    return;
+  }
+
   this._commandQueue.push({
     buffer,
     callback,
-    writeCallback
+    encrypt
   });
 
-  if (this._currentCommand === null) {
-    while (this._commandQueue.length) {
-      this._currentCommand = this._commandQueue.shift();
+  this._writeNextCommand();
+};
 
-      this.writeAtt(this._currentCommand.buffer);
+// the requests waiting for their responses and those queued behind them
+Gatt.prototype.pendingRequests = function () {
+  return this._commandQueue.length +
+    (this._currentCommand ? 1 : 0) +
+    this._bearers.filter((bearer) => bearer.command).length;
+};
 
-      if (this._currentCommand.callback) {
-        break;
-      } else if (this._currentCommand.writeCallback) {
-        this._currentCommand.writeCallback();
+// Requests that mustn't overtake each other on different bearers: those to
+// the same attribute, and Prepare and Execute Writes, as the server keeps one
+// prepare queue per client whichever bearer fills it.
+const sequenceOf = (buffer) => {
+  switch (buffer[0]) {
+    case ATT_OP_READ_REQ:
+    case ATT_OP_READ_BLOB_REQ:
+    case ATT_OP_WRITE_REQ:
+      return buffer.readUInt16LE(1);
+    case ATT_OP_PREPARE_WRITE_REQ:
+    case ATT_OP_EXECUTE_WRITE_REQ:
+      return 'prepare';
+    default:
+      return null;
+  }
+};
+
+// the first queued request no outstanding one holds up, and that fits in mtu
+// (the unenhanced bearer takes any, requests are sized by its MTU)
+Gatt.prototype._takeCommand = function (mtu) {
+  if (this._bearers.length === 0) {
+    return this._commandQueue.shift();
+  }
+
+  const outstanding = [this._currentCommand]
+    .concat(this._bearers.map((bearer) => bearer.command))
+    .filter((command) => command && command.buffer)
+    .map((command) => sequenceOf(command.buffer))
+    .filter((sequence) => sequence !== null);
+
+  const index = this._commandQueue.findIndex(({ buffer }) => {
+    const sequence = sequenceOf(buffer);
+
+    return (mtu === undefined || buffer.length <= mtu) &&
+      (sequence === null || outstanding.indexOf(sequence) === -1);
+  });
 
-        this._currentCommand = null;
+  return index === -1 ? undefined : this._commandQueue.splice(index, 1)[0];
+};
+
+Gatt.prototype._writeNextCommand = function () {
+  // the queue only holds requests, each waits for its response
+  if (this._currentCommand === null && this._commandQueue.length) {
+    const command = this._takeCommand();
+
+    if (command) {
+      this._currentCommand = command;
+
+      this.writeAtt(command.buffer);
+      this._startTimer();
+    }
+  }
+
+  for (const bearer of this._bearers) {
+    while (bearer.command === null && this._commandQueue.length) {
+      const command = this._takeCommand(bearer.mtu);
+
+      if (!command) {
+        break;
       }
+
+      bearer.command = command;
+
+      this._writeBearer(bearer, command.buffer);
+      this._startTimer(bearer);
     }
   }
 };
 
+// writeCallback runs once Hci has handed the PDU to the controller, so a
+// stream of commands is paced by the controller's ACL buffers
+Gatt.prototype._writeCommand = function (buffer, writeCallback) {
+  debug(`${this._address}: write command: ${buffer.toString('hex')}`);
+
+  this._aclStream.write(ATT_CID, buffer, writeCallback);
+};
+
+Gatt.prototype._startTimer = function (bearer) {
+  const timer = setTimeout(this.onAttTimeout.bind(this, bearer), this._timeout);
+  // the socket keeps the process alive while connected, the timer shouldn't
+  timer.unref();
+
+  if (bearer) {
+    clearTimeout(bearer.timer);
+    bearer.timer = timer;
+  } else {
+    clearTimeout(this._timer);
+    this._timer = timer;
+  }
+};
+
+// a timeout on any bearer ends ATT for the whole connection
+Gatt.prototype.onAttTimeout = function (bearer) {
+  const command = bearer ? bearer.command : this._currentCommand;
+
+  debug(`${this._address}: no response to 0x${command.buffer[0].toString(16)} in ${this._timeout} ms`);
+
+  clearTimeout(this._timer);
+  this._timer = null;
+  this._timedOut = true;
+  this._currentCommand = null;
+  this._commandQueue = [];
+
+  for (const other of this._bearers) {
+    clearTimeout(other.timer);
+    other.timer = null;
+    other.command = null;
+  }
+
+  this.emit('timeout', this._address, command.buffer[0]);
+};
+
 Gatt.prototype.mtuRequest = function (mtu) {
   const buf = Buffer.alloc(3);
 
@@ -280,6 +586,20 @@ Gatt.prototype.readBlobRequest = function (handle, offset) {
   return buf;
 };
 
+// Read Multiple concatenates the values, only Read Multiple Variable Length
+// responses can be split without knowing the value sizes up front
+Gatt.prototype.readMultipleRequest = function (handles, variable) {
+  const buf = Buffer.alloc(1 + handles.length * 2);
+
+  buf.writeUInt8(variable ? ATT_OP_READ_MULTI_VAR_REQ : ATT_OP_READ_MULTI_REQ, 0);
+
+  for (let i = 0; i < handles.length; i++) {
+    buf.writeUInt16LE(handles[i], 1 + i * 2);
+  }
+
+  return buf;
+};
+
 Gatt.prototype.findInfoRequest = function (startHandle, endHandle) {
   const buf = Buffer.alloc(5);
 
@@ -339,7 +659,8 @@ Gatt.prototype.exchangeMtu = function () {
     const opcode = data[0];
 
     if (opcode === ATT_OP_MTU_RESP) {
-      const newMtu = data.readUInt16LE(1);
+      // both sides use the smaller of the two Rx MTUs
+      const newMtu = Math.max(ATT_DEFAULT_MTU, Math.min(data.readUInt16LE(1), this._desired_mtu));
 
       debug(`${this._address}: new MTU is ${newMtu}`);
 
@@ -350,6 +671,54 @@ Gatt.prototype.exchangeMtu = function () {
   });
 };
 
+// Tells a server with Client Supported Features that this client takes
+// Multiple Handle Value Notifications, so it may bundle values into one PDU.
+// With eatt, that it does Enhanced ATT too, then emits 'eattSupported' if the
+// server's Supported Features say so as well.
+// made on every connection, so none of its requests encrypts the link
+Gatt.prototype.writeClientFeatures = function (eatt) {
+  const readServerFeatures = () => {
+    if (!eatt) {
+      return;
+    }
+
+    this._queueCommand(this.readByTypeRequest(0x0001, 0xffff, GATT_SERVER_SUPPORTED_FEATURES_UUID), (data) => {
+      if (data[0] !== ATT_OP_READ_BY_TYPE_RESP || data[1] < 3 || !(data[4] & SERVER_FEATURE_EATT)) {
+        debug(`${this._address}: no Enhanced ATT`);
+        return;
+      }
+
+      // the channels have an MTU of at least 64
+      this.emit('eattSupported', this._address, Math.max(this._desired_mtu, 64));
+    }, null, false);
+  };
+
+  this._queueCommand(this.readByTypeRequest(0x0001, 0xffff, GATT_CLIENT_SUPPORTED_FEATURES_UUID), (data) => {
+    if (data[0] !== ATT_OP_READ_BY_TYPE_RESP) {
+      debug(`${this._address}: no client supported features`);
+      return readServerFeatures();
+    }
+
+    // the client can't clear bits it set before (Vol 3, Part G, 7.2)
+    const handle = data.readUInt16LE(2);
+    const features = Buffer.from(data.slice(4, data[1] + 2));
+
+    if (features.length === 0) {
+      return readServerFeatures();
+    }
+
+    features[0] |= CLIENT_FEATURE_MULTIPLE_NOTIFICATIONS | (eatt ? CLIENT_FEATURE_EATT : 0);
+
+    // the EATT bit is set before any bearer is opened
+    this._queueCommand(this.writeRequest(handle, features, false), (data) => {
+      if (data[0] === ATT_OP_WRITE_RESP) {
+        debug(`${this._address}: client supported features 0x${features.toString('hex')}`);
+      }
+      readServerFeatures();
+    }, null, false);
+  }, null, false);
+};
+
 Gatt.prototype.addService = function (service) {
   this._services[service.uuid] = service;
 };
@@ -440,10 +809,37 @@ Gatt.prototype.addCharacteristics = function (serviceUuid, characteristics) {
   this._descriptors[serviceUuid] = this._descriptors[serviceUuid] || {};
 
   for (let i = 0; i < characteristics.length; i++) {
-    this._characteristics[serviceUuid][characteristics[i].uuid] = characteristics[i];
+    this._setCharacteristic(serviceUuid, characteristics[i]);
   }
 };
 
+// stores a characteristic and indexes it by value handle for notifications
+Gatt.prototype._setCharacteristic = function (serviceUuid, characteristic) {
+  const characteristicUuid = characteristic.uuid;
+  const previous = this._characteristics[serviceUuid][characteristicUuid];
+
+  if (previous !== undefined) {
+    const routes = this._valueHandles.get(previous.valueHandle) || [];
+    const index = routes.findIndex((route) => route.serviceUuid === serviceUuid && route.characteristicUuid === characteristicUuid);
+
+    if (index !== -1) {
+      routes.splice(index, 1);
+    }
+    if (routes.length === 0) {
+      this._valueHandles.delete(previous.valueHandle);
+    }
+  }
+
+  this._characteristics[serviceUuid][characteristicUuid] = characteristic;
+
+  let routes = this._valueHandles.get(characteristic.valueHandle);
+  if (routes === undefined) {
+    routes = [];
+    this._valueHandles.set(characteristic.valueHandle, routes);
+  }
+  routes.push({ serviceUuid, characteristicUuid });
+};
+
 Gatt.prototype.discoverCharacteristics = function (serviceUuid, characteristicUuids) {
   const service = this._services[serviceUuid];
   const characteristics = [];
@@ -476,7 +872,7 @@ Gatt.prototype.discoverCharacteristics = function (serviceUuid, characteristicUu
         const properties = characteristics[i].properties;
 
         const characteristic = {
-          properties: [],
+          properties: propertyNames(properties),
           uuid: characteristics[i].uuid
         };
 
@@ -492,77 +888,353 @@ Gatt.prototype.discoverCharacteristics = function (serviceUuid, characteristicUu
           characteristics[i].endHandle = service.endHandle;
         }
 
-        this._characteristics[serviceUuid][characteristics[i].uuid] = characteristics[i];
+        this._setCharacteristic(serviceUuid, characteristics[i]);
 
-        if (properties & 0x01) {
-          characteristic.properties.push('broadcast');
+        if (characteristicUuids.length === 0 || characteristicUuids.indexOf(characteristic.uuid) !== -1) {
+          characteristicsDiscovered.push(characteristic);
         }
+      }
 
-        if (properties & 0x02) {
-          characteristic.properties.push('read');
-        }
+      this.emit('characteristicsDiscovered', this._address, serviceUuid, characteristics);
+      this.emit('characteristicsDiscover', this._address, serviceUuid, characteristicsDiscovered);
+    } else {
+      this._queueCommand(this.readByTypeRequest(characteristics[characteristics.length - 1].valueHandle + 1, service.endHandle, GATT_CHARAC_UUID), callback);
+    }
+  };
+
+  this._queueCommand(this.readByTypeRequest(service.startHandle, service.endHandle, GATT_CHARAC_UUID), callback);
+};
 
-        if (properties & 0x04) {
-          characteristic.properties.push('writeWithoutResponse');
+// Discovers every service and characteristic, and with `descriptors` every
+// descriptor, in one sweep per level over the whole handle range instead of
+// one walk per service and characteristic, then emits 'databaseDiscover' with
+// the tree:
+//
+//   [{ uuid, startHandle, endHandle,
+//      characteristics: [{ uuid, properties, startHandle, valueHandle, endHandle,
+//                          descriptors: [{ uuid, handle }] }] }]
+//
+// descriptors is left out without `descriptors`. A sweep ends at the last
+// handle, on an error response, or on a response that doesn't move it on.
+// Included services are not looked up.
+Gatt.prototype.discoverDatabase = function (descriptors) {
+  const services = [];
+  const characteristics = [];
+
+  const discoverServices = (startHandle) => {
+    this._queueCommand(this.readByGroupRequest(startHandle, 0xffff, GATT_PRIM_SVC_UUID), (data) => {
+      // handle, end group handle and at least a 16-bit uuid per entry
+      if (data[0] === ATT_OP_READ_BY_GROUP_RESP && data[1] >= 6) {
+        const length = data[1];
+        const count = services.length;
+
+        for (let offset = 2; offset + length <= data.length; offset += length) {
+          // entries before the start were had already
+          if (data.readUInt16LE(offset) >= startHandle) {
+            services.push({
+              uuid: readUuid(data, offset + 4, length - 4),
+              startHandle: data.readUInt16LE(offset),
+              endHandle: data.readUInt16LE(offset + 2),
+              characteristics: []
+            });
+          }
         }
 
-        if (properties & 0x08) {
-          characteristic.properties.push('write');
+        const last = services[services.length - 1];
+        if (services.length > count && last.endHandle >= startHandle && last.endHandle !== 0xffff) {
+          return discoverServices(last.endHandle + 1);
         }
+      }
 
-        if (properties & 0x10) {
-          characteristic.properties.push('notify');
+      if (services.length === 0) {
+        return this._databaseDiscovered(services);
+      }
+      discoverCharacteristics(services[0].startHandle);
+    });
+  };
+
+  const lastHandle = () => services[services.length - 1].endHandle;
+
+  const discoverCharacteristics = (startHandle) => {
+    this._queueCommand(this.readByTypeRequest(startHandle, lastHandle(), GATT_CHARAC_UUID), (data) => {
+      // handle, properties, value handle and at least a 16-bit uuid per entry
+      if (data[0] === ATT_OP_READ_BY_TYPE_RESP && data[1] >= 7) {
+        const length = data[1];
+        const count = characteristics.length;
+
+        for (let offset = 2; offset + length <= data.length; offset += length) {
+          if (data.readUInt16LE(offset) >= startHandle) {
+            characteristics.push({
+              startHandle: data.readUInt16LE(offset),
+              properties: data.readUInt8(offset + 2),
+              valueHandle: data.readUInt16LE(offset + 3),
+              uuid: readUuid(data, offset + 5, length - 5)
+            });
+          }
         }
 
-        if (properties & 0x20) {
-          characteristic.properties.push('indicate');
+        const last = characteristics[characteristics.length - 1];
+        if (characteristics.length > count && last.valueHandle >= startHandle && last.valueHandle < lastHandle()) {
+          return discoverCharacteristics(last.valueHandle + 1);
         }
+      }
+
+      assignCharacteristics();
+    });
+  };
+
+  // handles after a value up to the next declaration may be descriptors
+  const ranges = [];
+
+  const assignCharacteristics = () => {
+    let s = 0;
 
-        if (properties & 0x40) {
-          characteristic.properties.push('authenticatedSignedWrites');
+    for (let i = 0; i < characteristics.length; i++) {
+      const characteristic = characteristics[i];
+
+      while (s < services.length && services[s].endHandle < characteristic.startHandle) {
+        s++;
+      }
+      const service = services[s];
+      if (service === undefined || service.startHandle > characteristic.startHandle) {
+        continue;
+      }
+
+      const next = characteristics[i + 1];
+      characteristic.endHandle = next && next.startHandle <= service.endHandle
+        ? next.startHandle - 1
+        : service.endHandle;
+      service.characteristics.push(characteristic);
+
+      if (descriptors) {
+        characteristic.descriptors = [];
+        if (characteristic.endHandle > characteristic.valueHandle) {
+          ranges.push(characteristic);
         }
+      }
+    }
+
+    if (ranges.length === 0) {
+      return this._databaseDiscovered(services);
+    }
+    discoverDescriptors(ranges[0].valueHandle + 1, 0);
+  };
+
+  const discoverDescriptors = (startHandle, r) => {
+    const endHandle = ranges[ranges.length - 1].endHandle;
+
+    this._queueCommand(this.findInfoRequest(startHandle, endHandle), (data) => {
+      let handle = endHandle;
+
+      if (data[0] === ATT_OP_FIND_INFO_RESP) {
+        const length = data[1] === 0x01 ? 4 : 18;
+
+        for (let offset = 2; offset + length <= data.length; offset += length) {
+          handle = data.readUInt16LE(offset);
 
-        if (properties & 0x80) {
-          characteristic.properties.push('extendedProperties');
+          while (r < ranges.length && ranges[r].endHandle < handle) {
+            r++;
+          }
+          if (r < ranges.length && ranges[r].valueHandle < handle) {
+            ranges[r].descriptors.push({
+              uuid: readUuid(data, offset + 2, length - 2),
+              handle
+            });
+          }
         }
+      }
 
-        if (characteristicUuids.length === 0 || characteristicUuids.indexOf(characteristic.uuid) !== -1) {
-          characteristicsDiscovered.push(characteristic);
+      // a response before the start can't move the sweep on
+      handle = Math.max(handle, startHandle);
+
+      // skip the declarations and values in between
+      while (r < ranges.length && ranges[r].endHandle <= handle) {
+        r++;
+      }
+      if (r === ranges.length) {
+        return this._databaseDiscovered(services);
+      }
+      discoverDescriptors(Math.max(handle + 1, ranges[r].valueHandle + 1), r);
+    });
+  };
+
+  discoverServices(0x0001);
+};
+
+Gatt.prototype._databaseDiscovered = function (services) {
+  const tree = [];
+
+  for (const service of services) {
+    const characteristics = [];
+
+    this._services[service.uuid] = {
+      uuid: service.uuid,
+      startHandle: service.startHandle,
+      endHandle: service.endHandle
+    };
+    this._characteristics[service.uuid] = {};
+    this._descriptors[service.uuid] = {};
+
+    for (const characteristic of service.characteristics) {
+      // the same shape discoverCharacteristics stores
+      this._setCharacteristic(service.uuid, {
+        startHandle: characteristic.startHandle,
+        properties: characteristic.properties,
+        valueHandle: characteristic.valueHandle,
+        uuid: characteristic.uuid,
+        propsDecoded: propertyNames(characteristic.properties),
+        rawProps: characteristic.properties,
+        endHandle: characteristic.endHandle
+      });
+
+      const characteristic_ = {
+        uuid: characteristic.uuid,
+        properties: propertyNames(characteristic.properties),
+        startHandle: characteristic.startHandle,
+        valueHandle: characteristic.valueHandle,
+        endHandle: characteristic.endHandle
+      };
+
+      if (characteristic.descriptors) {
+        const descriptors = {};
+        for (const descriptor of characteristic.descriptors) {
+          descriptors[descriptor.uuid] = descriptor;
         }
+
+        this._descriptors[service.uuid][characteristic.uuid] = descriptors;
+        characteristic_.descriptors = characteristic.descriptors;
       }
 
-      this.emit('characteristicsDiscovered', this._address, serviceUuid, characteristics);
-      this.emit('characteristicsDiscover', this._address, serviceUuid, characteristicsDiscovered);
-    } else {
-      this._queueCommand(this.readByTypeRequest(characteristics[characteristics.length - 1].valueHandle + 1, service.endHandle, GATT_CHARAC_UUID), callback);
+      characteristics.push(characteristic_);
     }
-  };
 
-  this._queueCommand(this.readByTypeRequest(service.startHandle, service.endHandle, GATT_CHARAC_UUID), callback);
+    tree.push({
+      uuid: service.uuid,
+      startHandle: service.startHandle,
+      endHandle: service.endHandle,
+      characteristics
+    });
+  }
+
+  this.emit('databaseDiscover', this._address, tree);
 };
 
 Gatt.prototype.read = function (serviceUuid, characteristicUuid) {
   const characteristic = this._characteristics[serviceUuid][characteristicUuid];
 
-  let readData = Buffer.alloc(0);
+  this._readLongValue(characteristic.valueHandle, Buffer.alloc(0), (readData) => {
+    this.emit('read', this._address, serviceUuid, characteristicUuid, readData);
+  });
+};
 
-  const callback = (data) => {
+// characteristics: [{ serviceUuid, characteristicUuid }], emits 'readMultiple'
+// with requestId and the values in the same order, or an error when one of
+// them hasn't been discovered
+Gatt.prototype.readMultiple = function (characteristics, requestId) {
+  const handles = [];
+
+  for (const { serviceUuid, characteristicUuid } of characteristics) {
+    const characteristic =
+      this._characteristics[serviceUuid] &&
+      this._characteristics[serviceUuid][characteristicUuid];
+
+    if (!characteristic) {
+      this.emit(
+        'readMultiple',
+        this._address,
+        requestId,
+        new Error(`unknown characteristic ${serviceUuid}, ${characteristicUuid}`)
+      );
+      return;
+    }
+
+    handles.push(characteristic.valueHandle);
+  }
+
+  const values = new Array(handles.length);
+  let remaining = handles.length;
+
+  const done = (index, value) => {
+    values[index] = value;
+
+    if (--remaining === 0) {
+      this.emit('readMultiple', this._address, requestId, null, values);
+    }
+  };
+
+  if (handles.length > 1 && this._readMultipleVariable) {
+    this._readMultipleVariableLength(handles, done);
+  } else {
+    for (let i = 0; i < handles.length; i++) {
+      this._readLongValue(handles[i], Buffer.alloc(0), done.bind(null, i));
+    }
+  }
+};
+
+Gatt.prototype._readMultipleVariableLength = function (handles, done) {
+  // as many handles as fit in a request
+  const perRequest = Math.floor((this._mtu - 1) / 2);
+
+  for (let start = 0; start < handles.length; start += perRequest) {
+    const batch = handles.slice(start, start + perRequest);
+
+    this._queueCommand(this.readMultipleRequest(batch, true), (data) => {
+      if (data[0] !== ATT_OP_READ_MULTI_VAR_RESP) {
+        if (data[0] === ATT_OP_ERROR && data[4] === ATT_ECODE_REQ_NOT_SUPP) {
+          this._readMultipleVariable = false;
+        }
+
+        // one unreadable handle fails the whole request, read them one by one
+        for (let i = 0; i < batch.length; i++) {
+          this._readLongValue(batch[i], Buffer.alloc(0), done.bind(null, start + i));
+        }
+        return;
+      }
+
+      // length / value tuples, cut off after ATT_MTU - 1 bytes
+      let offset = 1;
+      for (let i = 0; i < batch.length; i++) {
+        if (offset + 2 > data.length) {
+          this._readLongValue(batch[i], Buffer.alloc(0), done.bind(null, start + i));
+          continue;
+        }
+
+        const length = data.readUInt16LE(offset);
+        const value = data.slice(offset + 2, offset + 2 + length);
+        offset += 2 + value.length;
+
+        if (value.length < length) {
+          this._readLongValue(batch[i], value, done.bind(null, start + i));
+        } else {
+          done(start + i, value);
+        }
+      }
+    });
+  }
+};
+
+// reads the value of handle from value.length on, with Read Blob Requests
+// while responses fill the MTU and the value can still be longer
+Gatt.prototype._readLongValue = function (handle, value, callback) {
+  const request = value.length === 0
+    ? this.readRequest(handle)
+    : this.readBlobRequest(handle, value.length);
+
+  // mtu is that of the bearer the response came on
+  this._queueCommand(request, (data, mtu = this._mtu) => {
     const opcode = data[0];
 
     if (opcode === ATT_OP_READ_RESP || opcode === ATT_OP_READ_BLOB_RESP) {
-      readData = Buffer.from(`${readData.toString('hex')}${data.slice(1).toString('hex')}`, 'hex');
+      value = Buffer.concat([value, data.slice(1)]);
 
-      if (data.length === this._mtu) {
-        this._queueCommand(this.readBlobRequest(characteristic.valueHandle, readData.length), callback);
-      } else {
-        this.emit('read', this._address, serviceUuid, characteristicUuid, readData);
+      if (data.length === mtu && value.length < ATT_MAX_VALUE_LENGTH) {
+        this._readLongValue(handle, value, callback);
+        return;
       }
-    } else {
-      this.emit('read', this._address, serviceUuid, characteristicUuid, readData);
     }
-  };
 
-  this._queueCommand(this.readRequest(characteristic.valueHandle), callback);
+    callback(value);
+  });
 };
 
 Gatt.prototype.write = function (serviceUuid, characteristicUuid, data, withoutResponse) {
@@ -588,43 +1260,95 @@ Gatt.prototype.write = function (serviceUuid, characteristicUuid, data, withoutR
 /* Perform a "long write" as described Bluetooth Spec section 4.9.4 "Write Long Characteristic Values" */
 Gatt.prototype.longWrite = function (serviceUuid, characteristicUuid, data, withoutResponse) {
   const characteristic = this._characteristics[serviceUuid][characteristicUuid];
+  const handle = characteristic.valueHandle;
   const limit = this._mtu - 5;
 
-  const prepareWriteCallback = (dataChunk) => {
+  // The Prepare Writes of a batch and its Execute Write go out back to back,
+  // as many as the server is known to queue. When its queue runs full, what
+  // it holds is executed and the rest of the value follows in a new batch.
+  const batch = (start) => {
+    const end = this._prepareQueueSize
+      ? Math.min(data.length, start + this._prepareQueueSize * limit)
+      : data.length;
+    const count = Math.ceil((end - start) / limit);
+    const entries = [];
+
+    for (let index = 0; index < count; index++) {
+      const offset = start + index * limit;
+      const chunk = data.slice(offset, Math.min(offset + limit, end));
+
+      entries.push({
+        buffer: this.prepareWriteRequest(handle, offset, chunk),
+        callback: prepareWriteCallback(chunk, offset, index, count)
+      });
+    }
+
+    entries.push({
+      buffer: this.executeWriteRequest(handle),
+      callback: executeWriteCallback(end)
+    });
+
+    return entries;
+  };
+
+  const prepareWriteCallback = (dataChunk, offset, index, count) => {
     return (resp) => {
       const opcode = resp[0];
 
-      if (opcode !== ATT_OP_PREPARE_WRITE_RESP) {
-        debug(`${this._address}: unexpected reply opcode %d (expecting ATT_OP_PREPARE_WRITE_RESP)`, opcode);
-      } else {
+      if (opcode === ATT_OP_PREPARE_WRITE_RESP) {
         const expectedLength = dataChunk.length + 5;
 
         if (resp.length !== expectedLength) {
           /* the response should contain the data packet echoed back to the caller */
           debug(`${this._address}: unexpected prepareWriteResponse length %d (expecting %d)`, resp.length, expectedLength);
         }
+        return;
+      }
+
+      // the rest of the batch, up to its Execute Write, is the first of the
+      // prepare sequence in the queue
+      const rest = count - index;
+      const at = this._commandQueue.findIndex(({ buffer }) => sequenceOf(buffer) === 'prepare');
+
+      if (opcode === ATT_OP_ERROR && resp[4] === ATT_ECODE_PREP_QUEUE_FULL && index > 0) {
+        debug(`${this._address}: prepare queue full after ${index} writes`);
+
+        this._prepareQueueSize = index;
+        this._commandQueue.splice(at, rest, {
+          buffer: this.executeWriteRequest(handle),
+          callback: executeWriteCallback(offset)
+        });
+        return;
       }
+
+      debug(`${this._address}: unexpected reply opcode %d (expecting ATT_OP_PREPARE_WRITE_RESP)`, opcode);
+
+      this._commandQueue.splice(at, rest, {
+        buffer: this.executeWriteRequest(handle, true),
+        callback: () => {}
+      });
     };
   };
 
-  /* split into prepare-write chunks and queue them */
-  let offset = 0;
+  const executeWriteCallback = (end) => {
+    return (resp) => {
+      const opcode = resp[0];
 
-  while (offset < data.length) {
-    const end = offset + limit;
-    const chunk = data.slice(offset, end);
-    this._queueCommand(this.prepareWriteRequest(characteristic.valueHandle, offset, chunk), prepareWriteCallback(chunk));
-    offset = end;
-  }
+      if (opcode !== ATT_OP_EXECUTE_WRITE_RESP) {
+        return;
+      }
 
-  /* queue the execute command with a callback to emit the write signal when done */
-  this._queueCommand(this.executeWriteRequest(characteristic.valueHandle), resp => {
-    const opcode = resp[0];
+      if (end < data.length) {
+        this._commandQueue.unshift(...batch(end));
+      } else if (!withoutResponse) {
+        this.emit('write', this._address, serviceUuid, characteristicUuid);
+      }
+    };
+  };
 
-    if (opcode === ATT_OP_EXECUTE_WRITE_RESP && !withoutResponse) {
-      this.emit('write', this._address, serviceUuid, characteristicUuid);
-    }
-  });
+  for (const { buffer, callback } of batch(0)) {
+    this._queueCommand(buffer, callback);
+  }
 };
 
 Gatt.prototype.broadcast = function (serviceUuid, characteristicUuid, broadcast) {
@@ -739,23 +1463,9 @@ Gatt.prototype.discoverDescriptors = function (serviceUuid, characteristicUuid)
 Gatt.prototype.readValue = function (serviceUuid, characteristicUuid, descriptorUuid) {
   const descriptor = this._descriptors[serviceUuid][characteristicUuid][descriptorUuid];
 
-  let readData = Buffer.alloc(0);
-
-  const callback = (data) => {
-    const opcode = data[0];
-    if (opcode === ATT_OP_READ_RESP || opcode === ATT_OP_READ_BLOB_RESP) {
-      readData = Buffer.from(`${readData.toString('hex')}${data.slice(1).toString('hex')}`, 'hex');
-      if (data.length === this._mtu) {
-        this._queueCommand(this.readBlobRequest(descriptor.handle, readData.length), callback);
-      } else {
-        this.emit('valueRead', this._address, serviceUuid, characteristicUuid, descriptorUuid, readData);
-      }
-    } else {
-      this.emit('valueRead', this._address, serviceUuid, characteristicUuid, descriptorUuid, readData);
-    }
-  };
-
-  this._queueCommand(this.readRequest(descriptor.handle), callback);
+  this._readLongValue(descriptor.handle, Buffer.alloc(0), (readData) => {
+    this.emit('valueRead', this._address, serviceUuid, characteristicUuid, descriptorUuid, readData);
+  });
 };
 
 Gatt.prototype.writeValue = function (serviceUuid, characteristicUuid, descriptorUuid, data) {
@@ -771,23 +1481,9 @@ Gatt.prototype.writeValue = function (serviceUuid, characteristicUuid, descripto
 };
 
 Gatt.prototype.readHandle = function (handle) {
-  let readData = Buffer.alloc(0);
-
-  const callback = (data) => {
-    const opcode = data[0];
-    if (opcode === ATT_OP_READ_RESP || opcode === ATT_OP_READ_BLOB_RESP) {
-      readData = Buffer.from(`${readData.toString('hex')}${data.slice(1).toString('hex')}`, 'hex');
-      if (data.length === this._mtu) {
-        this._queueCommand(this.readBlobRequest(handle, readData.length), callback);
-      } else {
-        this.emit('handleRead', this._address, handle, readData);
-      }
-    } else {
-      this.emit('handleRead', this._address, handle, readData);
-    }
-  };
-
-  this._queueCommand(this.readRequest(handle), callback);
+  this._readLongValue(handle, Buffer.alloc(0), (readData) => {
+    this.emit('handleRead', this._address, handle, readData);
+  });
 };
 
 Gatt.prototype.writeHandle = function (handle, data, withoutResponse) {
@@ -4,6 +4,8 @@ const events = require('events');
 const util = require('util');
 
 const BluetoothHciSocket = {}; // require('@trainerroad/bluetooth-hci-socket');
+const adDecoder = require('../ad-decoder/bindings');
+const { BtsnoopWriter } = require('./btsnoop');
 
 const HCI_COMMAND_PKT = 0x01;
 const HCI_ACLDATA_PKT = 0x02;
@@ -25,6 +27,11 @@ const EVT_LE_ADVERTISING_REPORT = 0x02;
 const EVT_LE_ENHANCED_CONN_COMPLETE = 0x0a;
 const EVT_LE_EXTENDED_ADVERTISING_REPORT = 0x0d;
 const EVT_LE_CONN_UPDATE_COMPLETE = 0x03;
+const EVT_LE_DATA_LENGTH_CHANGE = 0x07;
+const EVT_LE_PHY_UPDATE_COMPLETE = 0x0c;
+const EVT_LE_PERIODIC_ADVERTISING_SYNC_ESTABLISHED = 0x0e;
+const EVT_LE_PERIODIC_ADVERTISING_REPORT = 0x0f;
+const EVT_LE_PERIODIC_ADVERTISING_SYNC_LOST = 0x10;
 
 const OGF_LINK_CTL = 0x01;
 const OCF_DISCONNECT = 0x0006;
@@ -54,10 +61,18 @@ const OCF_LE_SET_EXTENDED_SCAN_ENABLE = 0x0042;
 const OCF_LE_SET_SCAN_PARAMETERS = 0x000b;
 const OCF_LE_SET_SCAN_ENABLE = 0x000c;
 const OCF_LE_CREATE_CONN = 0x000d;
+const OCF_LE_READ_FILTER_ACCEPT_LIST_SIZE = 0x000f;
+const OCF_LE_CLEAR_FILTER_ACCEPT_LIST = 0x0010;
+const OCF_LE_ADD_DEVICE_TO_FILTER_ACCEPT_LIST = 0x0011;
 const OCF_LE_CREATE_EXTENDED_CONN = 0x0043;
+const OCF_LE_PERIODIC_ADVERTISING_CREATE_SYNC = 0x0044;
+const OCF_LE_PERIODIC_ADVERTISING_CREATE_SYNC_CANCEL = 0x0045;
+const OCF_LE_PERIODIC_ADVERTISING_TERMINATE_SYNC = 0x0046;
 const OCF_LE_CANCEL_CONN = 0x000e;
 const OCF_LE_CONN_UPDATE = 0x0013;
 const OCF_LE_START_ENCRYPTION = 0x0019;
+const OCF_LE_SET_DATA_LENGTH = 0x0022;
+const OCF_LE_SET_PHY = 0x0032;
 const DISCONNECT_CMD = OCF_DISCONNECT | (OGF_LINK_CTL << 10);
 
 const SET_EVENT_MASK_CMD = OCF_SET_EVENT_MASK | (OGF_HOST_CTL << 10);
@@ -85,20 +100,46 @@ const LE_SET_SCAN_PARAMETERS_CMD =
   OCF_LE_SET_SCAN_PARAMETERS | (OGF_LE_CTL << 10);
 const LE_SET_SCAN_ENABLE_CMD = OCF_LE_SET_SCAN_ENABLE | (OGF_LE_CTL << 10);
 const LE_CREATE_CONN_CMD = OCF_LE_CREATE_CONN | (OGF_LE_CTL << 10);
+const LE_READ_FILTER_ACCEPT_LIST_SIZE_CMD =
+  OCF_LE_READ_FILTER_ACCEPT_LIST_SIZE | (OGF_LE_CTL << 10);
+const LE_CLEAR_FILTER_ACCEPT_LIST_CMD =
+  OCF_LE_CLEAR_FILTER_ACCEPT_LIST | (OGF_LE_CTL << 10);
+const LE_ADD_DEVICE_TO_FILTER_ACCEPT_LIST_CMD =
+  OCF_LE_ADD_DEVICE_TO_FILTER_ACCEPT_LIST | (OGF_LE_CTL << 10);
 const LE_CREATE_EXTENDED_CONN_CMD =
   OCF_LE_CREATE_EXTENDED_CONN | (OGF_LE_CTL << 10);
+const LE_PERIODIC_ADVERTISING_CREATE_SYNC_CMD =
+  OCF_LE_PERIODIC_ADVERTISING_CREATE_SYNC | (OGF_LE_CTL << 10);
+const LE_PERIODIC_ADVERTISING_CREATE_SYNC_CANCEL_CMD =
+  OCF_LE_PERIODIC_ADVERTISING_CREATE_SYNC_CANCEL | (OGF_LE_CTL << 10);
+const LE_PERIODIC_ADVERTISING_TERMINATE_SYNC_CMD =
+  OCF_LE_PERIODIC_ADVERTISING_TERMINATE_SYNC | (OGF_LE_CTL << 10);
 const LE_CONN_UPDATE_CMD = OCF_LE_CONN_UPDATE | (OGF_LE_CTL << 10);
 const LE_CANCEL_CONN_CMD = OCF_LE_CANCEL_CONN | (OGF_LE_CTL << 10);
 const LE_START_ENCRYPTION_CMD = OCF_LE_START_ENCRYPTION | (OGF_LE_CTL << 10);
+const LE_SET_DATA_LENGTH_CMD = OCF_LE_SET_DATA_LENGTH | (OGF_LE_CTL << 10);
+const LE_SET_PHY_CMD = OCF_LE_SET_PHY | (OGF_LE_CTL << 10);
 const HCI_OE_USER_ENDED_CONNECTION = 0x13;
 
+// link layer data PDU payload every connection starts with (Vol 6 Part B 4.5.10)
+const LE_DEFAULT_DATA_LENGTH = 27;
+
+const DEFAULT_COMMAND_TIMEOUT = 2000; // ms, same as the kernel's HCI_CMD_TIMEOUT
+
 const STATUS_MAPPER = require('./hci-status');
 
 const Hci = function (options) {
   options = options || {};
-  this._socket = new BluetoothHciSocket();
+  this._socket = options.socket || new BluetoothHciSocket();
+
+  const btsnoopFile =
+    options.btsnoopFile || process.env.NOBLE_HCI_BTSNOOP_FILE;
+  this._btsnoop = btsnoopFile ? new BtsnoopWriter(btsnoopFile) : null;
   this._isDevUp = null;
   this._isExtended = 'extended' in options && options.extended;
+  // native advertising report decoder, null to decode in JS
+  this._adDecoder =
+    options.adDecoder !== undefined ? options.adDecoder : adDecoder;
   this._state = null;
 
   this._handleBuffers = {};
@@ -129,6 +170,19 @@ const Hci = function (options) {
 
   this._aclQueue = [];
 
+  // devices the Filter Accept List holds, read on init
+  this.filterAcceptListSize = undefined;
+
+  // Num_HCI_Command_Packets: the controller allows one command before the
+  // first Command Complete/Status event tells us otherwise (Vol 4 Part E 4.4)
+  this._cmdCredits = 1;
+  this._cmdQueue = [];
+  this._cmdPending = new Map();
+  // opcode -> responses still owed to commands that timed out, dropped when
+  // they turn up late rather than taken for a later command's
+  this._cmdTimedOut = new Map();
+  this._cmdTimeout = options.commandTimeout || DEFAULT_COMMAND_TIMEOUT;
+
   this._deviceId =
     options.deviceId != null
       ? parseInt(options.deviceId, 10)
@@ -136,9 +190,12 @@ const Hci = function (options) {
       ? parseInt(process.env.NOBLE_HCI_DEVICE_ID, 10)
       : undefined;
 
+  // options.userChannel binds the HCI user channel, which gives noble the
+  // adapter to itself; HCI_CHANNEL_USER only counts when it isn't given
   this._userChannel =
-    (typeof options.userChannel === 'undefined' && options.userChannel) ||
-    process.env.HCI_CHANNEL_USER;
+    options.userChannel !== undefined
+      ? options.userChannel
+      : process.env.HCI_CHANNEL_USER;
 
   this.on('stateChange', this.onStateChange.bind(this));
 };
@@ -179,17 +236,8 @@ Hci.prototype.pollIsDevUp = function () {
         return;
       }
 
-      if (this._isExtended) {
-        this.setCodedPhySupport();
-      }
       this.setSocketFilter();
-      this.setEventMask();
-      this.setLeEventMask();
-      this.readLocalVersion();
-      this.writeLeHostSupported();
-      this.readLeHostSupported();
-      this.readLeBufferSize();
-      this.readBdAddr();
+      this.initController();
     } else {
       this.emit('stateChange', 'poweredOff');
     }
@@ -200,6 +248,140 @@ Hci.prototype.pollIsDevUp = function () {
   setTimeout(this.pollIsDevUp.bind(this), 1000);
 };
 
+// None of the init commands depend on each other's results, so they are all
+// queued at once and go out in a single burst if the controller grants enough
+// command credits.
+Hci.prototype.initController = function () {
+  if (this._isExtended) {
+    this.setCodedPhySupport();
+  }
+  this.setEventMask();
+  this.setLeEventMask();
+  this.readLocalVersion();
+  this.writeLeHostSupported();
+  this.readLeHostSupported();
+  this.readLeBufferSize();
+  this.readFilterAcceptListSize();
+  this.readBdAddr();
+};
+
+Hci.prototype.sendCommand = function (cmd) {
+  const command = {
+    opcode: cmd.readUInt16LE(1),
+    packet: cmd,
+    resolve: null,
+    reject: null,
+    timer: null
+  };
+
+  const promise = new Promise((resolve, reject) => {
+    command.resolve = resolve;
+    command.reject = reject;
+  });
+  // most callers fire and forget, failures are reported through debug
+  promise.catch((error) => debug(error.message));
+
+  this._cmdQueue.push(command);
+  this.flushCommands();
+
+  return promise;
+};
+
+Hci.prototype.flushCommands = function () {
+  while (this._cmdQueue.length > 0 && this._cmdCredits > 0) {
+    const command = this._cmdQueue.shift();
+
+    this._cmdCredits--;
+
+    let pending = this._cmdPending.get(command.opcode);
+    if (!pending) {
+      pending = [];
+      this._cmdPending.set(command.opcode, pending);
+    }
+    pending.push(command);
+
+    command.timer = setTimeout(
+      this.onCommandTimeout.bind(this, command),
+      this._cmdTimeout
+    );
+
+    debug(`write command - writing: ${command.packet.toString('hex')}`);
+    this.writeSocket(command.packet);
+  }
+};
+
+Hci.prototype.onCommandTimeout = function (command) {
+  const pending = this._cmdPending.get(command.opcode);
+  const index = pending ? pending.indexOf(command) : -1;
+
+  if (index === -1) {
+    return;
+  }
+
+  pending.splice(index, 1);
+  if (pending.length === 0) {
+    this._cmdPending.delete(command.opcode);
+  }
+
+  this._cmdTimedOut.set(
+    command.opcode,
+    (this._cmdTimedOut.get(command.opcode) || 0) + 1
+  );
+
+  // the response got lost, don't stall the queue forever waiting for credits
+  if (this._cmdCredits === 0) {
+    this._cmdCredits = 1;
+  }
+
+  command.reject(
+    new Error(`HCI command 0x${command.opcode.toString(16)} timed out`)
+  );
+
+  this.flushCommands();
+};
+
+Hci.prototype.processCommandResponse = function (
+  cmd,
+  numCommandPackets,
+  status,
+  result
+) {
+  this._cmdCredits = numCommandPackets;
+
+  const timedOut = this._cmdTimedOut.get(cmd);
+  const pending = this._cmdPending.get(cmd);
+
+  if (timedOut) {
+    debug(`dropping late response to 0x${cmd.toString(16)}`);
+    if (timedOut === 1) {
+      this._cmdTimedOut.delete(cmd);
+    } else {
+      this._cmdTimedOut.set(cmd, timedOut - 1);
+    }
+  } else if (pending) {
+    const command = pending.shift();
+    if (pending.length === 0) {
+      this._cmdPending.delete(cmd);
+    }
+
+    clearTimeout(command.timer);
+
+    if (status === 0) {
+      command.resolve(result);
+    } else {
+      const error = new Error(
+        `${STATUS_MAPPER[status] || 'HCI Error: Unknown'} (0x${status.toString(
+          16
+        )})`
+      );
+      error.status = status;
+      command.reject(error);
+    }
+  }
+
+  this.flushCommands();
+};
+
 Hci.prototype.setCodedPhySupport = function () {
   const cmd = Buffer.alloc(7);
 
@@ -216,7 +398,7 @@ Hci.prototype.setCodedPhySupport = function () {
   cmd.writeUInt8(0x05, 6); // rx phy: 0x01 - LE 1M, 0x03 - LE 1M + LE 2M, 0x05 - LE 1M + LE CODED, 0x07 -  LE 1M + LE 2M +  LE CODED
 
   debug(`set all phys supporting - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
 };
 
 Hci.prototype.setRandomMAC = function () {
@@ -238,7 +420,7 @@ Hci.prototype.setRandomMAC = function () {
   cmd.writeUInt8(0x00, 9); // mac 1 byte
 
   debug(`set random mac address - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
 };
 
 Hci.prototype.setSocketFilter = function () {
@@ -277,7 +459,7 @@ Hci.prototype.setEventMask = function () {
   eventMask.copy(cmd, 4);
 
   debug(`set event mask - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
 };
 
 Hci.prototype.reset = function () {
@@ -291,7 +473,7 @@ Hci.prototype.reset = function () {
   cmd.writeUInt8(0x00, 3);
 
   debug(`reset - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
 };
 
 Hci.prototype.readSupportedCommands = function () {
@@ -305,7 +487,7 @@ Hci.prototype.readSupportedCommands = function () {
   cmd.writeUInt8(0x0, 3);
 
   debug(`read supported commands - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
 };
 
 Hci.prototype.readLocalVersion = function () {
@@ -319,7 +501,7 @@ Hci.prototype.readLocalVersion = function () {
   cmd.writeUInt8(0x0, 3);
 
   debug(`read local version - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
 };
 
 Hci.prototype.readBufferSize = function () {
@@ -333,7 +515,7 @@ Hci.prototype.readBufferSize = function () {
   cmd.writeUInt8(0x0, 3);
 
   debug(`read buffer size - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
 };
 
 Hci.prototype.readBdAddr = function () {
@@ -347,14 +529,14 @@ Hci.prototype.readBdAddr = function () {
   cmd.writeUInt8(0x0, 3);
 
   debug(`read bd addr - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
 };
 
 Hci.prototype.setLeEventMask = function () {
   const cmd = Buffer.alloc(12);
   const leEventMask = this._isExtended
-    ? Buffer.from('1fff000000000000', 'hex')
-    : Buffer.from('1f00000000000000', 'hex');
+    ? Buffer.from('5fff000000000000', 'hex')
+    : Buffer.from('5f08000000000000', 'hex');
 
   // header
   cmd.writeUInt8(HCI_COMMAND_PKT, 0);
@@ -366,7 +548,7 @@ Hci.prototype.setLeEventMask = function () {
   leEventMask.copy(cmd, 4);
 
   debug(`set le event mask - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
 };
 
 Hci.prototype.readLeBufferSize = function () {
@@ -380,7 +562,54 @@ Hci.prototype.readLeBufferSize = function () {
   cmd.writeUInt8(0x0, 3);
 
   debug(`le read buffer size - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
+};
+
+Hci.prototype.readFilterAcceptListSize = function () {
+  const cmd = Buffer.alloc(4);
+
+  // header
+  cmd.writeUInt8(HCI_COMMAND_PKT, 0);
+  cmd.writeUInt16LE(LE_READ_FILTER_ACCEPT_LIST_SIZE_CMD, 1);
+
+  // length
+  cmd.writeUInt8(0x0, 3);
+
+  debug(`le read filter accept list size - writing: ${cmd.toString('hex')}`);
+  return this.sendCommand(cmd);
+};
+
+// the Filter Accept List can't change while a Create Connection uses it
+Hci.prototype.clearFilterAcceptList = function () {
+  const cmd = Buffer.alloc(4);
+
+  // header
+  cmd.writeUInt8(HCI_COMMAND_PKT, 0);
+  cmd.writeUInt16LE(LE_CLEAR_FILTER_ACCEPT_LIST_CMD, 1);
+
+  // length
+  cmd.writeUInt8(0x0, 3);
+
+  debug(`le clear filter accept list - writing: ${cmd.toString('hex')}`);
+  return this.sendCommand(cmd);
+};
+
+Hci.prototype.addToFilterAcceptList = function (address, addressType) {
+  const cmd = Buffer.alloc(11);
+
+  // header
+  cmd.writeUInt8(HCI_COMMAND_PKT, 0);
+  cmd.writeUInt16LE(LE_ADD_DEVICE_TO_FILTER_ACCEPT_LIST_CMD, 1);
+
+  // length
+  cmd.writeUInt8(0x07, 3);
+
+  // data
+  cmd.writeUInt8(addressType === 'random' ? 0x01 : 0x00, 4); // address type
+  Buffer.from(address.split(':').reverse().join(''), 'hex').copy(cmd, 5);
+
+  debug(`le add device to filter accept list - writing: ${cmd.toString('hex')}`);
+  return this.sendCommand(cmd);
 };
 
 Hci.prototype.readLeHostSupported = function () {
@@ -394,7 +623,7 @@ Hci.prototype.readLeHostSupported = function () {
   cmd.writeUInt8(0x00, 3);
 
   debug(`read LE host supported - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
 };
 
 Hci.prototype.writeLeHostSupported = function () {
@@ -412,13 +641,16 @@ Hci.prototype.writeLeHostSupported = function () {
   cmd.writeUInt8(0x00, 5); // simul
 
   debug(`write LE host supported - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
 };
 
+// a passive scan sends no scan requests, so there are no scan responses
 Hci.prototype.setScanParameters = function (
   interval = 0x0012,
-  window = 0x0012
+  window = 0x0012,
+  passive = false
 ) {
+  const type = passive ? 0x00 : 0x01;
   const cmd = Buffer.alloc(this._isExtended ? 17 : 11);
 
   // header
@@ -439,11 +671,11 @@ Hci.prototype.setScanParameters = function (
     cmd.writeUInt8(0x00, 5); // filter: 0 -> all event types
     cmd.writeUInt8(0x05, 6); // phy: LE 1M + LE CODED
     // phy 1M
-    cmd.writeUInt8(0x01, 7); // type: 0 -> passive, 1 -> active
+    cmd.writeUInt8(type, 7); // type: 0 -> passive, 1 -> active
     cmd.writeUInt16LE(interval, 8); // interval, ms * 1.6
     cmd.writeUInt16LE(window, 10); // window, ms * 1.6
     // phy coded
-    cmd.writeUInt8(0x01, 12); // type: 0 -> passive, 1 -> active
+    cmd.writeUInt8(type, 12); // type: 0 -> passive, 1 -> active
     cmd.writeUInt16LE(interval, 13); // interval, ms * 1.6
     cmd.writeUInt16LE(window, 15); // window, ms * 1.6
   } else {
@@ -451,7 +683,7 @@ Hci.prototype.setScanParameters = function (
     cmd.writeUInt8(0x07, 3);
 
     // data
-    cmd.writeUInt8(0x01, 4); // type: 0 -> passive, 1 -> active
+    cmd.writeUInt8(type, 4); // type: 0 -> passive, 1 -> active
     cmd.writeUInt16LE(interval, 5); // interval, ms * 1.6
     cmd.writeUInt16LE(window, 7); // window, ms * 1.6
     cmd.writeUInt8(0x00, 9); // own address type: 0 -> public, 1 -> random
@@ -459,7 +691,7 @@ Hci.prototype.setScanParameters = function (
   }
 
   debug(`set scan parameters - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
 };
 
 Hci.prototype.setScanEnabled = function (enabled, filterDuplicates) {
@@ -491,10 +723,17 @@ Hci.prototype.setScanEnabled = function (enabled, filterDuplicates) {
   }
 
   debug(`set scan enabled - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
 };
 
-Hci.prototype.createLeConn = function (address, addressType, parameters = {}) {
+// with acceptList the controller connects to the first device on the Filter
+// Accept List it hears advertising, and address is ignored
+Hci.prototype.createLeConn = function (
+  address,
+  addressType,
+  parameters = {},
+  acceptList = false
+) {
   const {
     minInterval = 0x0006,
     maxInterval = 0x0012,
@@ -516,10 +755,12 @@ Hci.prototype.createLeConn = function (address, addressType, parameters = {}) {
     cmd.writeUInt8(0x2a, 3);
 
     // data
-    cmd.writeUInt8(0x00, 4); // filter policy: white list is not used
+    cmd.writeUInt8(acceptList ? 0x01 : 0x00, 4); // filter policy
     cmd.writeUInt8(0x00, 5); // own address type
-    cmd.writeUInt8(addressType === 'random' ? 0x01 : 0x00, 6); // peer address type
-    Buffer.from(address.split(':').reverse().join(''), 'hex').copy(cmd, 7); // peer address
+    if (!acceptList) {
+      cmd.writeUInt8(addressType === 'random' ? 0x01 : 0x00, 6); // peer address type
+      Buffer.from(address.split(':').reverse().join(''), 'hex').copy(cmd, 7); // peer address
+    }
     cmd.writeUInt8(0x05, 13); // initiating PHYs: LE 1M + LE Coded
 
     // LE 1M PHY
@@ -548,10 +789,12 @@ Hci.prototype.createLeConn = function (address, addressType, parameters = {}) {
     // data
     cmd.writeUInt16LE(0x0060, 4); // interval
     cmd.writeUInt16LE(0x0030, 6); // window
-    cmd.writeUInt8(0x00, 8); // initiator filter
+    cmd.writeUInt8(acceptList ? 0x01 : 0x00, 8); // initiator filter
 
-    cmd.writeUInt8(addressType === 'random' ? 0x01 : 0x00, 9); // peer address type
-    Buffer.from(address.split(':').reverse().join(''), 'hex').copy(cmd, 10); // peer address
+    if (!acceptList) {
+      cmd.writeUInt8(addressType === 'random' ? 0x01 : 0x00, 9); // peer address type
+      Buffer.from(address.split(':').reverse().join(''), 'hex').copy(cmd, 10); // peer address
+    }
 
     cmd.writeUInt8(0x00, 16); // own address type
 
@@ -564,7 +807,7 @@ Hci.prototype.createLeConn = function (address, addressType, parameters = {}) {
   }
 
   debug(`create le conn - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
 };
 
 Hci.prototype.connUpdateLe = function (
@@ -593,7 +836,51 @@ Hci.prototype.connUpdateLe = function (
   cmd.writeUInt16LE(0x0000, 16); // max ce length
 
   debug(`conn update le - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
+};
+
+// asks the controller for link layer PDUs of up to txOctets (27 - 251) bytes,
+// answered with an LE Data Length Change event once the peer agreed
+Hci.prototype.setDataLength = function (handle, txOctets) {
+  const cmd = Buffer.alloc(10);
+
+  // header
+  cmd.writeUInt8(HCI_COMMAND_PKT, 0);
+  cmd.writeUInt16LE(LE_SET_DATA_LENGTH_CMD, 1);
+
+  // length
+  cmd.writeUInt8(0x06, 3);
+
+  // data
+  cmd.writeUInt16LE(handle, 4);
+  cmd.writeUInt16LE(txOctets, 6);
+  cmd.writeUInt16LE((txOctets + 14) * 8, 8); // tx time on LE 1M, in us
+
+  debug(`set data length - writing: ${cmd.toString('hex')}`);
+  return this.sendCommand(cmd);
+};
+
+// phys: 0x01 - LE 1M, 0x02 - LE 2M, 0x04 - LE Coded, for both directions,
+// answered with an LE PHY Update Complete event
+Hci.prototype.setPhy = function (handle, phys) {
+  const cmd = Buffer.alloc(11);
+
+  // header
+  cmd.writeUInt8(HCI_COMMAND_PKT, 0);
+  cmd.writeUInt16LE(LE_SET_PHY_CMD, 1);
+
+  // length
+  cmd.writeUInt8(0x07, 3);
+
+  // data
+  cmd.writeUInt16LE(handle, 4);
+  cmd.writeUInt8(0x00, 6); // all phys: tx and rx preferences given
+  cmd.writeUInt8(phys, 7); // tx phys
+  cmd.writeUInt8(phys, 8); // rx phys
+  cmd.writeUInt16LE(0x0000, 9); // phy options: no coding preferred
+
+  debug(`set phy - writing: ${cmd.toString('hex')}`);
+  return this.sendCommand(cmd);
 };
 
 Hci.prototype.cancelConnect = function () {
@@ -607,7 +894,63 @@ Hci.prototype.cancelConnect = function () {
   cmd.writeUInt8(0x0, 3);
 
   debug('cancel le conn - writing: ' + cmd.toString('hex'));
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
+};
+
+// syncs to the periodic advertising train `sid` of an advertiser, lost after
+// `timeout` (in 10 ms units) without hearing it; only one may be pending
+Hci.prototype.createPeriodicSync = function (sid, address, addressType, timeout) {
+  const cmd = Buffer.alloc(18);
+
+  // header
+  cmd.writeUInt8(HCI_COMMAND_PKT, 0);
+  cmd.writeUInt16LE(LE_PERIODIC_ADVERTISING_CREATE_SYNC_CMD, 1);
+
+  // length
+  cmd.writeUInt8(0x0e, 3);
+
+  // data
+  cmd.writeUInt8(0x00, 4); // options: this advertiser, reports enabled
+  cmd.writeUInt8(sid, 5); // advertising SID
+  cmd.writeUInt8(addressType === 'random' ? 0x01 : 0x00, 6); // advertiser address type
+  Buffer.from(address.split(':').reverse().join(''), 'hex').copy(cmd, 7); // advertiser address
+  cmd.writeUInt16LE(0x0000, 13); // skip
+  cmd.writeUInt16LE(timeout, 15); // sync timeout, ms / 10
+  cmd.writeUInt8(0x00, 17); // sync CTE type: any
+
+  debug(`create periodic sync - writing: ${cmd.toString('hex')}`);
+  return this.sendCommand(cmd);
+};
+
+Hci.prototype.cancelPeriodicSync = function () {
+  const cmd = Buffer.alloc(4);
+
+  // header
+  cmd.writeUInt8(HCI_COMMAND_PKT, 0);
+  cmd.writeUInt16LE(LE_PERIODIC_ADVERTISING_CREATE_SYNC_CANCEL_CMD, 1);
+
+  // length
+  cmd.writeUInt8(0x00, 3);
+
+  debug(`cancel periodic sync - writing: ${cmd.toString('hex')}`);
+  return this.sendCommand(cmd);
+};
+
+Hci.prototype.terminatePeriodicSync = function (handle) {
+  const cmd = Buffer.alloc(6);
+
+  // header
+  cmd.writeUInt8(HCI_COMMAND_PKT, 0);
+  cmd.writeUInt16LE(LE_PERIODIC_ADVERTISING_TERMINATE_SYNC_CMD, 1);
+
+  // length
+  cmd.writeUInt8(0x02, 3);
+
+  // data
+  cmd.writeUInt16LE(handle, 4); // sync handle
+
+  debug(`terminate periodic sync - writing: ${cmd.toString('hex')}`);
+  return this.sendCommand(cmd);
 };
 
 Hci.prototype.startLeEncryption = function (handle, random, diversifier, key) {
@@ -627,7 +970,7 @@ Hci.prototype.startLeEncryption = function (handle, random, diversifier, key) {
   key.copy(cmd, 16);
 
   debug(`start le encryption - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
 };
 
 Hci.prototype.disconnect = function (handle, reason) {
@@ -647,7 +990,7 @@ Hci.prototype.disconnect = function (handle, reason) {
   cmd.writeUInt8(reason, 6); // reason
 
   debug(`disconnect - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
 };
 
 Hci.prototype.readRssi = function (handle) {
@@ -664,14 +1007,17 @@ Hci.prototype.readRssi = function (handle) {
   cmd.writeUInt16LE(handle, 4); // handle
 
   debug(`read rssi - writing: ${cmd.toString('hex')}`);
-  this._socket.write(cmd);
+  return this.sendCommand(cmd);
 };
 
-Hci.prototype.writeAclDataPkt = async function (handle, cid, data) {
+// callback, if any, runs when the last fragment has been written to the
+// controller, i.e. once it got an ACL buffer
+Hci.prototype.writeAclDataPkt = async function (handle, cid, data, callback) {
   const l2capLength = 4 /* l2cap header */ + data.length;
 
   const aclBuffers = await this.getAclBuffers();
-  const aclLength = Math.min(l2capLength, aclBuffers.length);
+  const fragmentLength = this.aclFragmentLength(handle, aclBuffers.length);
+  const aclLength = Math.min(l2capLength, fragmentLength);
 
   const minFirstLength = Math.max(
     aclLength + 5 /* acl header */,
@@ -695,7 +1041,7 @@ Hci.prototype.writeAclDataPkt = async function (handle, cid, data) {
   this._aclQueue.push({ handle, packet: first });
 
   while (data.length > 0) {
-    const fragAclLength = Math.min(data.length, aclBuffers.length);
+    const fragAclLength = Math.min(data.length, fragmentLength);
     const frag = Buffer.alloc(fragAclLength + 5 /* acl header */);
     // acl header
     frag.writeUInt8(HCI_ACLDATA_PKT, 0);
@@ -709,9 +1055,27 @@ Hci.prototype.writeAclDataPkt = async function (handle, cid, data) {
     this._aclQueue.push({ handle, packet: frag });
   }
 
+  if (callback) {
+    this._aclQueue[this._aclQueue.length - 1].callback = callback;
+  }
+
   this.flushAcl();
 };
 
+// The controller sends every ACL packet in link layer PDUs of up to the
+// connection's txOctets, the last one partly empty. Fragments that are a
+// multiple of txOctets keep all but the last PDU of an L2CAP PDU full.
+Hci.prototype.aclFragmentLength = function (handle, bufferLength) {
+  const connection = this._aclConnections.get(handle);
+  const txOctets = connection && connection.txOctets;
+
+  if (!txOctets || bufferLength <= txOctets) {
+    return bufferLength;
+  }
+
+  return bufferLength - (bufferLength % txOctets);
+};
+
 Hci.prototype.flushAcl = async function () {
   const pendingPackets = () => {
     let totalPending = 0;
@@ -729,16 +1093,42 @@ Hci.prototype.flushAcl = async function () {
 
   const aclBuffers = await this.getAclBuffers();
   while (this._aclQueue.length > 0 && pendingPackets() < aclBuffers.num) {
-    const { handle, packet } = this._aclQueue.shift();
+    const { handle, packet, callback } = this._aclQueue.shift();
     this._aclConnections.get(handle).pending++;
     debug(`write acl data packet - writing: ${packet.toString('hex')}`);
-    this._socket.write(packet);
+    this.writeSocket(packet);
+
+    if (callback) {
+      callback();
+    }
+  }
+};
+
+Hci.prototype.writeSocket = function (packet) {
+  if (this._btsnoop) {
+    this._btsnoop.write(packet, false);
+  }
+  this._socket.write(packet);
+};
+
+Hci.prototype.closeBtsnoop = function (callback) {
+  const btsnoop = this._btsnoop;
+  this._btsnoop = null;
+
+  if (btsnoop) {
+    btsnoop.close(callback);
+  } else if (callback) {
+    callback();
   }
 };
 
 Hci.prototype.onSocketData = function (data) {
   debug(`onSocketData: ${data.toString('hex')}`);
 
+  if (this._btsnoop) {
+    this._btsnoop.write(data, true);
+  }
+
   const eventType = data.readUInt8(0);
   let handle;
   let cmd;
@@ -764,16 +1154,20 @@ Hci.prototype.onSocketData = function (data) {
 
       this.emit('disconnComplete', handle, reason);
     } else if (subEventType === EVT_ENCRYPT_CHANGE) {
+      const status = data.readUInt8(3);
       handle = data.readUInt16LE(4);
       const encrypt = data.readUInt8(6);
 
+      debug(`\t\tstatus = ${status}`);
       debug(`\t\thandle = ${handle}`);
       debug(`\t\tencrypt = ${encrypt}`);
 
-      this.emit('encryptChange', handle, encrypt);
+      this.emit('encryptChange', handle, encrypt, status);
     } else if (subEventType === EVT_CMD_COMPLETE) {
+      const numCommandPackets = data.readUInt8(3);
       cmd = data.readUInt16LE(4);
-      status = data.readUInt8(6);
+      // the NOP opcode (0x0000) carries no return parameters
+      status = data.length > 6 ? data.readUInt8(6) : 0;
       const result = data.slice(7);
 
       debug(`\t\tcmd = ${cmd}`);
@@ -781,14 +1175,17 @@ Hci.prototype.onSocketData = function (data) {
       debug(`\t\tresult = ${result.toString('hex')}`);
 
       this.processCmdCompleteEvent(cmd, status, result);
+      this.processCommandResponse(cmd, numCommandPackets, status, result);
     } else if (subEventType === EVT_CMD_STATUS) {
       status = data.readUInt8(3);
+      const numCommandPackets = data.readUInt8(4);
       cmd = data.readUInt16LE(5);
 
       debug(`\t\tstatus = ${status}`);
       debug(`\t\tcmd = ${cmd}`);
 
       this.processCmdStatusEvent(cmd, status);
+      this.processCommandResponse(cmd, numCommandPackets, status);
     } else if (subEventType === EVT_LE_META_EVENT) {
       const leMetaEventLength = data.readUInt8(2);
       const leMetaEventType = data.readUInt8(3);
@@ -800,11 +1197,19 @@ Hci.prototype.onSocketData = function (data) {
       debug(`\t\tLE meta event num reports = ${leMetaEventNumReports}`);
       debug(`\t\tLE meta event data = ${leMetaEventData.toString('hex')}`);
 
-      this.processLeMetaEvent(
-        leMetaEventType,
-        leMetaEventNumReports,
-        leMetaEventData
-      );
+      if (
+        this._adDecoder === null ||
+        (leMetaEventType !== EVT_LE_ADVERTISING_REPORT &&
+          leMetaEventType !== EVT_LE_EXTENDED_ADVERTISING_REPORT) ||
+        !this.processLeAdvertisingEvent(data)
+      ) {
+        this.processLeMetaEvent(
+          leMetaEventType,
+          leMetaEventNumReports,
+          leMetaEventData,
+          data.slice(4)
+        );
+      }
     } else if (subEventType === EVT_NUMBER_OF_COMPLETED_PACKETS) {
       const handles = data.readUInt8(3);
       for (let h = 0; h < handles; h++) {
@@ -911,13 +1316,7 @@ Hci.prototype.onSocketError = function (error) {
 
 Hci.prototype.processCmdCompleteEvent = function (cmd, status, result) {
   if (cmd === RESET_CMD) {
-    if (this._isExtended) {
-      this.setCodedPhySupport();
-    }
-    this.setEventMask();
-    this.setLeEventMask();
-    this.readLocalVersion();
-    this.readBdAddr();
+    this.initController();
   } else if (cmd === READ_LE_HOST_SUPPORTED_CMD) {
     if (status === 0) {
       const le = result.readUInt8(0);
@@ -933,6 +1332,8 @@ Hci.prototype.processCmdCompleteEvent = function (cmd, status, result) {
     const manufacturer = result.readUInt16LE(4);
     const lmpSubVer = result.readUInt16LE(6);
 
+    this.hciVersion = hciVer;
+
     if (hciVer < 0x06) {
       this.emit('stateChange', 'unsupported');
     } else if (this._state !== 'poweredOn') {
@@ -1005,6 +1406,12 @@ Hci.prototype.processCmdCompleteEvent = function (cmd, status, result) {
         this.setAclBuffers(aclLength, aclNum);
       }
     }
+  } else if (cmd === LE_READ_FILTER_ACCEPT_LIST_SIZE_CMD) {
+    if (status === 0) {
+      this.filterAcceptListSize = result.readUInt8(0);
+
+      debug(`filter accept list size = ${this.filterAcceptListSize}`);
+    }
   } else if (cmd === READ_BUFFER_SIZE_CMD) {
     const aclLength = result.readUInt16LE(0);
     const aclNum = result.readUInt16LE(3);
@@ -1014,7 +1421,9 @@ Hci.prototype.processCmdCompleteEvent = function (cmd, status, result) {
   }
 };
 
-Hci.prototype.processLeMetaEvent = function (eventType, numReports, data) {
+// `parameters` are the event's from right after the sub event code, numReports
+// included, for the events that have no status: a view, not a copy
+Hci.prototype.processLeMetaEvent = function (eventType, numReports, data, parameters) {
   if (eventType === EVT_LE_CONN_COMPLETE) {
     this.processLeConnComplete(numReports, data);
   } else if (eventType === EVT_LE_ENHANCED_CONN_COMPLETE) {
@@ -1025,6 +1434,16 @@ Hci.prototype.processLeMetaEvent = function (eventType, numReports, data) {
     this.processLeExtendedAdvertisingReport(numReports, data);
   } else if (eventType === EVT_LE_CONN_UPDATE_COMPLETE) {
     this.processLeConnUpdateComplete(numReports, data);
+  } else if (eventType === EVT_LE_DATA_LENGTH_CHANGE) {
+    this.processLeDataLengthChange(parameters);
+  } else if (eventType === EVT_LE_PHY_UPDATE_COMPLETE) {
+    this.processLePhyUpdateComplete(numReports, data);
+  } else if (eventType === EVT_LE_PERIODIC_ADVERTISING_SYNC_ESTABLISHED) {
+    this.processLePeriodicSyncEstablished(numReports, data);
+  } else if (eventType === EVT_LE_PERIODIC_ADVERTISING_REPORT) {
+    this.processLePeriodicAdvertisingReport(parameters);
+  } else if (eventType === EVT_LE_PERIODIC_ADVERTISING_SYNC_LOST) {
+    this.processLePeriodicSyncLost(parameters);
   }
 };
 
@@ -1052,7 +1471,11 @@ Hci.prototype.processLeConnComplete = function (status, data) {
   debug(`\t\t\tsupervision timeout = ${supervisionTimeout}`);
   debug(`\t\t\tmaster clock accuracy = ${masterClockAccuracy}`);
 
-  this._aclConnections.set(handle, { pending: 0 });
+  this._aclConnections.set(handle, {
+    pending: 0,
+    txOctets: LE_DEFAULT_DATA_LENGTH,
+    rxOctets: LE_DEFAULT_DATA_LENGTH
+  });
 
   this.emit(
     'leConnComplete',
@@ -1110,7 +1533,11 @@ Hci.prototype.processLeEnhancedConnComplete = function (status, data) {
   debug(`\t\t\tsupervision timeout = ${supervisionTimeout}`);
   debug(`\t\t\tmaster clock accuracy = ${masterClockAccuracy}`);
 
-  this._aclConnections.set(handle, { pending: 0 });
+  this._aclConnections.set(handle, {
+    pending: 0,
+    txOctets: LE_DEFAULT_DATA_LENGTH,
+    rxOctets: LE_DEFAULT_DATA_LENGTH
+  });
 
   this.emit(
     'leConnComplete',
@@ -1192,7 +1619,7 @@ Hci.prototype.processLeExtendedAdvertisingReport = function (numReports, data) {
         .reverse()
         .join(':');
       const eirLength = data.readUInt8(23);
-      const eir = data.slice(24);
+      const eir = data.slice(24, eirLength + 24);
 
       debug(`\t\t\ttype = ${type}`);
       debug(`\t\t\taddress = ${address}`);
@@ -1218,7 +1645,10 @@ Hci.prototype.processLeExtendedAdvertisingReport = function (numReports, data) {
         addressType,
         txpower,
         rssi,
-        eir
+        eir,
+        undefined,
+        sid,
+        periodicAdvInterval * 1.25
       );
 
       data = data.slice(eirLength + 24);
@@ -1230,6 +1660,117 @@ Hci.prototype.processLeExtendedAdvertisingReport = function (numReports, data) {
   }
 };
 
+// Decodes every report of an LE (extended) advertising report event, AD
+// structures included, in one native call. The decoded advertisement is passed
+// on to Gap after the usual report arguments. Returns false when the event
+// could not be decoded and is left to the JS parser.
+Hci.prototype.processLeAdvertisingEvent = function (data) {
+  const reports = this._adDecoder.decodeAdvertisingEvent(data);
+
+  if (reports === null) {
+    return false;
+  }
+
+  for (const report of reports) {
+    const eir = data.slice(
+      report.eirOffset,
+      report.eirOffset + report.eirLength
+    );
+
+    if (report.txPower === undefined) {
+      this.emit(
+        'leAdvertisingReport',
+        0,
+        report.type,
+        report.address,
+        report.addressType,
+        eir,
+        report.rssi,
+        report.advertisement
+      );
+    } else {
+      // the SID and periodic advertising interval (1.25 ms units) sit 13 and
+      // 10 bytes before the data of an extended report
+      this.emit(
+        'leExtendedAdvertisingReport',
+        0,
+        report.type,
+        report.address,
+        report.addressType,
+        report.txPower,
+        report.rssi,
+        eir,
+        report.advertisement,
+        data.readUInt8(report.eirOffset - 13),
+        data.readUInt16LE(report.eirOffset - 10) * 1.25
+      );
+    }
+  }
+
+  if (reports.length < data.readUInt8(4)) {
+    console.warn(
+      'processLeAdvertisingEvent: Caught illegal packet (buffer overflow)'
+    );
+  }
+
+  return true;
+};
+
+Hci.prototype.processLePeriodicSyncEstablished = function (status, data) {
+  const handle = data.readUInt16LE(0);
+  const sid = data.readUInt8(2);
+  const addressType = data.readUInt8(3) === 0x01 ? 'random' : 'public';
+  const address = data
+    .slice(4, 10)
+    .toString('hex')
+    .match(/.{1,2}/g)
+    .reverse()
+    .join(':');
+  const interval = data.readUInt16LE(11) * 1.25;
+
+  debug(`\t\t\tstatus = ${status}`);
+  debug(`\t\t\tsync handle = ${handle}`);
+  debug(`\t\t\tSID = ${sid}`);
+  debug(`\t\t\taddress = ${address}`);
+  debug(`\t\t\tinterval = ${interval}`);
+
+  this.emit(
+    'lePeriodicSyncEstablished',
+    status,
+    handle,
+    sid,
+    address,
+    addressType,
+    interval
+  );
+};
+
+Hci.prototype.processLePeriodicAdvertisingReport = function (data) {
+  const handle = data.readUInt16LE(0);
+  const txPower = data.readInt8(2);
+  const rssi = data.readInt8(3);
+  // 0: complete, 1: more to come, 2: truncated, no more to come
+  const dataStatus = data.readUInt8(5);
+  const length = data.readUInt8(6);
+
+  this.emit(
+    'lePeriodicAdvertisingReport',
+    handle,
+    txPower,
+    rssi,
+    dataStatus,
+    data.slice(7, 7 + length)
+  );
+};
+
+Hci.prototype.processLePeriodicSyncLost = function (data) {
+  const handle = data.readUInt16LE(0);
+
+  debug(`\t\t\tsync handle = ${handle} lost`);
+
+  this.emit('lePeriodicSyncLost', handle);
+};
+
 Hci.prototype.processLeConnUpdateComplete = function (status, data) {
   const handle = data.readUInt16LE(0);
   const interval = data.readUInt16LE(2) * 1.25;
@@ -1251,11 +1792,47 @@ Hci.prototype.processLeConnUpdateComplete = function (status, data) {
   );
 };
 
+Hci.prototype.processLeDataLengthChange = function (data) {
+  const handle = data.readUInt16LE(0);
+  const txOctets = data.readUInt16LE(2);
+  const txTime = data.readUInt16LE(4);
+  const rxOctets = data.readUInt16LE(6);
+  const rxTime = data.readUInt16LE(8);
+
+  debug(`\t\t\thandle = ${handle}`);
+  debug(`\t\t\tmax tx octets = ${txOctets}, time = ${txTime}`);
+  debug(`\t\t\tmax rx octets = ${rxOctets}, time = ${rxTime}`);
+
+  const connection = this._aclConnections.get(handle);
+
+  if (connection) {
+    connection.txOctets = txOctets;
+    connection.rxOctets = rxOctets;
+  }
+
+  this.emit('leDataLengthChange', handle, txOctets, rxOctets);
+};
+
+Hci.prototype.processLePhyUpdateComplete = function (status, data) {
+  const handle = data.readUInt16LE(0);
+  const txPhy = data.readUInt8(2);
+  const rxPhy = data.readUInt8(3);
+
+  debug(`\t\t\thandle = ${handle}`);
+  debug(`\t\t\ttx phy = ${txPhy}, rx phy = ${rxPhy}`);
+
+  this.emit('lePhyUpdateComplete', status, handle, txPhy, rxPhy);
+};
+
 Hci.prototype.processCmdStatusEvent = function (cmd, status) {
   if (cmd === LE_CREATE_CONN_CMD || cmd === LE_CREATE_EXTENDED_CONN_CMD) {
     if (status !== 0) {
       this.emit('leConnComplete', status);
     }
+  } else if (cmd === LE_PERIODIC_ADVERTISING_CREATE_SYNC_CMD) {
+    if (status !== 0) {
+      this.emit('lePeriodicSyncEstablished', status);
+    }
   }
 };
 
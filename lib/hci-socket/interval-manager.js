@@ -0,0 +1,303 @@
+const debug = require('debug')('interval-manager');
+
+const events = require('events');
+const util = require('util');
+
+// connection intervals are multiples of 1.25 ms, 7.5 ms to 4 s
+const INTERVAL_UNIT = 1.25;
+const MIN_INTERVAL = 7.5;
+const MAX_INTERVAL = 4000;
+
+// a Connection Update procedure left unanswered this long is given up on
+const UPDATE_TIMEOUT = 5000;
+
+const toInterval = (ms) =>
+  Math.min(
+    Math.max(Math.ceil(ms / INTERVAL_UNIT) * INTERVAL_UNIT, MIN_INTERVAL),
+    MAX_INTERVAL
+  );
+
+/*
+ * Picks connection parameters from what each connection is doing, sampled
+ * every `sampleInterval` ms:
+ *
+ *   busy    requests outstanding (discovery, reads, long writes) or more than
+ *           `busyBytesPerSecond` of ATT traffic: the `fast` interval
+ *   steady  notifications only: an interval that carries about
+ *           `notificationsPerEvent` of them, within `steady`
+ *   idle    no traffic at all: the `idle` interval
+ *
+ * A connection goes fast as soon as it is busy and only relaxes after
+ * `relaxAfter` ms without being busy. Relaxed intervals are kept at
+ * `eventLength` ms per connection at least, so the controller can still fit
+ * every connection event in when many are up.
+ *
+ * Emits 'decision' (handle, decision) for every update asked for and
+ * 'update' (handle, status, interval, latency, supervisionTimeout) once the
+ * controller reports the parameters the link ended up with.
+ */
+const IntervalManager = function (hci, options) {
+  options = options || {};
+
+  this._hci = hci;
+
+  this._sampleInterval = options.sampleInterval || 250;
+  this._relaxAfter =
+    options.relaxAfter !== undefined ? options.relaxAfter : 2000;
+  this._busyBytesPerSecond = options.busyBytesPerSecond || 2000;
+  this._notificationsPerEvent = options.notificationsPerEvent || 4;
+  this._eventLength =
+    options.eventLength !== undefined ? options.eventLength : 2.5;
+  this._supervisionTimeout = options.supervisionTimeout || 420;
+
+  // in ms
+  this._fast = Object.assign(
+    { minInterval: 7.5, maxInterval: 15, latency: 0 },
+    options.fast
+  );
+  this._steady = Object.assign(
+    { minInterval: 30, maxInterval: 100 },
+    options.steady
+  );
+  this._idle = Object.assign(
+    { minInterval: 100, maxInterval: 125, latency: 0 },
+    options.idle
+  );
+
+  this._connections = new Map();
+  this._timer = null;
+};
+
+util.inherits(IntervalManager, events.EventEmitter);
+
+IntervalManager.prototype.addConnection = function (
+  handle,
+  aclStream,
+  gatt,
+  interval
+) {
+  const connection = {
+    handle,
+    aclStream,
+    gatt,
+    // what the link has now and what was last asked for
+    interval,
+    state: 'fast',
+    updating: null,
+    holdUntil: 0,
+    notifications: 0,
+    bytes: aclStream.txBytes + aclStream.rxBytes,
+    lastSample: Date.now(),
+    lastBusy: Date.now(),
+    onHandleNotify: () => connection.notifications++
+  };
+
+  gatt.on('handleNotify', connection.onHandleNotify);
+  this._connections.set(handle, connection);
+
+  if (this._timer === null) {
+    this._timer = setInterval(this.sample.bind(this), this._sampleInterval);
+    // the socket keeps the process alive while connected, the timer shouldn't
+    this._timer.unref();
+  }
+};
+
+IntervalManager.prototype.removeConnection = function (handle) {
+  const connection = this._connections.get(handle);
+
+  if (!connection) {
+    return;
+  }
+
+  connection.gatt.removeListener('handleNotify', connection.onHandleNotify);
+  this._connections.delete(handle);
+
+  if (this._connections.size === 0) {
+    clearInterval(this._timer);
+    this._timer = null;
+  }
+};
+
+IntervalManager.prototype.sample = function () {
+  const now = Date.now();
+
+  for (const connection of this._connections.values()) {
+    const elapsed = (now - connection.lastSample) / 1000;
+
+    if (elapsed <= 0) {
+      continue;
+    }
+
+    const bytes = connection.aclStream.txBytes + connection.aclStream.rxBytes;
+    const traffic = {
+      pendingRequests: connection.gatt.pendingRequests(),
+      bytesPerSecond: (bytes - connection.bytes) / elapsed,
+      notificationsPerSecond: connection.notifications / elapsed
+    };
+
+    connection.bytes = bytes;
+    connection.notifications = 0;
+    connection.lastSample = now;
+
+    this.decide(connection, traffic, now);
+  }
+};
+
+IntervalManager.prototype.decide = function (connection, traffic, now) {
+  let state;
+  let reason;
+  let params;
+
+  if (traffic.pendingRequests > 0) {
+    state = 'fast';
+    reason = 'requests';
+  } else if (traffic.bytesPerSecond >= this._busyBytesPerSecond) {
+    state = 'fast';
+    reason = 'throughput';
+  }
+
+  if (state === 'fast') {
+    connection.lastBusy = now;
+    params = this._fast;
+  } else if (now - connection.lastBusy < this._relaxAfter) {
+    return;
+  } else if (traffic.notificationsPerSecond > 0) {
+    state = 'steady';
+    reason = 'notifications';
+
+    const interval = this.relaxedInterval(
+      Math.min(
+        Math.max(
+          (this._notificationsPerEvent * 1000) /
+            traffic.notificationsPerSecond,
+          this._steady.minInterval
+        ),
+        this._steady.maxInterval
+      )
+    );
+
+    params = {
+      minInterval: interval,
+      maxInterval: toInterval(interval * 1.25),
+      latency: 0
+    };
+  } else {
+    state = 'idle';
+    reason = 'no traffic';
+
+    const interval = this.relaxedInterval(this._idle.minInterval);
+
+    params = {
+      minInterval: interval,
+      maxInterval: Math.max(toInterval(this._idle.maxInterval), interval),
+      latency: this._idle.latency
+    };
+  }
+
+  if (!this.shouldUpdate(connection, state, params, now)) {
+    return;
+  }
+
+  const decision = Object.assign(
+    {
+      state,
+      reason,
+      supervisionTimeout: this.supervisionTimeout(params)
+    },
+    params,
+    traffic
+  );
+
+  debug(
+    `handle ${connection.handle}: ${state} (${reason}), ` +
+      `${decision.minInterval} - ${decision.maxInterval} ms, latency ${decision.latency}`
+  );
+
+  connection.state = state;
+  connection.updating = now;
+
+  this.emit('decision', connection.handle, decision);
+
+  this._hci.connUpdateLe(
+    connection.handle,
+    decision.minInterval,
+    decision.maxInterval,
+    decision.latency,
+    decision.supervisionTimeout
+  );
+};
+
+// the controller needs room for every connection's events
+IntervalManager.prototype.relaxedInterval = function (interval) {
+  return toInterval(
+    Math.max(interval, this._connections.size * this._eventLength)
+  );
+};
+
+IntervalManager.prototype.shouldUpdate = function (
+  connection,
+  state,
+  params,
+  now
+) {
+  // one procedure at a time, the next sample asks again if still needed
+  if (
+    (connection.updating !== null &&
+      now - connection.updating < UPDATE_TIMEOUT) ||
+    now < connection.holdUntil
+  ) {
+    return false;
+  }
+
+  const within =
+    connection.interval >= params.minInterval &&
+    connection.interval <= params.maxInterval;
+
+  if (state !== connection.state) {
+    return !within;
+  }
+
+  // notification rates wander, only follow changes of more than a quarter
+  return (
+    !within &&
+    Math.abs(connection.interval - params.minInterval) >
+      connection.interval / 4
+  );
+};
+
+// more than (1 + latency) * maxInterval * 2, in units of 10 ms
+IntervalManager.prototype.supervisionTimeout = function (params) {
+  const least = (1 + params.latency) * params.maxInterval * 2;
+
+  return Math.max(
+    this._supervisionTimeout,
+    Math.floor(least / 10) * 10 + 10
+  );
+};
+
+IntervalManager.prototype.onConnectionUpdate = function (
+  status,
+  handle,
+  interval,
+  latency,
+  supervisionTimeout
+) {
+  const connection = this._connections.get(handle);
+
+  if (!connection) {
+    return;
+  }
+
+  connection.updating = null;
+
+  if (status === 0) {
+    connection.interval = interval;
+  } else {
+    debug(`handle ${handle}: update rejected (0x${status.toString(16)})`);
+    connection.holdUntil = Date.now() + this._relaxAfter;
+  }
+
+  this.emit('update', handle, status, interval, latency, supervisionTimeout);
+};
+
+module.exports = IntervalManager;
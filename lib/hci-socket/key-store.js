@@ -0,0 +1,186 @@
+const debug = require('debug')('key-store');
+
+const fs = require('fs');
+
+const crypto = require('./crypto');
+
+const MAGIC = Buffer.from('nbks', 'ascii');
+const VERSION = 1;
+
+const HEADER_SIZE = 5;
+// flags, address, key size, LTK, EDIV, Rand, IRK
+const RECORD_SIZE = 50;
+
+const FLAG_RANDOM = 0x01;
+const FLAG_IRK = 0x02;
+
+const addressToBuffer = (address) =>
+  Buffer.from(address.split(':').reverse().join(''), 'hex');
+
+const addressFromBuffer = (buffer) =>
+  Buffer.from(buffer).reverse().toString('hex').match(/.{1,2}/g).join(':');
+
+// random addresses with 0b01 in the two most significant bits
+const isResolvable = (address, addressType) =>
+  addressType === 'random' && (parseInt(address.slice(0, 2), 16) & 0xc0) === 0x40;
+
+const parse = function (buffer) {
+  const bonds = new Map();
+
+  if (
+    buffer.length < HEADER_SIZE ||
+    !buffer.slice(0, MAGIC.length).equals(MAGIC) ||
+    buffer.readUInt8(MAGIC.length) !== VERSION
+  ) {
+    debug('not a key store file, starting empty');
+    return bonds;
+  }
+
+  for (
+    let offset = HEADER_SIZE;
+    offset + RECORD_SIZE <= buffer.length;
+    offset += RECORD_SIZE
+  ) {
+    const flags = buffer.readUInt8(offset);
+    const address = addressFromBuffer(buffer.slice(offset + 1, offset + 7));
+
+    bonds.set(address, {
+      address,
+      addressType: flags & FLAG_RANDOM ? 'random' : 'public',
+      keySize: buffer.readUInt8(offset + 7),
+      ltk: Buffer.from(buffer.slice(offset + 8, offset + 24)),
+      ediv: Buffer.from(buffer.slice(offset + 24, offset + 26)),
+      rand: Buffer.from(buffer.slice(offset + 26, offset + 34)),
+      irk: flags & FLAG_IRK ? Buffer.from(buffer.slice(offset + 34, offset + 50)) : null
+    });
+  }
+
+  return bonds;
+};
+
+const serialize = function (bonds) {
+  const buffer = Buffer.alloc(HEADER_SIZE + bonds.size * RECORD_SIZE);
+
+  MAGIC.copy(buffer, 0);
+  buffer.writeUInt8(VERSION, MAGIC.length);
+
+  let offset = HEADER_SIZE;
+  for (const bond of bonds.values()) {
+    buffer.writeUInt8(
+      (bond.addressType === 'random' ? FLAG_RANDOM : 0) | (bond.irk ? FLAG_IRK : 0),
+      offset
+    );
+    addressToBuffer(bond.address).copy(buffer, offset + 1);
+    buffer.writeUInt8(bond.keySize, offset + 7);
+    bond.ltk.copy(buffer, offset + 8);
+    bond.ediv.copy(buffer, offset + 24);
+    bond.rand.copy(buffer, offset + 26);
+    if (bond.irk) {
+      bond.irk.copy(buffer, offset + 34);
+    }
+
+    offset += RECORD_SIZE;
+  }
+
+  return buffer;
+};
+
+/*
+ * The keys peripherals distributed when bonding, by identity address, so
+ * later connections can be encrypted with the LTK instead of pairing again.
+ * With a `path` they are kept in a file of 50 byte records, rewritten on every
+ * change; without one they only last as long as the process.
+ */
+const KeyStore = function (path) {
+  this._path = path || null;
+  this._bonds = new Map();
+
+  if (this._path && fs.existsSync(this._path)) {
+    this._bonds = parse(fs.readFileSync(this._path));
+  }
+};
+
+Object.defineProperty(KeyStore.prototype, 'size', {
+  get () {
+    return this._bonds.size;
+  }
+});
+
+// by identity address, or resolving a private address with the stored IRKs
+KeyStore.prototype.get = function (address, addressType) {
+  address = address.toLowerCase();
+
+  const bond = this._bonds.get(address);
+  if (bond || !isResolvable(address, addressType)) {
+    return bond || null;
+  }
+
+  const buffer = addressToBuffer(address);
+  const hash = buffer.slice(0, 3);
+  const prand = buffer.slice(3, 6);
+
+  for (const candidate of this._bonds.values()) {
+    if (candidate.irk && crypto.ah(candidate.irk, prand).equals(hash)) {
+      return candidate;
+    }
+  }
+
+  return null;
+};
+
+// keys: { ltk, ediv, rand, keySize, irk, address, addressType }, the identity
+// address when the peripheral distributed one
+KeyStore.prototype.set = function (address, addressType, keys) {
+  const bond = {
+    address: (keys.address || address).toLowerCase(),
+    addressType: keys.address ? keys.addressType : addressType,
+    keySize: keys.keySize || 16,
+    ltk: keys.ltk,
+    ediv: keys.ediv,
+    rand: keys.rand,
+    irk: keys.irk || null
+  };
+
+  // the peripheral may have been bonded under its private address before
+  const previous = this.get(address, addressType);
+  if (previous) {
+    this._bonds.delete(previous.address);
+  }
+
+  this._bonds.set(bond.address, bond);
+  this.save();
+
+  return bond;
+};
+
+KeyStore.prototype.delete = function (address, addressType) {
+  const bond = this.get(address, addressType);
+
+  if (bond) {
+    this._bonds.delete(bond.address);
+    this.save();
+  }
+
+  return bond !== null;
+};
+
+KeyStore.prototype.save = function () {
+  if (!this._path) {
+    return;
+  }
+
+  // written aside and renamed over, so a crash never leaves half a file
+  const tmp = `${this._path}.tmp`;
+
+  try {
+    fs.writeFileSync(tmp, serialize(this._bonds), { mode: 0o600 });
+    fs.renameSync(tmp, this._path);
+  } catch (error) {
+    debug(`write error: ${error.message}`);
+  }
+};
+
+KeyStore.parse = parse;
+KeyStore.serialize = serialize;
+
+module.exports = KeyStore;
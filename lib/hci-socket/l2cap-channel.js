@@ -0,0 +1,179 @@
+const debug = require('debug')('l2cap-channel');
+
+const stream = require('stream');
+const util = require('util');
+
+/*
+ * An LE credit based connection oriented channel (Core Spec Vol 3, Part A,
+ * 10.1), as a duplex stream: every chunk written is sent as one SDU (split at
+ * the peer's MTU) and every SDU received is read as one chunk.
+ *
+ * SDUs go out in K-frames of up to the peer's MPS, one credit each, and stop
+ * when the peer's credits run out until it grants more. Credits for the
+ * K-frames received are given back once half are used, and only while the
+ * reading side keeps up.
+ */
+const L2capChannel = function (signaling, aclStream, psm, local, remote) {
+  stream.Duplex.call(this);
+
+  this._signaling = signaling;
+  this._aclStream = aclStream;
+
+  this.psm = psm;
+  // { cid, mtu, mps, credits }
+  this.local = local;
+  this.remote = remote;
+
+  this._initialCredits = local.credits;
+  this._txQueue = [];
+  this._reassembly = null;
+  this._paused = false;
+  this._closing = false;
+  this._closed = false;
+
+  this.onAclStreamDataBinded = this.onAclStreamData.bind(this);
+  this.onAclStreamEndBinded = this.onAclStreamEnd.bind(this);
+
+  this._aclStream.on('data', this.onAclStreamDataBinded);
+  this._aclStream.on('end', this.onAclStreamEndBinded);
+};
+
+util.inherits(L2capChannel, stream.Duplex);
+
+L2capChannel.prototype._write = function (chunk, encoding, callback) {
+  // the peer takes SDUs of up to its MTU
+  for (let offset = 0; offset < chunk.length; offset += this.remote.mtu) {
+    const sdu = chunk.slice(offset, offset + this.remote.mtu);
+
+    // the first K-frame starts with the SDU length
+    const firstLength = Math.min(sdu.length, this.remote.mps - 2);
+    const first = Buffer.alloc(2 + firstLength);
+    first.writeUInt16LE(sdu.length, 0);
+    sdu.copy(first, 2, 0, firstLength);
+    this._txQueue.push({ frame: first });
+
+    for (let i = firstLength; i < sdu.length; i += this.remote.mps) {
+      this._txQueue.push({ frame: sdu.slice(i, i + this.remote.mps) });
+    }
+  }
+
+  // done once the last K-frame is with the controller
+  if (this._txQueue.length > 0) {
+    this._txQueue[this._txQueue.length - 1].callback = callback;
+  } else {
+    callback();
+  }
+
+  this._drain();
+};
+
+L2capChannel.prototype._drain = function () {
+  while (this._txQueue.length > 0 && this.remote.credits > 0) {
+    const { frame, callback } = this._txQueue.shift();
+
+    this.remote.credits--;
+    this._aclStream.write(this.remote.cid, frame, callback);
+  }
+
+  if (this._txQueue.length > 0) {
+    debug(`0x${this.local.cid.toString(16)}: out of credits`);
+  }
+};
+
+L2capChannel.prototype.addCredits = function (credits) {
+  this.remote.credits = Math.min(this.remote.credits + credits, 0xffff);
+
+  this._drain();
+};
+
+L2capChannel.prototype._read = function () {
+  if (this._paused) {
+    this._paused = false;
+    this._giveCredits();
+  }
+};
+
+L2capChannel.prototype.onAclStreamData = function (cid, data) {
+  if (cid !== this.local.cid) {
+    return;
+  }
+
+  this.local.credits--;
+
+  if (this._reassembly === null) {
+    this._reassembly = {
+      length: data.readUInt16LE(0),
+      data: [data.slice(2)],
+      received: data.length - 2
+    };
+  } else {
+    this._reassembly.data.push(data);
+    this._reassembly.received += data.length;
+  }
+
+  if (this._reassembly.received >= this._reassembly.length) {
+    const sdu = Buffer.concat(this._reassembly.data);
+
+    this._reassembly = null;
+
+    if (!this.push(sdu)) {
+      this._paused = true;
+    }
+  }
+
+  if (!this._paused) {
+    this._giveCredits();
+  }
+};
+
+L2capChannel.prototype._giveCredits = function () {
+  const used = this._initialCredits - this.local.credits;
+
+  if (used > 0 && used >= this._initialCredits / 2) {
+    this.local.credits += used;
+    this._signaling.sendFlowControlCredit(this.local.cid, used);
+  }
+};
+
+L2capChannel.prototype._final = function (callback) {
+  this.close();
+  callback();
+};
+
+L2capChannel.prototype.close = function () {
+  if (this._closing || this._closed) {
+    return;
+  }
+  this._closing = true;
+
+  this._signaling.disconnectChannel(this);
+};
+
+// the peer or the link closed the channel
+L2capChannel.prototype.onClose = function () {
+  if (this._closed) {
+    return;
+  }
+  this._closed = true;
+
+  this._aclStream.removeListener('data', this.onAclStreamDataBinded);
+  this._aclStream.removeListener('end', this.onAclStreamEndBinded);
+
+  // K-frames still waiting for credits are lost
+  const pending = this._txQueue;
+  this._txQueue = [];
+  for (const { callback } of pending) {
+    if (callback) {
+      callback(new Error('L2CAP channel closed'));
+    }
+  }
+
+  this.push(null);
+  this.end();
+};
+
+L2capChannel.prototype.onAclStreamEnd = function () {
+  this.onClose();
+};
+
+module.exports = L2capChannel;
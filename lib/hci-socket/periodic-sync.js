@@ -0,0 +1,288 @@
+const debug = require('debug')('periodic-sync');
+
+const events = require('events');
+const util = require('util');
+
+// Operation Cancelled by Host, what a cancelled Create Sync ends with
+const HCI_OPERATION_CANCELLED_BY_HOST = 0x44;
+
+// periodic advertising report data status (Vol 4 Part E 7.7.65.15)
+const DATA_COMPLETE = 0x00;
+const DATA_INCOMPLETE = 0x01;
+
+// Sync_Timeout bounds, in 10 ms units
+const MIN_SYNC_TIMEOUT = 0x000a;
+const MAX_SYNC_TIMEOUT = 0x4000;
+
+// devices with a train are forgotten when not heard for this long, the
+// longest first beyond the cap
+const ADVERTISER_TIMEOUT = 30000;
+const MAX_ADVERTISERS = 1024;
+
+/*
+ * Follows the periodic advertising trains of broadcasting devices, with no
+ * connection: the controller listens to each train on its own schedule and
+ * reports every event, so one adapter can follow far more devices than it
+ * could connect to.
+ *
+ * The SID and interval of a device's train come from its extended
+ * advertising reports, so it has to have been heard by an extended scan.
+ * Controllers take one LE Periodic Advertising Create Sync at a time, so
+ * syncs wait here and go out one after the other; each needs the scan to
+ * hear the device again before it is established. A Create Sync still
+ * pending after `establishTimeout` ms (10000, 0 for none) is cancelled. A
+ * sync is lost once the train hasn't been heard for `lostAfter` intervals
+ * (6), at least 100 ms.
+ *
+ * Data split over several reports is put back together, data the controller
+ * truncated is dropped. Emits 'established' (uuid, error, interval),
+ * 'report' (uuid, data, rssi, txPower) and 'lost' (uuid, reason), reason
+ * 'timeout' or 'terminated'.
+ */
+const PeriodicSync = function (hci, options) {
+  options = options || {};
+
+  this._hci = hci;
+
+  this._establishTimeout =
+    options.establishTimeout !== undefined ? options.establishTimeout : 10000;
+  this._lostAfter = options.lostAfter || 6;
+
+  // address -> { sid, interval, heardAt } of devices heard with a periodic
+  // train, the longest unheard first
+  this._advertisers = new Map();
+  this._queue = [];
+  this._current = null;
+  this._timer = null;
+  // sync handle -> { uuid, fragments }, and uuid -> sync handle
+  this._syncs = new Map();
+  this._handles = new Map();
+
+  this.stats = {
+    established: 0,
+    failed: 0,
+    reports: 0,
+    truncated: 0,
+    lost: 0
+  };
+};
+
+util.inherits(PeriodicSync, events.EventEmitter);
+
+PeriodicSync.prototype.onAdvertisingReport = function (address, sid, interval) {
+  if (!interval) {
+    return;
+  }
+
+  const now = Date.now();
+
+  this._advertisers.delete(address);
+  this._advertisers.set(address, { sid, interval, heardAt: now });
+  this.expireAdvertisers(now);
+};
+
+PeriodicSync.prototype.expireAdvertisers = function (now) {
+  for (const [address, advertiser] of this._advertisers) {
+    if (
+      now - advertiser.heardAt < ADVERTISER_TIMEOUT &&
+      this._advertisers.size <= MAX_ADVERTISERS
+    ) {
+      break;
+    }
+
+    this._advertisers.delete(address);
+  }
+};
+
+PeriodicSync.prototype.isSynced = function (uuid) {
+  return this._handles.has(uuid);
+};
+
+PeriodicSync.prototype.sync = function (uuid, address, addressType) {
+  this.expireAdvertisers(Date.now());
+  const advertiser = this._advertisers.get(address);
+
+  if (!advertiser) {
+    this.emit(
+      'established',
+      uuid,
+      new Error('No periodic advertising heard from this device')
+    );
+    return;
+  }
+
+  if (
+    this._handles.has(uuid) ||
+    (this._current && this._current.uuid === uuid) ||
+    this._queue.some((request) => request.uuid === uuid)
+  ) {
+    return;
+  }
+
+  this._queue.push({
+    uuid,
+    address,
+    addressType,
+    sid: advertiser.sid,
+    interval: advertiser.interval
+  });
+  this.next();
+};
+
+PeriodicSync.prototype.next = function () {
+  if (this._current || this._queue.length === 0) {
+    return;
+  }
+
+  const request = (this._current = this._queue.shift());
+  const timeout = Math.min(
+    Math.max(
+      Math.ceil((request.interval * this._lostAfter) / 10),
+      MIN_SYNC_TIMEOUT
+    ),
+    MAX_SYNC_TIMEOUT
+  );
+
+  debug(`${request.uuid}: create sync to SID ${request.sid}`);
+  this._hci.createPeriodicSync(
+    request.sid,
+    request.address,
+    request.addressType,
+    timeout
+  );
+
+  if (this._establishTimeout) {
+    this._timer = setTimeout(() => {
+      request.timedOut = true;
+      this._hci.cancelPeriodicSync();
+    }, this._establishTimeout);
+  }
+};
+
+// stops following a device, or trying to
+PeriodicSync.prototype.stop = function (uuid) {
+  const handle = this._handles.get(uuid);
+
+  if (handle !== undefined) {
+    this._hci.terminatePeriodicSync(handle);
+    this.forget(handle);
+    this.emit('lost', uuid, 'terminated');
+  } else if (this._current && this._current.uuid === uuid) {
+    this._hci.cancelPeriodicSync();
+  } else {
+    this._queue = this._queue.filter((request) => request.uuid !== uuid);
+  }
+};
+
+PeriodicSync.prototype.forget = function (handle) {
+  this._handles.delete(this._syncs.get(handle).uuid);
+  this._syncs.delete(handle);
+};
+
+PeriodicSync.prototype.onSyncEstablished = function (
+  status,
+  handle,
+  sid,
+  address
+) {
+  const request = this._current;
+
+  // a sync this host didn't ask for, or no longer waits for
+  if (!request || (address !== undefined && address !== request.address)) {
+    if (status === 0) {
+      this._hci.terminatePeriodicSync(handle);
+    }
+    return;
+  }
+
+  clearTimeout(this._timer);
+  this._timer = null;
+  this._current = null;
+
+  if (status === 0) {
+    this.stats.established++;
+    this._syncs.set(handle, { uuid: request.uuid, fragments: [] });
+    this._handles.set(request.uuid, handle);
+
+    this.emit('established', request.uuid, null, request.interval);
+  } else {
+    this.stats.failed++;
+
+    const message = request.timedOut
+      ? 'Periodic advertising sync timed out'
+      : status === HCI_OPERATION_CANCELLED_BY_HOST
+        ? 'Periodic advertising sync cancelled'
+        : `Periodic advertising sync failed (0x${status.toString(16)})`;
+    this.emit('established', request.uuid, new Error(message));
+  }
+
+  this.next();
+};
+
+PeriodicSync.prototype.onReport = function (
+  handle,
+  txPower,
+  rssi,
+  dataStatus,
+  data
+) {
+  const sync = this._syncs.get(handle);
+
+  if (!sync) {
+    return;
+  }
+
+  if (dataStatus === DATA_INCOMPLETE) {
+    sync.fragments.push(data);
+    return;
+  }
+
+  const fragments = sync.fragments;
+  sync.fragments = [];
+
+  if (dataStatus !== DATA_COMPLETE) {
+    this.stats.truncated++;
+    return;
+  }
+
+  this.stats.reports++;
+  this.emit(
+    'report',
+    sync.uuid,
+    fragments.length > 0 ? Buffer.concat(fragments.concat([data])) : data,
+    rssi,
+    txPower
+  );
+};
+
+PeriodicSync.prototype.onSyncLost = function (handle) {
+  const sync = this._syncs.get(handle);
+
+  if (sync) {
+    this.stats.lost++;
+    this.forget(handle);
+    this.emit('lost', sync.uuid, 'timeout');
+  }
+};
+
+// the controller forgets every sync when it is reset or powered off
+PeriodicSync.prototype.reset = function () {
+  const waiting = (this._current ? [this._current] : []).concat(this._queue);
+
+  clearTimeout(this._timer);
+  this._timer = null;
+  this._current = null;
+  this._queue = [];
+
+  for (const { uuid } of waiting) {
+    this.emit('established', uuid, new Error('Periodic advertising sync cancelled'));
+  }
+  for (const { uuid } of this._syncs.values()) {
+    this.emit('lost', uuid, 'timeout');
+  }
+  this._syncs.clear();
+  this._handles.clear();
+  this._advertisers.clear();
+};
+
+module.exports = PeriodicSync;
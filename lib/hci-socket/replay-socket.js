@@ -0,0 +1,124 @@
+const debug = require('debug')('replay-socket');
+
+const events = require('events');
+const util = require('util');
+
+const btsnoop = require('./btsnoop');
+
+// packets emitted per turn of the event loop when replaying at maximum speed
+const MAX_SPEED_BATCH = 64;
+
+/*
+ * A stand-in for BluetoothHciSocket that plays back the controller side of a
+ * btsnoop capture (see the btsnoopFile option of Hci):
+ *
+ *   const socket = new ReplaySocket('capture.btsnoop', { speed: 'max' });
+ *   const noble = new Noble(new NobleBindings({ socket, userChannel: true }));
+ *
+ * `speed` is 'original' (default) to keep the recorded inter-packet timing, a
+ * number to scale it (2 plays twice as fast) or 'max' to replay as fast as the
+ * stack consumes it. Packets written by the host are counted but not checked.
+ * 'end' is emitted after the last packet.
+ */
+const ReplaySocket = function (capture, options) {
+  options = options || {};
+
+  const records = Buffer.isBuffer(capture)
+    ? btsnoop.parse(capture)
+    : btsnoop.read(capture);
+
+  this._records = records.filter((record) => record.received);
+  this._speed = options.speed || 'original';
+  this._index = 0;
+  this._timer = null;
+  this._startTime = null;
+
+  this.stats = {
+    packets: 0,
+    writes: 0
+  };
+};
+
+util.inherits(ReplaySocket, events.EventEmitter);
+
+ReplaySocket.prototype.bindRaw = function (deviceId) {};
+
+ReplaySocket.prototype.bindUser = function (deviceId) {};
+
+ReplaySocket.prototype.isDevUp = function () {
+  return true;
+};
+
+ReplaySocket.prototype.setFilter = function (filter) {};
+
+ReplaySocket.prototype.start = function () {
+  if (this._timer !== null || this._index > 0) {
+    return;
+  }
+
+  debug(`replaying ${this._records.length} packets at ${this._speed} speed`);
+
+  this._startTime = process.hrtime.bigint();
+  this.schedule();
+};
+
+ReplaySocket.prototype.stop = function () {
+  clearTimeout(this._timer);
+  clearImmediate(this._timer);
+  this._timer = null;
+};
+
+ReplaySocket.prototype.write = function (data) {
+  this.stats.writes++;
+};
+
+ReplaySocket.prototype.schedule = function () {
+  if (this._index >= this._records.length) {
+    this._timer = null;
+    this.emit('end');
+    return;
+  }
+
+  if (this._speed === 'max') {
+    this._timer = setImmediate(this.replayBatch.bind(this));
+  } else {
+    this._timer = setTimeout(this.replayDue.bind(this), this.nextDelay());
+  }
+};
+
+ReplaySocket.prototype.replayBatch = function () {
+  const end = Math.min(this._index + MAX_SPEED_BATCH, this._records.length);
+
+  while (this._index < end) {
+    this.emitRecord(this._records[this._index++]);
+  }
+
+  this.schedule();
+};
+
+ReplaySocket.prototype.replayDue = function () {
+  while (this._index < this._records.length && this.nextDelay() <= 0) {
+    this.emitRecord(this._records[this._index++]);
+  }
+
+  this.schedule();
+};
+
+// ms until the next record is due, relative to when replay started
+ReplaySocket.prototype.nextDelay = function () {
+  const scale = typeof this._speed === 'number' ? this._speed : 1;
+  const offset =
+    (this._records[this._index].timestamp - this._records[0].timestamp) /
+    1000 /
+    scale;
+  const elapsed = Number(process.hrtime.bigint() - this._startTime) / 1e6;
+
+  return Math.max(offset - elapsed, 0);
+};
+
+ReplaySocket.prototype.emitRecord = function (record) {
+  this.stats.packets++;
+  this.emit('data', record.packet);
+};
+
+module.exports = ReplaySocket;
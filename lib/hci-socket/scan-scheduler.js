@@ -0,0 +1,221 @@
+const debug = require('debug')('scan-scheduler');
+
+// scan intervals, in units of 0.625 ms
+const AGGRESSIVE_INTERVAL = 0x0060; // 60 ms
+const BACKGROUND_INTERVAL = 0x0800; // 1.28 s
+
+// scan duty cycle given up to each connection's events, and the least left
+const CONNECTION_SHARE = 0.1;
+const MIN_AGGRESSIVE_DUTY = 0.5;
+
+const BACKGROUND_DUTY = 0.1;
+const BACKGROUND_BOOST_DUTY = 0.25;
+
+const POLICIES = ['continuous', 'aggressive', 'background', 'pausedWhenConnected'];
+
+const dutyCycle = (interval, duty) => ({
+  interval,
+  window: Math.max(4, Math.round(interval * duty))
+});
+
+/*
+ * Scan windows and connection events share the radio. This picks the scan
+ * interval and window for a scan the app started, by `policy`:
+ *
+ *   continuous           the controller default, scanning all the time
+ *   aggressive           60 ms intervals, all of each with nothing connected,
+ *                        10 % less for every connection down to half
+ *   background           10 % of 1.28 s, 25 % for `boostDuration` ms after a
+ *                        device shows up for the first time
+ *   pausedWhenConnected  aggressive with nothing connected, paused otherwise
+ *
+ * Except with continuous, scanning also pauses while a directed LE Create
+ * Connection is pending, and for `resumeDelay` ms after its LE Connection
+ * Complete, so the initiator and the first connection events of the link
+ * have the radio.
+ */
+const ScanScheduler = function (gap, options) {
+  options = options || {};
+
+  this._gap = gap;
+
+  this._resumeDelay =
+    options.resumeDelay !== undefined ? options.resumeDelay : 100;
+  this._boostDuration =
+    options.boostDuration !== undefined ? options.boostDuration : 5000;
+
+  this._connections = 0;
+  this._connecting = false;
+  this._resumeTimer = null;
+  this._boostUntil = 0;
+  this._boostTimer = null;
+  // devices discovered by a background scan, until it stops
+  this._seen = new Set();
+  // the parameters last given to Gap, null for its default
+  this._parameters = null;
+  this._paused = false;
+
+  this.stats = {
+    pauses: 0,
+    parameterChanges: 0
+  };
+
+  this.setPolicy(options.policy || 'continuous');
+};
+
+ScanScheduler.POLICIES = POLICIES;
+
+ScanScheduler.prototype.setPolicy = function (policy) {
+  if (!POLICIES.includes(policy)) {
+    throw new Error(`unknown scan policy ${policy}`);
+  }
+
+  debug(`policy ${policy}`);
+
+  this._policy = policy;
+  this.update();
+};
+
+Object.defineProperty(ScanScheduler.prototype, 'policy', {
+  get () {
+    return this._policy;
+  }
+});
+
+// the scan interval and window, null to pause
+ScanScheduler.prototype.parameters = function () {
+  const aggressive = () =>
+    dutyCycle(
+      AGGRESSIVE_INTERVAL,
+      Math.max(MIN_AGGRESSIVE_DUTY, 1 - this._connections * CONNECTION_SHARE)
+    );
+
+  switch (this._policy) {
+    case 'aggressive':
+      return aggressive();
+
+    case 'background':
+      return dutyCycle(
+        BACKGROUND_INTERVAL,
+        Date.now() < this._boostUntil ? BACKGROUND_BOOST_DUTY : BACKGROUND_DUTY
+      );
+
+    case 'pausedWhenConnected':
+      return this._connections > 0 ? null : aggressive();
+  }
+};
+
+ScanScheduler.prototype.update = function () {
+  if (this._policy === 'continuous') {
+    if (this._parameters !== null) {
+      // back to what Gap does on its own
+      this._parameters = null;
+      this._gap.setScanDutyCycle();
+    }
+    this.resume();
+    return;
+  }
+
+  const parameters = this._connecting ? null : this.parameters();
+
+  if (parameters === null) {
+    if (!this._paused && this._gap.isScanning()) {
+      debug('pausing');
+      this.stats.pauses++;
+      this._paused = true;
+      this._gap.pauseScanning();
+    }
+    return;
+  }
+
+  const current = this._parameters;
+  if (
+    current === null ||
+    current.interval !== parameters.interval ||
+    current.window !== parameters.window
+  ) {
+    debug(`interval ${parameters.interval}, window ${parameters.window}`);
+
+    this.stats.parameterChanges++;
+    this._parameters = parameters;
+    this._gap.setScanDutyCycle(parameters.interval, parameters.window);
+  }
+  this.resume();
+};
+
+ScanScheduler.prototype.resume = function () {
+  if (this._paused) {
+    debug('resuming');
+    this._paused = false;
+    this._gap.resumeScanning();
+  }
+};
+
+// a directed LE Create Connection went out
+ScanScheduler.prototype.onConnecting = function () {
+  clearTimeout(this._resumeTimer);
+  this._resumeTimer = null;
+
+  this._connecting = true;
+  this.update();
+};
+
+ScanScheduler.prototype.onConnComplete = function (status) {
+  if (status === 0) {
+    this._connections++;
+  }
+
+  if (this._connecting && this._resumeTimer === null) {
+    this._resumeTimer = setTimeout(() => {
+      this._resumeTimer = null;
+      this._connecting = false;
+      this.update();
+    }, this._resumeDelay);
+  }
+
+  this.update();
+};
+
+ScanScheduler.prototype.onDisconnect = function () {
+  this._connections = Math.max(0, this._connections - 1);
+  this.update();
+};
+
+// the app started scanning, paused if a connection is being set up
+ScanScheduler.prototype.onScanStart = function () {
+  this.update();
+};
+
+ScanScheduler.prototype.onScanStop = function () {
+  this._paused = false;
+  this._seen.clear();
+};
+
+ScanScheduler.prototype.onDiscover = function (address) {
+  if (this._policy !== 'background' || this._seen.has(address)) {
+    return;
+  }
+  this._seen.add(address);
+
+  const boosted = Date.now() < this._boostUntil;
+  this._boostUntil = Date.now() + this._boostDuration;
+
+  clearTimeout(this._boostTimer);
+  this._boostTimer = setTimeout(() => {
+    this._boostTimer = null;
+    this.update();
+  }, this._boostDuration);
+
+  if (!boosted) {
+    this.update();
+  }
+};
+
+ScanScheduler.prototype.stop = function () {
+  clearTimeout(this._resumeTimer);
+  clearTimeout(this._boostTimer);
+  this._resumeTimer = null;
+  this._boostTimer = null;
+};
+
+module.exports = ScanScheduler;
@@ -0,0 +1,483 @@
+const debug = require('debug')('sharded-bindings');
+
+const events = require('events');
+const util = require('util');
+
+const KeyStore = require('./key-store');
+const NobleBindings = require('./bindings');
+
+// how long an adapter's RSSI for a device counts, and the owner of a device's
+// discover events keeps them without reporting it, in ms
+const RSSI_MAX_AGE = 10000;
+const OWNER_TIMEOUT = 1000;
+
+// events about a peripheral passed on from whichever adapter it is on
+const PERIPHERAL_EVENTS = [
+  'rssiUpdate',
+  'servicesDiscover',
+  'servicesDiscovered',
+  'databaseDiscover',
+  'includedServicesDiscover',
+  'characteristicsDiscover',
+  'characteristicsDiscovered',
+  'read',
+  'readMultiple',
+  'write',
+  'broadcast',
+  'notify',
+  'descriptorsDiscover',
+  'valueRead',
+  'valueWrite',
+  'handleRead',
+  'handleWrite',
+  'handleNotify',
+  'l2capChannelOpen',
+  'onMtu',
+  'periodicSync',
+  'periodicAdvertisement',
+  'periodicSyncLost'
+];
+
+// calls taking the peripheral UUID first, sent to the adapter it is on
+const PERIPHERAL_METHODS = [
+  'disconnect',
+  'updateRssi',
+  'addService',
+  'discoverServices',
+  'discoverDatabase',
+  'discoverIncludedServices',
+  'addCharacteristics',
+  'discoverCharacteristics',
+  'read',
+  'write',
+  'broadcast',
+  'notify',
+  'discoverDescriptors',
+  'readValue',
+  'writeValue',
+  'readMultiple',
+  'readHandle',
+  'writeHandle',
+  'openL2capChannel'
+];
+
+const parseDeviceIds = (value) =>
+  value
+    .split(',')
+    .filter((id) => id.trim() !== '')
+    .map((id) => parseInt(id, 10));
+
+/*
+ * Several HCI adapters behind one set of bindings, for more connections than
+ * one controller takes. Every adapter scans, and their discover events are
+ * merged: one adapter owns each device's, the first to report it, until it
+ * hasn't for a second. Each connection goes to an adapter by `assignment`:
+ *
+ *   leastLoaded  the adapter with the fewest connections, pending or up,
+ *                the best recent RSSI between equals
+ *   rssi         the adapter that heard the device loudest lately
+ *
+ * preferring adapters that heard the device in the last 10 seconds and have
+ * fewer than `maxConnections`. Everything else about a peripheral goes to its
+ * adapter. The options are those of NobleBindings, given to every adapter
+ * with the ones in `adapters` on top, or `deviceIds` for just the HCI device
+ * IDs (NOBLE_HCI_DEVICE_IDS, comma separated). Adapters share a key store.
+ */
+const ShardedBindings = function (options) {
+  options = options || {};
+
+  let adapters = options.adapters;
+  if (!adapters) {
+    const deviceIds =
+      options.deviceIds || parseDeviceIds(process.env.NOBLE_HCI_DEVICE_IDS || '');
+    adapters = deviceIds.map((deviceId) => ({ deviceId }));
+  }
+  if (adapters.length === 0) {
+    throw new Error('no HCI adapters given');
+  }
+
+  this._assignment = options.assignment || 'leastLoaded';
+  if (this._assignment !== 'leastLoaded' && this._assignment !== 'rssi') {
+    throw new Error(`unknown adapter assignment ${this._assignment}`);
+  }
+  this._maxConnections = options.maxConnections || Infinity;
+
+  const shared = Object.assign({}, options);
+  delete shared.adapters;
+  delete shared.deviceIds;
+  if (shared.keyStore !== false && !(shared.keyStore instanceof KeyStore)) {
+    shared.keyStore = new KeyStore(
+      shared.keyStore || process.env.NOBLE_HCI_KEY_STORE
+    );
+  }
+
+  this.adapters = adapters.map(
+    (adapter) => new NobleBindings(Object.assign({}, shared, adapter))
+  );
+
+  this._states = this.adapters.map(() => null);
+  this._state = null;
+  this._scanning = new Set();
+  // the last startScanning arguments while the app scans, for adapters that
+  // power on later
+  this._scan = null;
+  this._scanParametersPending = 0;
+
+  // uuid -> adapter index, for pending and established connections and the
+  // peripherals adapters reconnect on their own
+  this._assigned = new Map();
+  this._connected = new Set();
+  this._reconnecting = new Set();
+  // uuid -> { owner, reportedAt, heardAt, rssi: [{ rssi, at }] by adapter },
+  // swept of devices not heard for RSSI_MAX_AGE once per RSSI_MAX_AGE
+  this._sightings = new Map();
+  this._sightingsSweptAt = Date.now();
+  // uuid -> adapter index following its periodic advertising
+  this._periodicSyncs = new Map();
+
+  this.adapters.forEach((adapter, index) => {
+    adapter.on('stateChange', (state) => this.onStateChange(index, state));
+    adapter.on('addressChange', (address) => {
+      if (index === 0) {
+        this.emit('addressChange', address);
+      }
+    });
+    adapter.on('scanParametersSet', () => this.onScanParametersSet());
+    adapter.on('scanStart', (filterDuplicates) =>
+      this.onScanStart(index, filterDuplicates)
+    );
+    adapter.on('scanStop', () => this.onScanStop(index));
+    adapter.on('discover', (...args) => this.onDiscover(index, ...args));
+    adapter.on('connect', (uuid, error) => this.onConnect(index, uuid, error));
+    adapter.on('disconnect', (uuid, reason) => this.onDisconnect(uuid, reason));
+
+    for (const event of PERIPHERAL_EVENTS) {
+      adapter.on(event, (...args) => this.emit(event, ...args));
+    }
+  });
+};
+
+util.inherits(ShardedBindings, events.EventEmitter);
+
+ShardedBindings.prototype.supportsScanFilter = true;
+
+ShardedBindings.prototype.init = function () {
+  for (const adapter of this.adapters) {
+    adapter.init();
+  }
+};
+
+ShardedBindings.prototype.reset = function () {
+  for (const adapter of this.adapters) {
+    adapter.reset();
+  }
+};
+
+ShardedBindings.prototype.setScanParameters = function (interval, window) {
+  this._scanParametersPending = this.adapters.length;
+
+  for (const adapter of this.adapters) {
+    adapter.setScanParameters(interval, window);
+  }
+};
+
+ShardedBindings.prototype.startScanning = function (...args) {
+  this._scan = args;
+
+  this.adapters.forEach((adapter, index) => {
+    if (this._states[index] === 'poweredOn') {
+      adapter.startScanning(...args);
+    }
+  });
+};
+
+ShardedBindings.prototype.stopScanning = function () {
+  this._scan = null;
+
+  this.adapters.forEach((adapter, index) => {
+    if (this._states[index] === 'poweredOn') {
+      adapter.stopScanning();
+    }
+  });
+};
+
+ShardedBindings.prototype.setScanPolicy = function (policy) {
+  for (const adapter of this.adapters) {
+    adapter.setScanPolicy(policy);
+  }
+};
+
+// the index of the adapter a peripheral is connected or connecting on
+ShardedBindings.prototype.adapterOf = function (peripheralUuid) {
+  const index = this._assigned.get(peripheralUuid);
+  return index !== undefined ? index : null;
+};
+
+ShardedBindings.prototype.load = function (index) {
+  let load = 0;
+  for (const assigned of this._assigned.values()) {
+    if (assigned === index) {
+      load++;
+    }
+  }
+  return load;
+};
+
+// the adapter's recent RSSI for the device, -Infinity if it hasn't heard it
+ShardedBindings.prototype.rssi = function (peripheralUuid, index) {
+  const sighting = this._sightings.get(peripheralUuid);
+  const entry = sighting && sighting.rssi[index];
+
+  return entry && Date.now() - entry.at < RSSI_MAX_AGE ? entry.rssi : -Infinity;
+};
+
+// only adapters that discovered the device know its address, however long ago
+ShardedBindings.prototype.assign = function (peripheralUuid) {
+  const candidates = this.adapters
+    .map((adapter, index) => ({
+      index,
+      load: this.load(index),
+      rssi: this.rssi(peripheralUuid, index),
+      poweredOn: this._states[index] === 'poweredOn',
+      known: adapter._addresses[peripheralUuid] !== undefined
+    }))
+    .filter((candidate) => candidate.poweredOn && candidate.known);
+
+  if (candidates.length === 0) {
+    return null;
+  }
+
+  const rank = (candidate) => [
+    candidate.load < this._maxConnections ? 0 : 1,
+    candidate.rssi !== -Infinity ? 0 : 1,
+    ...(this._assignment === 'rssi'
+      ? [-candidate.rssi, candidate.load]
+      : [candidate.load, -candidate.rssi]),
+    candidate.index
+  ];
+
+  candidates.sort((a, b) => {
+    const ra = rank(a);
+    const rb = rank(b);
+    const i = ra.findIndex((value, j) => value !== rb[j]);
+    return i === -1 ? 0 : ra[i] - rb[i];
+  });
+
+  const index = candidates[0].index;
+  debug(`${peripheralUuid} on adapter ${index}`);
+
+  this._assigned.set(peripheralUuid, index);
+  return this.adapters[index];
+};
+
+ShardedBindings.prototype.connect = function (peripheralUuid, parameters) {
+  const index = this._assigned.get(peripheralUuid);
+  const adapter =
+    index !== undefined ? this.adapters[index] : this.assign(peripheralUuid);
+
+  if (!adapter) {
+    this.emit(
+      'connect',
+      peripheralUuid,
+      new Error('Peripheral not discovered by any adapter')
+    );
+    return;
+  }
+
+  adapter.connect(peripheralUuid, parameters);
+};
+
+ShardedBindings.prototype.autoReconnect = function (peripheralUuid, parameters) {
+  const index = this._assigned.get(peripheralUuid);
+  const adapter =
+    index !== undefined ? this.adapters[index] : this.assign(peripheralUuid);
+
+  if (!adapter) {
+    this.emit(
+      'connect',
+      peripheralUuid,
+      new Error('Peripheral not discovered by any adapter')
+    );
+    return;
+  }
+
+  this._reconnecting.add(peripheralUuid);
+  adapter.autoReconnect(peripheralUuid, parameters);
+};
+
+ShardedBindings.prototype.stopAutoReconnect = function (peripheralUuid) {
+  const index = this._assigned.get(peripheralUuid);
+
+  if (this._reconnecting.delete(peripheralUuid) && index !== undefined) {
+    this.adapters[index].stopAutoReconnect(peripheralUuid);
+
+    if (!this._connected.has(peripheralUuid)) {
+      this._assigned.delete(peripheralUuid);
+    }
+  }
+};
+
+// followed by the adapter that owns the device's discover events
+ShardedBindings.prototype.syncPeriodicAdvertising = function (peripheralUuid) {
+  const sighting = this._sightings.get(peripheralUuid);
+  const index = sighting ? sighting.owner : 0;
+
+  this._periodicSyncs.set(peripheralUuid, index);
+  this.adapters[index].syncPeriodicAdvertising(peripheralUuid);
+};
+
+ShardedBindings.prototype.stopPeriodicSync = function (peripheralUuid) {
+  const index = this._periodicSyncs.get(peripheralUuid);
+
+  if (index !== undefined) {
+    this._periodicSyncs.delete(peripheralUuid);
+    this.adapters[index].stopPeriodicSync(peripheralUuid);
+  }
+};
+
+ShardedBindings.prototype.cancelConnect = function (peripheralUuid) {
+  const index = this._assigned.get(peripheralUuid);
+
+  if (index !== undefined) {
+    this.adapters[index].cancelConnect(peripheralUuid);
+
+    if (
+      !this._connected.has(peripheralUuid) &&
+      !this._reconnecting.has(peripheralUuid)
+    ) {
+      this._assigned.delete(peripheralUuid);
+    }
+  }
+};
+
+for (const method of PERIPHERAL_METHODS) {
+  ShardedBindings.prototype[method] = function (peripheralUuid, ...args) {
+    const index = this._assigned.get(peripheralUuid);
+
+    if (index === undefined) {
+      console.warn(`noble warning: unknown peripheral ${peripheralUuid}`);
+      return;
+    }
+
+    this.adapters[index][method](peripheralUuid, ...args);
+  };
+}
+
+// poweredOn while any adapter is
+ShardedBindings.prototype.onStateChange = function (index, state) {
+  this._states[index] = state;
+
+  if (state === 'poweredOn' && this._scan) {
+    this.adapters[index].startScanning(...this._scan);
+  } else if (state !== 'poweredOn') {
+    this.onScanStop(index);
+  }
+
+  const merged = this._states.includes('poweredOn')
+    ? 'poweredOn'
+    : this._states.find((state) => state !== null) || null;
+
+  if (merged !== this._state) {
+    this._state = merged;
+    this.emit('stateChange', merged);
+  }
+};
+
+ShardedBindings.prototype.onScanParametersSet = function () {
+  if (--this._scanParametersPending <= 0) {
+    this._scanParametersPending = 0;
+    this.emit('scanParametersSet');
+  }
+};
+
+ShardedBindings.prototype.onScanStart = function (index, filterDuplicates) {
+  const first = this._scanning.size === 0;
+  this._scanning.add(index);
+
+  if (first) {
+    this.emit('scanStart', filterDuplicates);
+  }
+};
+
+ShardedBindings.prototype.onScanStop = function (index) {
+  if (this._scanning.delete(index) && this._scanning.size === 0) {
+    this.emit('scanStop');
+  }
+};
+
+ShardedBindings.prototype.onDiscover = function (
+  index,
+  uuid,
+  address,
+  addressType,
+  connectable,
+  advertisement,
+  rssi,
+  scannable
+) {
+  const now = Date.now();
+
+  if (now - this._sightingsSweptAt >= RSSI_MAX_AGE) {
+    this.sweepSightings(now);
+  }
+
+  let sighting = this._sightings.get(uuid);
+  if (!sighting) {
+    sighting = { owner: index, reportedAt: now, heardAt: now, rssi: [] };
+    this._sightings.set(uuid, sighting);
+  }
+  sighting.heardAt = now;
+  sighting.rssi[index] = { rssi, at: now };
+
+  if (sighting.owner !== index) {
+    if (now - sighting.reportedAt < OWNER_TIMEOUT) {
+      return;
+    }
+    sighting.owner = index;
+  }
+  sighting.reportedAt = now;
+
+  this.emit(
+    'discover',
+    uuid,
+    address,
+    addressType,
+    connectable,
+    advertisement,
+    rssi,
+    scannable
+  );
+};
+
+// forgets devices no adapter has heard for RSSI_MAX_AGE, unless assigned
+ShardedBindings.prototype.sweepSightings = function (now) {
+  this._sightingsSweptAt = now;
+
+  for (const [uuid, sighting] of this._sightings) {
+    if (now - sighting.heardAt >= RSSI_MAX_AGE && !this._assigned.has(uuid)) {
+      this._sightings.delete(uuid);
+    }
+  }
+};
+
+ShardedBindings.prototype.onConnect = function (index, uuid, error) {
+  if (!error) {
+    this._assigned.set(uuid, index);
+    this._connected.add(uuid);
+  } else if (!this._reconnecting.has(uuid)) {
+    this._assigned.delete(uuid);
+  }
+
+  this.emit('connect', uuid, error);
+};
+
+ShardedBindings.prototype.onDisconnect = function (uuid, reason) {
+  this._connected.delete(uuid);
+  if (!this._reconnecting.has(uuid)) {
+    this._assigned.delete(uuid);
+  }
+
+  this.emit('disconnect', uuid, reason);
+};
+
+module.exports = ShardedBindings;
@@ -4,15 +4,69 @@ const events = require('events');
 const os = require('os');
 const util = require('util');
 
+const L2capChannel = require('./l2cap-channel');
+
+const COMMAND_REJECT = 0x01;
+const DISCONNECTION_REQUEST = 0x06;
+const DISCONNECTION_RESPONSE = 0x07;
 const CONNECTION_PARAMETER_UPDATE_REQUEST = 0x12;
 const CONNECTION_PARAMETER_UPDATE_RESPONSE = 0x13;
+const LE_CREDIT_BASED_CONNECTION_REQUEST = 0x14;
+const LE_CREDIT_BASED_CONNECTION_RESPONSE = 0x15;
+const FLOW_CONTROL_CREDIT_IND = 0x16;
+const CREDIT_BASED_CONNECTION_REQUEST = 0x17;
+const CREDIT_BASED_CONNECTION_RESPONSE = 0x18;
 
 const SIGNALING_CID = 0x0005;
 
+// dynamically allocated CIDs on LE (Vol 3, Part A, 2.1)
+const LE_DYNAMIC_CID_FIRST = 0x0040;
+const LE_DYNAMIC_CID_LAST = 0x007f;
+
+// LE Credit Based and Credit Based Connection Response results (Vol 3,
+// Part A, 4.23 and 4.26)
+const CREDIT_BASED_CONNECTION_RESULTS = {
+  0x0002: 'LE_PSM not supported',
+  0x0004: 'No resources available',
+  0x0005: 'Insufficient authentication',
+  0x0006: 'Insufficient authorization',
+  0x0007: 'Encryption key size too short',
+  0x0008: 'Insufficient encryption',
+  0x0009: 'Invalid Source CID',
+  0x000a: 'Source CID already allocated',
+  0x000b: 'Unacceptable parameters',
+  0x000c: 'Invalid parameters'
+};
+
+const connectionError = (result) => {
+  const error = new Error(
+    `${CREDIT_BASED_CONNECTION_RESULTS[result] || 'Unknown result'} (0x${result.toString(16)})`
+  );
+  error.result = result;
+  return error;
+};
+
+// a Credit Based Connection Request opens up to 5 channels, all with an MTU
+// and MPS of at least 64 (Vol 3, Part A, 4.25)
+const ENHANCED_MAX_CHANNELS = 5;
+const ENHANCED_MIN_MTU = 64;
+
+// what this side of a channel takes unless told otherwise: SDUs of up to
+// 2048 bytes in K-frames that fit a 251 byte link layer PDU
+const L2CAP_DEFAULT_MTU = 2048;
+const L2CAP_DEFAULT_MPS = 247;
+const L2CAP_DEFAULT_CREDITS = 10;
+
 const Signaling = function (handle, aclStream) {
   this._handle = handle;
   this._aclStream = aclStream;
 
+  this._identifier = 0;
+  // identifier -> callback (code, data) of the requests sent
+  this._requests = new Map();
+  // local CID -> L2capChannel, null while being opened
+  this._channels = new Map();
+
   this.onAclStreamDataBinded = this.onAclStreamData.bind(this);
   this.onAclStreamEndBinded = this.onAclStreamEnd.bind(this);
 
@@ -40,12 +94,253 @@ Signaling.prototype.onAclStreamData = function (cid, data) {
 
   if (code === CONNECTION_PARAMETER_UPDATE_REQUEST) {
     this.processConnectionParameterUpdateRequest(identifier, signalingData);
+  } else if (code === FLOW_CONTROL_CREDIT_IND) {
+    this.processFlowControlCredit(signalingData);
+  } else if (code === DISCONNECTION_REQUEST) {
+    this.processDisconnectionRequest(identifier, signalingData);
+  } else if (
+    code === COMMAND_REJECT ||
+    code === DISCONNECTION_RESPONSE ||
+    code === LE_CREDIT_BASED_CONNECTION_RESPONSE ||
+    code === CREDIT_BASED_CONNECTION_RESPONSE
+  ) {
+    const callback = this._requests.get(identifier);
+
+    if (callback) {
+      this._requests.delete(identifier);
+      callback(code, signalingData);
+    }
   }
 };
 
 Signaling.prototype.onAclStreamEnd = function () {
   this._aclStream.removeListener('data', this.onAclStreamDataBinded);
   this._aclStream.removeListener('end', this.onAclStreamEndBinded);
+
+  // the channels hear of it from the ACL stream themselves
+  this._requests.clear();
+  this._channels.clear();
+};
+
+Signaling.prototype.writeCommand = function (code, identifier, data) {
+  const command = Buffer.alloc(4 + data.length);
+
+  command.writeUInt8(code, 0);
+  command.writeUInt8(identifier, 1);
+  command.writeUInt16LE(data.length, 2);
+  data.copy(command, 4);
+
+  this._aclStream.write(SIGNALING_CID, command);
+};
+
+// identifiers 1 to 255, 0 is invalid
+Signaling.prototype.sendRequest = function (code, data, callback) {
+  this._identifier = (this._identifier % 0xff) + 1;
+
+  if (callback) {
+    this._requests.set(this._identifier, callback);
+  }
+
+  this.writeCommand(code, this._identifier, data);
+};
+
+Signaling.prototype.allocateCid = function () {
+  for (let cid = LE_DYNAMIC_CID_FIRST; cid <= LE_DYNAMIC_CID_LAST; cid++) {
+    if (!this._channels.has(cid)) {
+      return cid;
+    }
+  }
+
+  return null;
+};
+
+Signaling.prototype.openChannel = function (psm, options) {
+  options = options || {};
+
+  const cid = this.allocateCid();
+
+  if (cid === null) {
+    this.emit('channelOpen', this._handle, psm, new Error('No free CID'), null);
+    return;
+  }
+
+  const local = {
+    cid,
+    mtu: options.mtu || L2CAP_DEFAULT_MTU,
+    mps: options.mps || L2CAP_DEFAULT_MPS,
+    credits: options.credits || L2CAP_DEFAULT_CREDITS
+  };
+  const request = Buffer.alloc(10);
+
+  request.writeUInt16LE(psm, 0);
+  request.writeUInt16LE(local.cid, 2);
+  request.writeUInt16LE(local.mtu, 4);
+  request.writeUInt16LE(local.mps, 6);
+  request.writeUInt16LE(local.credits, 8);
+
+  debug(`open channel: psm 0x${psm.toString(16)}, cid 0x${cid.toString(16)}`);
+
+  this._channels.set(cid, null);
+
+  this.sendRequest(LE_CREDIT_BASED_CONNECTION_REQUEST, request, (code, data) => {
+    let error = null;
+
+    if (code !== LE_CREDIT_BASED_CONNECTION_RESPONSE) {
+      error = new Error('Command rejected');
+    } else if (data.readUInt16LE(8) !== 0x0000) {
+      error = connectionError(data.readUInt16LE(8));
+    }
+
+    if (error) {
+      this._channels.delete(cid);
+      this.emit('channelOpen', this._handle, psm, error, null);
+      return;
+    }
+
+    const remote = {
+      cid: data.readUInt16LE(0),
+      mtu: data.readUInt16LE(2),
+      mps: data.readUInt16LE(4),
+      credits: data.readUInt16LE(6)
+    };
+
+    debug(`\t\tremote cid = 0x${remote.cid.toString(16)}, mtu = ${remote.mtu}, mps = ${remote.mps}, credits = ${remote.credits}`);
+
+    const channel = new L2capChannel(this, this._aclStream, psm, local, remote);
+
+    this._channels.set(cid, channel);
+    this.emit('channelOpen', this._handle, psm, null, channel);
+  });
+};
+
+// Opens up to count channels in the enhanced credit based flow control mode
+// in one request, the way Enhanced ATT bearers are opened. callback (error,
+// channels) gets those the peer accepted, the error only when it took none.
+Signaling.prototype.openEnhancedChannels = function (psm, count, options, callback) {
+  options = options || {};
+
+  const cids = [];
+
+  while (cids.length < Math.min(count, ENHANCED_MAX_CHANNELS)) {
+    const cid = this.allocateCid();
+
+    if (cid === null) {
+      break;
+    }
+    this._channels.set(cid, null);
+    cids.push(cid);
+  }
+
+  if (cids.length === 0) {
+    callback(new Error('No free CID'), []);
+    return;
+  }
+
+  const mtu = Math.max(options.mtu || L2CAP_DEFAULT_MTU, ENHANCED_MIN_MTU);
+  const mps = Math.max(options.mps || L2CAP_DEFAULT_MPS, ENHANCED_MIN_MTU);
+  const credits = options.credits || L2CAP_DEFAULT_CREDITS;
+  const request = Buffer.alloc(8 + cids.length * 2);
+
+  request.writeUInt16LE(psm, 0);
+  request.writeUInt16LE(mtu, 2);
+  request.writeUInt16LE(mps, 4);
+  request.writeUInt16LE(credits, 6);
+  cids.forEach((cid, i) => request.writeUInt16LE(cid, 8 + i * 2));
+
+  debug(`open ${cids.length} enhanced channels: psm 0x${psm.toString(16)}`);
+
+  this.sendRequest(CREDIT_BASED_CONNECTION_REQUEST, request, (code, data) => {
+    if (code !== CREDIT_BASED_CONNECTION_RESPONSE) {
+      cids.forEach((cid) => this._channels.delete(cid));
+      callback(new Error('Command rejected'), []);
+      return;
+    }
+
+    const remoteMtu = data.readUInt16LE(0);
+    const remoteMps = data.readUInt16LE(2);
+    const remoteCredits = data.readUInt16LE(4);
+    const result = data.readUInt16LE(6);
+    const channels = [];
+
+    debug(`\t\tremote mtu = ${remoteMtu}, mps = ${remoteMps}, credits = ${remoteCredits}, result = 0x${result.toString(16)}`);
+
+    cids.forEach((cid, i) => {
+      // a destination CID of 0 refuses that one
+      const remoteCid = data.length >= 10 + i * 2 ? data.readUInt16LE(8 + i * 2) : 0x0000;
+
+      if (remoteCid === 0x0000) {
+        this._channels.delete(cid);
+        return;
+      }
+
+      const channel = new L2capChannel(
+        this,
+        this._aclStream,
+        psm,
+        { cid, mtu, mps, credits },
+        { cid: remoteCid, mtu: remoteMtu, mps: remoteMps, credits: remoteCredits }
+      );
+
+      this._channels.set(cid, channel);
+      channels.push(channel);
+    });
+
+    callback(channels.length === 0 ? connectionError(result) : null, channels);
+  });
+};
+
+Signaling.prototype.sendFlowControlCredit = function (cid, credits) {
+  const ind = Buffer.alloc(4);
+
+  ind.writeUInt16LE(cid, 0);
+  ind.writeUInt16LE(credits, 2);
+
+  this.sendRequest(FLOW_CONTROL_CREDIT_IND, ind);
+};
+
+// the CID is the sender's, the remote end of one of ours
+Signaling.prototype.processFlowControlCredit = function (data) {
+  const cid = data.readUInt16LE(0);
+  const credits = data.readUInt16LE(2);
+
+  for (const channel of this._channels.values()) {
+    if (channel && channel.remote.cid === cid) {
+      channel.addCredits(credits);
+      return;
+    }
+  }
+};
+
+Signaling.prototype.disconnectChannel = function (channel) {
+  const request = Buffer.alloc(4);
+
+  request.writeUInt16LE(channel.remote.cid, 0); // destination CID
+  request.writeUInt16LE(channel.local.cid, 2); // source CID
+
+  this.sendRequest(DISCONNECTION_REQUEST, request, () => {
+    this._channels.delete(channel.local.cid);
+    channel.onClose();
+  });
+};
+
+Signaling.prototype.processDisconnectionRequest = function (identifier, data) {
+  const cid = data.readUInt16LE(0); // destination, ours
+  const channel = this._channels.get(cid);
+
+  if (!channel) {
+    // reason 0x0002: invalid CID in request, then the CIDs
+    const reject = Buffer.alloc(6);
+    reject.writeUInt16LE(0x0002, 0);
+    data.copy(reject, 2, 0, 4);
+
+    this.writeCommand(COMMAND_REJECT, identifier, reject);
+    return;
+  }
+
+  this.writeCommand(DISCONNECTION_RESPONSE, identifier, data.slice(0, 4));
+
+  this._channels.delete(cid);
+  channel.onClose();
 };
 
 Signaling.prototype.processConnectionParameterUpdateRequest = function (identifier, data) {
@@ -12,6 +12,12 @@ const SMP_PAIRING_RANDOM = 0x04;
 const SMP_PAIRING_FAILED = 0x05;
 const SMP_ENCRYPT_INFO = 0x06;
 const SMP_MASTER_IDENT = 0x07;
+const SMP_IDENTITY_INFO = 0x08;
+const SMP_IDENTITY_ADDR_INFO = 0x09;
+const SMP_SECURITY_REQUEST = 0x0b;
+
+const SMP_DIST_ENC_KEY = 0x01;
+const SMP_DIST_ID_KEY = 0x02;
 
 const Smp = function (aclStream, localAddressType, localAddress, remoteAddressType, remoteAddress) {
   this._aclStream = aclStream;
@@ -38,7 +44,7 @@ Smp.prototype.sendPairingRequest = function () {
     0x01, // Authentication requirement: Bonding - No MITM
     0x10, // Max encryption key size
     0x00, // Initiator key distribution: <none>
-    0x01 // Responder key distribution: EncKey
+    SMP_DIST_ENC_KEY | SMP_DIST_ID_KEY // Responder key distribution: EncKey, IdKey
   ]);
 
   this.write(this._preq);
@@ -63,6 +69,12 @@ Smp.prototype.onAclStreamData = function (cid, data) {
     this.handleEncryptInfo(data);
   } else if (SMP_MASTER_IDENT === code) {
     this.handleMasterIdent(data);
+  } else if (SMP_IDENTITY_INFO === code) {
+    this.handleIdentityInfo(data);
+  } else if (SMP_IDENTITY_ADDR_INFO === code) {
+    this.handleIdentityAddrInfo(data);
+  } else if (SMP_SECURITY_REQUEST === code) {
+    this.emit('securityRequest');
   }
 };
 
@@ -76,6 +88,12 @@ Smp.prototype.onAclStreamEnd = function () {
 Smp.prototype.handlePairingResponse = function (data) {
   this._pres = data;
 
+  // what the responder distributes once the link is encrypted with the STK
+  this._keys = {
+    keySize: Math.min(this._preq[4], data[4])
+  };
+  this._pendingKeys = this._preq[6] & data[6];
+
   this._tk = Buffer.from('00000000000000000000000000000000', 'hex');
   this._r = crypto.r();
 
@@ -123,6 +141,10 @@ Smp.prototype.handlePairingFailed = function (data) {
 Smp.prototype.handleEncryptInfo = function (data) {
   const ltk = data.slice(1);
 
+  if (this._keys) {
+    this._keys.ltk = ltk;
+  }
+
   this.emit('ltk', ltk);
 };
 
@@ -130,9 +152,47 @@ Smp.prototype.handleMasterIdent = function (data) {
   const ediv = data.slice(1, 3);
   const rand = data.slice(3);
 
+  if (this._keys) {
+    this._keys.ediv = ediv;
+    this._keys.rand = rand;
+    this.keyReceived(SMP_DIST_ENC_KEY);
+  }
+
   this.emit('masterIdent', ediv, rand);
 };
 
+Smp.prototype.handleIdentityInfo = function (data) {
+  if (this._keys) {
+    this._keys.irk = data.slice(1);
+  }
+};
+
+Smp.prototype.handleIdentityAddrInfo = function (data) {
+  if (this._keys) {
+    this._keys.addressType = data.readUInt8(1) === 0x01 ? 'random' : 'public';
+    this._keys.address = Buffer.from(data.slice(2, 8))
+      .reverse()
+      .toString('hex')
+      .match(/.{1,2}/g)
+      .join(':');
+    this.keyReceived(SMP_DIST_ID_KEY);
+  }
+};
+
+// the keys are only worth keeping once all of them have arrived
+Smp.prototype.keyReceived = function (key) {
+  this._pendingKeys &= ~key;
+
+  if (this._pendingKeys === 0) {
+    const keys = this._keys;
+    this._keys = null;
+
+    if (keys.ltk) {
+      this.emit('keys', keys);
+    }
+  }
+};
+
 Smp.prototype.write = function (data) {
   this._aclStream.write(SMP_CID, data);
 };
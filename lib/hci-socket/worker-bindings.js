@@ -0,0 +1,196 @@
+const debug = require('debug')('worker-bindings');
+
+const events = require('events');
+const path = require('path');
+const util = require('util');
+const { Worker } = require('worker_threads');
+
+const EventRing = require('./event-ring');
+
+// everything the bindings emit for Noble
+const EVENTS = [
+  'stateChange',
+  'addressChange',
+  'scanParametersSet',
+  'scanStart',
+  'scanStop',
+  'discover',
+  'connect',
+  'disconnect',
+  'rssiUpdate',
+  'servicesDiscover',
+  'servicesDiscovered',
+  'databaseDiscover',
+  'includedServicesDiscover',
+  'characteristicsDiscover',
+  'characteristicsDiscovered',
+  'read',
+  'readMultiple',
+  'write',
+  'broadcast',
+  'notify',
+  'descriptorsDiscover',
+  'valueRead',
+  'valueWrite',
+  'handleRead',
+  'handleWrite',
+  'handleNotify',
+  'onMtu',
+  'periodicSync',
+  'periodicAdvertisement',
+  'periodicSyncLost'
+];
+
+// calls passed on to the bindings in the worker, all answered by events
+const METHODS = [
+  'setScanParameters',
+  'startScanning',
+  'stopScanning',
+  'setScanPolicy',
+  'connect',
+  'autoReconnect',
+  'stopAutoReconnect',
+  'disconnect',
+  'cancelConnect',
+  'reset',
+  'updateRssi',
+  'addService',
+  'discoverServices',
+  'discoverDatabase',
+  'discoverIncludedServices',
+  'addCharacteristics',
+  'discoverCharacteristics',
+  'read',
+  'write',
+  'broadcast',
+  'notify',
+  'discoverDescriptors',
+  'readValue',
+  'writeValue',
+  'readMultiple',
+  'readHandle',
+  'writeHandle',
+  'syncPeriodicAdvertising',
+  'stopPeriodicSync'
+];
+
+/*
+ * The hci-socket bindings (HCI, GAP, GATT, SMP) run in a worker thread, so a
+ * busy main thread doesn't hold up the HCI socket: the worker keeps reading
+ * it, answering the controller and the peripherals, and queues the events for
+ * Noble. Events and their payloads come through a SharedArrayBuffer ring of
+ * `ringSize` bytes (1 MB) the main thread drains whenever it gets to it, with
+ * no message per event. Calls go the other way through a smaller ring.
+ *
+ * The options are those of NobleBindings, or ShardedBindings with `adapters`,
+ * `deviceIds` or NOBLE_HCI_DEVICE_IDS, and have to survive being copied to
+ * the worker: instead of a `socket`, `socketModule` names a module exporting
+ * a socket class that is constructed with `socketOptions` in the worker.
+ * L2CAP channels and the connection and scan schedulers' metrics stay in the
+ * worker.
+ */
+const WorkerBindings = function (options) {
+  options = Object.assign({}, options);
+  delete options.worker;
+
+  this._ring = EventRing.create(options.ringSize || 1 << 20);
+  this._calls = EventRing.create(1 << 16);
+
+  this._worker = new Worker(path.join(__dirname, 'worker.js'), {
+    workerData: {
+      ring: this._ring.buffer,
+      calls: this._calls.buffer,
+      options
+    }
+  });
+  // the ring's doorbell, rung when Atomics.waitAsync is missing
+  this._worker.on('message', () => this._ring.onDoorbell());
+  this._worker.on('error', this.onWorkerError.bind(this));
+  this._worker.on('exit', this.onWorkerExit.bind(this));
+
+  this._stopped = false;
+  this._exited = false;
+  this.listen();
+};
+
+util.inherits(WorkerBindings, events.EventEmitter);
+
+WorkerBindings.EVENTS = EVENTS;
+
+// Gap in the worker applies scan filters
+WorkerBindings.prototype.supportsScanFilter = true;
+
+WorkerBindings.prototype.call = function (method, args) {
+  this._calls.send(method, args);
+  this._worker.postMessage(null);
+};
+
+for (const method of METHODS) {
+  WorkerBindings.prototype[method] = function (...args) {
+    this.call(method, args);
+  };
+}
+
+WorkerBindings.prototype.init = function () {
+  this.onSigIntBinded = this.onSigInt.bind(this);
+
+  this.call('init', []);
+
+  process.on('SIGINT', this.onSigIntBinded);
+};
+
+WorkerBindings.prototype.onSigInt = function () {
+  const sigIntListeners = process.listeners('SIGINT');
+
+  if (sigIntListeners[sigIntListeners.length - 1] === this.onSigIntBinded) {
+    // we are the last listener, so exit once the worker has cleaned up
+    this._worker.once('exit', () => process.exit(1));
+    this.stop();
+  }
+};
+
+// disconnects everything and ends the worker
+WorkerBindings.prototype.stop = function () {
+  if (!this._stopped) {
+    this._stopped = true;
+    process.removeListener('SIGINT', this.onSigIntBinded);
+    this.call('stop', []);
+  }
+};
+
+// drains the ring whenever the worker writes to it
+WorkerBindings.prototype.listen = function () {
+  const signal = this._ring.signal();
+
+  for (let event; (event = this._ring.shift()) !== null;) {
+    this.emit(event[0], ...event[1]);
+  }
+
+  if (this._exited) {
+    return;
+  }
+
+  const { async, value } = this._ring.wait(signal);
+  if (async) {
+    value.then(() => this.listen());
+  } else {
+    setImmediate(() => this.listen());
+  }
+};
+
+WorkerBindings.prototype.onWorkerError = function (error) {
+  console.warn(`noble warning: HCI worker failed: ${error.message}`);
+};
+
+WorkerBindings.prototype.onWorkerExit = function (code) {
+  debug(`worker exited with ${code}`);
+
+  this._stopped = true;
+  this._exited = true;
+  this._calls.close();
+  // stops listening once the events still in the ring are out
+  this._ring.wake();
+  this.emit('stateChange', 'poweredOff');
+};
+
+module.exports = WorkerBindings;
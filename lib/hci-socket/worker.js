@@ -0,0 +1,50 @@
+const { parentPort, workerData } = require('worker_threads');
+
+const EventRing = require('./event-ring');
+const NobleBindings = require('./bindings');
+const ShardedBindings = require('./sharded-bindings');
+const { EVENTS } = require('./worker-bindings');
+
+// The hci-socket bindings in a worker thread, see WorkerBindings. Events go
+// out through one ring, calls come in through another, with a message to
+// wake the worker up for them.
+const { ring: buffer, calls: callBuffer, options } = workerData;
+const ring = new EventRing(buffer);
+const calls = new EventRing(callBuffer);
+
+ring.doorbell = () => parentPort.postMessage(null);
+
+// sockets can't be passed to a worker, the module exporting one can
+const withSocket = (options) =>
+  options.socketModule
+    ? Object.assign({}, options, {
+      socket: new (require(options.socketModule))(options.socketOptions)
+    })
+    : options;
+
+// picked like resolve-bindings does, the worker sees the same environment
+const bindings =
+  options.adapters || options.deviceIds || process.env.NOBLE_HCI_DEVICE_IDS
+    ? new ShardedBindings(
+      Object.assign({}, options, {
+        adapters: options.adapters && options.adapters.map(withSocket)
+      })
+    )
+    : new NobleBindings(withSocket(options));
+
+for (const event of EVENTS) {
+  bindings.on(event, (...args) => ring.send(event, args));
+}
+
+parentPort.on('message', () => {
+  for (let call; (call = calls.shift()) !== null;) {
+    const [method, args] = call;
+
+    // disconnects everything on the way out, see NobleBindings#onExit
+    if (method === 'stop') {
+      process.exit(0);
+    }
+
+    bindings[method](...args);
+  }
+});
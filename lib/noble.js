@@ -7,6 +7,7 @@ const Peripheral = require('./peripheral');
 const Service = require('./service');
 const Characteristic = require('./characteristic');
 const Descriptor = require('./descriptor');
+const ScanFilter = require('./scan-filter');
 
 function Noble (bindings) {
   this.initialized = false;
@@ -19,6 +20,9 @@ function Noble (bindings) {
   this._characteristics = {};
   this._descriptors = {};
   this._discoveredPeripheralUUids = {};
+  // for bindings that don't filter scans themselves
+  this._scanFilter = null;
+  this._scanFilterMatched = {};
 
   this._bindings.on('stateChange', this.onStateChange.bind(this));
   this._bindings.on('addressChange', this.onAddressChange.bind(this));
@@ -31,10 +35,12 @@ function Noble (bindings) {
   this._bindings.on('rssiUpdate', this.onRssiUpdate.bind(this));
   this._bindings.on('servicesDiscover', this.onServicesDiscover.bind(this));
   this._bindings.on('servicesDiscovered', this.onServicesDiscovered.bind(this));
+  this._bindings.on('databaseDiscover', this.onDatabaseDiscover.bind(this));
   this._bindings.on('includedServicesDiscover', this.onIncludedServicesDiscover.bind(this));
   this._bindings.on('characteristicsDiscover', this.onCharacteristicsDiscover.bind(this));
   this._bindings.on('characteristicsDiscovered', this.onCharacteristicsDiscovered.bind(this));
   this._bindings.on('read', this.onRead.bind(this));
+  this._bindings.on('readMultiple', this.onReadMultiple.bind(this));
   this._bindings.on('write', this.onWrite.bind(this));
   this._bindings.on('broadcast', this.onBroadcast.bind(this));
   this._bindings.on('notify', this.onNotify.bind(this));
@@ -44,7 +50,11 @@ function Noble (bindings) {
   this._bindings.on('handleRead', this.onHandleRead.bind(this));
   this._bindings.on('handleWrite', this.onHandleWrite.bind(this));
   this._bindings.on('handleNotify', this.onHandleNotify.bind(this));
+  this._bindings.on('l2capChannelOpen', this.onL2capChannelOpen.bind(this));
   this._bindings.on('onMtu', this.onMtu.bind(this));
+  this._bindings.on('periodicSync', this.onPeriodicSync.bind(this));
+  this._bindings.on('periodicAdvertisement', this.onPeriodicAdvertisement.bind(this));
+  this._bindings.on('periodicSyncLost', this.onPeriodicSyncLost.bind(this));
 
   this.on('warning', (message) => {
     if (this.listeners('warning').length === 1) {
@@ -110,7 +120,17 @@ Noble.prototype.onScanParametersSet = function () {
   this.emit('scanParametersSet');
 };
 
+// serviceUuids can also be a scan filter, see ScanFilter, with serviceUuids
+// as one of its fields and `passive: true` for a passive scan, where the
+// bindings support it
 const startScanning = function (serviceUuids, allowDuplicates, callback) {
+  let filter = null;
+
+  if (serviceUuids && typeof serviceUuids === 'object' && !Array.isArray(serviceUuids)) {
+    filter = serviceUuids;
+    serviceUuids = filter.serviceUuids;
+  }
+
   if (typeof serviceUuids === 'function') {
     this.emit('warning', 'calling startScanning(callback) is deprecated');
   }
@@ -138,7 +158,16 @@ const startScanning = function (serviceUuids, allowDuplicates, callback) {
       this._discoveredPeripheralUUids = {};
       this._allowDuplicates = allowDuplicates;
 
-      this._bindings.startScanning(serviceUuids, allowDuplicates);
+      if (filter) {
+        this._scanFilter = this._bindings.supportsScanFilter ? null : ScanFilter.from(filter);
+        this._scanFilterMatched = {};
+
+        this._bindings.startScanning(serviceUuids, allowDuplicates, filter);
+      } else {
+        this._scanFilter = null;
+
+        this._bindings.startScanning(serviceUuids, allowDuplicates);
+      }
     }
   };
 
@@ -196,10 +225,13 @@ Noble.prototype.onDiscover = function (uuid, address, addressType, connectable,
     this._characteristics[uuid] = {};
     this._descriptors[uuid] = {};
   } else {
-    // "or" the advertisment data with existing
-    for (const i in advertisement) {
-      if (advertisement[i] !== undefined) {
-        peripheral.advertisement[i] = advertisement[i];
+    // "or" the advertisment data with existing, unless the bindings keep
+    // updating the very same object
+    if (peripheral.advertisement !== advertisement) {
+      for (const i in advertisement) {
+        if (advertisement[i] !== undefined) {
+          peripheral.advertisement[i] = advertisement[i];
+        }
       }
     }
 
@@ -208,6 +240,16 @@ Noble.prototype.onDiscover = function (uuid, address, addressType, connectable,
     peripheral.rssi = rssi;
   }
 
+  if (this._scanFilter !== null) {
+    const matched = (this._scanFilterMatched[uuid] | 0) |
+      this._scanFilter.matchAdvertisement(peripheral.advertisement);
+    this._scanFilterMatched[uuid] = matched;
+
+    if (!this._scanFilter.matched(matched) || !this._scanFilter.rssiMatched(rssi)) {
+      return;
+    }
+  }
+
   const previouslyDiscoverd = this._discoveredPeripheralUUids[uuid] === true;
 
   if (!previouslyDiscoverd) {
@@ -340,6 +382,46 @@ Noble.prototype.onServicesDiscover = function (peripheralUuid, serviceUuids) {
   }
 };
 
+// returns false when the bindings can't discover the whole database at once
+Noble.prototype.discoverDatabase = function (peripheralUuid, descriptors) {
+  if (!this._bindings.discoverDatabase) {
+    return false;
+  }
+
+  this._bindings.discoverDatabase(peripheralUuid, descriptors);
+  return true;
+};
+
+// builds the services, characteristics and, when they were swept, the
+// descriptors, with the events discovering them level by level emits
+Noble.prototype.onDatabaseDiscover = function (peripheralUuid, services) {
+  const peripheral = this._peripherals[peripheralUuid];
+
+  if (!peripheral) {
+    this.emit('warning', `unknown peripheral ${peripheralUuid} database discover!`);
+    return;
+  }
+
+  this.onServicesDiscover(peripheralUuid, services.map((service) => service.uuid));
+
+  for (const service of services) {
+    this.onCharacteristicsDiscover(peripheralUuid, service.uuid, service.characteristics);
+
+    for (const characteristic of service.characteristics) {
+      if (characteristic.descriptors) {
+        this.onDescriptorsDiscover(
+          peripheralUuid,
+          service.uuid,
+          characteristic.uuid,
+          characteristic.descriptors.map((descriptor) => descriptor.uuid)
+        );
+      }
+    }
+  }
+
+  peripheral.emit('databaseDiscover', peripheral.services);
+};
+
 Noble.prototype.discoverIncludedServices = function (peripheralUuid, serviceUuid, serviceUuids) {
   this._bindings.discoverIncludedServices(peripheralUuid, serviceUuid, serviceUuids);
 };
@@ -447,6 +529,53 @@ Noble.prototype.onRead = function (peripheralUuid, serviceUuid, characteristicUu
   }
 };
 
+Noble.prototype.readMultiple = function (peripheralUuid, characteristics, requestId) {
+  if (this._bindings.readMultiple) {
+    this._bindings.readMultiple(peripheralUuid, characteristics, requestId);
+    return;
+  }
+
+  // bindings without bulk reads get one read per characteristic
+  const known = this._characteristics[peripheralUuid] || {};
+  const unknown = characteristics.find(({ serviceUuid, characteristicUuid }) =>
+    !(known[serviceUuid] && known[serviceUuid][characteristicUuid])
+  );
+
+  if (unknown) {
+    this.onReadMultiple(
+      peripheralUuid,
+      requestId,
+      new Error(`unknown characteristic ${unknown.serviceUuid}, ${unknown.characteristicUuid}`)
+    );
+    return;
+  }
+
+  const values = new Array(characteristics.length);
+  let remaining = characteristics.length;
+  let firstError = null;
+
+  characteristics.forEach(({ serviceUuid, characteristicUuid }, i) => {
+    known[serviceUuid][characteristicUuid].read((error, data) => {
+      values[i] = data;
+      firstError = firstError || error || null;
+
+      if (--remaining === 0) {
+        this.onReadMultiple(peripheralUuid, requestId, firstError, firstError ? undefined : values);
+      }
+    });
+  });
+};
+
+Noble.prototype.onReadMultiple = function (peripheralUuid, requestId, error, values) {
+  const peripheral = this._peripherals[peripheralUuid];
+
+  if (peripheral) {
+    peripheral.emit('readMultiple', requestId, error, values);
+  } else {
+    this.emit('warning', `unknown peripheral ${peripheralUuid} read multiple!`);
+  }
+};
+
 Noble.prototype.write = function (peripheralUuid, serviceUuid, characteristicUuid, data, withoutResponse) {
   this._bindings.write(peripheralUuid, serviceUuid, characteristicUuid, data, withoutResponse);
 };
@@ -589,6 +718,68 @@ Noble.prototype.onHandleNotify = function (peripheralUuid, handle, data) {
   }
 };
 
+Noble.prototype.openL2capChannel = function (peripheralUuid, psm, options) {
+  if (!this._bindings.openL2capChannel) {
+    this.onL2capChannelOpen(peripheralUuid, psm, new Error('L2CAP channels are not supported by these bindings'), null);
+    return;
+  }
+
+  this._bindings.openL2capChannel(peripheralUuid, psm, options);
+};
+
+Noble.prototype.onL2capChannelOpen = function (peripheralUuid, psm, error, channel) {
+  const peripheral = this._peripherals[peripheralUuid];
+
+  if (peripheral) {
+    peripheral.emit(`l2capChannelOpen${psm}`, error, channel);
+  } else {
+    this.emit('warning', `unknown peripheral ${peripheralUuid} L2CAP channel open!`);
+  }
+};
+
+Noble.prototype.syncPeriodicAdvertising = function (peripheralUuid) {
+  if (!this._bindings.syncPeriodicAdvertising) {
+    this.onPeriodicSync(peripheralUuid, new Error('Periodic advertising is not supported by these bindings'));
+    return;
+  }
+
+  this._bindings.syncPeriodicAdvertising(peripheralUuid);
+};
+
+Noble.prototype.stopPeriodicSync = function (peripheralUuid) {
+  if (this._bindings.stopPeriodicSync) {
+    this._bindings.stopPeriodicSync(peripheralUuid);
+  }
+};
+
+Noble.prototype.onPeriodicSync = function (peripheralUuid, error, interval) {
+  const peripheral = this._peripherals[peripheralUuid];
+
+  if (peripheral) {
+    peripheral.periodicInterval = error ? null : interval;
+    peripheral.emit('periodicSync', error, interval);
+  } else {
+    this.emit('warning', `unknown peripheral ${peripheralUuid} periodic sync!`);
+  }
+};
+
+Noble.prototype.onPeriodicAdvertisement = function (peripheralUuid, data, rssi, txPower) {
+  const peripheral = this._peripherals[peripheralUuid];
+
+  if (peripheral) {
+    peripheral.emit('periodicAdvertisement', data, rssi, txPower);
+  }
+};
+
+Noble.prototype.onPeriodicSyncLost = function (peripheralUuid, reason) {
+  const peripheral = this._peripherals[peripheralUuid];
+
+  if (peripheral) {
+    peripheral.periodicInterval = null;
+    peripheral.emit('periodicSyncLost', reason);
+  }
+};
+
 Noble.prototype.onMtu = function (peripheralUuid, mtu) {
   const peripheral = this._peripherals[peripheralUuid];
   if (peripheral && mtu) peripheral.mtu = mtu;
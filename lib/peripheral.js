@@ -15,6 +15,8 @@ function Peripheral (noble, id, address, addressType, connectable, advertisement
   this.services = null;
   this.mtu = null;
   this.state = 'disconnected';
+  // of the periodic advertising train followed, in ms
+  this.periodicInterval = null;
 }
 
 util.inherits(Peripheral, events.EventEmitter);
@@ -179,6 +181,72 @@ Peripheral.prototype.discoverAllServicesAndCharacteristicsAsync = function () {
   );
 };
 
+// discovers every service and characteristic, and with options.descriptors
+// their descriptors, in one sweep per level on bindings that can, otherwise
+// level by level
+Peripheral.prototype.discoverDatabase = function (options, callback) {
+  if (typeof options === 'function') {
+    callback = options;
+    options = undefined;
+  }
+  const descriptors = !!(options && options.descriptors);
+
+  const done = (services) => {
+    const characteristics = [];
+
+    for (const service of services) {
+      characteristics.push(...service.characteristics);
+    }
+
+    if (callback) {
+      callback(null, services, characteristics);
+    }
+  };
+
+  this.once('databaseDiscover', done);
+
+  if (this._noble.discoverDatabase && this._noble.discoverDatabase(this.id, descriptors)) {
+    return;
+  }
+  this.removeListener('databaseDiscover', done);
+
+  this.discoverSomeServicesAndCharacteristics([], [], (error, services, characteristics) => {
+    if (error) {
+      if (callback) {
+        callback(error);
+      }
+      return;
+    }
+    if (!descriptors || characteristics.length === 0) {
+      return done(services);
+    }
+
+    let left = characteristics.length;
+    for (const characteristic of characteristics) {
+      characteristic.discoverDescriptors(() => {
+        if (--left === 0) {
+          done(services);
+        }
+      });
+    }
+  });
+};
+
+Peripheral.prototype.discoverDatabaseAsync = function (options) {
+  return new Promise((resolve, reject) =>
+    this.discoverDatabase(
+      options,
+      (error, services, characteristics) =>
+        error
+          ? reject(error)
+          : resolve({
+            services,
+            characteristics
+          })
+    )
+  );
+};
+
 const readHandle = function (handle, callback) {
   if (callback) {
     this.once(`handleRead${handle}`, data => {
@@ -192,6 +260,77 @@ const readHandle = function (handle, callback) {
 Peripheral.prototype.readHandle = readHandle;
 Peripheral.prototype.readHandleAsync = util.promisify(readHandle);
 
+// matches readMultiple events to their requests, whose arguments the
+// bindings may have copied
+let nextReadMultipleId = 0;
+
+const readMultiple = function (characteristics, callback) {
+  const requested = characteristics.map((characteristic) => ({
+    serviceUuid: characteristic._serviceUuid,
+    characteristicUuid: characteristic.uuid
+  }));
+
+  if (requested.length === 0) {
+    if (callback) {
+      callback(null, []);
+    }
+    return;
+  }
+
+  const requestId = ++nextReadMultipleId;
+
+  if (callback) {
+    const onReadMultiple = (id, error, values) => {
+      if (id === requestId) {
+        this.removeListener('readMultiple', onReadMultiple);
+
+        callback(error || null, values);
+      }
+    };
+
+    this.on('readMultiple', onReadMultiple);
+  }
+
+  this._noble.readMultiple(this.id, requested, requestId);
+};
+
+Peripheral.prototype.readMultiple = readMultiple;
+Peripheral.prototype.readMultipleAsync = util.promisify(readMultiple);
+
+// an LE credit based channel to the given LE_PSM, as a duplex stream of SDUs
+const openL2capChannel = function (psm, options, callback) {
+  if (typeof options === 'function') {
+    callback = options;
+    options = undefined;
+  }
+
+  if (callback) {
+    this.once(`l2capChannelOpen${psm}`, callback);
+  }
+
+  this._noble.openL2capChannel(this.id, psm, options);
+};
+
+const syncPeriodicAdvertising = function (callback) {
+  if (callback) {
+    this.once('periodicSync', error => {
+      callback(error);
+    });
+  }
+
+  this._noble.syncPeriodicAdvertising(this.id);
+};
+
+Peripheral.prototype.syncPeriodicAdvertising = syncPeriodicAdvertising;
+Peripheral.prototype.syncPeriodicAdvertisingAsync = util.promisify(syncPeriodicAdvertising);
+
+Peripheral.prototype.stopPeriodicSync = function () {
+  this._noble.stopPeriodicSync(this.id);
+};
+
+Peripheral.prototype.openL2capChannel = openL2capChannel;
+Peripheral.prototype.openL2capChannelAsync = util.promisify(openL2capChannel);
+
 const writeHandle = function (handle, data, withoutResponse, callback) {
   if (!(data instanceof Buffer)) {
     throw new Error('data must be a Buffer');
@@ -31,6 +31,14 @@ module.exports = function (options = {}) {
     (process.env.BLUETOOTH_HCI_SOCKET_USB_VID &&
       process.env.BLUETOOTH_HCI_SOCKET_USB_PID)
   ) {
+    // the stack in a worker thread, see WorkerBindings
+    if (options.worker || process.env.NOBLE_HCI_WORKER) {
+      return new (require('./hci-socket/worker-bindings'))(options);
+    }
+    // several adapters, see ShardedBindings
+    if (options.adapters || options.deviceIds || process.env.NOBLE_HCI_DEVICE_IDS) {
+      return new (require('./hci-socket/sharded-bindings'))(options);
+    }
     return new (require('./hci-socket/bindings'))(options);
   } else if (platform === 'darwin') {
     return new (require('./mac/bindings'))(options);
@@ -0,0 +1,186 @@
+// criteria, as bits of the masks returned by matchEir and matchAdvertisement
+const MANUFACTURER_ID = 0x01;
+const SERVICE_DATA = 0x02;
+const NAME_PREFIX = 0x04;
+
+const toArray = (value) =>
+  value === undefined || value === null
+    ? []
+    : Array.isArray(value)
+      ? value
+      : [value];
+
+const normalizeUuid = (uuid) => uuid.toLowerCase().replace(/-/g, '');
+
+// the AD type service data for a UUID of this many hex digits is sent under
+const SERVICE_DATA_TYPES = { 4: 0x16, 8: 0x20, 32: 0x21 };
+
+/*
+ * A declarative filter for advertisements, so bindings can drop the ones an
+ * app is not interested in before decoding them:
+ *
+ *   {
+ *     manufacturerId: 0x0059,                         // or an array, any of
+ *     serviceData: { uuid: 'feaa', prefix: Buffer },  // or an array, any of
+ *     namePrefix: 'KICKR',
+ *     rssi: -80                                       // floor, in dBm
+ *   }
+ *
+ * A device passes once every criterion given has been met, by its
+ * advertisements or scan responses since scanning started, and then reports
+ * whose RSSI is at or above the floor pass.
+ */
+const ScanFilter = function (spec) {
+  spec = spec || {};
+
+  this.manufacturerIds = toArray(spec.manufacturerId);
+  this.serviceData = toArray(spec.serviceData).map((entry) => {
+    const uuid = normalizeUuid(entry.uuid);
+
+    return {
+      uuid,
+      type: SERVICE_DATA_TYPES[uuid.length],
+      // little endian, as it is sent
+      uuidBytes: Buffer.from(uuid, 'hex').reverse(),
+      prefix: Buffer.from(entry.prefix || [])
+    };
+  });
+  this.namePrefix =
+    spec.namePrefix !== undefined ? Buffer.from(spec.namePrefix, 'utf8') : null;
+  this.rssi = typeof spec.rssi === 'number' ? spec.rssi : null;
+
+  this.criteria =
+    (this.manufacturerIds.length > 0 ? MANUFACTURER_ID : 0) |
+    (this.serviceData.length > 0 ? SERVICE_DATA : 0) |
+    (this.namePrefix !== null ? NAME_PREFIX : 0);
+};
+
+ScanFilter.MANUFACTURER_ID = MANUFACTURER_ID;
+ScanFilter.SERVICE_DATA = SERVICE_DATA;
+ScanFilter.NAME_PREFIX = NAME_PREFIX;
+
+// null for no filter, so callers can skip it altogether
+ScanFilter.from = function (spec) {
+  if (!spec) {
+    return null;
+  }
+
+  const filter = spec instanceof ScanFilter ? spec : new ScanFilter(spec);
+  return filter.criteria !== 0 || filter.rssi !== null ? filter : null;
+};
+
+ScanFilter.prototype.matched = function (mask) {
+  return (mask & this.criteria) === this.criteria;
+};
+
+ScanFilter.prototype.rssiMatched = function (rssi) {
+  return this.rssi === null || rssi >= this.rssi;
+};
+
+// the criteria met by raw AD structures, without decoding any of them
+ScanFilter.prototype.matchEir = function (eir) {
+  let mask = 0;
+  let i = 0;
+
+  while (i + 1 < eir.length) {
+    const length = eir[i];
+
+    if (length < 1 || i + length + 1 > eir.length) {
+      break;
+    }
+
+    const type = eir[i + 1];
+    const start = i + 2;
+    const end = i + length + 1;
+
+    switch (type) {
+      case 0xff: // Manufacturer Specific Data
+        if (
+          end - start >= 2 &&
+          this.manufacturerIds.indexOf(eir[start] | (eir[start + 1] << 8)) !== -1
+        ) {
+          mask |= MANUFACTURER_ID;
+        }
+        break;
+
+      case 0x16: // 16-bit Service Data
+      case 0x20: // 32-bit Service Data
+      case 0x21: // 128-bit Service Data
+        for (const entry of this.serviceData) {
+          if (entry.type !== type) {
+            continue;
+          }
+
+          const uuidEnd = start + entry.uuidBytes.length;
+          const prefixEnd = uuidEnd + entry.prefix.length;
+
+          if (
+            prefixEnd <= end &&
+            entry.uuidBytes.compare(eir, start, uuidEnd) === 0 &&
+            entry.prefix.compare(eir, uuidEnd, prefixEnd) === 0
+          ) {
+            mask |= SERVICE_DATA;
+            break;
+          }
+        }
+        break;
+
+      case 0x08: // Shortened Local Name
+      case 0x09: // Complete Local Name
+        if (
+          this.namePrefix !== null &&
+          start + this.namePrefix.length <= end &&
+          this.namePrefix.compare(eir, start, start + this.namePrefix.length) === 0
+        ) {
+          mask |= NAME_PREFIX;
+        }
+        break;
+    }
+
+    i = end;
+  }
+
+  return mask;
+};
+
+// the same for decoded advertisements, for bindings that can't filter
+ScanFilter.prototype.matchAdvertisement = function (advertisement) {
+  let mask = 0;
+
+  const manufacturerData = advertisement.manufacturerData;
+  if (
+    manufacturerData &&
+    manufacturerData.length >= 2 &&
+    this.manufacturerIds.indexOf(manufacturerData.readUInt16LE(0)) !== -1
+  ) {
+    mask |= MANUFACTURER_ID;
+  }
+
+  if (this.serviceData.length > 0) {
+    for (const { uuid, data } of advertisement.serviceData || []) {
+      const entry = this.serviceData.find(
+        (entry) =>
+          entry.uuid === uuid &&
+          data.length >= entry.prefix.length &&
+          entry.prefix.compare(data, 0, entry.prefix.length) === 0
+      );
+
+      if (entry) {
+        mask |= SERVICE_DATA;
+        break;
+      }
+    }
+  }
+
+  if (
+    this.namePrefix !== null &&
+    typeof advertisement.localName === 'string' &&
+    advertisement.localName.startsWith(this.namePrefix.toString('utf8'))
+  ) {
+    mask |= NAME_PREFIX;
+  }
+
+  return mask;
+};
+
+module.exports = ScanFilter;
@@ -59,9 +59,14 @@ NobleBindings.prototype.onClose = function () {
   this.emit('stateChange', 'poweredOff');
 };
 
-NobleBindings.prototype.startScanning = function (options, allowDuplicates) {
+NobleBindings.prototype.startScanning = function (options, allowDuplicates, filter) {
   const self = this;
 
+  // a scan filter passed to noble, its name prefix is a Web Bluetooth filter
+  if (filter) {
+    options = Object.assign({}, filter, { services: filter.services || options || [] });
+  }
+
   if (Array.isArray(options)) {
     options = { services: options };
   }
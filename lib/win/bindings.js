@@ -8,4 +8,7 @@ const { NobleWinrt } = bindings('binding.node');
 
 inherits(NobleWinrt, EventEmitter);
 
+// BLEManager::Scan applies the scan filter
+NobleWinrt.prototype.supportsScanFilter = true;
+
 module.exports = NobleWinrt;
@@ -13,6 +13,7 @@
 using winrt::Windows::Devices::Bluetooth::BluetoothCacheMode;
 using winrt::Windows::Devices::Bluetooth::BluetoothConnectionStatus;
 using winrt::Windows::Devices::Bluetooth::BluetoothLEDevice;
+using winrt::Windows::Devices::Bluetooth::BluetoothSignalStrengthFilter;
 using winrt::Windows::Storage::Streams::DataReader;
 using winrt::Windows::Storage::Streams::DataWriter;
 using winrt::Windows::Storage::Streams::IBuffer;
@@ -74,7 +75,6 @@ BLEManager::BLEManager(const Napi::Value& receiver, const Napi::Function& callba
     mEmit.Wrap(receiver, callback);
     auto onRadio = std::bind(&BLEManager::OnRadio, this, std::placeholders::_1);
     mWatcher.Start(onRadio);
-    mAdvertismentWatcher.ScanningMode(BluetoothLEScanningMode::Active);
     auto onReceived = bind2(this, &BLEManager::OnScanResult);
     mReceivedRevoker = mAdvertismentWatcher.Received(winrt::auto_revoke, onReceived);
     auto onStopped = bind2(this, &BLEManager::OnScanStopped);
@@ -115,10 +115,47 @@ void BLEManager::OnRadio(Radio& radio)
     }
 }
 
-void BLEManager::Scan(const std::vector<winrt::guid>& serviceUUIDs, bool allowDuplicates)
+// the OS filter takes data section patterns that all have to be in the same
+// advertisement, so only a filter with a single criterion and a single value
+// is handed to it. The full filter is matched in MatchScanFilter.
+static void addBytePattern(BluetoothLEAdvertisementFilter& advertisementFilter,
+                           const ScanFilter& filter)
+{
+    Data pattern;
+    uint8_t dataType;
+    if (filter.Criteria() == ScanFilter::kManufacturerId && filter.manufacturerIds.size() == 1)
+    {
+        dataType = 0xff;
+        pattern = { static_cast<uint8_t>(filter.manufacturerIds[0] & 0xff),
+                    static_cast<uint8_t>(filter.manufacturerIds[0] >> 8) };
+    }
+    else if (filter.Criteria() == ScanFilter::kServiceData && filter.serviceData.size() == 1 &&
+             filter.serviceData[0].first.size() == 4)
+    {
+        dataType = 0x16;
+        uint16_t uuid = static_cast<uint16_t>(std::stoi(filter.serviceData[0].first, 0, 16));
+        pattern = { static_cast<uint8_t>(uuid & 0xff), static_cast<uint8_t>(uuid >> 8) };
+        auto& prefix = filter.serviceData[0].second;
+        pattern.insert(pattern.end(), prefix.begin(), prefix.end());
+    }
+    else
+    {
+        return;
+    }
+
+    DataWriter writer;
+    writer.WriteBytes(pattern);
+    advertisementFilter.BytePatterns().Append(
+        BluetoothLEAdvertisementBytePattern(dataType, 0, writer.DetachBuffer()));
+}
+
+void BLEManager::Scan(const std::vector<winrt::guid>& serviceUUIDs, bool allowDuplicates,
+                      const ScanFilter& scanFilter, bool passive)
 {
     mAdvertismentMap.clear();
     mAllowDuplicates = allowDuplicates;
+    mScanFilter = scanFilter;
+    mScanFilterMatched.clear();
     BluetoothLEAdvertisementFilter filter = BluetoothLEAdvertisementFilter();
     BluetoothLEAdvertisement advertisment = BluetoothLEAdvertisement();
     auto services = advertisment.ServiceUuids();
@@ -127,11 +164,68 @@ void BLEManager::Scan(const std::vector<winrt::guid>& serviceUUIDs, bool allowDu
         services.Append(uuid);
     }
     filter.Advertisement(advertisment);
+    addBytePattern(filter, scanFilter);
     mAdvertismentWatcher.AdvertisementFilter(filter);
+    BluetoothSignalStrengthFilter signalStrengthFilter;
+    if (scanFilter.hasRssi)
+    {
+        signalStrengthFilter.InRangeThresholdInDBm(static_cast<int16_t>(scanFilter.rssi));
+    }
+    mAdvertismentWatcher.SignalStrengthFilter(signalStrengthFilter);
+    // passive scans send no scan requests, so there are no scan responses
+    mAdvertismentWatcher.ScanningMode(passive ? BluetoothLEScanningMode::Passive
+                                              : BluetoothLEScanningMode::Active);
     mAdvertismentWatcher.Start();
     mEmit.ScanState(true);
 }
 
+// criteria met by what the peripheral advertised last, see lib/scan-filter.js
+static uint8_t matchScanFilter(const ScanFilter& filter, const Peripheral& peripheral)
+{
+    uint8_t matched = 0;
+    auto& ids = filter.manufacturerIds;
+    auto& manufacturerData = peripheral.manufacturerData;
+    if (manufacturerData.size() >= 2 &&
+        std::find(ids.begin(), ids.end(), manufacturerData[0] | (manufacturerData[1] << 8)) !=
+            ids.end())
+    {
+        matched |= ScanFilter::kManufacturerId;
+    }
+    for (auto& entry : filter.serviceData)
+    {
+        for (auto& sd : peripheral.serviceData)
+        {
+            if (sd.first == entry.first && sd.second.size() >= entry.second.size() &&
+                std::equal(entry.second.begin(), entry.second.end(), sd.second.begin()))
+            {
+                matched |= ScanFilter::kServiceData;
+            }
+        }
+    }
+    if (filter.hasNamePrefix &&
+        peripheral.name.compare(0, filter.namePrefix.size(), filter.namePrefix) == 0)
+    {
+        matched |= ScanFilter::kNamePrefix;
+    }
+    return matched;
+}
+
+// once a device has met every criterion, reports at or above the RSSI floor
+bool BLEManager::MatchScanFilter(const std::string& uuid, int rssi, const Peripheral& peripheral)
+{
+    uint8_t criteria = mScanFilter.Criteria();
+    if (criteria == 0 && !mScanFilter.hasRssi)
+    {
+        return true;
+    }
+    uint8_t& matched = mScanFilterMatched[uuid];
+    if ((matched & criteria) != criteria)
+    {
+        matched |= matchScanFilter(mScanFilter, peripheral);
+    }
+    return (matched & criteria) == criteria && (!mScanFilter.hasRssi || rssi >= mScanFilter.rssi);
+}
+
 void BLEManager::OnScanResult(BluetoothLEAdvertisementWatcher watcher,
                               const BluetoothLEAdvertisementReceivedEventArgs& args)
 {
@@ -142,17 +236,21 @@ void BLEManager::OnScanResult(BluetoothLEAdvertisementWatcher watcher,
 
     if (mDeviceMap.find(uuid) == mDeviceMap.end())
     {
-        mAdvertismentMap.insert(uuid);
         auto peripheral =
             PeripheralWinrt(bluetoothAddress, advertismentType, rssi, args.Advertisement());
-        mEmit.Scan(uuid, rssi, peripheral);
+        if (MatchScanFilter(uuid, rssi, peripheral))
+        {
+            mAdvertismentMap.insert(uuid);
+            mEmit.Scan(uuid, rssi, peripheral);
+        }
         mDeviceMap.emplace(std::make_pair(uuid, std::move(peripheral)));
     }
     else
     {
         PeripheralWinrt& peripheral = mDeviceMap[uuid];
         peripheral.Update(rssi, args.Advertisement(), advertismentType);
-        if (mAllowDuplicates || mAdvertismentMap.find(uuid) == mAdvertismentMap.end())
+        if (MatchScanFilter(uuid, rssi, peripheral) &&
+            (mAllowDuplicates || mAdvertismentMap.find(uuid) == mAdvertismentMap.end()))
         {
             mAdvertismentMap.insert(uuid);
             mEmit.Scan(uuid, rssi, peripheral);
@@ -181,9 +279,16 @@ bool BLEManager::Connect(const std::string& uuid)
     PeripheralWinrt& peripheral = mDeviceMap[uuid];
     if (!peripheral.device.has_value())
     {
-        auto completed = bind2(this, &BLEManager::OnConnected, uuid);
-        BluetoothLEDevice::FromBluetoothAddressAsync(peripheral.bluetoothAddress)
-            .Completed(completed);
+        {
+            std::lock_guard<std::mutex> lock(mConnectMutex);
+            if (mConnecting.find(uuid) != mConnecting.end() ||
+                std::find(mConnectQueue.begin(), mConnectQueue.end(), uuid) != mConnectQueue.end())
+            {
+                return true;
+            }
+            mConnectQueue.push_back(uuid);
+        }
+        ConnectNext();
     }
     else
     {
@@ -192,9 +297,65 @@ bool BLEManager::Connect(const std::string& uuid)
     return true;
 }
 
+// a request per device floods the stack when many connect at once: keep a
+// few in flight, each with a deadline
+void BLEManager::ConnectNext()
+{
+    // completion handlers may run right away, so they are set outside the lock
+    std::vector<std::pair<std::string, IAsyncOperation<BluetoothLEDevice>>> started;
+    {
+        std::lock_guard<std::mutex> lock(mConnectMutex);
+        while (mConnecting.size() < kMaxConnecting && !mConnectQueue.empty())
+        {
+            auto uuid = mConnectQueue.front();
+            mConnectQueue.pop_front();
+
+            PeripheralWinrt& peripheral = mDeviceMap[uuid];
+            auto operation =
+                BluetoothLEDevice::FromBluetoothAddressAsync(peripheral.bluetoothAddress);
+            auto timer = ThreadPoolTimer::CreateTimer(
+                [this, uuid](ThreadPoolTimer) {
+                    IAsyncOperation<BluetoothLEDevice> operation = nullptr;
+                    {
+                        std::lock_guard<std::mutex> lock(mConnectMutex);
+                        auto it = mConnecting.find(uuid);
+                        if (it == mConnecting.end())
+                        {
+                            return;
+                        }
+                        it->second.timedOut = true;
+                        operation = it->second.operation;
+                    }
+                    operation.Cancel();
+                },
+                kConnectTimeout);
+            mConnecting.emplace(uuid, Connecting{ operation, timer, false });
+            started.emplace_back(uuid, operation);
+        }
+    }
+
+    for (auto& [uuid, operation] : started)
+    {
+        auto completed = bind2(this, &BLEManager::OnConnected, uuid);
+        operation.Completed(completed);
+    }
+}
+
 void BLEManager::OnConnected(IAsyncOperation<BluetoothLEDevice> asyncOp, AsyncStatus status,
                              const std::string uuid)
 {
+    bool timedOut = false;
+    {
+        std::lock_guard<std::mutex> lock(mConnectMutex);
+        auto it = mConnecting.find(uuid);
+        if (it != mConnecting.end())
+        {
+            it->second.timer.Cancel();
+            timedOut = it->second.timedOut;
+            mConnecting.erase(it);
+        }
+    }
+
     if (status == AsyncStatus::Completed)
     {
         BluetoothLEDevice device = asyncOp.GetResults();
@@ -214,15 +375,26 @@ void BLEManager::OnConnected(IAsyncOperation<BluetoothLEDevice> asyncOp, AsyncSt
             mEmit.Connected(uuid, "could not connect to device: result is null");
         }
     }
+    else if (timedOut)
+    {
+        mEmit.Connected(uuid, "could not connect to device: timed out");
+    }
     else
     {
         mEmit.Connected(uuid, "could not connect to device");
     }
+
+    ConnectNext();
 }
 
 bool BLEManager::Disconnect(const std::string& uuid)
 {
     CHECK_DEVICE();
+    {
+        std::lock_guard<std::mutex> lock(mConnectMutex);
+        mConnectQueue.erase(std::remove(mConnectQueue.begin(), mConnectQueue.end(), uuid),
+                            mConnectQueue.end());
+    }
     PeripheralWinrt& peripheral = mDeviceMap[uuid];
     peripheral.Disconnect();
     mNotifyMap.Remove(uuid);
@@ -9,6 +9,10 @@
 
 #include <winrt/Windows.Devices.Bluetooth.Advertisement.h>
 #include <winrt/Windows.Devices.Bluetooth.GenericAttributeProfile.h>
+#include <winrt/Windows.System.Threading.h>
+
+#include <deque>
+#include <mutex>
 
 #include "callbacks.h"
 #include "peripheral_winrt.h"
@@ -18,13 +22,20 @@
 using namespace winrt::Windows::Devices::Bluetooth::GenericAttributeProfile;
 using namespace winrt::Windows::Devices::Bluetooth::Advertisement;
 using winrt::Windows::Foundation::AsyncStatus;
+using winrt::Windows::System::Threading::ThreadPoolTimer;
+
+// connect requests opened at once, the others wait their turn
+constexpr size_t kMaxConnecting = 3;
+// a connect request still unanswered after this long is cancelled
+constexpr std::chrono::milliseconds kConnectTimeout{ 10000 };
 
 class BLEManager
 {
 public:
     // clang-format off
     BLEManager(const Napi::Value& receiver, const Napi::Function& callback);
-    void Scan(const std::vector<winrt::guid>& serviceUUIDs, bool allowDuplicates);
+    void Scan(const std::vector<winrt::guid>& serviceUUIDs, bool allowDuplicates, const ScanFilter& filter,
+              bool passive);
     void StopScan();
     bool Connect(const std::string& uuid);
     bool Disconnect(const std::string& uuid);
@@ -47,6 +58,8 @@ private:
     void OnRadio(Radio& radio);
     void OnScanResult(BluetoothLEAdvertisementWatcher watcher, const BluetoothLEAdvertisementReceivedEventArgs& args);
     void OnScanStopped(BluetoothLEAdvertisementWatcher watcher, const BluetoothLEAdvertisementWatcherStoppedEventArgs& args);
+    bool MatchScanFilter(const std::string& uuid, int rssi, const Peripheral& peripheral);
+    void ConnectNext();
     void OnConnected(IAsyncOperation<BluetoothLEDevice> asyncOp, AsyncStatus status, std::string uuid);
     void OnConnectionStatusChanged(BluetoothLEDevice device, winrt::Windows::Foundation::IInspectable inspectable);
     void OnServicesDiscovered(IAsyncOperation<GattDeviceServicesResult> asyncOp, AsyncStatus status, std::string uuid, std::vector<winrt::guid> serviceUUIDs);
@@ -70,8 +83,21 @@ private:
     winrt::event_revoker<IBluetoothLEAdvertisementWatcher> mReceivedRevoker;
     winrt::event_revoker<IBluetoothLEAdvertisementWatcher> mStoppedRevoker;
     bool mAllowDuplicates;
+    ScanFilter mScanFilter;
+    // criteria of the scan filter each device has met so far
+    std::unordered_map<std::string, uint8_t> mScanFilterMatched;
 
     std::unordered_map<std::string, PeripheralWinrt> mDeviceMap;
     std::set<std::string> mAdvertismentMap;
     NotifyMap mNotifyMap;
+
+    struct Connecting
+    {
+        IAsyncOperation<BluetoothLEDevice> operation;
+        ThreadPoolTimer timer;
+        bool timedOut;
+    };
+    std::mutex mConnectMutex;
+    std::deque<std::string> mConnectQueue;
+    std::unordered_map<std::string, Connecting> mConnecting;
 };
@@ -9,6 +9,8 @@
 #include <winrt/Windows.Devices.Bluetooth.GenericAttributeProfile.h>
 #include <rpc.h>
 
+#include <algorithm>
+
 using namespace winrt::Windows::Devices::Bluetooth;
 
 winrt::guid napiToUuid(Napi::String string)
@@ -74,3 +76,70 @@ bool getBool(const Napi::Value& value, bool def)
     }
     return def;
 }
+
+// { manufacturerId, serviceData: { uuid, prefix }, namePrefix, rssi }, the
+// first two may also be arrays
+ScanFilter getScanFilter(const Napi::Value& value)
+{
+    ScanFilter filter;
+    if (!value.IsObject())
+    {
+        return filter;
+    }
+    auto object = value.As<Napi::Object>();
+
+    auto forEach = [](const Napi::Value& value, auto fn) {
+        if (value.IsArray())
+        {
+            auto array = value.As<Napi::Array>();
+            for (size_t i = 0; i < array.Length(); i++)
+            {
+                fn(array.Get(i));
+            }
+        }
+        else if (!value.IsUndefined() && !value.IsNull())
+        {
+            fn(value);
+        }
+    };
+
+    forEach(object.Get("manufacturerId"), [&](const Napi::Value& id) {
+        if (id.IsNumber())
+        {
+            filter.manufacturerIds.push_back(static_cast<uint16_t>(napiToNumber(id.As<Napi::Number>())));
+        }
+    });
+
+    forEach(object.Get("serviceData"), [&](const Napi::Value& entry) {
+        if (!entry.IsObject() || !entry.As<Napi::Object>().Get("uuid").IsString())
+        {
+            return;
+        }
+        auto uuid = entry.As<Napi::Object>().Get("uuid").As<Napi::String>().Utf8Value();
+        uuid.erase(std::remove(uuid.begin(), uuid.end(), '-'), uuid.end());
+        std::transform(uuid.begin(), uuid.end(), uuid.begin(), ::tolower);
+        Data prefix;
+        auto prefixValue = entry.As<Napi::Object>().Get("prefix");
+        if (prefixValue.IsBuffer())
+        {
+            prefix = napiToData(prefixValue.As<Napi::Buffer<byte>>());
+        }
+        filter.serviceData.push_back(std::make_pair(uuid, prefix));
+    });
+
+    auto namePrefix = object.Get("namePrefix");
+    if (namePrefix.IsString())
+    {
+        filter.hasNamePrefix = true;
+        filter.namePrefix = namePrefix.As<Napi::String>().Utf8Value();
+    }
+
+    auto rssi = object.Get("rssi");
+    if (rssi.IsNumber())
+    {
+        filter.hasRssi = true;
+        filter.rssi = napiToNumber(rssi.As<Napi::Number>());
+    }
+
+    return filter;
+}
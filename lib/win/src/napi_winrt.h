@@ -6,6 +6,7 @@
 
 std::vector<winrt::guid> getUuidArray(const Napi::Value& value);
 bool getBool(const Napi::Value& value, bool def);
+ScanFilter getScanFilter(const Napi::Value& value);
 
 winrt::guid napiToUuid(Napi::String string);
 Data napiToData(Napi::Buffer<unsigned char> buffer);
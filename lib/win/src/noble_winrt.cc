@@ -62,14 +62,17 @@ Napi::Value NobleWinrt::Init(const Napi::CallbackInfo& info)
     return Napi::Value();
 }
 
-// startScanning(serviceUuids, allowDuplicates)
+// startScanning(serviceUuids, allowDuplicates, filter)
 Napi::Value NobleWinrt::Scan(const Napi::CallbackInfo& info)
 {
     CHECK_MANAGER()
     auto vector = getUuidArray(info[0]);
     // default value false
     auto duplicates = getBool(info[1], false);
-    manager->Scan(vector, duplicates);
+    auto filter = getScanFilter(info[2]);
+    // the filter object also asks for a passive scan, with passive: true
+    auto passive = info[2].IsObject() && getBool(info[2].As<Napi::Object>().Get("passive"), false);
+    manager->Scan(vector, duplicates, filter, passive);
     return Napi::Value();
 }
 
@@ -21,3 +21,25 @@ public:
     std::vector<std::pair<std::string, Data>> serviceData;
     std::vector<std::string> serviceUuids;
 };
+
+// what advertisements have to match to be reported, see lib/scan-filter.js
+struct ScanFilter
+{
+    static constexpr uint8_t kManufacturerId = 0x01;
+    static constexpr uint8_t kServiceData = 0x02;
+    static constexpr uint8_t kNamePrefix = 0x04;
+
+    std::vector<uint16_t> manufacturerIds;
+    // uuid as in Peripheral::serviceData, data prefix
+    std::vector<std::pair<std::string, Data>> serviceData;
+    bool hasNamePrefix = false;
+    std::string namePrefix;
+    bool hasRssi = false;
+    int rssi = 0;
+
+    uint8_t Criteria() const
+    {
+        return (manufacturerIds.empty() ? 0 : kManufacturerId) |
+            (serviceData.empty() ? 0 : kServiceData) | (hasNamePrefix ? kNamePrefix : 0);
+    }
+};
@@ -1,5 +1,6 @@
 #include "peripheral_winrt.h"
 #include "winrt_cpp.h"
+#include "ad_decoder.h"
 
 #include <winrt/Windows.Storage.Streams.h>
 #include <winrt/Windows.Foundation.Collections.h>
@@ -43,27 +44,44 @@ void PeripheralWinrt::Update(const int rssiValue, const BluetoothLEAdvertisement
     connectable = advertismentType == BluetoothLEAdvertisementType::ConnectableUndirected ||
         advertismentType == BluetoothLEAdvertisementType::ConnectableDirected;
 
-    manufacturerData.clear();
-
+    // rebuild the raw AD structures so they are decoded like on hci-socket
+    Data eir;
     for (auto ds : advertisment.DataSections())
     {
-        if (ds.DataType() == BluetoothLEAdvertisementDataTypes::TxPowerLevel())
-        {
-            auto d = ds.Data();
-            auto dr = DataReader::FromBuffer(d);
-            txPowerLevel = dr.ReadByte();
-            if (txPowerLevel >= 128)
-                txPowerLevel -= 256;
-            dr.Close();
-        }
-        if (ds.DataType() == BluetoothLEAdvertisementDataTypes::ManufacturerSpecificData())
+        auto d = ds.Data();
+        if (d.Length() > 254)
         {
-            auto d = ds.Data();
-            auto dr = DataReader::FromBuffer(d);
-            manufacturerData.resize(d.Length());
-            dr.ReadBytes(manufacturerData);
-            dr.Close();
+            continue;
         }
+        size_t offset = eir.size();
+        eir.resize(offset + 2 + d.Length());
+        eir[offset] = static_cast<uint8_t>(d.Length() + 1);
+        eir[offset + 1] = ds.DataType();
+        auto dr = DataReader::FromBuffer(d);
+        dr.ReadBytes(winrt::array_view<uint8_t>(eir.data() + offset + 2, eir.data() + eir.size()));
+        dr.Close();
+    }
+
+    addecoder::AdvertisingData data;
+    addecoder::DecodeAdvertisingData(eir.data(), eir.size(), data);
+
+    if (data.hasTxPowerLevel)
+    {
+        txPowerLevel = data.txPowerLevel;
+    }
+
+    manufacturerData.clear();
+    if (data.hasManufacturerData)
+    {
+        auto begin = eir.begin() + data.manufacturerData.offset;
+        manufacturerData.assign(begin, begin + data.manufacturerData.length);
+    }
+
+    serviceData.clear();
+    for (auto& sd : data.serviceData)
+    {
+        auto begin = eir.begin() + sd.data.offset;
+        serviceData.push_back(std::make_pair(sd.uuid, Data(begin, begin + sd.data.length)));
     }
 
     serviceUuids.clear();
@@ -0,0 +1,144 @@
+const should = require('should');
+
+const decoder = require('../../../lib/ad-decoder/bindings');
+const Gap = require('../../../lib/hci-socket/gap');
+
+// H4 LE Meta event holding legacy advertising reports
+const advertisingEvent = (reports) => {
+  const data = Buffer.concat(
+    reports.map(({ type, address, eir, rssi }) =>
+      Buffer.concat([
+        Buffer.from([type, 0x01]),
+        Buffer.from(address, 'hex'),
+        Buffer.from([eir.length]),
+        eir,
+        Buffer.from([rssi & 0xff])
+      ])
+    )
+  );
+
+  return Buffer.concat([
+    Buffer.from([0x04, 0x3e, data.length + 2, 0x02, reports.length]),
+    data
+  ]);
+};
+
+// deterministic pseudo random AD structures, including truncated ones
+const randomEir = (seed) => {
+  let state = seed;
+  const next = (max) => {
+    state = (state * 1103515245 + 12345) & 0x7fffffff;
+    return state % max;
+  };
+  const types = [0x01, 0x02, 0x03, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x14, 0x15, 0x16, 0x1f, 0x20, 0x21, 0xff];
+  const bytes = [];
+
+  while (bytes.length < 31) {
+    const length = next(20);
+    bytes.push(length, types[next(types.length)]);
+    for (let j = 1; j < length; j++) {
+      bytes.push(next(4) === 0 ? 0xc3 : 0x41 + next(26));
+    }
+  }
+
+  return Buffer.from(bytes.slice(0, 31 + next(2)));
+};
+
+describe('native advertising report decoder', function () {
+  before(function () {
+    if (decoder === null) {
+      this.skip();
+    }
+  });
+
+  it('should decode every report of an event', () => {
+    const packet = advertisingEvent([
+      { type: 0x00, address: '010203040506', eir: Buffer.from('0303' + '0d18' + '0509' + '68726d31', 'hex'), rssi: -60 },
+      { type: 0x04, address: '0a0b0c0d0e0f', eir: Buffer.from('05ff' + '4c000215', 'hex'), rssi: -72 }
+    ]);
+
+    const reports = decoder.decodeAdvertisingEvent(packet);
+
+    should(reports).deepEqual([
+      {
+        type: 0x00,
+        address: '06:05:04:03:02:01',
+        addressType: 'random',
+        rssi: -60,
+        eirOffset: 14,
+        eirLength: 10,
+        advertisement: { localName: 'hrm1', serviceUuids: ['180d'] }
+      },
+      {
+        type: 0x04,
+        address: '0f:0e:0d:0c:0b:0a',
+        addressType: 'random',
+        rssi: -72,
+        eirOffset: 34,
+        eirLength: 6,
+        advertisement: { manufacturerData: Buffer.from('4c000215', 'hex') }
+      }
+    ]);
+  });
+
+  it('should decode extended advertising reports', () => {
+    const eir = Buffer.from('0716' + '0f18' + '64000000', 'hex');
+    const report = Buffer.alloc(24);
+    report.writeUInt16LE(0x0013, 0);
+    Buffer.from('665544332211', 'hex').copy(report, 3);
+    report.writeUInt8(0x7f, 12);
+    report.writeInt8(-50, 13);
+    report.writeUInt8(eir.length, 23);
+    const packet = Buffer.concat([Buffer.from([0x04, 0x3e, 26 + eir.length, 0x0d, 0x01]), report, eir]);
+
+    const [decoded] = decoder.decodeAdvertisingEvent(packet);
+
+    should(decoded).deepEqual({
+      type: 0x13,
+      address: '11:22:33:44:55:66',
+      addressType: 'public',
+      rssi: -50,
+      txPower: 0x7f,
+      eirOffset: 29,
+      eirLength: 8,
+      advertisement: {
+        serviceData: [{ uuid: '180f', data: Buffer.from('64000000', 'hex') }]
+      }
+    });
+  });
+
+  it('should return the reports before a truncated one', () => {
+    const packet = advertisingEvent([
+      { type: 0x00, address: '010203040506', eir: Buffer.from('020a08', 'hex'), rssi: -60 },
+      { type: 0x00, address: '0a0b0c0d0e0f', eir: Buffer.alloc(8), rssi: -60 }
+    ]);
+
+    const reports = decoder.decodeAdvertisingEvent(packet.slice(0, packet.length - 4));
+
+    should(reports).have.length(1);
+    should(reports[0].advertisement).deepEqual({ txPowerLevel: 8 });
+  });
+
+  it('should return null for other events', () => {
+    should(decoder.decodeAdvertisingEvent(Buffer.from('040e0401030c00', 'hex'))).equal(null);
+    should(decoder.decodeAdvertisingEvent(Buffer.from('043e13010000', 'hex'))).equal(null);
+  });
+
+  it('should only accept buffers', () => {
+    should(() => decoder.decodeAdvertisingEvent('043e')).throw(/must be a Buffer/);
+  });
+
+  it('should decode like Gap#parseServices', () => {
+    for (let seed = 1; seed <= 500; seed++) {
+      const eir = randomEir(seed);
+      const [report] = decoder.decodeAdvertisingEvent(
+        advertisingEvent([{ type: 0x00, address: '010203040506', eir, rssi: -60 }])
+      );
+
+      const native = new Gap({ on: () => {} }).parseServices('address', eir, false, 0x00, undefined, report.advertisement);
+      const js = new Gap({ on: () => {} }).parseServices('address', eir, false, 0x00);
+
+      should(native).deepEqual(js, `seed ${seed}: ${eir.toString('hex')}`);
+    }
+  });
+});
@@ -37,9 +37,11 @@ describe('hci-socket acl-stream', () => {
     assert.calledOnce(Smp);
     assert.calledWith(Smp, aclStream, localAddressType, localAddress, remoteAddressType, remoteAddress);
 
-    assert.calledThrice(aclStream._smp.on);
+    assert.callCount(aclStream._smp.on, 5);
     assert.calledWith(aclStream._smp.on, 'stk', match.any);
     assert.calledWith(aclStream._smp.on, 'fail', match.any);
+    assert.calledWith(aclStream._smp.on, 'keys', match.any);
+    assert.calledWith(aclStream._smp.on, 'securityRequest', match.any);
     assert.calledWith(aclStream._smp.on, 'end', match.any);
   });
 
@@ -55,11 +57,92 @@ describe('hci-socket acl-stream', () => {
 
     aclStream._smp.sendPairingRequest = fake.resolves(null);
 
+    aclStream.encrypt();
     aclStream.encrypt();
 
     assert.calledOnceWithExactly(aclStream._smp.sendPairingRequest);
   });
 
+  describe('with a key store', () => {
+    const bond = {
+      ltk: Buffer.alloc(16, 0xaa),
+      ediv: Buffer.from([0x01, 0x02]),
+      rand: Buffer.alloc(8, 0xbb)
+    };
+
+    let hci;
+    let keyStore;
+    let aclStream;
+
+    beforeEach(() => {
+      hci = { startLeEncryption: fake.resolves(null) };
+      keyStore = { get: fake.returns(bond), set: fake(), delete: fake() };
+      aclStream = new AclStream(hci, 'handle', 'public', '00:11:22:33:44:55', 'random', 'c0:00:00:00:00:01', keyStore);
+      aclStream._smp.sendPairingRequest = fake();
+    });
+
+    it('should encrypt with the stored LTK', () => {
+      const encrypt = fake();
+      aclStream.on('encrypt', encrypt);
+
+      aclStream.encrypt();
+
+      assert.calledOnceWithExactly(keyStore.get, 'c0:00:00:00:00:01', 'random');
+      assert.calledOnceWithExactly(hci.startLeEncryption, 'handle', bond.rand, bond.ediv, bond.ltk);
+      assert.notCalled(aclStream._smp.sendPairingRequest);
+
+      aclStream.pushEncrypt(1);
+      assert.calledOnceWithExactly(encrypt, 1);
+    });
+
+    it('should pair when the peripheral lost the bond', () => {
+      const encrypt = fake();
+      aclStream.on('encrypt', encrypt);
+
+      aclStream.encrypt();
+      aclStream.pushEncrypt(0, 0x06);
+
+      assert.calledOnceWithExactly(keyStore.delete, 'c0:00:00:00:00:01', 'random');
+      assert.calledOnceWithExactly(aclStream._smp.sendPairingRequest);
+      assert.notCalled(encrypt);
+    });
+
+    it('should keep the bond when encryption fails otherwise', () => {
+      const encrypt = fake();
+      aclStream.on('encrypt', encrypt);
+
+      aclStream.encrypt();
+      aclStream.pushEncrypt(0, 0x3d); // MIC Failure
+
+      assert.notCalled(keyStore.delete);
+      assert.notCalled(aclStream._smp.sendPairingRequest);
+      assert.calledOnceWithExactly(encrypt, 0);
+      should(aclStream._encrypting).equal(false);
+    });
+
+    it('should report LE Start Encryption failing', async () => {
+      const error = new Error('Unknown Connection Identifier (0x2)');
+      const encryptFail = fake();
+      hci.startLeEncryption = fake.rejects(error);
+      aclStream.on('encryptFail', encryptFail);
+
+      aclStream.encrypt();
+      await new Promise((resolve) => setImmediate(resolve));
+
+      assert.calledOnceWithExactly(encryptFail, error);
+      should(aclStream._encrypting).equal(false);
+
+      aclStream.encrypt();
+      assert.calledTwice(hci.startLeEncryption);
+    });
+
+    it('should store the distributed keys', () => {
+      aclStream.onSmpKeys('keys');
+
+      assert.calledOnceWithExactly(keyStore.set, 'c0:00:00:00:00:01', 'random', 'keys');
+    });
+  });
+
   it('write', () => {
     const hci = fake.resolves();
     const handle = fake.resolves();
@@ -74,7 +157,25 @@ describe('hci-socket acl-stream', () => {
 
     aclStream.write('cid', 'data');
 
-    assert.calledOnceWithExactly(aclStream._hci.writeAclDataPkt, handle, 'cid', 'data');
+    assert.calledOnceWithExactly(aclStream._hci.writeAclDataPkt, handle, 'cid', 'data', undefined);
+  });
+
+  it('write with callback', () => {
+    const hci = fake.resolves();
+    const handle = fake.resolves();
+    const localAddressType = fake.resolves();
+    const localAddress = fake.resolves();
+    const remoteAddressType = fake.resolves();
+    const remoteAddress = fake.resolves();
+    const callback = fake();
+
+    const aclStream = new AclStream(hci, handle, localAddressType, localAddress, remoteAddressType, remoteAddress);
+
+    aclStream._hci.writeAclDataPkt = fake.resolves(null);
+
+    aclStream.write('cid', 'data', callback);
+
+    assert.calledOnceWithExactly(aclStream._hci.writeAclDataPkt, handle, 'cid', 'data', callback);
   });
 
   it('push data', () => {
@@ -180,9 +281,11 @@ describe('hci-socket acl-stream', () => {
 
     aclStream.onSmpEnd();
 
-    assert.calledThrice(aclStream._smp.removeListener);
+    assert.callCount(aclStream._smp.removeListener, 5);
     assert.calledWith(aclStream._smp.removeListener, 'stk', match.any);
     assert.calledWith(aclStream._smp.removeListener, 'fail', match.any);
+    assert.calledWith(aclStream._smp.removeListener, 'keys', match.any);
+    assert.calledWith(aclStream._smp.removeListener, 'securityRequest', match.any);
     assert.calledWith(aclStream._smp.removeListener, 'end', match.any);
   });
 });
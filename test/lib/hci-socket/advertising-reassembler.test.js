@@ -0,0 +1,185 @@
+const should = require('should');
+const sinon = require('sinon');
+
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const AdvertisingReassembler = require('../../../lib/hci-socket/advertising-reassembler');
+const FakeController = require('../../../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../../../lib/hci-socket/fake-peripheral');
+const Gap = require('../../../lib/hci-socket/gap');
+const Hci = require('../../../lib/hci-socket/hci');
+const ReplaySocket = require('../../../lib/hci-socket/replay-socket');
+
+describe('hci-socket advertising-reassembler', () => {
+  let clock;
+  let reassembler;
+
+  const COMPLETE = 0x00;
+  const INCOMPLETE = 0x01;
+  const TRUNCATED = 0x02;
+
+  beforeEach(() => {
+    clock = sinon.useFakeTimers();
+    reassembler = new AdvertisingReassembler({ timeout: 100, maxPending: 2 });
+  });
+
+  afterEach(() => {
+    clock.restore();
+  });
+
+  it('should join fragments into a buffer of its own', () => {
+    should(reassembler.push('a', 1, false, INCOMPLETE, Buffer.from([1, 2]))).be.null();
+    should(reassembler.push('a', 1, false, INCOMPLETE, Buffer.from([3]))).be.null();
+
+    const data = reassembler.push('a', 1, false, COMPLETE, Buffer.from([4]));
+    should(data).deepEqual(Buffer.from([1, 2, 3, 4]));
+
+    // the pooled buffer is reused for the next chain without touching it
+    reassembler.push('a', 1, false, INCOMPLETE, Buffer.from([9, 9, 9]));
+    should(data).deepEqual(Buffer.from([1, 2, 3, 4]));
+    should(reassembler._pool.length).equal(0);
+    should(reassembler.stats.fragments).equal(4);
+    should(reassembler.stats.reassembled).equal(1);
+  });
+
+  it('should keep advertisements and scan responses apart', () => {
+    reassembler.push('a', 1, false, INCOMPLETE, Buffer.from([1]));
+    reassembler.push('a', 1, true, INCOMPLETE, Buffer.from([2]));
+
+    should(reassembler.push('a', 1, true, COMPLETE, Buffer.from([3]))).deepEqual(
+      Buffer.from([2, 3])
+    );
+    should(reassembler.push('a', 1, false, COMPLETE, Buffer.from([4]))).deepEqual(
+      Buffer.from([1, 4])
+    );
+  });
+
+  it('should give out truncated data as far as it got', () => {
+    reassembler.push('a', 1, false, INCOMPLETE, Buffer.from([1]));
+
+    should(reassembler.push('a', 1, false, TRUNCATED, Buffer.from([2]))).deepEqual(
+      Buffer.from([1, 2])
+    );
+    should(reassembler.stats.truncated).equal(1);
+  });
+
+  it('should drop chains not completed in time', () => {
+    reassembler.push('a', 1, false, INCOMPLETE, Buffer.from([1]));
+    clock.tick(100);
+
+    const last = Buffer.from([2]);
+    should(reassembler.push('a', 1, false, COMPLETE, last)).equal(last);
+    should(reassembler.stats.expired).equal(1);
+    should(reassembler._pending.size).equal(0);
+  });
+
+  it('should take the buffer of the oldest chain beyond maxPending', () => {
+    reassembler.push('a', 1, false, INCOMPLETE, Buffer.from([1]));
+    reassembler.push('b', 1, false, INCOMPLETE, Buffer.from([2]));
+    reassembler.push('c', 1, false, INCOMPLETE, Buffer.from([3]));
+
+    should(reassembler.stats.evicted).equal(1);
+    should(Array.from(reassembler._pending.keys())).deepEqual(['b/1/0', 'c/1/0']);
+    should(reassembler.push('c', 1, false, COMPLETE, Buffer.from([4]))).deepEqual(
+      Buffer.from([3, 4])
+    );
+  });
+
+  it('should cap chains at the most an advertising set carries', () => {
+    reassembler.push('a', 1, false, INCOMPLETE, Buffer.alloc(1600));
+
+    const data = reassembler.push('a', 1, false, INCOMPLETE, Buffer.alloc(100));
+    should(data.length).equal(1650);
+    should(reassembler.stats.truncated).equal(1);
+  });
+
+  describe('with a recorded extended advertising stream', () => {
+    let file;
+
+    beforeEach(() => {
+      clock.restore();
+      file = path.join(os.tmpdir(), `noble-reassembly-${process.pid}-${Date.now()}.log`);
+    });
+
+    afterEach(() => {
+      if (fs.existsSync(file)) {
+        fs.unlinkSync(file);
+      }
+      clock = sinon.useFakeTimers();
+    });
+
+    const poweredOn = (hci) =>
+      new Promise((resolve) => {
+        hci.on('stateChange', (state) => state === 'poweredOn' && resolve());
+        hci.init();
+      });
+
+    // 3 devices with 400 bytes of manufacturer data each, in fragments of 100
+    const record = async () => {
+      const socket = new FakeController({
+        numCommandPackets: 4,
+        extendedFragmentSize: 100,
+        peripherals: [1, 2, 3].map(
+          (i) =>
+            new FakePeripheral({
+              address: `c0:00:00:00:00:0${i}`,
+              connectable: false,
+              sid: i,
+              advertisingInterval: 5,
+              advertisingData: Buffer.concat([
+                Buffer.from([0xc7, 0xff, 0x59, 0x00]),
+                Buffer.alloc(196, i),
+                Buffer.from([0xc7, 0xff, 0x59, 0x00]),
+                Buffer.alloc(196, i)
+              ])
+            })
+        )
+      });
+      const hci = new Hci({ socket, userChannel: true, extended: true, btsnoopFile: file });
+      const gap = new Gap(hci);
+
+      await poweredOn(hci);
+      gap.startScanning(true);
+      await new Promise((resolve) => setTimeout(resolve, 30));
+      gap.stopScanning();
+      await new Promise((resolve) => hci.closeBtsnoop(resolve));
+      socket.stop();
+    };
+
+    it('should parse each advertisement once, whole', async () => {
+      await record();
+
+      const socket = new ReplaySocket(file, { speed: 'max' });
+      const hci = new Hci({ socket, userChannel: true, extended: true });
+      const gap = new Gap(hci);
+      const parseServices = sinon.spy(gap, 'parseServices');
+      const discovered = [];
+
+      gap.on('discover', (status, address, addressType, connectable, advertisement) => {
+        discovered.push([address, advertisement.manufacturerData]);
+      });
+
+      const ended = new Promise((resolve) => socket.once('end', resolve));
+      hci.init();
+      await ended;
+
+      const { fragments, reassembled } = gap.reassembler.stats;
+
+      // the capture may end in the middle of an advertisement
+      should(reassembled).be.aboveOrEqual(3);
+      should(fragments - reassembled * 4).be.below(4);
+      should(discovered.length).equal(reassembled);
+      should(parseServices.callCount).equal(reassembled);
+
+      // the second Manufacturer Specific Data, split over fragments 3 and 4
+      for (const [address, manufacturerData] of discovered) {
+        const i = parseInt(address.slice(-1), 10);
+        should(manufacturerData).deepEqual(
+          Buffer.concat([Buffer.from([0x59, 0x00]), Buffer.alloc(196, i)])
+        );
+      }
+    });
+  });
+});
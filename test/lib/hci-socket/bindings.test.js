@@ -1,6 +1,7 @@
 const proxyquire = require('proxyquire').noCallThru();
 const should = require('should');
 const sinon = require('sinon');
+const { EventEmitter } = require('events');
 const { assert, fake } = sinon;
 
 describe('hci-socket bindings', () => {
@@ -12,6 +13,7 @@ describe('hci-socket bindings', () => {
   const Gatt = sinon.stub();
   Gatt.prototype.on = gattOnSpy;
   Gatt.prototype.exchangeMtu = gattExchangeMtuSpy;
+  Gatt.prototype.writeClientFeatures = sinon.spy();
 
   const createLeConnSpy = sinon.spy();
   const Hci = sinon.stub();
@@ -23,6 +25,8 @@ describe('hci-socket bindings', () => {
   const Signaling = sinon.stub();
   Signaling.prototype.on = signalingOnSpy;
 
+  const ConnectionScheduler = require('../../../lib/hci-socket/connection-scheduler');
+
   const Bindings = proxyquire('../../../lib/hci-socket/bindings', {
     './acl-stream': AclStream,
     './gap': Gap,
@@ -35,6 +39,14 @@ describe('hci-socket bindings', () => {
   let clock;
   const options = {};
 
+  // as if the peripherals had been heard advertising
+  const discover = (...uuids) => {
+    for (const uuid of uuids) {
+      bindings._addresses[uuid] = 'address';
+      bindings._addresseTypes[uuid] = 'random';
+    }
+  };
+
   beforeEach(() => {
     sinon.stub(process, 'on');
     sinon.stub(process, 'exit');
@@ -57,8 +69,7 @@ describe('hci-socket bindings', () => {
     should(bindings._addresseTypes).deepEqual({});
     should(bindings._connectable).deepEqual({});
 
-    should(bindings._pendingConnectionUuid).eql(null);
-    should(bindings._connectionQueue).deepEqual([]);
+    should(bindings.connectionScheduler).instanceOf(ConnectionScheduler);
 
     should(bindings._handles).deepEqual({});
     should(bindings._gatts).deepEqual({});
@@ -121,6 +132,16 @@ describe('hci-socket bindings', () => {
       assert.calledOnce(bindings._gap.startScanning);
       assert.calledWith(bindings._gap.startScanning, true);
     });
+
+    it('with a scan filter', () => {
+      bindings._gap.startScanning = fake.resolves(null);
+
+      const filter = { manufacturerId: 0x0059 };
+      bindings.startScanning(undefined, false, filter);
+
+      should(bindings.supportsScanFilter).equal(true);
+      assert.calledOnceWithExactly(bindings._gap.startScanning, false, filter);
+    });
   });
 
   it('stopScanning', () => {
@@ -132,15 +153,17 @@ describe('hci-socket bindings', () => {
   });
 
   describe('connect', () => {
-    it('missing peripheral, no queue', () => {
+    it('missing peripheral', () => {
+      const connectCallback = sinon.spy();
       bindings._hci.createLeConn = fake.resolves(null);
+      bindings.on('connect', connectCallback);
 
       bindings.connect('peripheralUuid', 'parameters');
 
-      should(bindings._pendingConnectionUuid).eql('peripheralUuid');
+      should(bindings.connectionScheduler.isPending('peripheralUuid')).equal(false);
 
-      assert.calledOnce(bindings._hci.createLeConn);
-      assert.calledWith(bindings._hci.createLeConn, undefined, undefined, 'parameters');
+      assert.notCalled(bindings._hci.createLeConn);
+      assert.calledOnceWithMatch(connectCallback, 'peripheralUuid', sinon.match({ message: 'Peripheral not discovered' }));
     });
 
     it('existing peripheral, no queue', () => {
@@ -154,18 +177,131 @@ describe('hci-socket bindings', () => {
 
       bindings.connect('peripheralUuid', 'parameters');
 
-      should(bindings._pendingConnectionUuid).eql('peripheralUuid');
+      should(bindings.connectionScheduler.isPending('peripheralUuid')).equal(true);
 
       assert.calledOnce(bindings._hci.createLeConn);
       assert.calledWith(bindings._hci.createLeConn, 'address', 'addressType', 'parameters');
     });
 
-    it('missing peripheral, with queue', () => {
-      bindings._pendingConnectionUuid = 'pending-uuid';
+    it('existing peripheral, with queue', () => {
+      bindings._hci.createLeConn = fake.resolves(null);
+      discover('pending-uuid', 'peripheralUuid');
+
+      bindings.connect('pending-uuid', 'parameters');
+      bindings.connect('peripheralUuid', 'parameters');
+
+      assert.calledOnce(bindings._hci.createLeConn);
+      should(bindings.connectionScheduler.isPending('peripheralUuid')).equal(true);
+    });
+
+    it('should keep the link options to ask for', () => {
+      bindings._hci.createLeConn = fake.resolves(null);
+      bindings._mtu = 247;
+      discover('peripheralUuid', 'otherUuid');
+
+      bindings.connect('peripheralUuid', { mtu: 517, dataLength: false, phy: 'coded' });
+      bindings.connect('otherUuid', {});
+
+      should(bindings._connectOptions).deepEqual({
+        peripheralUuid: { mtu: 517, dataLength: false, phy: 'coded' },
+        otherUuid: { mtu: 247, dataLength: 251, phy: '2m' }
+      });
+    });
+  });
+
+  describe('setScanPolicy', () => {
+    it('should pause scanning while connecting', () => {
+      bindings._hci.createLeConn = fake.resolves(null);
+      bindings._gap.isScanning = fake.returns(true);
+      bindings._gap.setScanDutyCycle = sinon.spy();
+      bindings._gap.pauseScanning = sinon.spy();
 
+      bindings.setScanPolicy('aggressive');
+      discover('peripheralUuid');
       bindings.connect('peripheralUuid', 'parameters');
 
-      should(bindings._connectionQueue).deepEqual([{ id: 'peripheralUuid', params: 'parameters' }]);
+      should(bindings.scanScheduler.policy).equal('aggressive');
+      assert.calledOnceWithExactly(bindings._gap.setScanDutyCycle, 0x60, 0x60);
+      assert.calledOnce(bindings._gap.pauseScanning);
+    });
+
+    it('should throw on an unknown policy', () => {
+      should(() => bindings.setScanPolicy('sometimes')).throw('unknown scan policy sometimes');
+    });
+  });
+
+  describe('syncPeriodicAdvertising', () => {
+    it('should need extended scans', () => {
+      const periodicSync = sinon.spy();
+      bindings.on('periodicSync', periodicSync);
+
+      bindings.syncPeriodicAdvertising('peripheralUuid');
+
+      assert.calledOnce(periodicSync);
+      should(periodicSync.args[0][1].message).equal(
+        'Periodic advertising needs the extended option'
+      );
+    });
+
+    it('should sync to a train heard in extended reports', () => {
+      bindings = new Bindings({ extended: true });
+      bindings._hci.createPeriodicSync = sinon.spy();
+      bindings._addresses = { peripheralUuid: 'address' };
+      bindings._addresseTypes = { peripheralUuid: 'random' };
+
+      bindings.onExtendedAdvertisingReport(0, 0, 'address', 'random', 127, -50, Buffer.alloc(0), undefined, 3, 100);
+      bindings.syncPeriodicAdvertising('peripheralUuid');
+
+      // lost after 6 intervals, in 10 ms units
+      assert.calledOnceWithExactly(bindings._hci.createPeriodicSync, 3, 'address', 'random', 60);
+    });
+  });
+
+  describe('autoReconnect', () => {
+    beforeEach(() => {
+      bindings._hci.createLeConn = sinon.spy();
+      bindings._hci.clearFilterAcceptList = sinon.spy();
+      bindings._hci.addToFilterAcceptList = sinon.spy();
+      bindings._hci.cancelConnect = sinon.spy();
+      bindings._addresses = { peripheralUuid: 'address' };
+      bindings._addresseTypes = { peripheralUuid: 'random' };
+    });
+
+    it('should wait for the peripheral on the accept list', () => {
+      bindings.autoReconnect('peripheralUuid', { mtu: 517 });
+
+      assert.calledOnceWithExactly(bindings._hci.addToFilterAcceptList, 'address', 'random');
+      assert.calledOnceWithExactly(bindings._hci.createLeConn, null, null, {}, true);
+      should(bindings._connectOptions.peripheralUuid.mtu).equal(517);
+    });
+
+    it('should not put a missing peripheral on the accept list', () => {
+      const connectCallback = sinon.spy();
+      bindings.on('connect', connectCallback);
+
+      bindings.autoReconnect('otherUuid', {});
+
+      assert.notCalled(bindings._hci.addToFilterAcceptList);
+      assert.notCalled(bindings._hci.createLeConn);
+      assert.calledOnceWithMatch(connectCallback, 'otherUuid', sinon.match({ message: 'Peripheral not discovered' }));
+    });
+
+    it('should cancel the accept list attempt once stopped', () => {
+      bindings.autoReconnect('peripheralUuid');
+      bindings.stopAutoReconnect('peripheralUuid');
+
+      assert.calledOnce(bindings._hci.cancelConnect);
+    });
+
+    it('should not report the cancelled accept list attempt', () => {
+      const connectCallback = sinon.spy();
+      bindings.on('connect', connectCallback);
+
+      bindings.autoReconnect('peripheralUuid');
+      bindings.stopAutoReconnect('peripheralUuid');
+      bindings.onLeConnComplete(0x02, 0, 0, 'public', '00:00:00:00:00:00');
+
+      assert.notCalled(connectCallback);
     });
   });
 
@@ -193,42 +329,48 @@ describe('hci-socket bindings', () => {
   });
 
   describe('cancel', () => {
-    it('missing handle', () => {
-      bindings._connectionQueue.push({ id: 'anotherPeripheralUuid' });
-
+    beforeEach(() => {
+      bindings._hci.createLeConn = fake.resolves(null);
       bindings._hci.cancelConnect = fake.resolves(null);
+    });
 
+    it('not connecting', () => {
       bindings.cancelConnect('peripheralUuid');
 
-      should(bindings._connectionQueue).size(1);
-
-      assert.calledOnce(bindings._hci.cancelConnect);
-      assert.calledWith(bindings._hci.cancelConnect, undefined);
+      assert.notCalled(bindings._hci.cancelConnect);
     });
 
-    it('existing handle', () => {
-      bindings._handles = {
-        peripheralUuid: 'handle'
-      };
-      bindings._connectionQueue.push({ id: 'anotherPeripheralUuid' });
-      bindings._connectionQueue.push({ id: 'peripheralUuid' });
-      bindings._hci.cancelConnect = fake.resolves(null);
+    it('queued', () => {
+      discover('anotherPeripheralUuid', 'peripheralUuid');
+      bindings.connect('anotherPeripheralUuid');
+      bindings.connect('peripheralUuid');
 
       bindings.cancelConnect('peripheralUuid');
 
-      should(bindings._connectionQueue).size(1);
+      should(bindings.connectionScheduler.isPending('peripheralUuid')).equal(false);
+      should(bindings.connectionScheduler.isPending('anotherPeripheralUuid')).equal(true);
 
-      assert.calledOnce(bindings._hci.cancelConnect);
-      assert.calledWith(bindings._hci.cancelConnect, 'handle');
+      assert.notCalled(bindings._hci.cancelConnect);
+    });
+
+    it('connecting', () => {
+      discover('peripheralUuid');
+      bindings.connect('peripheralUuid');
+
+      bindings.cancelConnect('peripheralUuid');
+
+      assert.calledOnceWithExactly(bindings._hci.cancelConnect);
     });
   });
 
   it('reset', () => {
     bindings._hci.reset = fake.resolves(null);
+    bindings.scanScheduler.stop = sinon.spy();
 
     bindings.reset();
 
     assert.calledOnce(bindings._hci.reset);
+    assert.calledOnce(bindings.scanScheduler.stop);
   });
 
   describe('updateRssi', () => {
@@ -257,12 +399,14 @@ describe('hci-socket bindings', () => {
   it('init', () => {
     bindings._gap.on = fake.resolves(null);
     bindings._hci.on = fake.resolves(null);
+    bindings._hci.prependListener = fake.resolves(null);
     bindings._hci.init = fake.resolves(null);
 
     bindings.init();
 
     assert.callCount(bindings._gap.on, 4);
-    assert.callCount(bindings._hci.on, 8);
+    assert.callCount(bindings._hci.on, 11);
+    assert.calledOnce(bindings._hci.prependListener);
     assert.calledOnce(bindings._hci.init);
 
     assert.calledTwice(process.on);
@@ -271,10 +415,12 @@ describe('hci-socket bindings', () => {
   describe('onExit', () => {
     it('no handles', () => {
       bindings._gap.stopScanning = fake.resolves(null);
+      bindings.scanScheduler.stop = sinon.spy();
 
       bindings.onExit();
 
       assert.calledOnce(bindings._gap.stopScanning);
+      assert.calledOnce(bindings.scanScheduler.stop);
     });
 
     it('with handles', () => {
@@ -587,7 +733,7 @@ describe('hci-socket bindings', () => {
       assert.calledOnce(Gatt);
       assert.calledOnce(Signaling);
 
-      assert.callCount(gattOnSpy, 17);
+      assert.callCount(gattOnSpy, 21);
       assert.calledWithMatch(gattOnSpy, 'mtu', sinon.match.func);
       assert.calledWithMatch(gattOnSpy, 'servicesDiscover', sinon.match.func);
       assert.calledWithMatch(gattOnSpy, 'servicesDiscovered', sinon.match.func);
@@ -605,14 +751,28 @@ describe('hci-socket bindings', () => {
       assert.calledWithMatch(gattOnSpy, 'handleRead', sinon.match.func);
       assert.calledWithMatch(gattOnSpy, 'handleWrite', sinon.match.func);
       assert.calledWithMatch(gattOnSpy, 'handleNotify', sinon.match.func);
+      assert.calledWithMatch(gattOnSpy, 'timeout', sinon.match.func);
+      assert.calledWithMatch(gattOnSpy, 'readMultiple', sinon.match.func);
+      assert.calledWithMatch(gattOnSpy, 'databaseDiscover', sinon.match.func);
+      assert.calledWithMatch(gattOnSpy, 'eattSupported', sinon.match.func);
 
-      assert.calledOnceWithMatch(signalingOnSpy, 'connectionParameterUpdateRequest', sinon.match.func);
+      assert.callCount(signalingOnSpy, 2);
+      assert.calledWithMatch(signalingOnSpy, 'connectionParameterUpdateRequest', sinon.match.func);
+      assert.calledWithMatch(signalingOnSpy, 'channelOpen', sinon.match.func);
 
       assert.calledOnceWithExactly(gattExchangeMtuSpy);
+      // Enhanced ATT bearers are opt-in
+      assert.calledOnceWithExactly(Gatt.prototype.writeClientFeatures, false);
 
       assert.calledOnceWithExactly(connectCallback, 'addresssplitbyseparator', null);
+    });
 
-      should(bindings._pendingConnectionUuid).equal(null);
+    it('with Enhanced ATT bearers asked for', () => {
+      bindings._eattBearers = 3;
+      bindings.onLeConnComplete(0, 'handle', 0, 'addressType', 'address:split:by:separator');
+      clock.tick(0);
+
+      assert.calledOnceWithExactly(Gatt.prototype.writeClientFeatures, true);
     });
 
     it('with invalid status on master node', () => {
@@ -624,7 +784,8 @@ describe('hci-socket bindings', () => {
 
       const connectCallback = sinon.spy();
 
-      bindings._pendingConnectionUuid = 'pending_uuid';
+      discover('pending_uuid');
+      bindings.connect('pending_uuid');
       bindings.on('connect', connectCallback);
       bindings.onLeConnComplete(status, handle, role, addressType, address);
 
@@ -634,7 +795,7 @@ describe('hci-socket bindings', () => {
 
       assert.calledOnceWithMatch(connectCallback, 'pending_uuid', sinon.match({ message: 'custom mapper (0x1)' }));
 
-      should(bindings._pendingConnectionUuid).equal(null);
+      should(bindings.connectionScheduler.isPending('pending_uuid')).equal(false);
     });
 
     it('with unmapped status on master node', () => {
@@ -646,7 +807,8 @@ describe('hci-socket bindings', () => {
 
       const connectCallback = sinon.spy();
 
-      bindings._pendingConnectionUuid = 'pending_uuid';
+      discover('pending_uuid');
+      bindings.connect('pending_uuid');
       bindings.on('connect', connectCallback);
       bindings.onLeConnComplete(status, handle, role, addressType, address);
 
@@ -656,7 +818,7 @@ describe('hci-socket bindings', () => {
 
       assert.calledOnceWithExactly(connectCallback, 'pending_uuid', sinon.match({ message: 'HCI Error: Unknown (0x2)' }));
 
-      should(bindings._pendingConnectionUuid).equal(null);
+      should(bindings.connectionScheduler.isPending('pending_uuid')).equal(false);
     });
 
     it('with connection queue', () => {
@@ -668,9 +830,12 @@ describe('hci-socket bindings', () => {
 
       const connectCallback = sinon.spy();
 
-      bindings._connectionQueue = [{ id: 'queuedId', params: { p1: 'p1' } }];
-      bindings._addresses = { queuedId: 'queuedAddress' };
-      bindings._addresseTypes = { queuedId: 'queuedAddressType' };
+      bindings._addresses = { addresssplitbyseparator: address, queuedId: 'queuedAddress' };
+      bindings._addresseTypes = { addresssplitbyseparator: addressType, queuedId: 'queuedAddressType' };
+      bindings.connect('addresssplitbyseparator');
+      bindings.connect('queuedId', { p1: 'p1' });
+      createLeConnSpy.resetHistory();
+
       bindings.on('connect', connectCallback);
       bindings.onLeConnComplete(status, handle, role, addressType, address);
 
@@ -678,7 +843,38 @@ describe('hci-socket bindings', () => {
 
       assert.calledOnceWithExactly(createLeConnSpy, 'queuedAddress', 'queuedAddressType', { p1: 'p1' });
 
-      should(bindings._pendingConnectionUuid).equal('queuedId');
+      should(bindings.connectionScheduler.isPending('queuedId')).equal(true);
+    });
+
+    it('should keep a retried attempt pending', () => {
+      const connectCallback = sinon.spy();
+
+      bindings._hci.cancelConnect = sinon.spy();
+      discover('pending_uuid');
+      bindings.connect('pending_uuid');
+      bindings.on('connect', connectCallback);
+
+      bindings.onLeConnComplete(0x3e, 'handle', 0, 'addressType', 'address');
+
+      assert.notCalled(connectCallback);
+      should(bindings.connectionScheduler.isPending('pending_uuid')).equal(true);
+    });
+
+    it('with a timed out attempt', () => {
+      const connectCallback = sinon.spy();
+
+      bindings._hci.cancelConnect = sinon.spy();
+      bindings.connectionScheduler._retries = 0;
+      discover('pending_uuid');
+      bindings.connect('pending_uuid');
+      bindings.on('connect', connectCallback);
+
+      clock.tick(10000);
+      assert.calledOnce(bindings._hci.cancelConnect);
+
+      bindings.onLeConnComplete(0x02, 'handle', 0, 'addressType', 'address');
+
+      assert.calledOnceWithMatch(connectCallback, 'pending_uuid', sinon.match({ message: 'Connection attempt timed out (0x2)' }));
     });
   });
 
@@ -737,6 +933,158 @@ describe('hci-socket bindings', () => {
     });
   });
 
+  describe('tuneLink', () => {
+    beforeEach(() => {
+      bindings._hci.setDataLength = sinon.spy();
+      bindings._hci.setPhy = sinon.spy();
+    });
+
+    it('should ask for the longest PDUs and the 2M PHY', () => {
+      bindings._hci.hciVersion = 0x09;
+
+      bindings.tuneLink(0x0040, { dataLength: 251, phy: '2m' });
+
+      assert.calledOnceWithExactly(bindings._hci.setDataLength, 0x0040, 251);
+      assert.calledOnceWithExactly(bindings._hci.setPhy, 0x0040, 0x03);
+    });
+
+    it('should only ask for what the controller can have', () => {
+      bindings._hci.hciVersion = 0x08;
+
+      bindings.tuneLink(0x0040, { dataLength: 1000, phy: '2m' });
+
+      assert.calledOnceWithExactly(bindings._hci.setDataLength, 0x0040, 251);
+      assert.notCalled(bindings._hci.setPhy);
+    });
+
+    it('should leave the link alone when told to', () => {
+      bindings._hci.hciVersion = 0x0c;
+
+      bindings.tuneLink(0x0040, { dataLength: false, phy: '1m' });
+
+      assert.notCalled(bindings._hci.setDataLength);
+      assert.notCalled(bindings._hci.setPhy);
+    });
+  });
+
+  describe('openL2capChannel', () => {
+    it('should open the channel on the connection', () => {
+      const signaling = { openChannel: sinon.spy() };
+      bindings._handles.uuid = 'handle';
+      bindings._signalings.handle = signaling;
+
+      bindings.openL2capChannel('uuid', 0x0080, { credits: 4 });
+
+      assert.calledOnceWithExactly(signaling.openChannel, 0x0080, { credits: 4 });
+    });
+
+    it('should emit the channel for the peripheral', () => {
+      const callback = sinon.spy();
+      bindings._handles.handle = 'uuid';
+      bindings.on('l2capChannelOpen', callback);
+
+      bindings.onL2capChannelOpen('handle', 0x0080, null, 'channel');
+
+      assert.calledOnceWithExactly(callback, 'uuid', 0x0080, null, 'channel');
+    });
+  });
+
+  describe('onEattSupported', () => {
+    let signaling;
+    let gatt;
+    let aclStream;
+
+    beforeEach(() => {
+      signaling = { openEnhancedChannels: sinon.spy() };
+      gatt = { addBearer: sinon.spy() };
+      aclStream = new EventEmitter();
+      bindings._handles.aabbccddeeff = 'handle';
+      bindings._signalings.handle = signaling;
+      bindings._gatts.handle = gatt;
+      bindings._aclStreams.handle = aclStream;
+      bindings._eattBearers = 3;
+    });
+
+    it('should hand the opened channels to gatt as bearers', () => {
+      bindings.onEattSupported('aa:bb:cc:dd:ee:ff', 517);
+
+      assert.calledOnceWithMatch(signaling.openEnhancedChannels, 0x0027, 3, { mtu: 517 });
+
+      signaling.openEnhancedChannels.firstCall.args[3](null, ['one', 'two']);
+
+      assert.calledTwice(gatt.addBearer);
+      assert.calledWithExactly(gatt.addBearer, 'one');
+      assert.calledWithExactly(gatt.addBearer, 'two');
+    });
+
+    it('should try again once encrypted', () => {
+      const error = new Error('Insufficient encryption (0x8)');
+      error.result = 0x0008;
+
+      bindings.onEattSupported('aa:bb:cc:dd:ee:ff', 517);
+      signaling.openEnhancedChannels.firstCall.args[3](error, []);
+
+      assert.notCalled(gatt.addBearer);
+
+      aclStream.emit('encrypt', 1);
+
+      assert.calledTwice(signaling.openEnhancedChannels);
+    });
+
+    it('should give up when the peer has no EATT', () => {
+      const error = new Error('LE_PSM not supported (0x2)');
+      error.result = 0x0002;
+
+      bindings.onEattSupported('aa:bb:cc:dd:ee:ff', 517);
+      signaling.openEnhancedChannels.firstCall.args[3](error, []);
+
+      should(aclStream.listenerCount('encrypt')).equal(0);
+    });
+  });
+
+  describe('interval manager', () => {
+    beforeEach(() => {
+      bindings = new Bindings({ intervalManager: { relaxAfter: 1000 } });
+    });
+
+    it('should only be there when asked for', () => {
+      should(new Bindings({}).intervalManager).equal(null);
+      should(bindings.intervalManager._relaxAfter).equal(1000);
+    });
+
+    it('should hear of connection updates', () => {
+      bindings.intervalManager.onConnectionUpdate = sinon.spy();
+
+      bindings.onLeConnUpdateComplete(0, 0x0040, 50, 0, 420);
+
+      assert.calledOnceWithExactly(
+        bindings.intervalManager.onConnectionUpdate,
+        0,
+        0x0040,
+        50,
+        0,
+        420
+      );
+    });
+
+    it('should forget disconnected handles', () => {
+      bindings.intervalManager.removeConnection = sinon.spy();
+
+      bindings._handles.handle = 'uuid';
+      bindings._handles.uuid = 'handle';
+      bindings._aclStreams.handle = [];
+      bindings._gatts.handle = { removeAllListeners: sinon.spy() };
+      bindings._signalings.handle = { removeAllListeners: sinon.spy() };
+
+      bindings.onDisconnComplete('handle', 'reason');
+
+      assert.calledOnceWithExactly(
+        bindings.intervalManager.removeConnection,
+        'handle'
+      );
+    });
+  });
+
   describe('onEncryptChange', () => {
     it('missing handle', () => {
       const handle = 'handle';
@@ -760,9 +1108,9 @@ describe('hci-socket bindings', () => {
       };
 
       bindings._aclStreams[handle] = aclSpy;
-      bindings.onEncryptChange(handle, encrypt);
+      bindings.onEncryptChange(handle, encrypt, 0x06);
 
-      assert.calledOnceWithExactly(aclSpy.pushEncrypt, encrypt);
+      assert.calledOnceWithExactly(aclSpy.pushEncrypt, encrypt, 0x06);
     });
 
     it('existing handle no encrypt', () => {
@@ -774,7 +1122,7 @@ describe('hci-socket bindings', () => {
       bindings._aclStreams[handle] = aclSpy;
       bindings.onEncryptChange(handle);
 
-      assert.calledOnceWithExactly(aclSpy.pushEncrypt, undefined);
+      assert.calledOnceWithExactly(aclSpy.pushEncrypt, undefined, undefined);
     });
   });
 
@@ -789,6 +1137,16 @@ describe('hci-socket bindings', () => {
     assert.calledOnceWithExactly(callback, 'thisisanaddress', rssi);
   });
 
+  it('onAttTimeout', () => {
+    const address = 'this:is:an:address';
+
+    bindings._hci.disconnect = sinon.spy();
+    bindings._handles.thisisanaddress = 'handle';
+    bindings.onAttTimeout(address, 0x0a);
+
+    assert.calledOnceWithExactly(bindings._hci.disconnect, 'handle');
+  });
+
   it('onRssiRead', () => {
     const handle = 'handle';
     const rssi = 'rssi';
@@ -1607,6 +1965,97 @@ describe('hci-socket bindings', () => {
     assert.calledOnceWithExactly(callback, 'thisisanaddress', serviceUuid, characteristicUuid, descriptorUuid);
   });
 
+  describe('discoverDatabase', () => {
+    it('missing gatt', () => {
+      const peripheralUuid = 'uuid';
+      const handle = 'handle';
+      const anotherHandle = 'another_handle';
+      const gatt = {
+        discoverDatabase: sinon.spy()
+      };
+
+      bindings._handles[peripheralUuid] = anotherHandle;
+      bindings._gatts[handle] = gatt;
+      bindings.discoverDatabase(peripheralUuid);
+
+      assert.notCalled(gatt.discoverDatabase);
+    });
+
+    it('existing gatt', () => {
+      const peripheralUuid = 'uuid';
+      const handle = 'handle';
+      const gatt = {
+        discoverDatabase: sinon.spy()
+      };
+
+      bindings._handles[peripheralUuid] = handle;
+      bindings._gatts[handle] = gatt;
+      bindings.discoverDatabase(peripheralUuid, true);
+
+      assert.calledOnceWithExactly(gatt.discoverDatabase, true);
+    });
+  });
+
+  it('onDatabaseDiscover', () => {
+    const address = 'this:is:an:address';
+    const services = 'services';
+    const callback = sinon.spy();
+
+    bindings.on('databaseDiscover', callback);
+    bindings.onDatabaseDiscover(address, services);
+
+    assert.calledOnceWithExactly(callback, 'thisisanaddress', services);
+  });
+
+  describe('readMultiple', () => {
+    it('missing gatt', () => {
+      const peripheralUuid = 'uuid';
+      const handle = 'handle';
+      const anotherHandle = 'another_handle';
+      const characteristics = [{ serviceUuid: 'serviceUuid', characteristicUuid: 'characteristicUuid' }];
+      const gatt = {
+        readMultiple: sinon.spy()
+      };
+
+      const callback = sinon.spy();
+
+      bindings._handles[peripheralUuid] = anotherHandle;
+      bindings._gatts[handle] = gatt;
+      bindings.on('readMultiple', callback);
+      bindings.readMultiple(peripheralUuid, characteristics, 1);
+
+      assert.notCalled(gatt.readMultiple);
+      should(callback.firstCall.args.slice(0, 2)).deepEqual([peripheralUuid, 1]);
+      should(callback.firstCall.args[2].message).equal('Peripheral not connected');
+    });
+
+    it('existing gatt', () => {
+      const peripheralUuid = 'uuid';
+      const handle = 'handle';
+      const characteristics = [{ serviceUuid: 'serviceUuid', characteristicUuid: 'characteristicUuid' }];
+      const gatt = {
+        readMultiple: sinon.spy()
+      };
+
+      bindings._handles[peripheralUuid] = handle;
+      bindings._gatts[handle] = gatt;
+      bindings.readMultiple(peripheralUuid, characteristics, 1);
+
+      assert.calledOnceWithExactly(gatt.readMultiple, characteristics, 1);
+    });
+  });
+
+  it('onReadMultiple', () => {
+    const address = 'this:is:an:address';
+    const values = 'values';
+    const callback = sinon.spy();
+
+    bindings.on('readMultiple', callback);
+    bindings.onReadMultiple(address, 1, null, values);
+
+    assert.calledOnceWithExactly(callback, 'thisisanaddress', 1, null, values);
+  });
+
   describe('readHandle', () => {
     it('missing gatt', () => {
       const peripheralUuid = 'uuid';
@@ -0,0 +1,89 @@
+const should = require('should');
+
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const btsnoop = require('../../../lib/hci-socket/btsnoop');
+
+describe('hci-socket btsnoop', () => {
+  let file;
+
+  beforeEach(() => {
+    file = path.join(
+      os.tmpdir(),
+      `noble-btsnoop-${process.pid}-${Date.now()}.log`
+    );
+  });
+
+  afterEach(() => {
+    if (fs.existsSync(file)) {
+      fs.unlinkSync(file);
+    }
+  });
+
+  const close = (writer) =>
+    new Promise((resolve) => writer.close(resolve));
+
+  it('should write a btsnoop header', async () => {
+    const writer = new btsnoop.BtsnoopWriter(file);
+    await close(writer);
+
+    const data = fs.readFileSync(file);
+    should(data.toString('hex')).equal('6274736e6f6f700000000001000003ea');
+  });
+
+  it('should round trip records', async () => {
+    const command = Buffer.from('01030c00', 'hex');
+    const event = Buffer.from('040e0401030c00', 'hex');
+    const acl = Buffer.from('0240000700030004000a0300', 'hex');
+
+    const writer = new btsnoop.BtsnoopWriter(file);
+    writer.write(command, false);
+    writer.write(event, true);
+    writer.write(acl, true);
+    await close(writer);
+
+    const records = btsnoop.read(file);
+
+    should(records).have.length(3);
+    should(records[0].packet).deepEqual(command);
+    should(records[0].received).equal(false);
+    should(records[1].packet).deepEqual(event);
+    should(records[1].received).equal(true);
+    should(records[2].packet).deepEqual(acl);
+    should(records[2].timestamp).be.aboveOrEqual(records[0].timestamp);
+    should(Math.abs(records[0].timestamp / 1000 - Date.now())).be.below(
+      60000
+    );
+  });
+
+  it('should flush when the chunk is full', async () => {
+    const writer = new btsnoop.BtsnoopWriter(file, { flushSize: 32 });
+    const packet = Buffer.alloc(20, 0x02);
+
+    for (let i = 0; i < 10; i++) {
+      writer.write(packet, true);
+    }
+    await close(writer);
+
+    should(btsnoop.read(file)).have.length(10);
+  });
+
+  it('should set the command/event flag', async () => {
+    const writer = new btsnoop.BtsnoopWriter(file);
+    writer.write(Buffer.from('01030c00', 'hex'), false);
+    writer.write(Buffer.from('02400000', 'hex'), false);
+    await close(writer);
+
+    const data = fs.readFileSync(file);
+    should(data.readUInt32BE(16 + 8)).equal(0x02);
+    should(data.readUInt32BE(16 + 24 + 4 + 8)).equal(0x00);
+  });
+
+  it('should reject other files', () => {
+    should(() => btsnoop.parse(Buffer.from('not a capture'))).throw(
+      'Not a btsnoop file'
+    );
+  });
+});
@@ -0,0 +1,267 @@
+const should = require('should');
+const sinon = require('sinon');
+
+const { assert } = sinon;
+
+const ConnectionScheduler = require('../../../lib/hci-socket/connection-scheduler');
+
+describe('hci-socket connection-scheduler', () => {
+  let clock;
+  let hci;
+  let scheduler;
+
+  // the uuid the controller is connecting to
+  const connecting = () =>
+    hci.createLeConn.lastCall && hci.createLeConn.lastCall.args[0];
+
+  beforeEach(() => {
+    clock = sinon.useFakeTimers();
+    hci = {
+      createLeConn: sinon.spy(),
+      cancelConnect: sinon.spy(),
+      clearFilterAcceptList: sinon.spy(),
+      addToFilterAcceptList: sinon.spy()
+    };
+    scheduler = new ConnectionScheduler(hci, {
+      attemptTimeout: 1000,
+      retries: 2,
+      backoff: { base: 100, max: 400 },
+      random: () => 1
+    });
+  });
+
+  afterEach(() => {
+    scheduler.stop();
+    clock.restore();
+  });
+
+  it('should have one attempt in flight', () => {
+    scheduler.connect('a', 'a', 'random', { minInterval: 6 });
+    scheduler.connect('b', 'b', 'public');
+
+    assert.calledOnceWithExactly(hci.createLeConn, 'a', 'random', { minInterval: 6 });
+
+    should(scheduler.onConnComplete(0)).deepEqual({ uuid: 'a', done: true, timedOut: false });
+    scheduler.next();
+
+    assert.calledTwice(hci.createLeConn);
+    should(connecting()).equal('b');
+  });
+
+  it('should go by priority, then in order', () => {
+    scheduler.connect('busy', 'busy');
+    scheduler.connect('a', 'a');
+    scheduler.connect('b', 'b');
+    scheduler.connect('trainer', 'trainer', 'random', { priority: 1 });
+
+    const order = [];
+    for (let i = 0; i < 4; i++) {
+      order.push(scheduler.onConnComplete(0).uuid);
+      scheduler.next();
+    }
+
+    should(order).deepEqual(['busy', 'trainer', 'a', 'b']);
+  });
+
+  it('should cancel attempts past their deadline and retry them', () => {
+    const retry = sinon.spy();
+    scheduler.on('retry', retry);
+
+    scheduler.connect('a', 'a');
+    clock.tick(999);
+    assert.notCalled(hci.cancelConnect);
+
+    clock.tick(1);
+    assert.calledOnce(hci.cancelConnect);
+    should(scheduler.stats.timeouts).equal(1);
+
+    // Unknown Connection Identifier, for the cancelled attempt
+    should(scheduler.onConnComplete(0x02)).deepEqual({ uuid: 'a', done: false, timedOut: true });
+    assert.calledOnceWithExactly(retry, 'a', { attempt: 1, delay: 100, status: 0x02, timedOut: true });
+
+    scheduler.next();
+    assert.calledOnce(hci.createLeConn);
+
+    clock.tick(100);
+    assert.calledTwice(hci.createLeConn);
+  });
+
+  it('should back off exponentially with jitter', () => {
+    scheduler._random = () => 0;
+    should(scheduler.backoff(1)).equal(50);
+    should(scheduler.backoff(2)).equal(100);
+
+    scheduler._random = () => 0.5;
+    should(scheduler.backoff(3)).equal(300);
+    should(scheduler.backoff(10)).equal(300);
+  });
+
+  it('should requeue failed devices behind healthy ones', () => {
+    scheduler.connect('flaky', 'flaky');
+    scheduler.connect('a', 'a');
+
+    // Connection Failed to be Established
+    scheduler.onConnComplete(0x3e);
+    scheduler.next();
+    should(connecting()).equal('a');
+
+    scheduler.connect('b', 'b');
+    clock.tick(100);
+    scheduler.onConnComplete(0);
+    scheduler.next();
+
+    should(connecting()).equal('b');
+  });
+
+  it('should give up once out of retries', () => {
+    const failed = sinon.spy();
+    scheduler.on('failed', failed);
+
+    scheduler.connect('a', 'a', 'random', { retries: 1 });
+
+    should(scheduler.onConnComplete(0x3e).done).equal(false);
+    scheduler.next();
+    clock.tick(100);
+    should(scheduler.onConnComplete(0x3e).done).equal(true);
+
+    assert.calledOnceWithExactly(failed, 'a', { attempts: 2, status: 0x3e, timedOut: false });
+    should(scheduler.isPending('a')).equal(false);
+  });
+
+  it('should not retry other statuses', () => {
+    scheduler.connect('a', 'a');
+
+    should(scheduler.onConnComplete(0x12).done).equal(true);
+    should(scheduler.stats.failed).equal(1);
+  });
+
+  it('should drop queued intents when cancelled', () => {
+    scheduler.connect('a', 'a');
+    scheduler.connect('b', 'b');
+
+    should(scheduler.cancel('b')).equal(true);
+    should(scheduler.cancel('c')).equal(false);
+
+    assert.notCalled(hci.cancelConnect);
+    should(scheduler.isPending('b')).equal(false);
+  });
+
+  it('should cancel the attempt in flight without retrying it', () => {
+    scheduler.connect('a', 'a');
+
+    should(scheduler.cancel('a')).equal(true);
+    assert.calledOnce(hci.cancelConnect);
+
+    clock.tick(1000);
+    assert.calledOnce(hci.cancelConnect);
+
+    should(scheduler.onConnComplete(0x02)).deepEqual({ uuid: 'a', done: true, timedOut: false });
+    should(scheduler.stats.cancelled).equal(1);
+    should(scheduler.stats.retries).equal(0);
+    should(scheduler.stats.timeouts).equal(0);
+  });
+
+  it('should measure queue wait and establishment time', () => {
+    const established = sinon.spy();
+    scheduler.on('established', established);
+
+    scheduler.connect('a', 'a');
+    scheduler.connect('b', 'b');
+
+    clock.tick(30);
+    scheduler.onConnComplete(0);
+    scheduler.next();
+    clock.tick(20);
+    scheduler.onConnComplete(0);
+
+    assert.calledWithExactly(established, 'b', {
+      attempts: 1,
+      queueWait: 30,
+      establishmentTime: 20
+    });
+
+    const metrics = scheduler.metrics();
+    should(metrics.established).equal(2);
+    should(metrics.waiting).equal(0);
+    should(metrics.queueWait).deepEqual({ mean: 15, count: 2, total: 30, max: 30 });
+    should(metrics.establishmentTime).deepEqual({ mean: 25, count: 2, total: 50, max: 30 });
+  });
+
+  describe('reconnect', () => {
+    it('should wait on the accept list for devices to come back', () => {
+      scheduler.reconnect('a', 'aa:aa', 'random');
+      scheduler.reconnect('b', 'bb:bb', 'public');
+
+      assert.calledOnceWithExactly(hci.createLeConn, null, null, {}, true);
+      // the list changed, so the pending attempt makes way for a new one
+      assert.calledOnce(hci.cancelConnect);
+      scheduler.onConnComplete(0x02);
+      scheduler.next();
+
+      assert.calledTwice(hci.clearFilterAcceptList);
+      assert.calledWithExactly(hci.addToFilterAcceptList, 'aa:aa', 'random');
+      assert.calledWithExactly(hci.addToFilterAcceptList, 'bb:bb', 'public');
+      should(hci.createLeConn.lastCall.args[0]).equal(null);
+    });
+
+    it('should report reconnection latency', () => {
+      const reconnected = sinon.spy();
+      scheduler.on('reconnected', reconnected);
+
+      scheduler.reconnect('a', 'aa:aa', 'random');
+      should(scheduler.onConnComplete(0, 'a')).deepEqual({ uuid: 'a', done: true, timedOut: false });
+      scheduler.next();
+      assert.calledOnce(hci.createLeConn);
+
+      clock.tick(1000);
+      scheduler.onDisconnect('a');
+      assert.calledTwice(hci.createLeConn);
+
+      clock.tick(120);
+      scheduler.onConnComplete(0, 'a');
+
+      assert.calledWithExactly(reconnected, 'a', { latency: 120 });
+      should(scheduler.metrics().reconnectLatency.max).equal(120);
+    });
+
+    it('should make way for directed attempts', () => {
+      scheduler.reconnect('a', 'aa:aa', 'random');
+      scheduler.connect('b', 'bb:bb', 'public');
+
+      assert.calledOnce(hci.cancelConnect);
+
+      // the cancelled accept list attempt is not reported
+      should(scheduler.onConnComplete(0x02)).deepEqual({ uuid: null, done: false, timedOut: false });
+      scheduler.next();
+
+      should(hci.createLeConn.lastCall.args).deepEqual(['bb:bb', 'public', {}]);
+
+      scheduler.onConnComplete(0, 'b');
+      scheduler.next();
+      should(hci.createLeConn.lastCall.args[0]).equal(null);
+    });
+
+    it('should leave stopped devices off the list', () => {
+      scheduler.reconnect('a', 'aa:aa', 'random');
+      scheduler.onConnComplete(0, 'a');
+      scheduler.next();
+
+      scheduler.stopReconnect('a');
+      scheduler.onDisconnect('a');
+
+      assert.calledOnce(hci.createLeConn);
+      should(scheduler.reconnectCandidates()).deepEqual([]);
+    });
+
+    it('should back off when the controller gives up on the list', () => {
+      scheduler.reconnect('a', 'aa:aa', 'random');
+
+      scheduler.onConnComplete(0x3e);
+      scheduler.next();
+      assert.calledOnce(hci.createLeConn);
+
+      clock.tick(100);
+      assert.calledTwice(hci.createLeConn);
+    });
+  });
+});
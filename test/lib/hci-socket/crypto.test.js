@@ -52,4 +52,14 @@ describe('hci-socket crypto', () => {
     should(result).deepEqual(expectedResult);
     assert.calledOnceWithMatch(cryptoLib.createCipheriv, 'aes-128-ecb', sinon.match(Buffer.from(swapKey)), '');
   });
+
+  it('should compute ah', () => {
+    // Core spec Vol 3, Part H, D.7, most significant octet first
+    const irk = Buffer.from('ec0234a357c8ad05341010a60a397d9b', 'hex').reverse();
+    const prand = Buffer.from('708194', 'hex').reverse();
+
+    const result = crypto.ah(irk, prand);
+
+    should(result).deepEqual(Buffer.from('0dfbaa', 'hex').reverse());
+  });
 });
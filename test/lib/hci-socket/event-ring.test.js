@@ -0,0 +1,110 @@
+const should = require('should');
+
+const EventRing = require('../../../lib/hci-socket/event-ring');
+
+describe('hci-socket event ring', () => {
+  it('should carry events and their arguments', () => {
+    const ring = EventRing.create(1024);
+    const error = new Error('Connection attempt timed out');
+    const advertisement = {
+      localName: 'KICKR',
+      txPowerLevel: -8,
+      manufacturerData: Buffer.from([0x59, 0x00]),
+      serviceData: [{ uuid: '1826', data: Buffer.from([0x01]) }],
+      serviceUuids: ['1826'],
+      solicitationServiceUuids: []
+    };
+
+    should(ring.push('discover', ['uuid', 'c0:00:00:00:00:01', 'random', true, advertisement, -60, undefined])).equal(true);
+    should(ring.push('connect', ['uuid', error])).equal(true);
+    should(ring.push('scanStop', [])).equal(true);
+
+    should(ring.shift()).deepEqual(['discover', ['uuid', 'c0:00:00:00:00:01', 'random', true, advertisement, -60, undefined]]);
+
+    const [event, [uuid, decoded]] = ring.shift();
+    should(event).equal('connect');
+    should(uuid).equal('uuid');
+    should(decoded).be.instanceOf(Error);
+    should(decoded.message).equal(error.message);
+
+    should(ring.shift()).deepEqual(['scanStop', []]);
+    should(ring.shift()).equal(null);
+  });
+
+  it('should wrap around the end of the buffer', () => {
+    const ring = EventRing.create(256);
+
+    for (let i = 0; i < 100; i++) {
+      const data = Buffer.alloc(i % 50, i);
+
+      should(ring.push('read', ['uuid', data, i])).equal(true);
+      should(ring.shift()).deepEqual(['read', ['uuid', data, i]]);
+    }
+
+    should(ring.signal()).equal(100);
+  });
+
+  it('should keep events sent to a full ring until there is room', async () => {
+    const ring = EventRing.create(64);
+
+    ring.send('read', [Buffer.alloc(30, 1)]);
+    ring.send('read', [Buffer.alloc(30, 2)]);
+    should(ring.stats).deepEqual({ events: 2, queued: 1 });
+
+    should(ring.shift()).deepEqual(['read', [Buffer.alloc(30, 1)]]);
+    should(ring.shift()).equal(null);
+
+    await new Promise((resolve) => setTimeout(resolve, 5));
+    should(ring.shift()).deepEqual(['read', [Buffer.alloc(30, 2)]]);
+  });
+
+  describe('without Atomics.waitAsync', () => {
+    const waitAsync = Atomics.waitAsync;
+
+    beforeEach(() => {
+      delete Atomics.waitAsync;
+    });
+
+    afterEach(() => {
+      if (waitAsync) {
+        Atomics.waitAsync = waitAsync;
+      }
+    });
+
+    it('should wait for the doorbell', async () => {
+      const ring = EventRing.create(64);
+      let rung = 0;
+      ring.doorbell = () => rung++;
+
+      const { async, value } = ring.wait(ring.signal());
+      should(async).equal(true);
+
+      ring.push('scanStop', []);
+      ring.push('scanStop', []);
+      should(rung).equal(1);
+
+      ring.onDoorbell();
+      should(await value).equal('ok');
+      should(ring.shift()).deepEqual(['scanStop', []]);
+    });
+
+    it('should not wait once something was written', () => {
+      const ring = EventRing.create(64);
+      let rung = 0;
+      ring.doorbell = () => rung++;
+
+      const signal = ring.signal();
+      ring.push('scanStop', []);
+
+      should(ring.wait(signal)).deepEqual({ async: false, value: 'not-equal' });
+      ring.push('scanStop', []);
+      should(rung).equal(0);
+    });
+  });
+
+  it('should refuse events larger than the ring', () => {
+    const ring = EventRing.create(64);
+
+    should(() => ring.push('read', [Buffer.alloc(64)])).throw("read of 87 bytes doesn't fit the ring");
+  });
+});
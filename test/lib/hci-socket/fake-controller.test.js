@@ -0,0 +1,238 @@
+const should = require('should');
+
+const FakeController = require('../../../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../../../lib/hci-socket/fake-peripheral');
+
+describe('hci-socket fake controller', () => {
+  let controller;
+  let events;
+
+  const command = (opcode, params) => {
+    const packet = Buffer.alloc(4 + params.length);
+    packet.writeUInt8(0x01, 0);
+    packet.writeUInt16LE(opcode, 1);
+    packet.writeUInt8(params.length, 3);
+    params.copy(packet, 4);
+    controller.write(packet);
+  };
+
+  const wait = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+  const leMeta = (subEvent) =>
+    events.filter((event) => event[1] === 0x3e && event[3] === subEvent);
+
+  beforeEach(() => {
+    controller = new FakeController({
+      numCommandPackets: 4,
+      connectLatency: 1,
+      peripherals: [
+        new FakePeripheral({
+          address: 'c0:00:00:00:00:01',
+          localName: 'one',
+          advertisingInterval: 5,
+          services: [{ uuid: '180f', characteristics: [{ uuid: '2a19' }] }]
+        }),
+        new FakePeripheral({
+          address: 'c0:00:00:00:00:02',
+          connectable: false,
+          advertisingInterval: 5
+        })
+      ]
+    });
+    events = [];
+    controller.on('data', (data) => events.push(data));
+    controller.start();
+  });
+
+  afterEach(() => {
+    controller.stop();
+  });
+
+  it('should report advertisers while scanning', async () => {
+    command(0x200c, Buffer.from([0x01, 0x00]));
+    await wait(40);
+    command(0x200c, Buffer.from([0x00, 0x00]));
+    await wait(5);
+
+    const reports = leMeta(0x02);
+    const count = reports.length;
+
+    // ADV_IND + SCAN_RSP for the first, ADV_NONCONN_IND for the second
+    should(reports.some((report) => report[5] === 0x00)).equal(true);
+    should(reports.some((report) => report[5] === 0x04)).equal(true);
+    should(reports.some((report) => report[5] === 0x03)).equal(true);
+    should(count).be.above(6);
+
+    await wait(20);
+    should(leMeta(0x02)).have.length(count);
+  });
+
+  it('should filter duplicates', async () => {
+    command(0x200c, Buffer.from([0x01, 0x01]));
+    await wait(40);
+
+    should(leMeta(0x02)).have.length(3);
+  });
+
+  it('should connect and serve ATT over ACL', async () => {
+    const params = Buffer.alloc(25);
+    params.writeUInt8(0x01, 5); // random
+    Buffer.from('0100000000c0', 'hex').copy(params, 6);
+    params.writeUInt16LE(0x0006, 15); // max interval 7.5 ms
+    command(0x200d, params);
+    await wait(20);
+
+    const complete = leMeta(0x01)[0];
+    should(complete[4]).equal(0x00); // status
+    const handle = complete.readUInt16LE(5);
+    should(handle).equal(0x0040);
+
+    // read request for handle 3 (battery level value)
+    controller.write(Buffer.from('024000070003000400' + '0a0300', 'hex'));
+    await wait(30);
+
+    const completed = events.filter((event) => event[1] === 0x13);
+    should(completed).have.length(1);
+    should(completed[0].toString('hex')).equal('0413050140000100');
+
+    const acl = events.filter((event) => event[0] === 0x02);
+    should(acl).have.length(1);
+    should(acl[0].toString('hex')).equal('024020050001000400' + '0b');
+  });
+
+  it('should only encrypt with a key the peripheral has', async () => {
+    const params = Buffer.alloc(25);
+    params.writeUInt8(0x01, 5); // random
+    Buffer.from('0100000000c0', 'hex').copy(params, 6);
+    params.writeUInt16LE(0x0006, 15); // max interval 7.5 ms
+    command(0x200d, params);
+    await wait(20);
+
+    // LE Start Encryption with a made up EDIV, Rand and LTK
+    command(0x2019, Buffer.concat([Buffer.from([0x40, 0x00]), Buffer.alloc(26, 0x01)]));
+    await wait(30);
+
+    const change = events.filter((event) => event[1] === 0x08);
+    should(change).have.length(1);
+    // PIN or Key Missing, encryption off
+    should(change[0].toString('hex')).equal('0408040640' + '0000');
+  });
+
+  it('should raise the data length and switch to LE 2M', async () => {
+    const params = Buffer.alloc(25);
+    params.writeUInt8(0x01, 5); // random
+    Buffer.from('0100000000c0', 'hex').copy(params, 6);
+    params.writeUInt16LE(0x0006, 15); // max interval 7.5 ms
+    command(0x200d, params);
+    await wait(20);
+
+    command(0x2022, Buffer.from('4000' + 'fb00' + '4808', 'hex'));
+    command(0x2032, Buffer.from('4000' + '00' + '03' + '03' + '0000', 'hex'));
+    await wait(40);
+
+    should(leMeta(0x07).map((event) => event.toString('hex'))).deepEqual([
+      '043e0b07' + '4000' + 'fb00' + '4808' + 'fb00' + '4808'
+    ]);
+    should(leMeta(0x0c).map((event) => event.toString('hex'))).deepEqual([
+      '043e060c' + '00' + '4000' + '02' + '02'
+    ]);
+
+    const connection = controller._connections.get(0x0040);
+    should(connection.txOctets).equal(251);
+    should(connection.phy).equal(0x02);
+  });
+
+  it('should refuse connections beyond maxConnections', async () => {
+    controller._maxConnections = 0;
+
+    const params = Buffer.alloc(25);
+    params.writeUInt8(0x01, 5); // random
+    Buffer.from('0100000000c0', 'hex').copy(params, 6);
+    command(0x200d, params);
+    await wait(20);
+
+    should(leMeta(0x01).map((event) => event[4])).deepEqual([0x09]);
+    should(controller._connections.size).equal(0);
+  });
+
+  it('should lose connections to a scan that keeps the radio', async () => {
+    controller._sharedRadio = true;
+    controller._scanPriority = 1;
+
+    const params = Buffer.alloc(25);
+    params.writeUInt8(0x01, 5); // random
+    Buffer.from('0100000000c0', 'hex').copy(params, 6);
+    params.writeUInt16LE(0x0006, 15); // max interval 7.5 ms
+    params.writeUInt16LE(0x0003, 19); // supervision timeout 30 ms
+    command(0x200d, params);
+    await wait(20);
+    should(leMeta(0x01)[0][4]).equal(0x00);
+
+    // scanning all of every 10 ms
+    command(0x200b, Buffer.from('01' + '1000' + '1000' + '0000', 'hex'));
+    command(0x200c, Buffer.from([0x01, 0x00]));
+    await wait(60);
+
+    const disconnect = events.filter((event) => event[1] === 0x05);
+    should(disconnect.map((event) => event.toString('hex'))).deepEqual(['040504' + '00' + '4000' + '08']);
+    should(controller.stats.supervisionTimeouts).equal(1);
+    should(controller.stats.missedConnectionEvents).be.above(3);
+  });
+
+  it('should count ACL buffer violations', () => {
+    controller._aclBuffersInUse = 8;
+    controller.write(Buffer.from('024000050001000400' + '0a', 'hex'));
+
+    should(controller.stats.aclBufferViolations).equal(1);
+  });
+
+  it('should keep unknown addresses pending until cancelled', async () => {
+    command(0x200d, Buffer.alloc(25));
+    await wait(20);
+
+    should(leMeta(0x01)).have.length(0);
+
+    command(0x200e, Buffer.alloc(0));
+    await wait(5);
+
+    const complete = leMeta(0x01);
+    should(complete).have.length(1);
+    should(complete[0][4]).equal(0x02);
+  });
+
+  it('should fail the first connectFailures attempts', async () => {
+    controller._peripherals.get('c0:00:00:00:00:01').connectFailures = 1;
+
+    const params = Buffer.alloc(25);
+    params.writeUInt8(0x01, 5); // random
+    Buffer.from('0100000000c0', 'hex').copy(params, 6);
+    command(0x200d, params);
+    await wait(10);
+    command(0x200d, params);
+    await wait(10);
+
+    should(leMeta(0x01).map((complete) => complete[4])).deepEqual([0x3e, 0x00]);
+  });
+
+  it('should connect to the first device on the accept list that advertises', async () => {
+    // LE Add Device To Filter Accept List: random c0:00:00:00:00:01
+    command(0x2011, Buffer.from('01' + '0100000000c0', 'hex'));
+    // initiator filter policy: accept list
+    const params = Buffer.alloc(25);
+    params.writeUInt8(0x01, 4);
+    params.writeUInt16LE(0x0006, 15);
+    command(0x200d, params);
+    await wait(5);
+
+    // the list can't change while in use
+    command(0x2010, Buffer.alloc(0));
+    await wait(20);
+
+    should(events.some((event) => event.toString('hex') === '040e0404' + '1020' + '0c')).equal(true);
+
+    const complete = leMeta(0x01);
+    should(complete).have.length(1);
+    should(complete[0][4]).equal(0x00);
+    should(complete[0].slice(9, 15).toString('hex')).equal('0100000000c0');
+  });
+});
@@ -0,0 +1,269 @@
+const should = require('should');
+
+const events = require('events');
+
+const FakePeripheral = require('../../../lib/hci-socket/fake-peripheral');
+const Smp = require('../../../lib/hci-socket/smp');
+
+describe('hci-socket fake peripheral', () => {
+  let peripheral;
+  let session;
+  let sent;
+
+  beforeEach(() => {
+    peripheral = new FakePeripheral({
+      address: 'c0:00:00:00:00:aa',
+      localName: 'test',
+      serviceUuids: ['180d'],
+      services: [
+        {
+          uuid: '180d',
+          characteristics: [
+            {
+              uuid: '2a37',
+              properties: ['read', 'notify'],
+              value: Buffer.from('abc'),
+              notifyRate: 1000,
+              notifySize: 8
+            }
+          ]
+        }
+      ]
+    });
+    sent = [];
+    session = peripheral.createSession((pdu) => sent.push(pdu));
+  });
+
+  afterEach(() => {
+    session.close();
+  });
+
+  it('should build advertising and scan response data', () => {
+    should(peripheral.advertisingData.toString('hex')).equal(
+      '0201060303' + '0d18'
+    );
+    should(peripheral.scanResponseData.toString('hex')).equal(
+      '050974657374'
+    );
+  });
+
+  it('should answer MTU exchange', () => {
+    session.onAtt(Buffer.from('02f700', 'hex'));
+
+    should(sent[0].toString('hex')).equal('03f700');
+  });
+
+  it('should list primary services', () => {
+    session.onAtt(Buffer.from('100100ffff0028', 'hex'));
+
+    // handle 1, end handle 0xffff, uuid 180d
+    should(sent[0].toString('hex')).equal('11060100ffff0d18');
+  });
+
+  it('should list characteristics', () => {
+    session.onAtt(Buffer.from('080100ffff0328', 'hex'));
+
+    // declaration 2: properties read|notify, value handle 3, uuid 2a37
+    should(sent[0].toString('hex')).equal('09070200120300372a');
+  });
+
+  it('should report attribute not found past the last attribute', () => {
+    session.onAtt(Buffer.from('080500ffff0328', 'hex'));
+
+    should(sent[0].toString('hex')).equal('010805000a');
+  });
+
+  it('should read multiple values', () => {
+    session.onAtt(Buffer.from('0e03000300', 'hex'));
+    session.onAtt(Buffer.from('2003000400', 'hex'));
+    session.onAtt(Buffer.from('2003000900', 'hex'));
+
+    should(sent[0].toString('hex')).equal('0f616263616263');
+    // value 3, then the 2 byte CCCD
+    should(sent[1].toString('hex')).equal('2103006162630200' + '0000');
+    should(sent[2].toString('hex')).equal('0120090001');
+  });
+
+  it('should reject Read Multiple Variable Length when told to', () => {
+    peripheral.readMultipleVariable = false;
+    session.onAtt(Buffer.from('2003000400', 'hex'));
+
+    should(sent[0].toString('hex')).equal('0120000006');
+  });
+
+  it('should read values and blobs', () => {
+    session.onAtt(Buffer.from('0a0300', 'hex'));
+    session.onAtt(Buffer.from('0c03000100', 'hex'));
+    session.onAtt(Buffer.from('0c03000900', 'hex'));
+
+    should(sent[0].toString('hex')).equal('0b616263');
+    should(sent[1].toString('hex')).equal('0d6263');
+    should(sent[2].toString('hex')).equal('010c030007');
+  });
+
+  it('should find descriptors', () => {
+    session.onAtt(Buffer.from('040400ffff', 'hex'));
+
+    should(sent[0].toString('hex')).equal('050104000229');
+  });
+
+  it('should notify once subscribed', (done) => {
+    session.onAtt(Buffer.from('1204000100', 'hex'));
+
+    should(sent[0].toString('hex')).equal('13');
+
+    setTimeout(() => {
+      const notifications = sent.slice(1);
+      should(notifications.length).be.above(0);
+      should(notifications[0].toString('hex')).equal('1b03000000000000000000');
+      done();
+    }, 20);
+  });
+
+  it('should bundle notifications once the client takes them', (done) => {
+    session.close();
+    peripheral = new FakePeripheral({
+      multipleNotifications: true,
+      services: [
+        {
+          uuid: '180d',
+          characteristics: [
+            { uuid: '2a37', properties: ['notify'], notifyRate: 200, notifySize: 4 },
+            { uuid: '2a38', properties: ['notify'], notifyRate: 200, notifySize: 4 }
+          ]
+        }
+      ]
+    });
+    sent = [];
+    session = peripheral.createSession((pdu) => sent.push(pdu));
+
+    // Client Supported Features is handle 3, the CCCDs 7 and 10
+    session.onAtt(Buffer.from('080100ffff292b', 'hex'));
+    should(sent[0].toString('hex')).equal('0903030000');
+
+    session.onAtt(Buffer.from('12030004', 'hex'));
+    session.onAtt(Buffer.from('1207000100', 'hex'));
+    session.onAtt(Buffer.from('120a000100', 'hex'));
+    sent = [];
+
+    setTimeout(() => {
+      should(sent.length).be.above(0);
+      should(sent[0].toString('hex')).equal(
+        '23' + '0600' + '0400' + '00000000' + '0900' + '0400' + '00000000'
+      );
+      should(session.stats.notifications).equal(2 * sent.length);
+      done();
+    }, 10);
+  });
+
+  it('should accept LE credit based channels', () => {
+    const received = [];
+    session.close();
+    peripheral = new FakePeripheral({
+      l2capChannels: [{ psm: 0x0080, mtu: 512, mps: 50, credits: 4 }]
+    });
+    peripheral.on('l2capData', (psm, sdu, reply) => {
+      received.push(sdu);
+      reply(Buffer.from('ok'));
+    });
+    sent = [];
+    session = peripheral.createSession((pdu, cid) => sent.push({ pdu, cid }));
+
+    session.onSignaling(Buffer.from('14010a00' + '8000' + '4000' + '0008' + 'f700' + '0100', 'hex'));
+    should(sent[0].cid).equal(5);
+    should(sent[0].pdu.toString('hex')).equal('15010a00' + '4000' + '0002' + '3200' + '0400' + '0000');
+
+    session.onChannelData(0x40, Buffer.from('050068656c', 'hex'));
+    session.onChannelData(0x40, Buffer.from('6c6f', 'hex'));
+
+    should(received).deepEqual([Buffer.from('hello')]);
+    // the reply on the central's CID, then credits back
+    should(sent[1]).deepEqual({ pdu: Buffer.from('02006f6b', 'hex'), cid: 0x40 });
+    should(sent[2].pdu.toString('hex')).equal('16010400' + '4000' + '0200');
+
+    session.onSignaling(Buffer.from('14020a00' + '8100' + '4100' + '0008' + 'f700' + '0100', 'hex'));
+    should(sent[3].pdu.toString('hex')).equal('15020a00' + '0000000000000000' + '0200');
+  });
+
+  it('should serve ATT on Enhanced ATT bearers', () => {
+    session.close();
+    peripheral = new FakePeripheral({
+      eatt: true,
+      services: [{ uuid: '180d', characteristics: [{ uuid: '2a37', value: Buffer.from('abc') }] }]
+    });
+    sent = [];
+    session = peripheral.createSession((pdu, cid) => sent.push({ pdu, cid }));
+
+    // Server Supported Features
+    session.onAtt(Buffer.from('080100ffff3a2b', 'hex'));
+    should(sent[0].pdu.toString('hex')).equal('0903' + '0500' + '01');
+
+    // two channels on the EATT PSM
+    session.onSignaling(Buffer.from('17010c00' + '2700' + '4000' + '4000' + '0a00' + '4000' + '4100', 'hex'));
+    should(sent[1].pdu.toString('hex')).equal('18010c00' + 'f700' + 'f700' + '0a00' + '0000' + '4000' + '4100');
+
+    // Read Request for 2a37 (handle 8) on the second one, answered there
+    session.onChannelData(0x41, Buffer.from('0300' + '0a0800', 'hex'));
+    should(sent[2]).deepEqual({ pdu: Buffer.from('0400' + '0b616263', 'hex'), cid: 0x41 });
+    should(session.stats.eattRequests).equal(1);
+
+    // no MTU exchange on them
+    session.onChannelData(0x40, Buffer.from('0300' + '024000', 'hex'));
+    should(sent[3].pdu.toString('hex')).equal('0500' + '0102000006');
+  });
+
+  it('should pair, encrypt and keep the bond', () => {
+    const central = { address: '00:11:22:33:44:55', addressType: 'public' };
+    const aclStream = new events.EventEmitter();
+    const results = {};
+
+    session.close();
+    peripheral = new FakePeripheral({
+      address: 'c0:00:00:00:00:bb',
+      services: [{ uuid: '1818', characteristics: [{ uuid: '2a66', value: Buffer.from('abc'), encrypt: true }] }]
+    });
+    sent = [];
+    session = peripheral.createSession((pdu, cid) => {
+      if (cid === 6) {
+        aclStream.emit('data', cid, pdu);
+      } else {
+        sent.push(pdu);
+      }
+    }, central);
+    aclStream.write = (cid, data) => session.onSmp(data);
+
+    // Insufficient Authentication for 2a66 (handle 3)
+    session.onAtt(Buffer.from('0a0300', 'hex'));
+    should(sent[0].toString('hex')).equal('010a030005');
+
+    const smp = new Smp(aclStream, central.addressType, central.address, 'random', peripheral.address);
+    smp.on('stk', (stk) => { results.stk = stk; });
+    smp.on('keys', (keys) => { results.keys = keys; });
+    smp.sendPairingRequest();
+
+    should(session.encryptionKey(Buffer.alloc(8), Buffer.alloc(2))).deepEqual(results.stk);
+    session.onEncrypted();
+
+    should(results.keys.ltk).deepEqual(peripheral.bonds.get(central.address).ltk);
+    should(results.keys.irk).deepEqual(peripheral.irk);
+    should(results.keys.address).equal('c0:00:00:00:00:bb');
+    should(session.stats.pairings).equal(1);
+
+    session.onAtt(Buffer.from('0a0300', 'hex'));
+    should(sent[1].toString('hex')).equal('0b616263');
+
+    // the next connection encrypts with the LTK, or not at all with another
+    const next = peripheral.createSession(() => {}, central);
+    should(next.encryptionKey(results.keys.rand, results.keys.ediv)).deepEqual(results.keys.ltk);
+    should(next.encryptionKey(Buffer.alloc(8, 1), results.keys.ediv)).equal(null);
+  });
+
+  it('should reject unsupported requests', () => {
+    // Find By Type Value
+    session.onAtt(Buffer.from('060100ffff00280d18', 'hex'));
+    session.onAtt(Buffer.from('d2030000', 'hex'));
+
+    should(sent).have.length(1);
+    should(sent[0].toString('hex')).equal('0106000006');
+  });
+});
@@ -39,7 +39,7 @@ describe('hci-socket gap', () => {
     const gap = new Gap(hci);
     gap.setScanParameters(interval, window);
 
-    assert.calledOnceWithExactly(hci.setScanParameters, interval, window);
+    assert.calledOnceWithExactly(hci.setScanParameters, interval, window, false);
   });
 
   it('startScanning', () => {
@@ -58,7 +58,7 @@ describe('hci-socket gap', () => {
     assert.callCount(hci.setScanEnabled, 2);
     assert.calledWithExactly(hci.setScanEnabled, false, true);
     assert.calledWithExactly(hci.setScanEnabled, true, false);
-    assert.calledOnceWithExactly(hci.setScanParameters);
+    assert.calledOnceWithExactly(hci.setScanParameters, undefined, undefined, false);
   });
 
   it('stopScanning', () => {
@@ -75,6 +75,64 @@ describe('hci-socket gap', () => {
     assert.calledOnceWithExactly(hci.setScanEnabled, false, true);
   });
 
+  describe('scan duty cycle', () => {
+    let hci;
+    let gap;
+
+    beforeEach(() => {
+      hci = {
+        on: sinon.spy(),
+        setScanEnabled: sinon.spy(),
+        setScanParameters: sinon.spy()
+      };
+
+      gap = new Gap(hci);
+      gap.emit = sinon.spy();
+      gap._scanState = 'started';
+      gap._scanFilterDuplicates = true;
+    });
+
+    it('should pause and resume without scanStop or scanStart', () => {
+      gap.pauseScanning();
+      should(gap._scanState).equal('pausing');
+      gap.onHciLeScanEnableSet(0);
+      should(gap._scanState).equal('paused');
+      should(gap.isScanning()).equal(true);
+
+      gap.resumeScanning();
+      should(gap._scanState).equal('resuming');
+      gap.onHciLeScanEnableSet(0);
+      should(gap._scanState).equal('started');
+
+      should(hci.setScanEnabled.args).deepEqual([[false, true], [true, true]]);
+      should(hci.setScanParameters.args).deepEqual([[undefined, undefined, false]]);
+      assert.notCalled(gap.emit);
+    });
+
+    it('should restart a scan in progress with new parameters', () => {
+      gap.setScanDutyCycle(0x60, 0x30);
+
+      should(gap._scanState).equal('resuming');
+      should(hci.setScanEnabled.args).deepEqual([[false, true], [true, true]]);
+      should(hci.setScanParameters.args).deepEqual([[0x60, 0x30, false]]);
+
+      gap.setScanDutyCycle();
+      should(hci.setScanParameters.args).deepEqual([[0x60, 0x30, false], [undefined, undefined, false]]);
+    });
+
+    it('should keep the parameters for the next scan', () => {
+      gap._scanState = 'stopped';
+      gap.setScanDutyCycle(0x800, 0xcd);
+      gap.pauseScanning();
+      gap.resumeScanning();
+
+      assert.notCalled(hci.setScanEnabled);
+
+      gap.startScanning(false);
+      should(hci.setScanParameters.args).deepEqual([[0x800, 0xcd, false]]);
+    });
+  });
+
   it('onHciLeScanParametersSet', () => {
     const hci = {
       on: sinon.spy()
@@ -1125,4 +1183,375 @@ describe('hci-socket gap', () => {
 
     assert.calledOnce(discoverCallback);
   });
+
+  describe('scan filter', () => {
+    // manufacturer data for 0x0059, then the complete local name 'KICKR'
+    const advertisement = Buffer.from('05ff5900aabb', 'hex');
+    const scanResponse = Buffer.from('06094b49434b52', 'hex');
+    const other = Buffer.from('05ff4c00aabb', 'hex');
+
+    let gap;
+    let discover;
+
+    beforeEach(() => {
+      gap = new Gap({
+        on: sinon.spy(),
+        setScanEnabled: sinon.spy(),
+        setScanParameters: sinon.spy()
+      });
+      discover = sinon.spy();
+      gap.on('discover', discover);
+    });
+
+    it('should drop reports before parsing them', () => {
+      gap.startScanning(true, { manufacturerId: 0x0059 });
+      gap.onHciLeAdvertisingReport(0, 0x03, 'other', 'random', other, -50);
+
+      should(gap._discoveries).deepEqual({});
+      assert.notCalled(discover);
+
+      gap.onHciLeAdvertisingReport(0, 0x03, 'trainer', 'random', advertisement, -50);
+      assert.calledOnce(discover);
+      should(discover.args[0][1]).equal('trainer');
+    });
+
+    it('should report the held advertisement once the scan response matches', () => {
+      gap.startScanning(true, { manufacturerId: 0x0059, namePrefix: 'KICKR' });
+
+      // connectable, so only reported along with the scan response
+      gap.onHciLeAdvertisingReport(0, 0x00, 'trainer', 'random', advertisement, -50);
+      should(gap._discoveries).deepEqual({});
+
+      gap.onHciLeAdvertisingReport(0, 0x04, 'trainer', 'random', scanResponse, -50);
+      assert.calledOnce(discover);
+
+      const reported = discover.args[0][4];
+      should(reported.localName).equal('KICKR');
+      should(reported.manufacturerData).deepEqual(Buffer.from('5900aabb', 'hex'));
+    });
+
+    it('should apply the RSSI floor to every report', () => {
+      gap.startScanning(true, { manufacturerId: 0x0059, rssi: -60 });
+
+      gap.onHciLeAdvertisingReport(0, 0x03, 'trainer', 'random', advertisement, -70);
+      assert.notCalled(discover);
+
+      gap.onHciLeAdvertisingReport(0, 0x03, 'trainer', 'random', advertisement, -55);
+      gap.onHciLeAdvertisingReport(0, 0x03, 'trainer', 'random', advertisement, -65);
+      assert.calledOnce(discover);
+      should(discover.args[0][5]).equal(-55);
+    });
+
+    it('should filter extended reports', () => {
+      gap.startScanning(true, { namePrefix: 'KICKR' });
+
+      gap.onHciLeExtendedAdvertisingReport(0, 0x00, 'other', 'random', 127, -50, other);
+      gap.onHciLeExtendedAdvertisingReport(0, 0x00, 'trainer', 'random', 127, -50, scanResponse);
+
+      assert.calledOnce(discover);
+      should(discover.args[0][1]).equal('trainer');
+    });
+
+    it('should hold an advertisement only while its scan response may complete the match', () => {
+      gap.startScanning(true, { manufacturerId: 0x0059, namePrefix: 'KICKR' });
+
+      // not scannable, so no scan response to wait for
+      gap.onHciLeAdvertisingReport(0, 0x03, 'sensor', 'random', advertisement, -50);
+      should(gap._filtered.get('sensor').advertisement).be.null();
+
+      gap.onHciLeAdvertisingReport(0, 0x00, 'trainer', 'random', advertisement, -50);
+      should(gap._filtered.get('trainer').advertisement).be.a.Function();
+
+      // the scan response came and didn't complete it
+      gap.onHciLeAdvertisingReport(0, 0x04, 'trainer', 'random', other, -50);
+      gap.onHciLeAdvertisingReport(0, 0x00, 'trainer', 'random', advertisement, -50);
+      should(gap._filtered.get('trainer').advertisement).be.null();
+      should(gap._filtered.get('trainer').scanResponse).be.null();
+      assert.notCalled(discover);
+    });
+
+    it('should keep no state for an RSSI floor alone', () => {
+      gap.startScanning(true, { rssi: -60 });
+
+      gap.onHciLeAdvertisingReport(0, 0x03, 'trainer', 'random', advertisement, -50);
+      gap.onHciLeAdvertisingReport(0, 0x03, 'other', 'random', other, -70);
+
+      assert.calledOnce(discover);
+      should(gap._filtered.size).equal(0);
+    });
+
+    describe('with devices coming and going', () => {
+      let clock;
+
+      beforeEach(() => {
+        clock = sinon.useFakeTimers();
+      });
+
+      afterEach(() => {
+        clock.restore();
+      });
+
+      it('should forget devices not heard for a while', () => {
+        gap.startScanning(true, { manufacturerId: 0x0059 });
+        gap.onHciLeAdvertisingReport(0, 0x03, 'gone', 'random', other, -50);
+        clock.tick(3000);
+        gap.onHciLeAdvertisingReport(0, 0x03, 'here', 'random', other, -50);
+        clock.tick(2000);
+        gap.onHciLeAdvertisingReport(0, 0x03, 'here', 'random', other, -50);
+
+        should(Array.from(gap._filtered.keys())).deepEqual(['here']);
+      });
+
+      it('should keep no more than 1024 devices', () => {
+        gap.startScanning(true, { manufacturerId: 0x0059 });
+        for (let i = 0; i < 1100; i++) {
+          gap.onHciLeAdvertisingReport(0, 0x03, `device${i}`, 'random', other, -50);
+        }
+
+        should(gap._filtered.size).equal(1024);
+        should(gap._filtered.has('device75')).be.false();
+        should(gap._filtered.has('device76')).be.true();
+      });
+    });
+
+    it('should forget matches when scanning starts again', () => {
+      gap.startScanning(true, { manufacturerId: 0x0059 });
+      gap.onHciLeAdvertisingReport(0, 0x03, 'trainer', 'random', advertisement, -50);
+
+      gap.startScanning(true);
+      should(gap._scanFilter).equal(null);
+      should(gap._filtered.size).equal(0);
+    });
+  });
+
+  describe('passive scan', () => {
+    const advertisement = Buffer.from('05ff5900aabb', 'hex');
+
+    let hci;
+    let gap;
+    let discover;
+
+    beforeEach(() => {
+      hci = {
+        on: sinon.spy(),
+        setScanEnabled: sinon.spy(),
+        setScanParameters: sinon.spy()
+      };
+      gap = new Gap(hci);
+      discover = sinon.spy();
+      gap.on('discover', discover);
+    });
+
+    it('should scan passively and keep doing so with new parameters', () => {
+      gap.startScanning(true, { passive: true });
+      gap.setScanDutyCycle(0x60, 0x30);
+
+      should(hci.setScanParameters.args).deepEqual([
+        [undefined, undefined, true],
+        [0x60, 0x30, true]
+      ]);
+      should(gap._scanFilter).equal(null);
+    });
+
+    it('should report connectable devices without waiting for a scan response', () => {
+      gap.startScanning(true, { passive: true });
+
+      gap.onHciLeAdvertisingReport(0, 0x00, 'trainer', 'random', advertisement, -50);
+      gap.onHciLeExtendedAdvertisingReport(0, 0x13, 'rower', 'random', 127, -50, advertisement);
+
+      should(discover.args.map((args) => [args[1], args[3]])).deepEqual([
+        ['trainer', true],
+        ['rower', 1]
+      ]);
+    });
+  });
+
+  describe('extended advertising fragments', () => {
+    // 254 bytes of manufacturer data for 0x0059 then the name 'KICKR', in
+    // three fragments that split both AD structures
+    const data = Buffer.concat([
+      Buffer.from([0xff, 0xff, 0x59, 0x00]),
+      Buffer.alloc(252, 0xaa),
+      Buffer.from('06094b49434b52', 'hex')
+    ]);
+    const fragments = [data.subarray(0, 100), data.subarray(100, 259), data.subarray(259)];
+
+    let gap;
+    let discover;
+
+    beforeEach(() => {
+      gap = new Gap({
+        on: sinon.spy(),
+        setScanEnabled: sinon.spy(),
+        setScanParameters: sinon.spy()
+      });
+      discover = sinon.spy();
+      gap.on('discover', discover);
+      sinon.spy(gap, 'parseServices');
+    });
+
+    // non-connectable extended advertising, more to come or complete
+    const report = (address, sid, eir, more) =>
+      gap.onHciLeExtendedAdvertisingReport(
+        0,
+        more ? 0x20 : 0x00,
+        address,
+        'random',
+        127,
+        -50,
+        eir,
+        more ? { localName: 'fragment' } : undefined,
+        sid
+      );
+
+    it('should parse the data once all fragments are in', () => {
+      report('trainer', 1, fragments[0], true);
+      report('trainer', 1, fragments[1], true);
+
+      assert.notCalled(gap.parseServices);
+      assert.notCalled(discover);
+
+      report('trainer', 1, fragments[2], false);
+
+      assert.calledOnce(gap.parseServices);
+      assert.calledOnce(discover);
+
+      const advertisement = discover.args[0][4];
+      should(advertisement.localName).equal('KICKR');
+      should(advertisement.manufacturerData.length).equal(254);
+      should(gap.reassembler.stats.reassembled).equal(1);
+    });
+
+    it('should keep the fragments of each advertiser and set apart', () => {
+      report('trainer', 1, fragments[0], true);
+      report('trainer', 2, Buffer.from('05ff4c00aabb', 'hex'), false);
+      report('rower', 1, fragments[0], true);
+      report('trainer', 1, fragments[1], true);
+      report('rower', 1, fragments[1], true);
+      report('rower', 1, fragments[2], false);
+      report('trainer', 1, fragments[2], false);
+
+      should(discover.args.map((args) => args[1])).deepEqual(['trainer', 'rower', 'trainer']);
+      should(discover.args[1][4].manufacturerData.length).equal(254);
+      should(discover.args[2][4].manufacturerData.length).equal(254);
+    });
+
+    it('should pass on unfragmented reports as they are', () => {
+      const eir = Buffer.from('05ff5900aabb', 'hex');
+      report('trainer', 1, eir, false);
+
+      should(gap.parseServices.args[0][1]).equal(eir);
+      should(gap.reassembler.stats.fragments).equal(0);
+    });
+
+    it('should forget unfinished fragments when scanning stops', () => {
+      gap.startScanning(true);
+      gap.onHciLeScanEnableSet(0);
+      report('trainer', 1, fragments[0], true);
+
+      gap.stopScanning();
+      gap.onHciLeScanEnableSet(0);
+      report('trainer', 1, fragments[2], false);
+
+      should(gap.parseServices.args[0][1]).equal(fragments[2]);
+      should(discover.args[0][4].manufacturerData).be.undefined();
+    });
+  });
+
+  describe('parseServices', () => {
+    let gap;
+
+    beforeEach(() => {
+      gap = new Gap({ on: sinon.spy() });
+    });
+
+    it('should deduplicate service UUIDs across AD structures', () => {
+      const eir = Buffer.from('0503' + '0d180f18' + '0302' + '0d18' + '1107' + '000102030405060708090a0b0c0d0e0f', 'hex');
+
+      const advertisement = gap.parseServices('address', eir, false, 0x00);
+
+      should(advertisement.serviceUuids).deepEqual([
+        '180d',
+        '180f',
+        '0f0e0d0c0b0a09080706050403020100'
+      ]);
+    });
+
+    it('should merge scan response UUIDs into the advertisement', () => {
+      const advertisement = gap.parseServices('address', Buffer.from('03030d18', 'hex'), false, 0x00);
+      gap._discoveries.address = { advertisement };
+
+      gap.parseServices('address', Buffer.from('05030d180f18', 'hex'), true, 0x04);
+
+      should(advertisement.serviceUuids).deepEqual(['180d', '180f']);
+    });
+
+    it('should decode service data and solicitation UUIDs on first access', () => {
+      const eir = Buffer.from('0516' + '0d18' + 'aabb' + '0314' + '0118', 'hex');
+
+      const advertisement = gap.parseServices('address', eir, false, 0x00);
+      const readUInt16LE = sinon.spy(eir, 'readUInt16LE');
+
+      should(advertisement.serviceData[0].uuid).equal('180d');
+      should(advertisement.serviceData[0].data.toString('hex')).equal('aabb');
+      should(advertisement.serviceSolicitationUuids).deepEqual(['1801']);
+      should(readUInt16LE.callCount).equal(1);
+
+      // decoded once, later reads return the same objects
+      should(advertisement.serviceData).equal(advertisement.serviceData);
+      should(readUInt16LE.callCount).equal(1);
+    });
+
+    it('should not copy manufacturer or service data', () => {
+      const eir = Buffer.from('03ff5900' + '0416' + '0d18' + '01', 'hex');
+
+      const advertisement = gap.parseServices('address', eir, false, 0x00);
+
+      should(advertisement.manufacturerData.buffer).equal(eir.buffer);
+      should(advertisement.serviceData[0].data.buffer).equal(eir.buffer);
+    });
+
+    it('should skip service data structures too short for their UUID', () => {
+      const eir = Buffer.from('0216' + '0d' + '0420' + '0d1800' + '0309' + '6869', 'hex');
+
+      const advertisement = gap.parseServices('address', eir, false, 0x00);
+
+      should(advertisement.serviceData).deepEqual([]);
+      should(advertisement.localName).equal('hi');
+    });
+
+    it('should not read the next structure for an empty Tx Power Level', () => {
+      const eir = Buffer.from('010a' + '0309' + '6869', 'hex');
+
+      const advertisement = gap.parseServices('address', eir, false, 0x00, 127);
+
+      should(advertisement.txPowerLevel).equal(127);
+      should(advertisement.localName).equal('hi');
+    });
+
+    it('should merge an advertisement decoded by the native decoder', () => {
+      const advertisement = gap.parseServices('address', Buffer.alloc(0), false, 0x00, undefined, {
+        localName: 'sensor',
+        serviceUuids: ['180d'],
+        serviceData: [{ uuid: '180f', data: Buffer.from([0x64]) }]
+      });
+      gap._discoveries.address = { advertisement };
+
+      gap.parseServices('address', Buffer.alloc(0), true, 0x04, undefined, {
+        txPowerLevel: -8,
+        serviceUuids: ['180d', '180a'],
+        serviceSolicitationUuids: ['1801']
+      });
+
+      should(advertisement).deepEqual({
+        localName: 'sensor',
+        txPowerLevel: -8,
+        manufacturerData: undefined,
+        serviceData: [{ uuid: '180f', data: Buffer.from([0x64]) }],
+        serviceUuids: ['180d', '180a'],
+        solicitationServiceUuids: [],
+        serviceSolicitationUuids: ['1801']
+      });
+    });
+  });
 });
@@ -4,6 +4,7 @@ const sinon = require('sinon');
 const { assert } = sinon;
 
 const Gatt = require('../../../lib/hci-socket/gatt');
+const FakePeripheral = require('../../../lib/hci-socket/fake-peripheral');
 
 describe('hci-socket gatt', () => {
   let gatt;
@@ -149,26 +150,31 @@ describe('hci-socket gatt', () => {
       const cid = 0x0004;
       const data = Buffer.from([0x1b, 0x01, 0x02, 0x03, 0x04]);
 
-      const services = { service1: {}, service2: {} };
+      const services = { service1: { uuid: 'service1' }, service2: { uuid: 'service2' } };
       const characteristics = {
         service1: {
           char1: {
+            uuid: 'char1',
             valueHandle: 0
           },
           char2: {
+            uuid: 'char2',
             valueHandle: 513
           }
         },
         service2: {
           char3: {
+            uuid: 'char3',
             valueHandle: 513
           }
         }
       };
 
       // Setup
-      gatt._services = services;
-      gatt._characteristics = characteristics;
+      for (const serviceUuid in services) {
+        gatt.addService(services[serviceUuid]);
+        gatt.addCharacteristics(serviceUuid, Object.values(characteristics[serviceUuid]));
+      }
       // Register events
       gatt.on('handleNotify', handleNotifyCallback);
       gatt.on('handleConfirmation', handleConfirmationCallback);
@@ -180,7 +186,7 @@ describe('hci-socket gatt', () => {
       should(gatt._aclStream).deepEqual(aclStream);
       should(gatt._services).deepEqual(services);
       should(gatt._characteristics).deepEqual(characteristics);
-      should(gatt._descriptors).deepEqual({});
+      should(gatt._descriptors).deepEqual({ service1: {}, service2: {} });
       should(gatt._currentCommand).equal(null);
       should(gatt._commandQueue).deepEqual([]);
       should(gatt._mtu).equal(23);
@@ -205,8 +211,8 @@ describe('hci-socket gatt', () => {
       assert.calledWithExactly(
         notificationCallback,
         address,
-        'service1',
-        'char2',
+        'service2',
+        'char3',
         Buffer.from([0x03, 0x04])
       );
     });
@@ -216,27 +222,33 @@ describe('hci-socket gatt', () => {
       const cid = 0x0004;
       const data = Buffer.from([0x1d, 0x01, 0x02, 0x03, 0x04]);
 
-      const services = { service1: {}, service2: {} };
+      const services = { service1: { uuid: 'service1' }, service2: { uuid: 'service2' } };
       const characteristics = {
         service1: {
           char1: {
+            uuid: 'char1',
             valueHandle: 0
           },
           char2: {
+            uuid: 'char2',
             valueHandle: 513
           }
         },
         service2: {
           char3: {
+            uuid: 'char3',
             valueHandle: 513
           }
         }
       };
 
       // Setup
+      aclStream.write = sinon.spy();
       gatt._currentCommand = { buffer: Buffer.from([0x01]) };
-      gatt._services = services;
-      gatt._characteristics = characteristics;
+      for (const serviceUuid in services) {
+        gatt.addService(services[serviceUuid]);
+        gatt.addCharacteristics(serviceUuid, Object.values(characteristics[serviceUuid]));
+      }
       // Register events
       gatt.on('handleNotify', handleNotifyCallback);
       gatt.on('handleConfirmation', handleConfirmationCallback);
@@ -248,12 +260,18 @@ describe('hci-socket gatt', () => {
       should(gatt._aclStream).deepEqual(aclStream);
       should(gatt._services).deepEqual(services);
       should(gatt._characteristics).deepEqual(characteristics);
-      should(gatt._descriptors).deepEqual({});
+      should(gatt._descriptors).deepEqual({ service1: {}, service2: {} });
       should(gatt._currentCommand).deepEqual({ buffer: Buffer.from([0x01]) });
-      should(gatt._commandQueue).has.size(1);
+      should(gatt._commandQueue).deepEqual([]);
       should(gatt._mtu).equal(23);
       should(gatt._security).equal('low');
 
+      // The confirmation doesn't wait for the current command
+      assert.calledOnceWithMatch(aclStream.write, 4, Buffer.from([0x1e]), sinon.match.func);
+      assert.notCalled(handleConfirmationCallback);
+      aclStream.write.firstCall.args[2]();
+      assert.calledOnceWithExactly(handleConfirmationCallback, address, 513);
+
       // Events
       assert.calledOnceWithExactly(
         handleNotifyCallback,
@@ -261,7 +279,6 @@ describe('hci-socket gatt', () => {
         513,
         Buffer.from([0x03, 0x04])
       );
-      assert.notCalled(handleConfirmationCallback);
       assert.callCount(notificationCallback, 2);
       assert.calledWithExactly(
         notificationCallback,
@@ -273,12 +290,38 @@ describe('hci-socket gatt', () => {
       assert.calledWithExactly(
         notificationCallback,
         address,
-        'service1',
-        'char2',
+        'service2',
+        'char3',
         Buffer.from([0x03, 0x04])
       );
     });
 
+    it('ATT_OP_MULTI_HANDLE_NOTIFY', () => {
+      const callback = sinon.spy();
+      gatt._currentCommand = { buffer: Buffer.from([0x0a, 0x03, 0x00]), callback };
+
+      gatt.addService({ uuid: 'service1' });
+      gatt.addCharacteristics('service1', [
+        { uuid: 'char1', valueHandle: 3 },
+        { uuid: 'char2', valueHandle: 6 }
+      ]);
+      gatt.on('handleNotify', handleNotifyCallback);
+      gatt.on('notification', notificationCallback);
+
+      // handle 3: 0x0102, handle 6: 0x03
+      gatt.onAclStreamData(0x0004, Buffer.from('23030002000102060001000304', 'hex'));
+
+      assert.callCount(handleNotifyCallback, 2);
+      assert.calledWithExactly(handleNotifyCallback, address, 3, Buffer.from([0x01, 0x02]));
+      assert.calledWithExactly(handleNotifyCallback, address, 6, Buffer.from([0x03]));
+      assert.callCount(notificationCallback, 2);
+      assert.calledWithExactly(notificationCallback, address, 'service1', 'char1', Buffer.from([0x01, 0x02]));
+      assert.calledWithExactly(notificationCallback, address, 'service1', 'char2', Buffer.from([0x03]));
+
+      // not the response to the outstanding request
+      assert.notCalled(callback);
+    });
+
     it('no current command', () => {
       // ATT_CID
       const cid = 0x0004;
@@ -387,8 +430,8 @@ describe('hci-socket gatt', () => {
       const callback = sinon.spy();
       const currentCommand = { buffer: Buffer.from([0x00]), callback };
       const queueCallback = sinon.spy();
-      const queueWriteCallback = sinon.spy();
-      const commandQueue = [{ buffer: Buffer.from([0x98]), callback: queueCallback }, { buffer: Buffer.from([0x99]), writeCallback: queueWriteCallback }];
+      const nextCallback = sinon.spy();
+      const commandQueue = [{ buffer: Buffer.from([0x98]), callback: queueCallback }, { buffer: Buffer.from([0x99]), callback: nextCallback }];
 
       // Setup
       gatt._currentCommand = currentCommand;
@@ -417,55 +460,10 @@ describe('hci-socket gatt', () => {
 
       assert.calledOnceWithExactly(callback, data);
       assert.notCalled(queueCallback);
-      assert.notCalled(queueWriteCallback);
+      assert.notCalled(nextCallback);
 
       assert.calledOnceWithExactly(aclStream.write, 4, Buffer.from([0x98]));
     });
-
-    it('write command callback with queue', () => {
-      // ATT_CID
-      const cid = 0x0004;
-      const data = Buffer.from([0x01, 0x01, 0x02, 0x03, 0x00]);
-
-      const callback = sinon.spy();
-      const currentCommand = { buffer: Buffer.from([0x00]), callback };
-      const queueCallback = sinon.spy();
-      const queueWriteCallback = sinon.spy();
-      const commandQueue = [{ buffer: Buffer.from([0x99]), writeCallback: queueWriteCallback }, { buffer: Buffer.from([0x98]), callback: queueCallback }];
-
-      // Setup
-      gatt._currentCommand = currentCommand;
-      gatt._commandQueue = [...commandQueue];
-      // Register events
-      gatt.on('handleNotify', handleNotifyCallback);
-      gatt.on('handleConfirmation', handleConfirmationCallback);
-      gatt.on('notification', notificationCallback);
-      gatt.onAclStreamData(cid, data);
-
-      // No changes
-      should(gatt._address).equal(address);
-      should(gatt._aclStream).deepEqual(aclStream);
-      should(gatt._services).deepEqual({});
-      should(gatt._characteristics).deepEqual({});
-      should(gatt._descriptors).deepEqual({});
-      should(gatt._currentCommand).deepEqual(commandQueue[1]);
-      should(gatt._commandQueue).deepEqual([]);
-      should(gatt._mtu).equal(23);
-      should(gatt._security).equal('low');
-
-      // Events
-      assert.notCalled(handleNotifyCallback);
-      assert.notCalled(handleConfirmationCallback);
-      assert.notCalled(notificationCallback);
-
-      assert.calledOnceWithExactly(callback, data);
-      assert.notCalled(queueCallback);
-      assert.calledOnceWithExactly(queueWriteCallback);
-
-      assert.callCount(aclStream.write, 2);
-      assert.calledWithExactly(aclStream.write, 4, Buffer.from([0x98]));
-      assert.calledWithExactly(aclStream.write, 4, Buffer.from([0x99]));
-    });
   });
 
   describe('onAclStreamEncrypt', () => {
@@ -488,11 +486,22 @@ describe('hci-socket gatt', () => {
       // Setup
       gatt._security = 'low';
       gatt._currentCommand = { buffer };
+      gatt._encrypting = true;
       gatt.onAclStreamEncrypt(true);
 
       should(gatt._security).equal('medium');
+      should(gatt._encrypting).equal(false);
       assert.calledOnceWithExactly(aclStream.write, 4, buffer);
     });
+
+    it('should not repeat requests still waiting for their response', () => {
+      aclStream.write = sinon.spy();
+
+      gatt._currentCommand = { buffer: Buffer.from([0x01, 0x99]) };
+      gatt.onAclStreamEncrypt(true);
+
+      assert.notCalled(aclStream.write);
+    });
   });
 
   it('onAclStreamEnd should remove listeners', () => {
@@ -531,11 +540,10 @@ describe('hci-socket gatt', () => {
     it('should only queue', () => {
       const buffer = Buffer.from([0x01, 0x01, 0x02, 0x03, 0x00]);
       const callback = sinon.spy();
-      const writeCallback = sinon.spy();
 
       // Setup
       gatt._currentCommand = 'command';
-      gatt._queueCommand(buffer, callback, writeCallback);
+      gatt._queueCommand(buffer, callback);
 
       // No changes
       should(gatt._address).equal(address);
@@ -544,11 +552,10 @@ describe('hci-socket gatt', () => {
       should(gatt._characteristics).deepEqual({});
       should(gatt._descriptors).deepEqual({});
       should(gatt._currentCommand).equal('command');
-      should(gatt._commandQueue).deepEqual([{ buffer, callback, writeCallback }]);
+      should(gatt._commandQueue).deepEqual([{ buffer, callback, encrypt: true }]);
       should(gatt._mtu).equal(23);
 
       assert.notCalled(callback);
-      assert.notCalled(writeCallback);
     });
 
     it('should queue and unqueue', () => {
@@ -556,15 +563,14 @@ describe('hci-socket gatt', () => {
 
       const buffer = Buffer.from([0x01, 0x01, 0x02, 0x03, 0x00]);
       const callback = sinon.spy();
-      const writeCallback = sinon.spy();
 
       const queueCallback = sinon.spy();
-      const queueWriteCallback = sinon.spy();
-      const commandQueue = [{ buffer: Buffer.from([0x98]), callback: queueCallback }, { buffer: Buffer.from([0x99]), writeCallback: queueWriteCallback }];
+      const nextCallback = sinon.spy();
+      const commandQueue = [{ buffer: Buffer.from([0x98]), callback: queueCallback }, { buffer: Buffer.from([0x99]), callback: nextCallback }];
 
       // Setup
       gatt._commandQueue = [...commandQueue];
-      gatt._queueCommand(buffer, callback, writeCallback);
+      gatt._queueCommand(buffer, callback);
 
       // No changes
       should(gatt._address).equal(address);
@@ -573,48 +579,101 @@ describe('hci-socket gatt', () => {
       should(gatt._characteristics).deepEqual({});
       should(gatt._descriptors).deepEqual({});
       should(gatt._currentCommand).deepEqual(commandQueue[0]);
-      should(gatt._commandQueue).deepEqual([commandQueue[1], { buffer, callback, writeCallback }]);
+      should(gatt._commandQueue).deepEqual([commandQueue[1], { buffer, callback, encrypt: true }]);
       should(gatt._mtu).equal(23);
       should(gatt._security).equal('low');
 
       assert.notCalled(queueCallback);
-      assert.notCalled(queueWriteCallback);
+      assert.notCalled(nextCallback);
 
       assert.calledOnceWithExactly(aclStream.write, 4, Buffer.from([0x98]));
     });
+  });
+
+  describe('pendingRequests', () => {
+    it('should count the current request and those queued', () => {
+      should(gatt.pendingRequests()).equal(0);
+
+      gatt._currentCommand = { buffer: Buffer.from([0x0a]) };
+      gatt._commandQueue = [{ buffer: Buffer.from([0x0a]) }];
 
-    it('write command callback with queue', () => {
+      should(gatt.pendingRequests()).equal(2);
+    });
+  });
+
+  describe('command lane', () => {
+    it('should write commands while a request is outstanding', () => {
       aclStream.write = sinon.spy();
 
-      const buffer = Buffer.from([0x01, 0x01, 0x02, 0x03, 0x00]);
       const callback = sinon.spy();
       const writeCallback = sinon.spy();
+      const request = Buffer.from([0x0a, 0x03, 0x00]);
+      const command = Buffer.from([0x52, 0x03, 0x00, 0x01]);
 
-      const queueCallback = sinon.spy();
-      const queueWriteCallback = sinon.spy();
-      const commandQueue = [{ buffer: Buffer.from([0x99]), writeCallback: queueWriteCallback }, { buffer: Buffer.from([0x98]), callback: queueCallback }];
+      gatt._queueCommand(request, callback);
+      gatt._queueCommand(Buffer.from([0x0a, 0x04, 0x00]), callback);
+      gatt._queueCommand(command, null, writeCallback);
 
-      // Setup
-      gatt._commandQueue = [...commandQueue];
-      gatt._queueCommand(buffer, callback, writeCallback);
+      should(gatt._currentCommand.buffer).equal(request);
+      should(gatt._commandQueue).have.length(1);
 
-      // No changes
-      should(gatt._address).equal(address);
-      should(gatt._aclStream).deepEqual(aclStream);
-      should(gatt._services).deepEqual({});
-      should(gatt._characteristics).deepEqual({});
-      should(gatt._descriptors).deepEqual({});
-      should(gatt._currentCommand).deepEqual(commandQueue[1]);
-      should(gatt._commandQueue).deepEqual([{ buffer, callback, writeCallback }]);
-      should(gatt._mtu).equal(23);
-      should(gatt._security).equal('low');
+      assert.callCount(aclStream.write, 2);
+      assert.calledWithExactly(aclStream.write, 4, request);
+      assert.calledWithExactly(aclStream.write, 4, command, writeCallback);
+      assert.notCalled(writeCallback);
+      assert.notCalled(callback);
+    });
 
-      assert.notCalled(queueCallback);
-      assert.calledOnceWithExactly(queueWriteCallback);
+    it('should time out the outstanding request', () => {
+      const clock = sinon.useFakeTimers();
+      aclStream.write = sinon.spy();
 
-      assert.callCount(aclStream.write, 2);
-      assert.calledWithExactly(aclStream.write, 4, Buffer.from([0x98]));
-      assert.calledWithExactly(aclStream.write, 4, Buffer.from([0x99]));
+      const callback = sinon.spy();
+      const timeoutCallback = sinon.spy();
+      gatt.on('timeout', timeoutCallback);
+
+      gatt._queueCommand(Buffer.from([0x0a, 0x03, 0x00]), callback);
+      gatt._queueCommand(Buffer.from([0x0a, 0x04, 0x00]), callback);
+
+      clock.tick(29999);
+      assert.notCalled(timeoutCallback);
+
+      clock.tick(1);
+      assert.calledOnceWithExactly(timeoutCallback, address, 0x0a);
+      should(gatt._currentCommand).equal(null);
+      should(gatt._commandQueue).deepEqual([]);
+
+      // nothing more goes out on the bearer
+      gatt._queueCommand(Buffer.from([0x52, 0x03, 0x00, 0x01]), null, sinon.spy());
+      gatt._queueCommand(Buffer.from([0x0a, 0x05, 0x00]), callback);
+      assert.calledOnce(aclStream.write);
+      assert.notCalled(callback);
+
+      clock.restore();
+    });
+
+    it('should restart the timeout for the next request', () => {
+      const clock = sinon.useFakeTimers();
+      aclStream.write = sinon.spy();
+
+      const callback = sinon.spy();
+      const timeoutCallback = sinon.spy();
+      gatt.on('timeout', timeoutCallback);
+
+      gatt._queueCommand(Buffer.from([0x0a, 0x03, 0x00]), callback);
+      gatt._queueCommand(Buffer.from([0x0a, 0x04, 0x00]), callback);
+
+      clock.tick(20000);
+      gatt.onAclStreamData(4, Buffer.from([0x0b, 0x01]));
+      clock.tick(20000);
+      gatt.onAclStreamData(4, Buffer.from([0x0b, 0x02]));
+      clock.tick(30000);
+
+      assert.calledTwice(callback);
+      assert.notCalled(timeoutCallback);
+      should(gatt._timer).equal(null);
+
+      clock.restore();
     });
   });
 
@@ -756,8 +815,32 @@ describe('hci-socket gatt', () => {
     assert.calledOnce(queueCommand);
 
     queueCommand.callArgWith(1, Buffer.from([0x03, 0x12, 0x33]));
-    assert.calledOnceWithExactly(callback, address, 13074);
-    should(gatt._mtu).equal(13074);
+    assert.calledOnceWithExactly(callback, address, 517);
+    should(gatt._mtu).equal(517);
+  });
+
+  it('exchangeMtu should settle on the smaller Rx MTU', () => {
+    const queueCommand = sinon.spy();
+    const callback = sinon.stub();
+
+    gatt = new Gatt(address, aclStream, 185);
+    gatt._queueCommand = queueCommand;
+    gatt.on('mtu', callback);
+    gatt.exchangeMtu();
+
+    assert.calledOnceWithExactly(queueCommand, Buffer.from([0x02, 0xb9, 0x00]), sinon.match.func);
+
+    queueCommand.callArgWith(1, Buffer.from([0x03, 0xf7, 0x00]));
+    assert.calledOnceWithExactly(callback, address, 185);
+
+    queueCommand.callArgWith(1, Buffer.from([0x03, 0x40, 0x00]));
+    should(gatt._mtu).equal(64);
+  });
+
+  it('should ask for at most a 517 byte MTU', () => {
+    gatt = new Gatt(address, aclStream, 1024);
+
+    should(gatt._desired_mtu).equal(517);
   });
 
   it('addService', () => {
@@ -1295,6 +1378,20 @@ describe('hci-socket gatt', () => {
       });
       should(gatt._descriptors).deepEqual({ [serviceUuid]: {} });
     });
+    it('should route notifications by the latest value handle', () => {
+      const notification = sinon.spy();
+      gatt.on('notification', notification);
+
+      gatt.addCharacteristics('service', [{ uuid: 'c_uuid', valueHandle: 3 }]);
+      gatt.addCharacteristics('service', [{ uuid: 'c_uuid', valueHandle: 5 }]);
+
+      gatt.onAclStreamData(0x0004, Buffer.from([0x1b, 0x03, 0x00, 0x01]));
+      assert.notCalled(notification);
+
+      gatt.onAclStreamData(0x0004, Buffer.from([0x1b, 0x05, 0x00, 0x01]));
+      assert.calledOnceWithExactly(notification, address, 'service', 'c_uuid', Buffer.from([0x01]));
+      should(gatt._valueHandles.has(3)).equal(false);
+    });
   });
 
   describe('discoverCharacteristics', () => {
@@ -1759,6 +1856,547 @@ describe('hci-socket gatt', () => {
         assert.notCalled(callback);
       });
     });
+
+    it('should not ask for more than the longest attribute value', () => {
+      const callback = sinon.stub();
+      const response = Buffer.alloc(257, 0x0d);
+
+      gatt._mtu = response.length;
+      gatt.readBlobRequest = sinon.spy();
+      gatt.on('read', callback);
+      gatt.read(serviceUuid, characteristic.uuid);
+
+      gatt._queueCommand.getCall(0).callArgWith(1, response);
+      gatt._queueCommand.getCall(1).callArgWith(1, response);
+
+      assert.callCount(gatt._queueCommand, 2);
+      assert.calledOnceWithExactly(gatt.readBlobRequest, characteristic.valueHandle, 256);
+      assert.calledOnceWithExactly(callback, address, serviceUuid, characteristic.uuid, Buffer.alloc(512, 0x0d));
+    });
+  });
+
+  describe('writeClientFeatures', () => {
+    const serve = (options) => {
+      const responses = [];
+      const session = new FakePeripheral(options).createSession((pdu) => responses.push(pdu));
+
+      aclStream.write = (cid, data) => session.onAtt(data);
+
+      return {
+        session,
+        pump: () => {
+          while (responses.length) {
+            gatt.onAclStreamData(4, responses.shift());
+          }
+        }
+      };
+    };
+
+    it('should set the Multiple Handle Value Notifications bit', () => {
+      const { session, pump } = serve({
+        multipleNotifications: true,
+        services: [{ uuid: '180d', characteristics: [{ uuid: '2a37', properties: ['notify'] }] }]
+      });
+
+      gatt.writeClientFeatures();
+      pump();
+
+      should(session._clientFeatures).equal(0x04);
+      should(session.stats.requests).equal(2);
+      should(gatt.pendingRequests()).equal(0);
+    });
+
+    it('should leave servers without Client Supported Features alone', () => {
+      const { session, pump } = serve({
+        services: [{ uuid: '180d', characteristics: [{ uuid: '2a37', properties: ['notify'] }] }]
+      });
+
+      gatt.writeClientFeatures();
+      pump();
+
+      should(session.stats.requests).equal(1);
+      should(gatt.pendingRequests()).equal(0);
+    });
+
+    it('should set the EATT bit and look for it on the server', () => {
+      const eattSupported = sinon.spy();
+      const { session, pump } = serve({ eatt: true, mtu: 100 });
+
+      gatt.on('eattSupported', eattSupported);
+      gatt.writeClientFeatures(true);
+      pump();
+
+      should(session._clientFeatures).equal(0x06);
+      should(session.stats.requests).equal(3);
+      assert.calledOnceWithExactly(eattSupported, address, 517);
+    });
+
+    it('should queue the write behind requests made meanwhile', () => {
+      const { pump } = serve({ eatt: true });
+      const opcodes = [];
+      const write = aclStream.write;
+
+      aclStream.write = (cid, data) => {
+        opcodes.push(data[0]);
+        write(cid, data);
+      };
+      gatt.writeClientFeatures(true);
+      gatt.exchangeMtu();
+      pump();
+
+      // Read By Type, Exchange MTU, Write, then Read By Type again
+      should(opcodes).deepEqual([0x08, 0x02, 0x12, 0x08]);
+    });
+
+    it('should leave the link unencrypted when refused for security', () => {
+      const requests = [];
+      aclStream.encrypt = sinon.spy();
+      aclStream.write = (cid, data) => requests.push(data);
+
+      gatt.writeClientFeatures(true);
+      gatt.onAclStreamData(4, Buffer.from([0x01, 0x08, 0x01, 0x00, 0x05]));
+      gatt.onAclStreamData(4, Buffer.from([0x01, 0x08, 0x01, 0x00, 0x0f]));
+
+      assert.notCalled(aclStream.encrypt);
+      should(requests.map((request) => request[0])).deepEqual([0x08, 0x08]);
+      should(gatt.pendingRequests()).equal(0);
+    });
+
+    it('should not emit for servers without EATT', () => {
+      const eattSupported = sinon.spy();
+      const { pump } = serve({ multipleNotifications: true });
+
+      gatt.on('eattSupported', eattSupported);
+      gatt.writeClientFeatures(true);
+      pump();
+
+      assert.notCalled(eattSupported);
+    });
+  });
+
+  describe('Enhanced ATT bearers', () => {
+    const EventEmitter = require('events');
+
+    const bearer = (cid, mtu) => {
+      const channel = new EventEmitter();
+      channel.local = { cid, mtu: 517 };
+      channel.remote = { cid: cid + 0x10, mtu };
+      channel.write = sinon.spy();
+
+      gatt.addBearer(channel);
+      return channel;
+    };
+
+    beforeEach(() => {
+      aclStream.write = sinon.spy();
+    });
+
+    it('should spread requests across the bearers', () => {
+      const callback = sinon.spy();
+      const one = bearer(0x40, 517);
+      const two = bearer(0x41, 517);
+
+      gatt._queueCommand(gatt.readRequest(0x0003), callback);
+      gatt._queueCommand(gatt.readRequest(0x0005), callback);
+      gatt._queueCommand(gatt.readRequest(0x0007), callback);
+      gatt._queueCommand(gatt.readRequest(0x0009), callback);
+
+      assert.calledOnceWithExactly(aclStream.write, 4, Buffer.from('0a0300', 'hex'));
+      assert.calledOnceWithExactly(one.write, Buffer.from('0a0500', 'hex'), undefined);
+      assert.calledOnceWithExactly(two.write, Buffer.from('0a0700', 'hex'), undefined);
+      should(gatt.pendingRequests()).equal(4);
+
+      two.emit('data', Buffer.from('0b07', 'hex'));
+
+      assert.calledOnceWithExactly(callback, Buffer.from('0b07', 'hex'), 517);
+      assert.calledWithExactly(two.write, Buffer.from('0a0900', 'hex'), undefined);
+      should(gatt.pendingRequests()).equal(3);
+    });
+
+    it('should keep requests to the same attribute in order', () => {
+      const one = bearer(0x40, 517);
+
+      gatt._queueCommand(gatt.writeRequest(0x0003, Buffer.from([1]), false), sinon.spy());
+      gatt._queueCommand(gatt.writeRequest(0x0003, Buffer.from([2]), false), sinon.spy());
+      gatt._queueCommand(gatt.readRequest(0x0005), sinon.spy());
+
+      assert.calledOnce(aclStream.write);
+      assert.calledOnceWithExactly(one.write, Buffer.from('0a0500', 'hex'), undefined);
+
+      gatt.onAclStreamData(4, Buffer.from('13', 'hex'));
+
+      assert.calledWithExactly(aclStream.write, 4, Buffer.from('12030002', 'hex'));
+    });
+
+    it('should keep long writes to one prepare queue at a time', () => {
+      const one = bearer(0x40, 517);
+      const write = sinon.spy();
+
+      gatt._mtu = 10;
+      gatt._characteristics = { s: { c: { valueHandle: 0x0003 } } };
+      gatt.on('write', write);
+      gatt.longWrite('s', 'c', Buffer.from('0102030405060708', 'hex'), false);
+
+      // one request of the sequence out at a time, on any bearer
+      assert.calledOnceWithExactly(aclStream.write, 4, Buffer.from('16030000000102030405', 'hex'));
+      assert.notCalled(one.write);
+
+      gatt.onAclStreamData(4, Buffer.from('17030000000102030405', 'hex'));
+      assert.calledWithExactly(aclStream.write, 4, Buffer.from('1603000500060708', 'hex'));
+
+      gatt.onAclStreamData(4, Buffer.from('1703000500060708', 'hex'));
+      assert.calledWithExactly(aclStream.write, 4, Buffer.from('1801', 'hex'));
+
+      gatt.onAclStreamData(4, Buffer.from('19', 'hex'));
+      assert.notCalled(one.write);
+      assert.calledOnce(write);
+    });
+
+    it('should only hand a bearer requests that fit its MTU', () => {
+      const one = bearer(0x40, 64);
+
+      gatt._mtu = 100;
+      gatt._queueCommand(gatt.readRequest(0x0003), sinon.spy());
+      gatt._queueCommand(gatt.writeRequest(0x0005, Buffer.alloc(80), false), sinon.spy());
+
+      assert.notCalled(one.write);
+      should(gatt._commandQueue).have.length(1);
+    });
+
+    it('should confirm indications on the bearer they came on', () => {
+      const one = bearer(0x40, 517);
+      const handleNotify = sinon.spy();
+      gatt.on('handleNotify', handleNotify);
+
+      one.emit('data', Buffer.from('1d030001', 'hex'));
+
+      assert.calledOnceWithExactly(handleNotify, address, 0x0003, Buffer.from([0x01]));
+      assert.calledOnceWithMatch(one.write, Buffer.from('1e', 'hex'), sinon.match.func);
+      assert.notCalled(aclStream.write);
+    });
+
+    it('should move the request of a closed bearer to another one', () => {
+      const callback = sinon.spy();
+      const one = bearer(0x40, 517);
+
+      gatt._currentCommand = { buffer: gatt.readRequest(0x0003) };
+      gatt._queueCommand(gatt.readRequest(0x0005), callback);
+      const two = bearer(0x41, 517);
+
+      one.emit('end');
+      assert.calledOnceWithExactly(two.write, Buffer.from('0a0500', 'hex'), undefined);
+
+      two.emit('data', Buffer.from('0b', 'hex'));
+      assert.calledOnce(callback);
+    });
+
+    it('should time out on any bearer', () => {
+      const clock = sinon.useFakeTimers();
+      const timeout = sinon.spy();
+      bearer(0x40, 517);
+      gatt.on('timeout', timeout);
+
+      gatt._queueCommand(gatt.readRequest(0x0003), sinon.spy());
+      gatt._queueCommand(gatt.readRequest(0x0005), sinon.spy());
+      gatt.onAclStreamData(4, Buffer.from('0b', 'hex'));
+
+      clock.tick(30000);
+      clock.restore();
+
+      assert.calledOnceWithExactly(timeout, address, 0x0a);
+      should(gatt.pendingRequests()).equal(0);
+    });
+  });
+
+  describe('discoverDatabase', () => {
+    const serve = (services) => {
+      const responses = [];
+      const session = new FakePeripheral({ services }).createSession((pdu) => responses.push(pdu));
+      let requests = 0;
+
+      aclStream.write = (cid, data) => {
+        requests++;
+        session.onAtt(data);
+      };
+
+      return () => {
+        while (responses.length) {
+          gatt.onAclStreamData(4, responses.shift());
+        }
+        return requests;
+      };
+    };
+
+    const database = [
+      {
+        uuid: '180d',
+        characteristics: [
+          { uuid: '2a37', properties: ['notify'] },
+          { uuid: '2a38', properties: ['read'], descriptors: [{ uuid: '2901' }] }
+        ]
+      }
+    ];
+
+    it('should emit the whole tree', () => {
+      const callback = sinon.spy();
+      const pump = serve([
+        {
+          uuid: '180d',
+          characteristics: [
+            { uuid: '2a37', properties: ['notify'] },
+            { uuid: '2a38', properties: ['read'], descriptors: [{ uuid: '2901' }] }
+          ]
+        },
+        {
+          uuid: '6e400001b5a3f393e0a9e50e24dcca9e',
+          characteristics: [
+            { uuid: '6e400003b5a3f393e0a9e50e24dcca9e', properties: ['notify', 'write'] }
+          ]
+        }
+      ]);
+
+      gatt.on('databaseDiscover', callback);
+      gatt.discoverDatabase(true);
+      // MTU 23: 2 Read By Group Type, 3 Read By Type and 3 Find Information
+      // requests, the last ones run into the end of the handle range
+      should(pump()).equal(8);
+
+      assert.calledOnceWithExactly(callback, address, [
+        {
+          uuid: '180d',
+          startHandle: 1,
+          endHandle: 7,
+          characteristics: [
+            {
+              uuid: '2a37',
+              properties: ['notify'],
+              startHandle: 2,
+              valueHandle: 3,
+              endHandle: 4,
+              descriptors: [{ uuid: '2902', handle: 4 }]
+            },
+            {
+              uuid: '2a38',
+              properties: ['read'],
+              startHandle: 5,
+              valueHandle: 6,
+              endHandle: 7,
+              descriptors: [{ uuid: '2901', handle: 7 }]
+            }
+          ]
+        },
+        {
+          uuid: '6e400001b5a3f393e0a9e50e24dcca9e',
+          startHandle: 8,
+          endHandle: 0xffff,
+          characteristics: [
+            {
+              uuid: '6e400003b5a3f393e0a9e50e24dcca9e',
+              properties: ['write', 'notify'],
+              startHandle: 9,
+              valueHandle: 10,
+              endHandle: 0xffff,
+              descriptors: [{ uuid: '2902', handle: 11 }]
+            }
+          ]
+        }
+      ]);
+
+      // and can use it right away
+      should(gatt._services['180d'].endHandle).equal(7);
+      should(gatt._characteristics['180d']['2a38'].valueHandle).equal(6);
+      should(gatt._descriptors['180d']['2a37']['2902'].handle).equal(4);
+      should(gatt._valueHandles.get(10)).deepEqual([
+        { serviceUuid: '6e400001b5a3f393e0a9e50e24dcca9e', characteristicUuid: '6e400003b5a3f393e0a9e50e24dcca9e' }
+      ]);
+    });
+
+    it('should leave the descriptors out unless asked', () => {
+      const callback = sinon.spy();
+      const pump = serve(database);
+
+      gatt.on('databaseDiscover', callback);
+      gatt.discoverDatabase();
+
+      // 1 Read By Group Type and 2 Read By Type requests, no Find Information
+      should(pump()).equal(3);
+      should(callback.firstCall.args[1][0].characteristics[1]).deepEqual({
+        uuid: '2a38',
+        properties: ['read'],
+        startHandle: 5,
+        valueHandle: 6,
+        endHandle: 0xffff
+      });
+      should(gatt._descriptors['180d']).deepEqual({});
+    });
+
+    describe('with a misbehaving server', () => {
+      let callback;
+
+      beforeEach(() => {
+        callback = sinon.spy();
+        aclStream.write = sinon.spy();
+        gatt.on('databaseDiscover', callback);
+        gatt.discoverDatabase();
+      });
+
+      it('should stop on a response without a complete entry', () => {
+        gatt.onAclStreamData(4, Buffer.from([0x11, 0x06, 0x01, 0x00]));
+
+        assert.calledOnce(aclStream.write);
+        assert.calledOnceWithExactly(callback, address, []);
+      });
+
+      it('should stop on a length below the smallest entry', () => {
+        gatt.onAclStreamData(4, Buffer.from([0x11, 0x00, 0x01, 0x00]));
+
+        assert.calledOnce(aclStream.write);
+        assert.calledOnceWithExactly(callback, address, []);
+      });
+
+      it('should stop on a response that doesn\'t move the sweep on', () => {
+        const service = Buffer.from([0x11, 0x06, 0x01, 0x00, 0x05, 0x00, 0x0d, 0x18]);
+
+        gatt.onAclStreamData(4, service);
+        gatt.onAclStreamData(4, service);
+
+        // then the characteristics of the one service
+        assert.calledThrice(aclStream.write);
+        gatt.onAclStreamData(4, Buffer.from([0x09, 0x07, 0x02, 0x00, 0x02, 0x03, 0x00, 0x37, 0x2a]));
+        gatt.onAclStreamData(4, Buffer.from([0x09, 0x07, 0x02, 0x00, 0x02, 0x03, 0x00, 0x37, 0x2a]));
+
+        should(aclStream.write.callCount).equal(4);
+        should(callback.firstCall.args[1]).have.length(1);
+        should(callback.firstCall.args[1][0].characteristics).have.length(1);
+      });
+    });
+
+    it('should emit an empty tree without services', () => {
+      const callback = sinon.spy();
+      const pump = serve([]);
+
+      gatt.on('databaseDiscover', callback);
+      gatt.discoverDatabase();
+
+      should(pump()).equal(1);
+      assert.calledOnceWithExactly(callback, address, []);
+    });
+  });
+
+  describe('readMultiple', () => {
+    const characteristics = [
+      { serviceUuid: 'service', characteristicUuid: 'char1' },
+      { serviceUuid: 'service', characteristicUuid: 'char2' },
+      { serviceUuid: 'service', characteristicUuid: 'char3' }
+    ];
+    let callback;
+
+    beforeEach(() => {
+      aclStream.write = sinon.spy();
+      callback = sinon.spy();
+      gatt._characteristics = {
+        service: {
+          char1: { uuid: 'char1', valueHandle: 0x0003 },
+          char2: { uuid: 'char2', valueHandle: 0x0005 },
+          char3: { uuid: 'char3', valueHandle: 0x0007 }
+        }
+      };
+      gatt.on('readMultiple', callback);
+    });
+
+    const written = () => aclStream.write.args.map((args) => args[1].toString('hex'));
+
+    it('should read all values with one Read Multiple Variable Length Request', () => {
+      gatt.readMultiple(characteristics, 7);
+
+      should(written()).deepEqual(['20030005000700']);
+
+      gatt.onAclStreamData(4, Buffer.from('21' + '0100' + '64' + '0300' + '312e30' + '0000', 'hex'));
+
+      assert.calledOnceWithExactly(callback, address, 7, null, [
+        Buffer.from([0x64]),
+        Buffer.from('1.0'),
+        Buffer.alloc(0)
+      ]);
+    });
+
+    it('should read the rest of truncated and missing values', () => {
+      gatt.readMultiple(characteristics, 7);
+
+      // 22 bytes of a 30 byte value fill the 23 byte MTU
+      const value = Buffer.alloc(30, 0x61);
+      gatt.onAclStreamData(4, Buffer.concat([Buffer.from('210100641e00', 'hex'), value.slice(0, 16)]));
+
+      should(written()).deepEqual(['20030005000700', '0c05001000']);
+      assert.notCalled(callback);
+
+      gatt.onAclStreamData(4, Buffer.concat([Buffer.from('0d', 'hex'), value.slice(16)]));
+      should(written()).deepEqual(['20030005000700', '0c05001000', '0a0700']);
+      gatt.onAclStreamData(4, Buffer.from('0b0102', 'hex'));
+
+      assert.calledOnceWithExactly(callback, address, 7, null, [
+        Buffer.from([0x64]),
+        value,
+        Buffer.from([0x01, 0x02])
+      ]);
+    });
+
+    it('should fall back to single reads when not supported', () => {
+      gatt.readMultiple(characteristics, 7);
+      gatt.onAclStreamData(4, Buffer.from('0120030006', 'hex'));
+
+      should(written()).deepEqual(['20030005000700', '0a0300']);
+      gatt.onAclStreamData(4, Buffer.from('0b01', 'hex'));
+      should(written()).deepEqual(['20030005000700', '0a0300', '0a0500']);
+      gatt.onAclStreamData(4, Buffer.from('0b02', 'hex'));
+      gatt.onAclStreamData(4, Buffer.from('0b03', 'hex'));
+
+      assert.calledOnceWithExactly(callback, address, 7, null, [
+        Buffer.from([0x01]),
+        Buffer.from([0x02]),
+        Buffer.from([0x03])
+      ]);
+
+      // and doesn't try again
+      gatt.readMultiple(characteristics.slice(1));
+      should(written().slice(4)).deepEqual(['0a0500']);
+    });
+
+    it('should fail on characteristics not discovered', () => {
+      gatt.readMultiple([characteristics[0], { serviceUuid: 'other', characteristicUuid: 'char1' }], 7);
+
+      assert.notCalled(aclStream.write);
+      should(callback.firstCall.args[1]).equal(7);
+      should(callback.firstCall.args[2].message).equal('unknown characteristic other, char1');
+    });
+
+    it('should split requests at the MTU', () => {
+      const many = [];
+      for (let i = 0; i < 12; i++) {
+        gatt._characteristics.service[`c${i}`] = { valueHandle: 0x0010 + i };
+        many.push({ serviceUuid: 'service', characteristicUuid: `c${i}` });
+      }
+
+      gatt.readMultiple(many);
+      gatt.onAclStreamData(4, Buffer.from('21' + '010000'.repeat(11), 'hex'));
+
+      // (23 - 1) / 2 handles per request
+      should(written()).deepEqual([
+        '2010001100120013001400150016001700180019001a00',
+        '201b00'
+      ]);
+
+      gatt.onAclStreamData(4, Buffer.from('21010001', 'hex'));
+
+      assert.calledOnce(callback);
+      should(callback.firstCall.args[3]).have.length(12);
+      should(callback.firstCall.args[3][11]).deepEqual(Buffer.from([0x01]));
+    });
+  });
+
+  it('readMultipleRequest', () => {
+    should(gatt.readMultipleRequest([0x0003, 0x0105], false)).deepEqual(Buffer.from('0e03000501', 'hex'));
+    should(gatt.readMultipleRequest([0x0003, 0x0105], true)).deepEqual(Buffer.from('2003000501', 'hex'));
   });
 
   describe('write', () => {
@@ -1934,6 +2572,94 @@ describe('hci-socket gatt', () => {
     });
   });
 
+  describe('longWrite with a limited prepare queue', () => {
+    const serviceUuid = 'serviceUuid';
+    const characteristic = {
+      valueHandle: 0x0003,
+      uuid: 'cUuid'
+    };
+    let callback;
+
+    beforeEach(() => {
+      aclStream.write = sinon.spy();
+      callback = sinon.stub();
+
+      gatt._mtu = 10;
+      gatt._characteristics = {
+        [serviceUuid]: {
+          [characteristic.uuid]: characteristic
+        }
+      };
+      gatt.on('write', callback);
+    });
+
+    const written = () => aclStream.write.lastCall.args[1].toString('hex');
+    // echoes Prepare Write Requests back
+    const prepared = () => {
+      const response = Buffer.from(aclStream.write.lastCall.args[1]);
+      response[0] = 0x17;
+      gatt.onAclStreamData(4, response);
+    };
+    const respond = (hex) => gatt.onAclStreamData(4, Buffer.from(hex, 'hex'));
+
+    it('should execute what the server queued and go on in smaller batches', () => {
+      gatt.longWrite(serviceUuid, characteristic.uuid, Buffer.from('0102030405060708090a0b0c', 'hex'), false);
+
+      should(written()).equal('1603000000' + '0102030405');
+      prepared();
+      should(written()).equal('1603000500' + '060708090a');
+      respond('0116030009');
+
+      should(gatt._prepareQueueSize).equal(1);
+      should(written()).equal('1801');
+      respond('19');
+
+      should(written()).equal('1603000500' + '060708090a');
+      prepared();
+      should(written()).equal('1801');
+      respond('19');
+
+      should(written()).equal('1603000a00' + '0b0c');
+      prepared();
+      should(written()).equal('1801');
+      assert.notCalled(callback);
+      respond('19');
+
+      should(gatt._commandQueue).deepEqual([]);
+      assert.calledOnceWithExactly(callback, address, serviceUuid, characteristic.uuid);
+    });
+
+    it('should batch by the known queue size from the start', () => {
+      gatt._prepareQueueSize = 2;
+      gatt.longWrite(serviceUuid, characteristic.uuid, Buffer.from('0102030405060708090a0b0c', 'hex'), false);
+
+      prepared();
+      prepared();
+      should(written()).equal('1801');
+      respond('19');
+
+      should(written()).equal('1603000a00' + '0b0c');
+      prepared();
+      respond('19');
+
+      assert.calledOnceWithExactly(callback, address, serviceUuid, characteristic.uuid);
+    });
+
+    it('should cancel the prepared writes on an error', () => {
+      gatt.longWrite(serviceUuid, characteristic.uuid, Buffer.from('0102030405060708090a0b0c', 'hex'), false);
+
+      prepared();
+      respond('0116030003');
+
+      should(written()).equal('1800');
+      respond('19');
+
+      should(gatt._commandQueue).deepEqual([]);
+      should(gatt._currentCommand).equal(null);
+      assert.notCalled(callback);
+    });
+  });
+
   describe('broadcast', () => {
     const serviceUuid = 'serviceUuid';
     const characteristic = {
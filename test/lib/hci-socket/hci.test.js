@@ -1889,3 +1889,322 @@
 //     should(hci._state).equal('newState');
 //   });
 // });
+
+const should = require('should');
+const sinon = require('sinon');
+
+const { assert } = sinon;
+
+const Hci = require('../../../lib/hci-socket/hci');
+const FakeController = require('../../../lib/hci-socket/fake-controller');
+
+describe('hci-socket hci command flow control', () => {
+  const init = (controllerOptions, hciOptions) => {
+    const socket = new FakeController(controllerOptions);
+    const hci = new Hci(
+      Object.assign({ socket, userChannel: true }, hciOptions)
+    );
+    return { socket, hci };
+  };
+
+  const poweredOn = (hci) =>
+    new Promise((resolve) => {
+      hci.on('stateChange', (state) => {
+        if (state === 'poweredOn') {
+          resolve();
+        }
+      });
+      hci.init();
+    });
+
+  it('should only send one command before the first response', () => {
+    const { socket, hci } = init({ numCommandPackets: 4, commandLatency: 5 });
+    socket.start();
+    hci._socket.on('data', hci.onSocketData.bind(hci));
+
+    hci.readLocalVersion();
+    hci.readBdAddr();
+    hci.readLeBufferSize();
+
+    should(socket.stats.commands).equal(1);
+    should(hci._cmdQueue).have.length(2);
+  });
+
+  it('should power on without exceeding a single command credit', async () => {
+    const { socket, hci } = init({ numCommandPackets: 1 });
+
+    await poweredOn(hci);
+
+    should(socket.stats.creditViolations).equal(0);
+    should(socket.stats.maxCommandsInFlight).equal(1);
+    should(hci.address).equal(socket.address);
+  });
+
+  it('should pipeline init commands when the controller grants credits', async () => {
+    const { socket, hci } = init({ numCommandPackets: 8 });
+
+    await poweredOn(hci);
+
+    should(socket.stats.creditViolations).equal(0);
+    should(socket.stats.maxCommandsInFlight).equal(8);
+  });
+
+  it('should resolve with the return parameters', async () => {
+    const { socket, hci } = init({ numCommandPackets: 2 });
+    socket.start();
+    hci._socket.on('data', hci.onSocketData.bind(hci));
+
+    const result = await hci.readBdAddr();
+
+    should(result.toString('hex')).equal('554433221100');
+  });
+
+  it('should reject with the controller status', async () => {
+    const { socket, hci } = init({ numCommandPackets: 2 });
+    socket.start();
+    hci._socket.on('data', hci.onSocketData.bind(hci));
+
+    const error = await hci.readSupportedCommands().then(
+      () => null,
+      (error) => error
+    );
+    should(error).equal(null);
+
+    const cmd = Buffer.from([0x01, 0x34, 0x12, 0x00]);
+    const unknown = await hci.sendCommand(cmd).then(
+      () => null,
+      (error) => error
+    );
+    should(unknown.status).equal(0x01);
+    should(hci._cmdCredits).equal(2);
+  });
+
+  it('should time out and recover the command credit', async () => {
+    const { socket, hci } = init(
+      { numCommandPackets: 1 },
+      { commandTimeout: 10 }
+    );
+    // never started, so the controller swallows every response
+
+    const first = hci.readBdAddr().then(
+      () => null,
+      (error) => error
+    );
+    hci.readLocalVersion();
+
+    should(socket.stats.commands).equal(1);
+
+    const error = await first;
+    should(error.message).equal('HCI command 0x1009 timed out');
+    should(socket.stats.commands).equal(2);
+  });
+
+  it('should drop the late response to a timed out command', async () => {
+    const { hci } = init({ numCommandPackets: 1 }, { commandTimeout: 10 });
+
+    const first = hci.readBdAddr().then(
+      () => null,
+      (error) => error
+    );
+    should((await first).message).equal('HCI command 0x1009 timed out');
+
+    const resolved = sinon.spy();
+    const second = hci.readBdAddr().then(resolved);
+
+    hci.processCommandResponse(0x1009, 1, 0, Buffer.from('665544332211', 'hex'));
+    await new Promise((resolve) => setImmediate(resolve));
+    assert.notCalled(resolved);
+
+    hci.processCommandResponse(0x1009, 1, 0, Buffer.from('554433221100', 'hex'));
+    await second;
+    assert.calledOnce(resolved);
+    should(resolved.args[0][0].toString('hex')).equal('554433221100');
+    should(hci._cmdTimedOut.size).equal(0);
+  });
+
+  it('should call back once the controller took the last ACL fragment', async () => {
+    const { socket, hci } = init();
+    hci.setAclBuffers(27, 1);
+    hci._aclConnections.set(0x0040, { pending: 0 });
+
+    const first = sinon.spy();
+    const second = sinon.spy();
+
+    await hci.writeAclDataPkt(0x0040, 0x0004, Buffer.alloc(20), first);
+    await hci.writeAclDataPkt(0x0040, 0x0004, Buffer.alloc(20), second);
+    await hci.flushAcl();
+
+    assert.calledOnce(first);
+    assert.notCalled(second);
+    should(socket.stats.aclPacketsReceived).equal(1);
+
+    // Number Of Completed Packets frees the buffer
+    hci.onSocketData(Buffer.from('0413050140000100', 'hex'));
+    await hci.flushAcl();
+
+    assert.calledOnce(second);
+    should(socket.stats.aclPacketsReceived).equal(2);
+  });
+
+  it('should fragment ACL data into whole link layer PDUs', async () => {
+    const { hci } = init();
+    hci.setAclBuffers(251, 8);
+    hci.processLeMetaEvent(0x01, 0x00, Buffer.from('400000010100000000c0' + '0600' + '0000' + '2a00' + '00', 'hex'));
+
+    const writes = [];
+    const lengths = () => writes.map((packet) => packet.readUInt16LE(3));
+    hci.writeSocket = (packet) => writes.push(packet);
+
+    // 27 byte PDUs: 9 fill a 243 byte fragment
+    await hci.writeAclDataPkt(0x0040, 0x0004, Buffer.alloc(300));
+    should(lengths()).deepEqual([243, 61]);
+
+    const dataLengthChanged = sinon.spy();
+    hci.on('leDataLengthChange', dataLengthChanged);
+    const event = Buffer.from('043e0b07' + '4000' + 'fb00' + '4808' + 'fb00' + '4808', 'hex');
+    const parameters = sinon.spy(hci, 'processLeDataLengthChange');
+    hci.onSocketData(event);
+    assert.calledOnceWithExactly(dataLengthChanged, 0x0040, 251, 251);
+    // read in place, from right after the sub event code
+    should(parameters.firstCall.args[0].buffer).equal(event.buffer);
+    should(parameters.firstCall.args[0].byteOffset).equal(event.byteOffset + 4);
+
+    writes.length = 0;
+    await hci.writeAclDataPkt(0x0040, 0x0004, Buffer.alloc(300));
+    should(lengths()).deepEqual([251, 53]);
+  });
+});
+
+describe('hci-socket hci periodic advertising events', () => {
+  let hci;
+
+  beforeEach(() => {
+    hci = new Hci({ socket: new FakeController(), userChannel: true });
+  });
+
+  it('should read periodic advertising reports in place', () => {
+    const reports = sinon.spy();
+    const event = Buffer.from('043e0c0f' + '0500' + '7f' + 'c4' + 'ff' + '00' + '03' + 'aabbcc', 'hex');
+
+    hci.on('lePeriodicAdvertisingReport', reports);
+    hci.onSocketData(event);
+
+    assert.calledOnceWithExactly(reports, 0x0005, 127, -60, 0x00, Buffer.from('aabbcc', 'hex'));
+    should(reports.firstCall.args[4].buffer).equal(event.buffer);
+    should(reports.firstCall.args[4].byteOffset).equal(event.byteOffset + 11);
+  });
+
+  it('should report lost syncs', () => {
+    const lost = sinon.spy();
+
+    hci.on('lePeriodicSyncLost', lost);
+    hci.onSocketData(Buffer.from('043e03100500', 'hex'));
+
+    assert.calledOnceWithExactly(lost, 0x0005);
+  });
+});
+
+describe('hci-socket hci advertising report decoding', () => {
+  // LE Advertising Report, connectable, random address 06:05:04:03:02:01,
+  // "hi" as local name, rssi -60
+  const packet = Buffer.from('043e1102010001010203040506' + '04' + '03096869' + 'c4', 'hex');
+
+  const init = (adDecoder) => {
+    const hci = new Hci({ socket: new FakeController(), adDecoder });
+    const reports = sinon.spy();
+    hci.on('leAdvertisingReport', reports);
+    return { hci, reports };
+  };
+
+  it('should decode in JS without a native decoder', () => {
+    const { hci, reports } = init(null);
+
+    hci.onSocketData(packet);
+
+    assert.calledOnceWithExactly(reports, 0, 0, '06:05:04:03:02:01', 'random', Buffer.from('03096869', 'hex'), -60);
+  });
+
+  it('should pass on advertisements decoded by the native decoder', () => {
+    const advertisement = { localName: 'hi' };
+    const decodeAdvertisingEvent = sinon.fake.returns([
+      {
+        type: 0,
+        address: '06:05:04:03:02:01',
+        addressType: 'random',
+        rssi: -60,
+        eirOffset: 14,
+        eirLength: 4,
+        advertisement
+      }
+    ]);
+    const { hci, reports } = init({ decodeAdvertisingEvent });
+
+    hci.onSocketData(packet);
+
+    assert.calledOnceWithExactly(decodeAdvertisingEvent, packet);
+    assert.calledOnceWithExactly(reports, 0, 0, '06:05:04:03:02:01', 'random', Buffer.from('03096869', 'hex'), -60, advertisement);
+  });
+
+  it('should fall back to JS when the native decoder rejects the event', () => {
+    const { hci, reports } = init({ decodeAdvertisingEvent: sinon.fake.returns(null) });
+
+    hci.onSocketData(packet);
+
+    assert.calledOnceWithExactly(reports, 0, 0, '06:05:04:03:02:01', 'random', Buffer.from('03096869', 'hex'), -60);
+  });
+});
+
+describe('hci-socket hci user channel', () => {
+  const env = process.env.HCI_CHANNEL_USER;
+  let socket;
+
+  beforeEach(() => {
+    socket = {
+      on: sinon.spy(),
+      bindUser: sinon.spy(),
+      bindRaw: sinon.spy(),
+      start: sinon.spy()
+    };
+  });
+
+  afterEach(() => {
+    if (env === undefined) {
+      delete process.env.HCI_CHANNEL_USER;
+    } else {
+      process.env.HCI_CHANNEL_USER = env;
+    }
+  });
+
+  const init = (options) => {
+    const hci = new Hci(Object.assign({ socket, deviceId: 1 }, options));
+    hci.reset = sinon.spy();
+    hci.pollIsDevUp = sinon.spy();
+    hci.init();
+    return hci;
+  };
+
+  it('should bind the user channel when asked to', () => {
+    delete process.env.HCI_CHANNEL_USER;
+    const hci = init({ userChannel: true });
+
+    assert.calledOnceWithExactly(socket.bindUser, 1);
+    assert.notCalled(socket.bindRaw);
+    assert.calledOnce(hci.reset);
+  });
+
+  it('should fall back to HCI_CHANNEL_USER', () => {
+    process.env.HCI_CHANNEL_USER = '1';
+    init();
+
+    assert.calledOnceWithExactly(socket.bindUser, 1);
+  });
+
+  it('should let the option override HCI_CHANNEL_USER', () => {
+    process.env.HCI_CHANNEL_USER = '1';
+    const hci = init({ userChannel: false });
+
+    assert.notCalled(socket.bindUser);
+    assert.calledOnceWithExactly(socket.bindRaw, 1);
+    assert.calledOnce(hci.pollIsDevUp);
+  });
+});
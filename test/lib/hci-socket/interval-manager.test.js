@@ -0,0 +1,175 @@
+const should = require('should');
+const sinon = require('sinon');
+const events = require('events');
+
+const { assert } = sinon;
+
+const IntervalManager = require('../../../lib/hci-socket/interval-manager');
+
+describe('hci-socket interval-manager', () => {
+  let clock;
+  let hci;
+  let manager;
+
+  const connect = (handle, interval) => {
+    const aclStream = { txBytes: 0, rxBytes: 0 };
+    const gatt = new events.EventEmitter();
+    gatt.pendingRequests = sinon.stub().returns(0);
+
+    manager.addConnection(handle, aclStream, gatt, interval);
+
+    return { aclStream, gatt };
+  };
+
+  beforeEach(() => {
+    clock = sinon.useFakeTimers();
+    hci = { connUpdateLe: sinon.spy() };
+    manager = new IntervalManager(hci, {});
+  });
+
+  afterEach(() => {
+    for (const handle of Array.from(manager._connections.keys())) {
+      manager.removeConnection(handle);
+    }
+    clock.restore();
+  });
+
+  it('should ask for the fast interval while requests are outstanding', () => {
+    const decision = sinon.spy();
+    manager.on('decision', decision);
+
+    const { gatt } = connect(1, 30);
+    gatt.pendingRequests.returns(2);
+
+    clock.tick(250);
+
+    assert.calledOnceWithExactly(hci.connUpdateLe, 1, 7.5, 15, 0, 420);
+    assert.calledOnceWithMatch(decision, 1, {
+      state: 'fast',
+      reason: 'requests',
+      minInterval: 7.5,
+      maxInterval: 15,
+      pendingRequests: 2
+    });
+  });
+
+  it('should ask for the fast interval for bulk commands', () => {
+    const { aclStream } = connect(1, 50);
+    aclStream.txBytes = 1000;
+
+    clock.tick(250);
+
+    assert.calledOnceWithExactly(hci.connUpdateLe, 1, 7.5, 15, 0, 420);
+  });
+
+  it('should wait for the update before asking again', () => {
+    const { gatt } = connect(1, 30);
+    gatt.pendingRequests.returns(1);
+
+    clock.tick(1000);
+    assert.calledOnce(hci.connUpdateLe);
+
+    manager.onConnectionUpdate(0, 1, 15, 0, 420);
+    clock.tick(1000);
+    assert.calledOnce(hci.connUpdateLe);
+  });
+
+  it('should relax to the notification rate once calm', () => {
+    const decision = sinon.spy();
+    const update = sinon.spy();
+    manager.on('decision', decision);
+    manager.on('update', update);
+
+    const { gatt } = connect(1, 7.5);
+
+    // 40 Hz: 4 notifications per event at 100 ms
+    const notifier = setInterval(() => gatt.emit('handleNotify'), 25);
+
+    clock.tick(1750);
+    assert.notCalled(hci.connUpdateLe);
+
+    clock.tick(500);
+    clearInterval(notifier);
+
+    assert.calledOnceWithExactly(hci.connUpdateLe, 1, 100, 125, 0, 420);
+    assert.calledOnceWithMatch(decision, 1, {
+      state: 'steady',
+      reason: 'notifications',
+      notificationsPerSecond: 40
+    });
+
+    manager.onConnectionUpdate(0, 1, 125, 0, 420);
+    assert.calledOnceWithExactly(update, 1, 0, 125, 0, 420);
+    should(manager._connections.get(1).interval).equal(125);
+  });
+
+  it('should go back to fast from steady right away', () => {
+    const { gatt } = connect(1, 7.5);
+    const notifier = setInterval(() => gatt.emit('handleNotify'), 25);
+
+    clock.tick(2250);
+    manager.onConnectionUpdate(0, 1, 125, 0, 420);
+    hci.connUpdateLe.resetHistory();
+
+    gatt.pendingRequests.returns(1);
+    clock.tick(250);
+    clearInterval(notifier);
+
+    assert.calledOnceWithExactly(hci.connUpdateLe, 1, 7.5, 15, 0, 420);
+  });
+
+  it('should go idle without traffic', () => {
+    connect(1, 7.5);
+
+    clock.tick(2250);
+
+    assert.calledOnceWithExactly(hci.connUpdateLe, 1, 100, 125, 0, 420);
+  });
+
+  it('should leave room for every connection', () => {
+    for (let handle = 1; handle <= 60; handle++) {
+      connect(handle, 7.5);
+    }
+
+    clock.tick(2250);
+
+    // 60 connections of 2.5 ms each
+    assert.callCount(hci.connUpdateLe, 60);
+    assert.calledWithExactly(hci.connUpdateLe, 1, 150, 150, 0, 420);
+  });
+
+  it('should stretch the supervision timeout with the latency', () => {
+    manager = new IntervalManager(hci, {
+      idle: { minInterval: 400, maxInterval: 500, latency: 4 }
+    });
+    connect(1, 7.5);
+
+    clock.tick(2250);
+
+    assert.calledOnceWithExactly(hci.connUpdateLe, 1, 400, 500, 4, 5010);
+  });
+
+  it('should hold off after a rejected update', () => {
+    const { gatt } = connect(1, 30);
+    gatt.pendingRequests.returns(1);
+
+    clock.tick(250);
+    manager.onConnectionUpdate(0x3b, 1, 0, 0, 0);
+    should(manager._connections.get(1).interval).equal(30);
+
+    clock.tick(1750);
+    assert.calledOnce(hci.connUpdateLe);
+
+    clock.tick(500);
+    assert.calledTwice(hci.connUpdateLe);
+  });
+
+  it('should stop sampling once the last connection is gone', () => {
+    const { gatt } = connect(1, 7.5);
+
+    manager.removeConnection(1);
+
+    should(manager._timer).equal(null);
+    should(gatt.listenerCount('handleNotify')).equal(0);
+  });
+});
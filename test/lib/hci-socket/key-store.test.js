@@ -0,0 +1,100 @@
+const should = require('should');
+
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const crypto = require('../../../lib/hci-socket/crypto');
+const KeyStore = require('../../../lib/hci-socket/key-store');
+
+describe('hci-socket key-store', () => {
+  let file;
+
+  const keys = (fill) => ({
+    ltk: Buffer.alloc(16, fill),
+    ediv: Buffer.from([fill, 0x01]),
+    rand: Buffer.alloc(8, fill + 1),
+    keySize: 16
+  });
+
+  beforeEach(() => {
+    file = path.join(
+      os.tmpdir(),
+      `noble-key-store-${process.pid}-${Date.now()}`
+    );
+  });
+
+  afterEach(() => {
+    if (fs.existsSync(file)) {
+      fs.unlinkSync(file);
+    }
+  });
+
+  it('should keep bonds in memory without a path', () => {
+    const store = new KeyStore();
+
+    store.set('C0:00:00:00:00:01', 'random', keys(0x11));
+
+    should(store.get('c0:00:00:00:00:01', 'random').ltk).deepEqual(Buffer.alloc(16, 0x11));
+    should(store.get('c0:00:00:00:00:02', 'random')).equal(null);
+    should(store.size).equal(1);
+  });
+
+  it('should round trip bonds through the file', () => {
+    const irk = Buffer.alloc(16, 0x33);
+    const store = new KeyStore(file);
+
+    store.set('c0:00:00:00:00:01', 'random', keys(0x11));
+    store.set('00:11:22:33:44:55', 'public', Object.assign(keys(0x22), { irk }));
+
+    // a 5 byte header and 50 bytes a bond
+    should(fs.statSync(file).size).equal(105);
+
+    const loaded = new KeyStore(file);
+    should(loaded.size).equal(2);
+    should(loaded.get('c0:00:00:00:00:01', 'random')).deepEqual({
+      address: 'c0:00:00:00:00:01',
+      addressType: 'random',
+      keySize: 16,
+      ltk: Buffer.alloc(16, 0x11),
+      ediv: Buffer.from([0x11, 0x01]),
+      rand: Buffer.alloc(8, 0x12),
+      irk: null
+    });
+    should(loaded.get('00:11:22:33:44:55', 'public').irk).deepEqual(irk);
+  });
+
+  it('should file bonds under the identity address and resolve private ones', () => {
+    const irk = crypto.r();
+    const prand = Buffer.from([0x12, 0x34, 0x56]); // 0x56: resolvable
+    const hash = crypto.ah(irk, prand);
+    const rpa = Buffer.concat([hash, prand]).reverse().toString('hex').match(/.{1,2}/g).join(':');
+
+    const store = new KeyStore(file);
+    store.set(rpa, 'random', Object.assign(keys(0x11), {
+      irk,
+      address: 'c0:00:00:00:00:01',
+      addressType: 'random'
+    }));
+
+    should(store.get(rpa, 'random').address).equal('c0:00:00:00:00:01');
+    should(store.get(rpa, 'public')).equal(null);
+    should(new KeyStore(file).get(rpa, 'random').address).equal('c0:00:00:00:00:01');
+  });
+
+  it('should forget bonds', () => {
+    const store = new KeyStore(file);
+
+    store.set('c0:00:00:00:00:01', 'random', keys(0x11));
+
+    should(store.delete('c0:00:00:00:00:01', 'random')).equal(true);
+    should(store.delete('c0:00:00:00:00:01', 'random')).equal(false);
+    should(new KeyStore(file).size).equal(0);
+  });
+
+  it('should start empty from something else', () => {
+    fs.writeFileSync(file, 'not keys');
+
+    should(new KeyStore(file).size).equal(0);
+  });
+});
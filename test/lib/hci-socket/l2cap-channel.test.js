@@ -0,0 +1,124 @@
+const should = require('should');
+const sinon = require('sinon');
+const events = require('events');
+
+const { assert } = sinon;
+
+const L2capChannel = require('../../../lib/hci-socket/l2cap-channel');
+
+describe('hci-socket l2cap-channel', () => {
+  let aclStream;
+  let signaling;
+  let channel;
+
+  beforeEach(() => {
+    aclStream = new events.EventEmitter();
+    aclStream.write = sinon.spy((cid, data, callback) => callback && callback());
+    signaling = {
+      sendFlowControlCredit: sinon.spy(),
+      disconnectChannel: sinon.spy()
+    };
+    channel = new L2capChannel(
+      signaling,
+      aclStream,
+      0x0080,
+      { cid: 0x0040, mtu: 2048, mps: 247, credits: 4 },
+      { cid: 0x0041, mtu: 100, mps: 30, credits: 3 }
+    );
+  });
+
+  it('should segment SDUs into K-frames of the peer MPS', (done) => {
+    const data = Buffer.alloc(60, 0xaa);
+
+    channel.write(data, () => {
+      assert.calledThrice(aclStream.write);
+      // SDU length, then 28 + 30 + 2 bytes
+      should(aclStream.write.getCall(0).args[0]).equal(0x0041);
+      should(aclStream.write.getCall(0).args[1]).deepEqual(
+        Buffer.concat([Buffer.from([60, 0]), data.slice(0, 28)])
+      );
+      should(aclStream.write.getCall(1).args[1]).deepEqual(data.slice(28, 58));
+      should(aclStream.write.getCall(2).args[1]).deepEqual(data.slice(58));
+      done();
+    });
+  });
+
+  it('should split writes at the peer MTU', () => {
+    channel.remote.credits = 100;
+    channel.write(Buffer.alloc(150));
+
+    // 100 bytes in 4 K-frames, then 50 in 2
+    assert.callCount(aclStream.write, 6);
+    should(aclStream.write.getCall(0).args[1].readUInt16LE(0)).equal(100);
+    should(aclStream.write.getCall(4).args[1].readUInt16LE(0)).equal(50);
+  });
+
+  it('should wait for credits', () => {
+    const callback = sinon.spy();
+
+    channel.write(Buffer.alloc(100), callback);
+
+    assert.calledThrice(aclStream.write);
+    assert.notCalled(callback);
+
+    channel.addCredits(2);
+
+    assert.callCount(aclStream.write, 4);
+    should(channel.remote.credits).equal(1);
+  });
+
+  it('should reassemble SDUs', () => {
+    aclStream.emit('data', 0x0040, Buffer.concat([Buffer.from([5, 0]), Buffer.from('hel')]));
+    aclStream.emit('data', 0x0041, Buffer.from('ignored'));
+    aclStream.emit('data', 0x0040, Buffer.from('lo'));
+
+    should(channel.read()).deepEqual(Buffer.from('hello'));
+  });
+
+  it('should give credits back once half are used', () => {
+    channel.on('data', () => {});
+
+    aclStream.emit('data', 0x0040, Buffer.from([1, 0, 1]));
+    assert.notCalled(signaling.sendFlowControlCredit);
+
+    aclStream.emit('data', 0x0040, Buffer.from([1, 0, 2]));
+    assert.calledOnceWithExactly(signaling.sendFlowControlCredit, 0x0040, 2);
+    should(channel.local.credits).equal(4);
+  });
+
+  it('should hold credits while the reader is behind', () => {
+    channel = new L2capChannel(
+      signaling,
+      aclStream,
+      0x0080,
+      { cid: 0x0042, mtu: 2048, mps: 247, credits: 2 },
+      { cid: 0x0043, mtu: 100, mps: 30, credits: 3 }
+    );
+    channel._readableState.highWaterMark = 1;
+
+    aclStream.emit('data', 0x0042, Buffer.from([2, 0, 1, 2]));
+    assert.notCalled(signaling.sendFlowControlCredit);
+
+    channel.read();
+    assert.calledOnceWithExactly(signaling.sendFlowControlCredit, 0x0042, 1);
+  });
+
+  it('should ask to disconnect on end', (done) => {
+    channel.end(() => {
+      assert.calledOnceWithExactly(signaling.disconnectChannel, channel);
+      done();
+    });
+  });
+
+  it('should end and fail queued writes once closed', (done) => {
+    channel.on('error', (error) => {
+      should(error.message).equal('L2CAP channel closed');
+      should(channel._readableState.ended).equal(true);
+      should(aclStream.listenerCount('data')).equal(0);
+      done();
+    });
+
+    channel.write(Buffer.alloc(100));
+    aclStream.emit('end');
+  });
+});
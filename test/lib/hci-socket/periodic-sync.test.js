@@ -0,0 +1,229 @@
+const should = require('should');
+const sinon = require('sinon');
+
+const { assert } = sinon;
+
+const FakeController = require('../../../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../../../lib/hci-socket/fake-peripheral');
+const NobleBindings = require('../../../lib/hci-socket/bindings');
+const PeriodicSync = require('../../../lib/hci-socket/periodic-sync');
+const Noble = require('../../../lib/noble');
+
+describe('hci-socket periodic-sync', () => {
+  let clock;
+  let hci;
+  let periodicSync;
+  let established;
+  let reports;
+  let lost;
+
+  beforeEach(() => {
+    clock = sinon.useFakeTimers();
+    hci = {
+      createPeriodicSync: sinon.spy(),
+      cancelPeriodicSync: sinon.spy(),
+      terminatePeriodicSync: sinon.spy()
+    };
+    periodicSync = new PeriodicSync(hci);
+
+    established = sinon.spy();
+    reports = sinon.spy();
+    lost = sinon.spy();
+    periodicSync.on('established', established);
+    periodicSync.on('report', reports);
+    periodicSync.on('lost', lost);
+
+    periodicSync.onAdvertisingReport('a', 1, 100);
+    periodicSync.onAdvertisingReport('b', 2, 7.5);
+  });
+
+  afterEach(() => {
+    clock.restore();
+  });
+
+  it('should need a periodic train to have been heard', () => {
+    periodicSync.sync('c', 'c', 'public');
+
+    assert.notCalled(hci.createPeriodicSync);
+    should(established.firstCall.args[1].message).equal(
+      'No periodic advertising heard from this device'
+    );
+  });
+
+  it('should forget trains not heard for a while', () => {
+    clock.tick(20000);
+    periodicSync.onAdvertisingReport('b', 2, 7.5);
+    clock.tick(10000);
+
+    periodicSync.sync('a', 'a', 'random');
+    periodicSync.sync('b', 'b', 'public');
+
+    should(established.firstCall.args[1].message).equal(
+      'No periodic advertising heard from this device'
+    );
+    assert.calledOnceWithExactly(hci.createPeriodicSync, 2, 'b', 'public', 10);
+    should(Array.from(periodicSync._advertisers.keys())).deepEqual(['b']);
+  });
+
+  it('should keep at most 1024 trains', () => {
+    for (let i = 0; i < 1100; i++) {
+      periodicSync.onAdvertisingReport(`c${i}`, 0, 100);
+    }
+
+    should(periodicSync._advertisers.size).equal(1024);
+    should(periodicSync._advertisers.has('a')).be.false();
+    should(periodicSync._advertisers.has('c1099')).be.true();
+  });
+
+  it('should create one sync at a time', () => {
+    periodicSync.sync('a', 'a', 'random');
+    periodicSync.sync('b', 'b', 'public');
+    periodicSync.sync('a', 'a', 'random');
+
+    // 6 intervals, in 10 ms units and at least 100 ms
+    assert.calledOnceWithExactly(hci.createPeriodicSync, 1, 'a', 'random', 60);
+
+    periodicSync.onSyncEstablished(0, 5, 1, 'a');
+    assert.calledWithExactly(established, 'a', null, 100);
+    should(hci.createPeriodicSync.args[1]).deepEqual([2, 'b', 'public', 10]);
+
+    periodicSync.onSyncEstablished(0x3e, 0);
+    should(established.args[1][1].message).equal(
+      'Periodic advertising sync failed (0x3e)'
+    );
+    should(periodicSync.isSynced('a')).be.true();
+    should(periodicSync.isSynced('b')).be.false();
+    should(periodicSync.stats.established).equal(1);
+    should(periodicSync.stats.failed).equal(1);
+  });
+
+  it('should cancel a sync not established in time', () => {
+    periodicSync.sync('a', 'a', 'random');
+    clock.tick(10000);
+
+    assert.calledOnce(hci.cancelPeriodicSync);
+
+    periodicSync.onSyncEstablished(0x44, 0);
+    should(established.firstCall.args[1].message).equal(
+      'Periodic advertising sync timed out'
+    );
+  });
+
+  it('should put fragmented data back together and drop truncated data', () => {
+    periodicSync.sync('a', 'a', 'random');
+    periodicSync.onSyncEstablished(0, 5, 1, 'a');
+
+    periodicSync.onReport(5, 0x7f, -60, 0x01, Buffer.from([0x01]));
+    periodicSync.onReport(5, 0x7f, -60, 0x00, Buffer.from([0x02]));
+    periodicSync.onReport(5, 0x7f, -60, 0x01, Buffer.from([0x03]));
+    periodicSync.onReport(5, 0x7f, -60, 0x02, Buffer.from([0x04]));
+    periodicSync.onReport(5, 0x7f, -61, 0x00, Buffer.from([0x05]));
+    periodicSync.onReport(6, 0x7f, -60, 0x00, Buffer.from([0x06]));
+
+    should(reports.args).deepEqual([
+      ['a', Buffer.from([0x01, 0x02]), -60, 0x7f],
+      ['a', Buffer.from([0x05]), -61, 0x7f]
+    ]);
+    should(periodicSync.stats.reports).equal(2);
+    should(periodicSync.stats.truncated).equal(1);
+  });
+
+  it('should report syncs lost or terminated', () => {
+    periodicSync.sync('a', 'a', 'random');
+    periodicSync.onSyncEstablished(0, 5, 1, 'a');
+    periodicSync.sync('b', 'b', 'public');
+    periodicSync.onSyncEstablished(0, 6, 2, 'b');
+
+    periodicSync.onSyncLost(5);
+    periodicSync.stop('b');
+
+    assert.calledOnceWithExactly(hci.terminatePeriodicSync, 6);
+    should(lost.args).deepEqual([
+      ['a', 'timeout'],
+      ['b', 'terminated']
+    ]);
+    should(periodicSync.isSynced('a')).be.false();
+    should(periodicSync.isSynced('b')).be.false();
+  });
+
+  it('should forget trains on reset', () => {
+    periodicSync.reset();
+    periodicSync.sync('a', 'a', 'random');
+
+    assert.notCalled(hci.createPeriodicSync);
+    should(periodicSync._advertisers.size).equal(0);
+  });
+
+  it('should terminate syncs nobody asked for', () => {
+    periodicSync.onSyncEstablished(0, 7, 1, 'a');
+
+    assert.calledOnceWithExactly(hci.terminatePeriodicSync, 7);
+    assert.notCalled(established);
+  });
+
+  describe('with the fake controller', () => {
+    let controller;
+    let noble;
+
+    beforeEach(() => {
+      clock.restore();
+      sinon.stub(process, 'on');
+    });
+
+    afterEach(() => {
+      process.on.restore();
+      noble.removeAllListeners();
+      controller.stop();
+      clock = sinon.useFakeTimers();
+    });
+
+    it('should follow a train without connecting', async () => {
+      const sensor = new FakePeripheral({
+        address: 'c0:00:00:00:00:01',
+        connectable: false,
+        advertisingInterval: 5,
+        periodicAdvertising: { sid: 3, interval: 10, size: 300 }
+      });
+
+      controller = new FakeController({ numCommandPackets: 4, peripherals: [sensor] });
+      noble = new Noble(
+        new NobleBindings({
+          userChannel: true,
+          keyStore: false,
+          extended: true,
+          socket: controller
+        })
+      );
+
+      await new Promise((resolve) =>
+        noble.on('stateChange', (state) => state === 'poweredOn' && resolve())
+      );
+      const [peripheral] = await Promise.all([
+        new Promise((resolve) => noble.once('discover', resolve)),
+        noble.startScanningAsync([], true)
+      ]);
+
+      await peripheral.syncPeriodicAdvertisingAsync();
+      should(peripheral.periodicInterval).equal(10);
+
+      const data = await new Promise((resolve) =>
+        peripheral.once('periodicAdvertisement', resolve)
+      );
+      should(data.length).equal(300);
+      should(controller.stats.periodicReports).be.above(1);
+
+      // the train is followed without the scan
+      await noble.stopScanningAsync();
+      const counter = data.readUInt32LE(0);
+      const next = await new Promise((resolve) =>
+        peripheral.once('periodicAdvertisement', resolve)
+      );
+      should(next.readUInt32LE(0)).be.above(counter);
+
+      const reason = new Promise((resolve) => peripheral.once('periodicSyncLost', resolve));
+      peripheral.stopPeriodicSync();
+      should(await reason).equal('terminated');
+      should(peripheral.periodicInterval).be.null();
+    });
+  });
+});
@@ -0,0 +1,87 @@
+const should = require('should');
+
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const Hci = require('../../../lib/hci-socket/hci');
+const FakeController = require('../../../lib/hci-socket/fake-controller');
+const ReplaySocket = require('../../../lib/hci-socket/replay-socket');
+
+describe('hci-socket replay socket', () => {
+  let file;
+
+  beforeEach(() => {
+    file = path.join(
+      os.tmpdir(),
+      `noble-replay-${process.pid}-${Date.now()}.log`
+    );
+  });
+
+  afterEach(() => {
+    if (fs.existsSync(file)) {
+      fs.unlinkSync(file);
+    }
+  });
+
+  const poweredOn = (hci) =>
+    new Promise((resolve) => {
+      hci.on('stateChange', (state) => {
+        if (state === 'poweredOn') {
+          resolve();
+        }
+      });
+      hci.init();
+    });
+
+  const record = async () => {
+    const hci = new Hci({
+      socket: new FakeController({ numCommandPackets: 4, commandLatency: 5 }),
+      userChannel: true,
+      btsnoopFile: file
+    });
+
+    await poweredOn(hci);
+    await new Promise((resolve) => hci.closeBtsnoop(resolve));
+  };
+
+  it('should replay a capture through hci', async () => {
+    await record();
+
+    const socket = new ReplaySocket(file, { speed: 'max' });
+    const hci = new Hci({ socket, userChannel: true });
+    const addressChange = new Promise((resolve) =>
+      hci.once('addressChange', resolve)
+    );
+
+    await poweredOn(hci);
+
+    should(await addressChange).equal('00:11:22:33:44:55');
+    should(socket.stats.packets).equal(11);
+    should(socket.stats.writes).be.above(0);
+  });
+
+  it('should keep the recorded timing', async () => {
+    await record();
+
+    const socket = new ReplaySocket(file);
+    const ended = new Promise((resolve) => socket.once('end', resolve));
+    const start = Date.now();
+
+    socket.start();
+    await ended;
+
+    // reset, init burst and scan parameters, each at least 5 ms apart
+    should(Date.now() - start).be.aboveOrEqual(9);
+    should(socket.stats.packets).equal(11);
+  });
+
+  it('should emit nothing before start', () => {
+    const socket = new ReplaySocket(
+      Buffer.from('6274736e6f6f700000000001000003ea', 'hex')
+    );
+
+    should(socket.stats.packets).equal(0);
+    should(socket.isDevUp()).equal(true);
+  });
+});
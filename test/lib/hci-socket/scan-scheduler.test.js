@@ -0,0 +1,142 @@
+const should = require('should');
+const sinon = require('sinon');
+
+const { assert } = sinon;
+
+const ScanScheduler = require('../../../lib/hci-socket/scan-scheduler');
+
+describe('hci-socket scan-scheduler', () => {
+  let clock;
+  let gap;
+
+  // the interval and window last given to Gap
+  const dutyCycle = () => gap.setScanDutyCycle.lastCall.args;
+
+  beforeEach(() => {
+    clock = sinon.useFakeTimers();
+    gap = {
+      isScanning: sinon.stub().returns(true),
+      setScanDutyCycle: sinon.spy(),
+      pauseScanning: sinon.spy(),
+      resumeScanning: sinon.spy()
+    };
+  });
+
+  afterEach(() => {
+    clock.restore();
+  });
+
+  it('should leave scanning alone when continuous', () => {
+    const scheduler = new ScanScheduler(gap);
+
+    scheduler.onConnecting();
+    scheduler.onConnComplete(0);
+
+    assert.notCalled(gap.setScanDutyCycle);
+    assert.notCalled(gap.pauseScanning);
+  });
+
+  it('should reject unknown policies', () => {
+    should(() => new ScanScheduler(gap, { policy: 'fast' })).throw('unknown scan policy fast');
+  });
+
+  it('should give connections room when aggressive', () => {
+    const scheduler = new ScanScheduler(gap, { policy: 'aggressive' });
+    should(dutyCycle()).deepEqual([0x60, 0x60]);
+
+    scheduler.onConnComplete(0);
+    scheduler.onConnComplete(0);
+    should(dutyCycle()).deepEqual([0x60, 0x4d]);
+
+    for (let i = 0; i < 8; i++) {
+      scheduler.onConnComplete(0);
+    }
+    should(dutyCycle()).deepEqual([0x60, 0x30]);
+
+    scheduler.onDisconnect();
+    should(dutyCycle()).deepEqual([0x60, 0x30]);
+    should(scheduler.stats.parameterChanges).equal(6);
+  });
+
+  it('should pause around LE Create Connection', () => {
+    const scheduler = new ScanScheduler(gap, { policy: 'aggressive', resumeDelay: 100 });
+
+    scheduler.onConnecting();
+    assert.calledOnce(gap.pauseScanning);
+
+    scheduler.onConnComplete(0);
+    clock.tick(99);
+    assert.notCalled(gap.resumeScanning);
+
+    clock.tick(1);
+    assert.calledOnce(gap.resumeScanning);
+    should(dutyCycle()).deepEqual([0x60, 0x56]);
+    should(scheduler.stats.pauses).equal(1);
+  });
+
+  it('should pause a scan started while connecting', () => {
+    const scheduler = new ScanScheduler(gap, { policy: 'aggressive' });
+
+    gap.isScanning.returns(false);
+    scheduler.onConnecting();
+    assert.notCalled(gap.pauseScanning);
+
+    gap.isScanning.returns(true);
+    scheduler.onScanStart();
+    assert.calledOnce(gap.pauseScanning);
+  });
+
+  it('should boost background scans when devices show up', () => {
+    const scheduler = new ScanScheduler(gap, { policy: 'background', boostDuration: 1000 });
+    should(dutyCycle()).deepEqual([0x800, 0xcd]);
+
+    scheduler.onDiscover('a');
+    should(dutyCycle()).deepEqual([0x800, 0x200]);
+
+    clock.tick(600);
+    scheduler.onDiscover('a');
+    scheduler.onDiscover('b');
+    clock.tick(600);
+    should(dutyCycle()).deepEqual([0x800, 0x200]);
+
+    clock.tick(400);
+    should(dutyCycle()).deepEqual([0x800, 0xcd]);
+  });
+
+  it('should only remember the devices of a background scan, until it stops', () => {
+    const scheduler = new ScanScheduler(gap, { boostDuration: 1000 });
+
+    scheduler.onDiscover('a');
+    should(scheduler._seen.size).equal(0);
+
+    scheduler.setPolicy('background');
+    scheduler.onDiscover('a');
+    should(scheduler._seen.size).equal(1);
+
+    scheduler.onScanStop();
+    should(scheduler._seen.size).equal(0);
+  });
+
+  it('should pause while connected when asked to', () => {
+    const scheduler = new ScanScheduler(gap, { policy: 'pausedWhenConnected', resumeDelay: 0 });
+
+    scheduler.onConnecting();
+    scheduler.onConnComplete(0);
+    clock.tick(0);
+    assert.calledOnce(gap.pauseScanning);
+    assert.notCalled(gap.resumeScanning);
+
+    scheduler.onDisconnect();
+    assert.calledOnce(gap.resumeScanning);
+  });
+
+  it('should go back to the controller default', () => {
+    const scheduler = new ScanScheduler(gap, { policy: 'pausedWhenConnected' });
+    scheduler.onConnComplete(0);
+
+    scheduler.setPolicy('continuous');
+
+    should(dutyCycle()).deepEqual([]);
+    assert.calledOnce(gap.resumeScanning);
+  });
+});
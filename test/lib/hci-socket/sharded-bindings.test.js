@@ -0,0 +1,236 @@
+const should = require('should');
+const sinon = require('sinon');
+
+const FakeController = require('../../../lib/hci-socket/fake-controller');
+const FakePeripheral = require('../../../lib/hci-socket/fake-peripheral');
+const ShardedBindings = require('../../../lib/hci-socket/sharded-bindings');
+const Noble = require('../../../lib/noble');
+
+describe('hci-socket sharded bindings', () => {
+  let controllers;
+  let bindings;
+  let noble;
+  let discovered;
+
+  const peripheral = (address, level) =>
+    new FakePeripheral({
+      address,
+      localName: `battery ${level}`,
+      advertisingInterval: 5,
+      services: [
+        {
+          uuid: '180f',
+          characteristics: [
+            { uuid: '2a19', properties: ['read'], value: Buffer.from([level]) }
+          ]
+        }
+      ]
+    });
+
+  const wait = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+  // the first adapter hears 01 and 02, the second 02 and 03, 02 louder
+  const start = async (options) => {
+    const shared = peripheral('c0:00:00:00:00:02', 2);
+
+    controllers = [
+      new FakeController({
+        numCommandPackets: 4,
+        connectLatency: 1,
+        rssiOffset: -20,
+        peripherals: [peripheral('c0:00:00:00:00:01', 1), shared]
+      }),
+      new FakeController({
+        numCommandPackets: 4,
+        connectLatency: 1,
+        peripherals: [shared, peripheral('c0:00:00:00:00:03', 3)]
+      })
+    ];
+
+    bindings = new ShardedBindings(
+      Object.assign(
+        {
+          userChannel: true,
+          keyStore: false,
+          adapters: controllers.map((socket) => ({ socket }))
+        },
+        options
+      )
+    );
+    noble = new Noble(bindings);
+
+    discovered = new Map();
+    noble.on('discover', (peripheral) => {
+      discovered.set(peripheral.id, (discovered.get(peripheral.id) || 0) + 1);
+    });
+
+    await new Promise((resolve) =>
+      noble.on('stateChange', (state) => state === 'poweredOn' && resolve())
+    );
+    await noble.startScanningAsync([], false);
+    await wait(50);
+  };
+
+  const readLevel = async (uuid) => {
+    const peripheral = noble._peripherals[uuid];
+    await peripheral.connectAsync();
+
+    const { characteristics } =
+      await peripheral.discoverSomeServicesAndCharacteristicsAsync(['180f'], ['2a19']);
+    return (await characteristics[0].readAsync())[0];
+  };
+
+  beforeEach(() => {
+    sinon.stub(process, 'on');
+  });
+
+  afterEach(() => {
+    process.on.restore();
+    if (noble) {
+      noble.removeAllListeners();
+      noble = null;
+      for (const controller of controllers) {
+        controller.stop();
+      }
+    }
+  });
+
+  it('should merge the discoveries of all adapters', async () => {
+    await start();
+
+    should(Array.from(discovered.keys()).sort()).deepEqual([
+      'c00000000001',
+      'c00000000002',
+      'c00000000003'
+    ]);
+    should(Array.from(discovered.values())).deepEqual([1, 1, 1]);
+  });
+
+  it('should report one state and one scan for all adapters', async () => {
+    const states = [];
+    const scanStops = sinon.spy();
+
+    await start();
+    noble.on('stateChange', (state) => states.push(state));
+    noble.on('scanStop', scanStops);
+
+    await noble.stopScanningAsync();
+    await wait(10);
+
+    should(noble.state).equal('poweredOn');
+    should(states).deepEqual([]);
+    should(scanStops.callCount).equal(1);
+    should(bindings._scanning.size).equal(0);
+  });
+
+  it('should connect to the least loaded adapter and route GATT by connection', async () => {
+    await start();
+
+    should(await readLevel('c00000000001')).equal(1);
+    should(await readLevel('c00000000002')).equal(2);
+    should(await readLevel('c00000000003')).equal(3);
+
+    should(bindings.adapterOf('c00000000001')).equal(0);
+    should(bindings.adapterOf('c00000000002')).equal(1);
+    should(bindings.adapterOf('c00000000003')).equal(1);
+    should(controllers.map((controller) => controller._connections.size)).deepEqual([1, 2]);
+
+    await noble._peripherals.c00000000002.disconnectAsync();
+    should(bindings.adapterOf('c00000000002')).equal(null);
+    should(bindings.load(1)).equal(1);
+  });
+
+  it('should connect to the adapter hearing the device best', async () => {
+    await start({ assignment: 'rssi' });
+
+    await readLevel('c00000000001');
+    await readLevel('c00000000003');
+    await readLevel('c00000000002');
+
+    should(bindings.adapterOf('c00000000002')).equal(1);
+  });
+
+  it('should skip adapters at maxConnections', async () => {
+    await start({ assignment: 'rssi', maxConnections: 1 });
+
+    await readLevel('c00000000003');
+    await readLevel('c00000000002');
+
+    should(bindings.adapterOf('c00000000002')).equal(0);
+  });
+
+  it('should connect on an adapter that discovered the device once its RSSI is stale', async () => {
+    await start();
+    await noble.stopScanningAsync();
+
+    for (const sighting of bindings._sightings.values()) {
+      for (const entry of sighting.rssi.filter(Boolean)) {
+        entry.at -= 10000;
+      }
+    }
+
+    should(await readLevel('c00000000003')).equal(3);
+    should(bindings.adapterOf('c00000000003')).equal(1);
+  });
+
+  it('should fail to connect when no adapter discovered the device', async () => {
+    const connect = sinon.spy();
+
+    await start();
+    bindings.on('connect', connect);
+    bindings.connect('c00000000009', {});
+
+    should(connect.callCount).equal(1);
+    should(connect.args[0][0]).equal('c00000000009');
+    should(connect.args[0][1].message).equal('Peripheral not discovered by any adapter');
+    should(bindings.adapterOf('c00000000009')).equal(null);
+  });
+
+  it('should keep a reconnecting device on its adapter when a connect is cancelled', async () => {
+    await start();
+    for (const adapter of bindings.adapters) {
+      sinon.stub(adapter, 'autoReconnect');
+      sinon.stub(adapter, 'cancelConnect');
+      sinon.stub(adapter, 'stopAutoReconnect');
+    }
+
+    bindings.autoReconnect('c00000000003', {});
+    bindings.cancelConnect('c00000000003');
+    should(bindings.adapters[1].cancelConnect.callCount).equal(1);
+    should(bindings.adapterOf('c00000000003')).equal(1);
+
+    bindings.stopAutoReconnect('c00000000003');
+    should(bindings.adapters[1].stopAutoReconnect.callCount).equal(1);
+    should(bindings.adapterOf('c00000000003')).equal(null);
+  });
+
+  it('should ignore stopping auto reconnect of a device on no adapter', async () => {
+    await start();
+    bindings._reconnecting.add('c00000000009');
+
+    should(() => bindings.stopAutoReconnect('c00000000009')).not.throw();
+    should(bindings._reconnecting.has('c00000000009')).be.false();
+  });
+
+  it('should forget devices not heard for a while unless assigned', async () => {
+    await start();
+
+    for (const sighting of bindings._sightings.values()) {
+      sighting.heardAt -= 10000;
+    }
+    bindings._sightingsSweptAt -= 10000;
+    bindings._assigned.set('c00000000001', 0);
+    bindings.onDiscover(1, 'c00000000009', 'c0:00:00:00:00:09', 'random', true, {}, -50, true);
+
+    should(Array.from(bindings._sightings.keys()).sort()).deepEqual([
+      'c00000000001',
+      'c00000000009'
+    ]);
+  });
+
+  it('should throw on an unknown assignment', () => {
+    should(() => new ShardedBindings({ deviceIds: [0], assignment: 'random' })).throw(
+      'unknown adapter assignment random'
+    );
+  });
+});
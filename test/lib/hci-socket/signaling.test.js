@@ -91,4 +91,147 @@ describe('hci-socket signaling', () => {
       assert.calledOnceWithExactly(aclStream.write, 5, Buffer.from([0x13, 0x01, 0x02, 0x00, 0x00, 0x00]));
     });
   });
+
+  describe('LE credit based channels', () => {
+    const response = (identifier, data) =>
+      Buffer.concat([Buffer.from([0x15, identifier, data.length, 0x00]), data]);
+
+    it('should ask for a channel', () => {
+      signaling.openChannel(0x0080);
+
+      assert.calledOnceWithExactly(
+        aclStream.write,
+        5,
+        Buffer.from('14010a00' + '8000' + '4000' + '0008' + 'f700' + '0a00', 'hex')
+      );
+      should(signaling._channels.has(0x0040)).equal(true);
+    });
+
+    it('should emit the channel once accepted', () => {
+      const callback = sinon.spy();
+      signaling.on('channelOpen', callback);
+
+      signaling.openChannel(0x0080, { mtu: 512, mps: 100, credits: 4 });
+      signaling.onAclStreamData(5, response(1, Buffer.from('4100' + '0002' + 'f700' + '0500' + '0000', 'hex')));
+
+      assert.calledOnceWithMatch(callback, handle, 0x0080, null, sinon.match.object);
+
+      const channel = callback.firstCall.args[3];
+      should(channel.local).deepEqual({ cid: 0x0040, mtu: 512, mps: 100, credits: 4 });
+      should(channel.remote).deepEqual({ cid: 0x0041, mtu: 512, mps: 247, credits: 5 });
+      should(signaling._channels.get(0x0040)).equal(channel);
+    });
+
+    it('should fail with the result', () => {
+      const callback = sinon.spy();
+      signaling.on('channelOpen', callback);
+
+      signaling.openChannel(0x0080);
+      signaling.onAclStreamData(5, response(1, Buffer.from('0000000000000000' + '0200', 'hex')));
+
+      assert.calledOnceWithMatch(callback, handle, 0x0080, sinon.match.instanceOf(Error), null);
+      should(callback.firstCall.args[2].message).equal('LE_PSM not supported (0x2)');
+      should(signaling._channels.size).equal(0);
+    });
+
+    it('should fail when rejected', () => {
+      const callback = sinon.spy();
+      signaling.on('channelOpen', callback);
+
+      signaling.openChannel(0x0080);
+      signaling.onAclStreamData(5, Buffer.from('010102000000', 'hex'));
+
+      should(callback.firstCall.args[2].message).equal('Command rejected');
+    });
+
+    it('should hand credits to the channel', () => {
+      const channel = { local: { cid: 0x40 }, remote: { cid: 0x41 }, addCredits: sinon.spy() };
+      signaling._channels.set(0x40, channel);
+
+      signaling.onAclStreamData(5, Buffer.from('16010400' + '4100' + '0300', 'hex'));
+
+      assert.calledOnceWithExactly(channel.addCredits, 3);
+    });
+
+    it('should close channels the peer disconnects', () => {
+      const channel = { local: { cid: 0x40 }, remote: { cid: 0x41 }, onClose: sinon.spy() };
+      signaling._channels.set(0x40, channel);
+
+      signaling.onAclStreamData(5, Buffer.from('06070400' + '4000' + '4100', 'hex'));
+
+      assert.calledOnceWithExactly(aclStream.write, 5, Buffer.from('07070400' + '4000' + '4100', 'hex'));
+      assert.calledOnceWithExactly(channel.onClose);
+      should(signaling._channels.size).equal(0);
+    });
+
+    it('should reject disconnecting unknown channels', () => {
+      signaling.onAclStreamData(5, Buffer.from('06070400' + '4000' + '4100', 'hex'));
+
+      assert.calledOnceWithExactly(aclStream.write, 5, Buffer.from('01070600' + '0200' + '4000' + '4100', 'hex'));
+    });
+
+    it('should close the channel once the peer answers', () => {
+      const channel = { local: { cid: 0x40 }, remote: { cid: 0x41 }, onClose: sinon.spy() };
+      signaling._channels.set(0x40, channel);
+
+      signaling.disconnectChannel(channel);
+      assert.calledOnceWithExactly(aclStream.write, 5, Buffer.from('06010400' + '4100' + '4000', 'hex'));
+      assert.notCalled(channel.onClose);
+
+      signaling.onAclStreamData(5, Buffer.from('07010400' + '4100' + '4000', 'hex'));
+      assert.calledOnceWithExactly(channel.onClose);
+    });
+  });
+
+  describe('enhanced credit based channels', () => {
+    const response = (identifier, data) =>
+      Buffer.concat([Buffer.from([0x18, identifier, data.length, 0x00]), data]);
+
+    it('should ask for all channels in one request', () => {
+      signaling.openEnhancedChannels(0x0027, 3, { mtu: 517 }, sinon.spy());
+
+      assert.calledOnceWithExactly(
+        aclStream.write,
+        5,
+        Buffer.from('17010e00' + '2700' + '0502' + 'f700' + '0a00' + '4000' + '4100' + '4200', 'hex')
+      );
+      should(signaling._channels.size).equal(3);
+    });
+
+    it('should take at most 5 channels and an MTU of at least 64', () => {
+      signaling.openEnhancedChannels(0x0027, 8, { mtu: 23 }, sinon.spy());
+
+      const request = aclStream.write.firstCall.args[1];
+      should(request.readUInt16LE(2)).equal(18);
+      should(request.readUInt16LE(6)).equal(64);
+    });
+
+    it('should hand over the channels accepted', () => {
+      const callback = sinon.spy();
+
+      signaling.openEnhancedChannels(0x0027, 3, { mtu: 517 }, callback);
+      // the second one refused
+      signaling.onAclStreamData(5, response(1, Buffer.from('0001' + 'f700' + '0400' + '0400' + '5000' + '0000' + '5200', 'hex')));
+
+      assert.calledOnceWithMatch(callback, null, sinon.match.array);
+
+      const channels = callback.firstCall.args[1];
+      should(channels.map((channel) => channel.local.cid)).deepEqual([0x40, 0x42]);
+      should(channels[1].remote).deepEqual({ cid: 0x52, mtu: 256, mps: 247, credits: 4 });
+      should(channels[0].remote).not.equal(channels[1].remote);
+      should(Array.from(signaling._channels.keys())).deepEqual([0x40, 0x42]);
+    });
+
+    it('should fail with the result when none are accepted', () => {
+      const callback = sinon.spy();
+
+      signaling.openEnhancedChannels(0x0027, 2, {}, callback);
+      signaling.onAclStreamData(5, response(1, Buffer.from('0000000000000800' + '0000' + '0000', 'hex')));
+
+      assert.calledOnceWithExactly(callback, sinon.match.instanceOf(Error), []);
+      should(callback.firstCall.args[0].message).equal('Insufficient encryption (0x8)');
+      should(callback.firstCall.args[0].result).equal(0x0008);
+      should(signaling._channels.size).equal(0);
+    });
+  });
 });
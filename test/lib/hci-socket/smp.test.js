@@ -57,7 +57,7 @@ describe('hci-socket smp', () => {
 
     smp.sendPairingRequest();
 
-    assert.calledOnceWithExactly(smp.write, Buffer.from([0x01, 0x03, 0x00, 0x01, 0x10, 0x00, 0x01]));
+    assert.calledOnceWithExactly(smp.write, Buffer.from([0x01, 0x03, 0x00, 0x01, 0x10, 0x00, 0x03]));
   });
 
   describe('onAclStreamData', () => {
@@ -182,9 +182,14 @@ describe('hci-socket smp', () => {
     crypto.r = sinon.spy();
     crypto.c1 = sinon.fake.returns(Buffer.from([0x99]));
 
-    smp.handlePairingResponse('data');
+    const data = Buffer.from([0x02, 0x03, 0x00, 0x01, 0x07, 0x00, 0x01]);
+    smp._preq = Buffer.from([0x01, 0x03, 0x00, 0x01, 0x10, 0x00, 0x03]);
+    smp.handlePairingResponse(data);
 
-    should(smp._pres).equal('data');
+    should(smp._pres).equal(data);
+    // only the EncKey is coming, at the smaller key size
+    should(smp._pendingKeys).equal(0x01);
+    should(smp._keys).deepEqual({ keySize: 7 });
 
     assert.calledOnceWithExactly(crypto.r);
     assert.calledOnce(crypto.c1);
@@ -261,6 +266,39 @@ describe('hci-socket smp', () => {
     assert.calledOnceWithExactly(callback, Buffer.from([0x03, 0x04]), Buffer.from([0x05, 0x06]));
   });
 
+  it('should emit the keys once all of them arrived', () => {
+    const callback = sinon.spy();
+    smp.on('keys', callback);
+    smp._keys = { keySize: 16 };
+    smp._pendingKeys = 0x03;
+
+    smp.handleEncryptInfo(Buffer.concat([Buffer.from([0x06]), Buffer.alloc(16, 0xaa)]));
+    smp.handleMasterIdent(Buffer.from('0701020304050607080910', 'hex'));
+    assert.notCalled(callback);
+
+    smp.handleIdentityInfo(Buffer.concat([Buffer.from([0x08]), Buffer.alloc(16, 0xbb)]));
+    smp.handleIdentityAddrInfo(Buffer.from('09010100000000c0', 'hex'));
+
+    assert.calledOnce(callback);
+    should(callback.firstCall.args[0]).deepEqual({
+      keySize: 16,
+      ltk: Buffer.alloc(16, 0xaa),
+      ediv: Buffer.from([0x01, 0x02]),
+      rand: Buffer.from('0304050607080910', 'hex'),
+      irk: Buffer.alloc(16, 0xbb),
+      addressType: 'random',
+      address: 'c0:00:00:00:00:01'
+    });
+    should(smp._keys).equal(null);
+  });
+
+  it('should emit securityRequest', () => {
+    const callback = sinon.spy();
+    smp.on('securityRequest', callback);
+    smp.onAclStreamData(6, Buffer.from([0x0b, 0x01]));
+    assert.calledOnceWithExactly(callback);
+  });
+
   it('should write on aclStream', () => {
     smp.write('data');
     assert.calledOnceWithExactly(aclStream.write, 6, 'data');
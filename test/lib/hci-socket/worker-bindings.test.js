@@ -0,0 +1,117 @@
+const should = require('should');
+
+const Noble = require('../../../lib/noble');
+const WorkerBindings = require('../../../lib/hci-socket/worker-bindings');
+
+describe('hci-socket worker bindings', () => {
+  let bindings;
+  let noble;
+
+  beforeEach(() => {
+    bindings = new WorkerBindings({
+      userChannel: true,
+      keyStore: false,
+      socketModule: require.resolve('../../../lib/hci-socket/fake-controller'),
+      socketOptions: {
+        numCommandPackets: 4,
+        connectLatency: 1,
+        peripherals: [
+          {
+            localName: 'battery',
+            advertisingInterval: 5,
+            services: [
+              {
+                uuid: '180f',
+                characteristics: [
+                  {
+                    uuid: '2a19',
+                    properties: ['read', 'notify'],
+                    value: Buffer.from([0x2a]),
+                    notifyRate: 100,
+                    notifySize: 12
+                  }
+                ]
+              }
+            ]
+          }
+        ]
+      }
+    });
+    noble = new Noble(bindings);
+  });
+
+  afterEach(async () => {
+    noble.removeAllListeners();
+    if (!bindings._exited) {
+      bindings.stop();
+      await new Promise((resolve) => bindings._worker.once('exit', resolve));
+    }
+  });
+
+  it('should run the stack in the worker', async () => {
+    await new Promise((resolve) =>
+      noble.on('stateChange', (state) => state === 'poweredOn' && resolve())
+    );
+
+    noble.startScanning([], false);
+    const peripheral = await new Promise((resolve) => noble.once('discover', resolve));
+    await noble.stopScanningAsync();
+
+    should(peripheral.advertisement.localName).equal('battery');
+
+    await peripheral.connectAsync();
+    const { characteristics } =
+      await peripheral.discoverSomeServicesAndCharacteristicsAsync(['180f'], ['2a19']);
+
+    should(await characteristics[0].readAsync()).deepEqual(Buffer.from([0x2a]));
+
+    const notifications = [];
+    characteristics[0].on('data', (data, isNotification) => {
+      notifications.push(data.readUInt32LE(0));
+    });
+    await characteristics[0].subscribeAsync();
+    await new Promise((resolve) => setTimeout(resolve, 60));
+
+    should(notifications.length).be.above(2);
+    should(notifications.slice(0, 3)).deepEqual([0, 1, 2]);
+  });
+
+  it('should drain the ring on the doorbell without Atomics.waitAsync', async () => {
+    const waitAsync = Atomics.waitAsync;
+    delete Atomics.waitAsync;
+
+    try {
+      await new Promise((resolve) =>
+        noble.on('stateChange', (state) => state === 'poweredOn' && resolve())
+      );
+
+      noble.startScanning([], false);
+      const peripheral = await new Promise((resolve) => noble.once('discover', resolve));
+      await noble.stopScanningAsync();
+
+      should(peripheral.advertisement.localName).equal('battery');
+    } finally {
+      if (waitAsync) {
+        Atomics.waitAsync = waitAsync;
+      }
+    }
+  });
+
+  it('should report the adapter powered off once the worker is gone', async () => {
+    const states = [];
+    await new Promise((resolve) =>
+      noble.on('stateChange', (state) => {
+        states.push(state);
+        if (state === 'poweredOn') {
+          resolve();
+        }
+      })
+    );
+
+    bindings.stop();
+    await new Promise((resolve) => bindings._worker.once('exit', resolve));
+    await new Promise((resolve) => setImmediate(resolve));
+
+    should(states).deepEqual(['poweredOn', 'poweredOff']);
+  });
+});
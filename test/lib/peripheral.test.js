@@ -467,6 +467,87 @@ describe('peripheral', () => {
     });
   });
 
+  describe('discoverDatabase', () => {
+    beforeEach(() => {
+      mockNoble.discoverDatabase = sinon.stub().returns(true);
+      peripheral.discoverSomeServicesAndCharacteristics = sinon.stub();
+    });
+
+    afterEach(() => {
+      sinon.reset();
+    });
+
+    it('should callback with the whole tree', () => {
+      const callback = sinon.spy();
+      const services = [
+        { characteristics: ['char1', 'char2'] },
+        { characteristics: ['char3'] }
+      ];
+
+      peripheral.discoverDatabase(callback);
+      peripheral.emit('databaseDiscover', services);
+
+      assert.calledOnceWithExactly(mockNoble.discoverDatabase, mockId, false);
+      assert.notCalled(peripheral.discoverSomeServicesAndCharacteristics);
+      assert.calledOnceWithExactly(callback, null, services, ['char1', 'char2', 'char3']);
+    });
+
+    it('should ask for the descriptors', () => {
+      peripheral.discoverDatabase({ descriptors: true });
+
+      assert.calledOnceWithExactly(mockNoble.discoverDatabase, mockId, true);
+    });
+
+    it('should fall back when noble can\'t', () => {
+      const callback = sinon.spy();
+      const services = [{ characteristics: ['char1'] }];
+      mockNoble.discoverDatabase.returns(false);
+
+      peripheral.discoverDatabase(callback);
+      peripheral.discoverSomeServicesAndCharacteristics.callArgWith(2, null, services, ['char1']);
+
+      should(peripheral.listenerCount('databaseDiscover')).equal(0);
+      assert.calledOnceWithExactly(callback, null, services, ['char1']);
+    });
+
+    it('should fall back to the descriptors of each characteristic', () => {
+      const callback = sinon.spy();
+      const characteristics = [
+        { discoverDescriptors: sinon.stub() },
+        { discoverDescriptors: sinon.stub() }
+      ];
+      const services = [{ characteristics }];
+      mockNoble.discoverDatabase.returns(false);
+
+      peripheral.discoverDatabase({ descriptors: true }, callback);
+      peripheral.discoverSomeServicesAndCharacteristics.callArgWith(2, null, services, characteristics);
+
+      characteristics[1].discoverDescriptors.callArg(0);
+      assert.notCalled(callback);
+      characteristics[0].discoverDescriptors.callArg(0);
+      assert.calledOnceWithExactly(callback, null, services, characteristics);
+    });
+  });
+
+  describe('discoverDatabaseAsync', () => {
+    beforeEach(() => {
+      mockNoble.discoverDatabase = sinon.stub().returns(true);
+    });
+
+    afterEach(() => {
+      sinon.reset();
+    });
+
+    it('should resolve with the tree', async () => {
+      const services = [{ characteristics: ['char1'] }];
+      const promise = peripheral.discoverDatabaseAsync({ descriptors: true });
+
+      peripheral.emit('databaseDiscover', services);
+
+      should(await promise).deepEqual({ services, characteristics: ['char1'] });
+    });
+  });
+
   describe('discoverAllServicesAndCharacteristicsAsync', () => {
     beforeEach(() => {
       peripheral.discoverSomeServicesAndCharacteristics = sinon.stub();
@@ -518,6 +599,70 @@ describe('peripheral', () => {
     });
   });
 
+  describe('readMultiple', () => {
+    const characteristics = [
+      { _serviceUuid: 'service', uuid: 'char1' },
+      { _serviceUuid: 'service', uuid: 'char2' }
+    ];
+    const requested = [
+      { serviceUuid: 'service', characteristicUuid: 'char1' },
+      { serviceUuid: 'service', characteristicUuid: 'char2' }
+    ];
+
+    beforeEach(() => {
+      mockNoble.readMultiple = sinon.spy();
+    });
+
+    afterEach(() => {
+      sinon.reset();
+    });
+
+    it('should delegate to noble', () => {
+      peripheral.readMultiple(characteristics);
+      assert.calledOnceWithExactly(mockNoble.readMultiple, mockId, requested, sinon.match.number);
+    });
+
+    it('should callback with the values of its own request', () => {
+      const callback = sinon.spy();
+
+      peripheral.readMultiple(characteristics, callback);
+      const requestId = mockNoble.readMultiple.firstCall.args[2];
+
+      peripheral.emit('readMultiple', requestId + 1, null, ['other']);
+      assert.notCalled(callback);
+
+      peripheral.emit('readMultiple', requestId, null, ['data1', 'data2']);
+      peripheral.emit('readMultiple', requestId, null, ['data1', 'data2']);
+      assert.calledOnceWithExactly(callback, null, ['data1', 'data2']);
+    });
+
+    it('should callback with the error of its request', () => {
+      const callback = sinon.spy();
+      const error = new Error('unknown characteristic');
+
+      peripheral.readMultiple(characteristics, callback);
+      peripheral.emit('readMultiple', mockNoble.readMultiple.firstCall.args[2], error);
+
+      assert.calledOnceWithExactly(callback, error, undefined);
+    });
+
+    it('should callback right away without characteristics', () => {
+      const callback = sinon.spy();
+
+      peripheral.readMultiple([], callback);
+
+      assert.calledOnceWithExactly(callback, null, []);
+      assert.notCalled(mockNoble.readMultiple);
+    });
+
+    it('should resolve with the values', async () => {
+      const promise = peripheral.readMultipleAsync(characteristics);
+      peripheral.emit('readMultiple', mockNoble.readMultiple.firstCall.args[2], null, ['data1', 'data2']);
+
+      should(await promise).deepEqual(['data1', 'data2']);
+    });
+  });
+
   describe('readHandleAsync', () => {
     beforeEach(() => {
       mockNoble.readHandle = sinon.spy();
@@ -544,6 +689,39 @@ describe('peripheral', () => {
     });
   });
 
+  describe('openL2capChannel', () => {
+    beforeEach(() => {
+      mockNoble.openL2capChannel = sinon.spy();
+    });
+
+    afterEach(() => {
+      sinon.reset();
+    });
+
+    it('should delegate to noble', () => {
+      peripheral.openL2capChannel(0x0080, { credits: 4 });
+
+      assert.calledOnceWithExactly(mockNoble.openL2capChannel, mockId, 0x0080, { credits: 4 });
+    });
+
+    it('should callback with the channel', () => {
+      const callback = sinon.spy();
+
+      peripheral.openL2capChannel(0x0080, callback);
+      peripheral.emit('l2capChannelOpen128', null, 'channel');
+
+      assert.calledOnceWithExactly(callback, null, 'channel');
+      assert.calledOnceWithExactly(mockNoble.openL2capChannel, mockId, 0x0080, undefined);
+    });
+
+    it('should resolve with the channel', async () => {
+      const promise = peripheral.openL2capChannelAsync(0x0080);
+      peripheral.emit('l2capChannelOpen128', null, 'channel');
+
+      should(await promise).equal('channel');
+    });
+  });
+
   describe('writeHandle', () => {
     beforeEach(() => {
       mockNoble.writeHandle = sinon.spy();
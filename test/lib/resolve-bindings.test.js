@@ -26,9 +26,20 @@ const NobleBindings = proxyquire('../../lib/distributed/bindings', {
 const HciNobleBindings = proxyquire('../../lib/hci-socket/bindings', {
   './hci': EventEmitter,
 });
+const ShardedBindings = proxyquire('../../lib/hci-socket/sharded-bindings', {
+  './bindings': HciNobleBindings,
+});
+class WorkerBindings {
+  constructor (options) {
+    this.options = options;
+  }
+}
+
 const resolver = proxyquire('../../lib/resolve-bindings', {
   './distributed/bindings': NobleBindings,
   './hci-socket/bindings': HciNobleBindings,
+  './hci-socket/sharded-bindings': ShardedBindings,
+  './hci-socket/worker-bindings': WorkerBindings,
   './mac/bindings': NobleMacImport,
   './win/bindings': NobleWinrtImport,
   os: { platform, release },
@@ -75,6 +86,24 @@ describe('resolve-bindings', () => {
     should(bindings).instanceof(HciNobleBindings);
   });
 
+  it('linux with several adapters', () => {
+    chosenPlatform = 'linux';
+    process.env.NOBLE_HCI_DEVICE_IDS = '0,1';
+
+    const bindings = resolver({});
+    should(bindings).instanceof(ShardedBindings);
+    should(bindings.adapters).have.length(2);
+  });
+
+  it('linux in a worker thread', () => {
+    chosenPlatform = 'linux';
+    process.env.NOBLE_HCI_WORKER = '1';
+
+    const bindings = resolver({ deviceId: 1 });
+    should(bindings).instanceof(WorkerBindings);
+    should(bindings.options).deepEqual({ deviceId: 1 });
+  });
+
   it('freebsd', () => {
     chosenPlatform = 'freebsd';
 
@@ -0,0 +1,71 @@
+const should = require('should');
+
+const ScanFilter = require('../../lib/scan-filter');
+
+const { MANUFACTURER_ID, SERVICE_DATA, NAME_PREFIX } = ScanFilter;
+
+describe('scan-filter', () => {
+  // flags, manufacturer data for 0x0059, 16-bit service data for feaa
+  const eir = Buffer.from('020106' + '05ff5900aabb' + '0516aafe1020', 'hex');
+  // complete local name 'KICKR 1234'
+  const scanResponse = Buffer.from('0b094b49434b522031323334', 'hex');
+
+  it('should be null without criteria', () => {
+    should(ScanFilter.from(undefined)).equal(null);
+    should(ScanFilter.from({ serviceUuids: ['180d'] })).equal(null);
+    should(ScanFilter.from({ rssi: -70 })).not.equal(null);
+  });
+
+  it('should match manufacturer IDs on raw AD structures', () => {
+    should(new ScanFilter({ manufacturerId: 0x0059 }).matchEir(eir)).equal(MANUFACTURER_ID);
+    should(new ScanFilter({ manufacturerId: [0x004c, 0x0059] }).matchEir(eir)).equal(MANUFACTURER_ID);
+    should(new ScanFilter({ manufacturerId: 0x004c }).matchEir(eir)).equal(0);
+  });
+
+  it('should match service data by UUID and prefix', () => {
+    should(new ScanFilter({ serviceData: { uuid: 'FEAA' } }).matchEir(eir)).equal(SERVICE_DATA);
+    should(new ScanFilter({ serviceData: { uuid: 'feaa', prefix: Buffer.from([0x10]) } }).matchEir(eir)).equal(SERVICE_DATA);
+    should(new ScanFilter({ serviceData: { uuid: 'feaa', prefix: Buffer.from([0x20]) } }).matchEir(eir)).equal(0);
+    should(new ScanFilter({ serviceData: { uuid: 'feaa', prefix: Buffer.from([0x10, 0x20, 0x30]) } }).matchEir(eir)).equal(0);
+    should(new ScanFilter({ serviceData: { uuid: '0000feaa' } }).matchEir(eir)).equal(0);
+  });
+
+  it('should match name prefixes', () => {
+    const filter = new ScanFilter({ namePrefix: 'KICKR', manufacturerId: 0x0059 });
+
+    should(filter.matchEir(scanResponse)).equal(NAME_PREFIX);
+    should(filter.matched(filter.matchEir(eir))).equal(false);
+    should(filter.matched(filter.matchEir(eir) | filter.matchEir(scanResponse))).equal(true);
+    should(new ScanFilter({ namePrefix: 'KICKR 12345' }).matchEir(scanResponse)).equal(0);
+  });
+
+  it('should stop at malformed AD structures', () => {
+    const filter = new ScanFilter({ manufacturerId: 0x0059 });
+
+    should(filter.matchEir(Buffer.from('0001' + '05ff5900', 'hex'))).equal(0);
+    should(filter.matchEir(Buffer.from('05ff5900', 'hex'))).equal(0);
+  });
+
+  it('should match decoded advertisements alike', () => {
+    const filter = new ScanFilter({
+      manufacturerId: 0x0059,
+      serviceData: { uuid: 'feaa', prefix: Buffer.from([0x10]) },
+      namePrefix: 'KICKR'
+    });
+
+    should(filter.matchAdvertisement({
+      localName: 'KICKR 1234',
+      manufacturerData: Buffer.from('5900aabb', 'hex'),
+      serviceData: [{ uuid: 'feaa', data: Buffer.from([0x10, 0x20]) }]
+    })).equal(MANUFACTURER_ID | SERVICE_DATA | NAME_PREFIX);
+    should(filter.matchAdvertisement({ serviceUuids: [] })).equal(0);
+  });
+
+  it('should apply the RSSI floor', () => {
+    const filter = new ScanFilter({ rssi: -70 });
+
+    should(filter.matched(0)).equal(true);
+    should(filter.rssiMatched(-70)).equal(true);
+    should(filter.rssiMatched(-71)).equal(false);
+  });
+});
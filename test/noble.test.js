@@ -184,6 +184,40 @@ describe('noble', () => {
     });
   });
 
+  describe('scan filter', () => {
+    const filter = { serviceUuids: ['1826'], manufacturerId: 0x0059, rssi: -70 };
+
+    beforeEach(() => {
+      mockBindings.startScanning = sinon.spy();
+      noble._state = 'poweredOn';
+      noble.initialized = true;
+    });
+
+    it('should pass the filter to the bindings', () => {
+      mockBindings.supportsScanFilter = true;
+
+      noble.startScanning(filter, true);
+
+      assert.calledOnceWithExactly(mockBindings.startScanning, ['1826'], true, filter);
+      should(noble._scanFilter).equal(null);
+    });
+
+    it('should filter discoveries for bindings that do not', () => {
+      const discover = sinon.spy();
+      noble.on('discover', discover);
+
+      noble.startScanning(filter, true);
+
+      noble.onDiscover('a', 'a', 'random', true, { localName: 'a' }, -50);
+      noble.onDiscover('b', 'b', 'random', true, { manufacturerData: Buffer.from('5900', 'hex') }, -80);
+      noble.onDiscover('b', 'b', 'random', true, { localName: 'b' }, -60);
+
+      assert.calledOnce(discover);
+      should(discover.args[0][0].id).equal('b');
+      should(noble._peripherals).have.keys('a', 'b');
+    });
+  });
+
   describe('startScanningAsync', () => {
     beforeEach(() => {
       mockBindings.startScanning = sinon.spy();
@@ -1120,6 +1154,192 @@ describe('noble', () => {
     });
   });
 
+  describe('discoverDatabase', () => {
+    it('should delegate to bindings', () => {
+      noble._bindings.discoverDatabase = sinon.spy();
+
+      should(noble.discoverDatabase('peripheralUuid', true)).equal(true);
+      assert.calledOnceWithExactly(noble._bindings.discoverDatabase, 'peripheralUuid', true);
+    });
+
+    it('should return false without bindings support', () => {
+      should(noble.discoverDatabase('peripheralUuid')).equal(false);
+    });
+  });
+
+  describe('onDatabaseDiscover', () => {
+    it('should emit warning', () => {
+      const warningCallback = sinon.spy();
+      noble.on('warning', warningCallback);
+
+      noble._peripherals = {};
+      noble.onDatabaseDiscover('peripheralUuid', []);
+
+      assert.calledOnceWithExactly(warningCallback, 'unknown peripheral peripheralUuid database discover!');
+    });
+
+    const database = (descriptors) => [
+      {
+        uuid: '180d',
+        startHandle: 1,
+        endHandle: 4,
+        characteristics: [
+          Object.assign({
+            uuid: '2a37',
+            properties: ['notify'],
+            startHandle: 2,
+            valueHandle: 3,
+            endHandle: 4
+          }, descriptors && { descriptors })
+        ]
+      }
+    ];
+    let emit;
+    let peripheral;
+
+    beforeEach(() => {
+      emit = sinon.spy();
+      peripheral = { emit };
+
+      noble._peripherals = { peripheralUuid: peripheral };
+      noble._services = { peripheralUuid: {} };
+      noble._characteristics = { peripheralUuid: {} };
+      noble._descriptors = { peripheralUuid: {} };
+    });
+
+    it('should build the tree and emit databaseDiscover', () => {
+      noble.onDatabaseDiscover('peripheralUuid', database([{ uuid: '2902', handle: 4 }]));
+
+      const services = peripheral.services;
+      assert.calledTwice(emit);
+      assert.calledWithExactly(emit, 'servicesDiscover', services);
+      assert.calledWithExactly(emit, 'databaseDiscover', services);
+      should(services).have.length(1);
+      should(services[0]).be.instanceOf(Service);
+      should(services[0].uuid).equal('180d');
+
+      const characteristic = services[0].characteristics[0];
+      should(characteristic).be.instanceOf(Characteristic);
+      should(characteristic.uuid).equal('2a37');
+      should(characteristic.properties).deepEqual(['notify']);
+      should(characteristic.descriptors[0]).be.instanceOf(Descriptor);
+      should(characteristic.descriptors[0].uuid).equal('2902');
+
+      should(noble._services.peripheralUuid['180d']).equal(services[0]);
+      should(noble._characteristics.peripheralUuid['180d']['2a37']).equal(characteristic);
+      should(noble._descriptors.peripheralUuid['180d']['2a37']['2902']).equal(characteristic.descriptors[0]);
+    });
+
+    it('should go through the handlers of each level', () => {
+      const onCharacteristicsDiscover = sinon.spy(noble, 'onCharacteristicsDiscover');
+      const onDescriptorsDiscover = sinon.spy(noble, 'onDescriptorsDiscover');
+      const services = database([{ uuid: '2902', handle: 4 }]);
+
+      noble.onDatabaseDiscover('peripheralUuid', services);
+
+      assert.calledOnceWithExactly(onCharacteristicsDiscover, 'peripheralUuid', '180d', services[0].characteristics);
+      assert.calledOnceWithExactly(onDescriptorsDiscover, 'peripheralUuid', '180d', '2a37', ['2902']);
+    });
+
+    it('should leave the descriptors alone when they weren\'t swept', () => {
+      noble.onDatabaseDiscover('peripheralUuid', database());
+
+      const characteristic = peripheral.services[0].characteristics[0];
+      should(characteristic.descriptors).be.null();
+      should(noble._descriptors.peripheralUuid['180d']['2a37']).deepEqual({});
+    });
+  });
+
+  describe('readMultiple', () => {
+    const characteristics = [
+      { serviceUuid: 'serviceUuid', characteristicUuid: 'char1' },
+      { serviceUuid: 'serviceUuid', characteristicUuid: 'char2' }
+    ];
+
+    it('should delegate to bindings', () => {
+      noble._bindings.readMultiple = sinon.spy();
+      noble.readMultiple('peripheralUuid', characteristics, 1);
+      assert.calledOnceWithExactly(noble._bindings.readMultiple, 'peripheralUuid', characteristics, 1);
+    });
+
+    it('should read one by one without bindings support', () => {
+      const emit = sinon.spy();
+      const read1 = sinon.spy();
+      const read2 = sinon.spy();
+
+      noble._peripherals = { peripheralUuid: { emit } };
+      noble._characteristics = {
+        peripheralUuid: {
+          serviceUuid: {
+            char1: { read: read1 },
+            char2: { read: read2 }
+          }
+        }
+      };
+      noble.readMultiple('peripheralUuid', characteristics, 1);
+
+      assert.calledOnce(read1);
+      assert.calledOnce(read2);
+
+      read2.firstCall.args[0](null, 'data2');
+      assert.notCalled(emit);
+      read1.firstCall.args[0](null, 'data1');
+      assert.calledOnceWithExactly(emit, 'readMultiple', 1, null, ['data1', 'data2']);
+    });
+
+    it('should pass on the error of a single read', () => {
+      const emit = sinon.spy();
+      const error = new Error('read failed');
+      const read = sinon.stub().callsFake((callback) => callback(error));
+
+      noble._peripherals = { peripheralUuid: { emit } };
+      noble._characteristics = {
+        peripheralUuid: { serviceUuid: { char1: { read }, char2: { read } } }
+      };
+      noble.readMultiple('peripheralUuid', characteristics, 2);
+
+      assert.calledOnceWithExactly(emit, 'readMultiple', 2, error, undefined);
+    });
+
+    it('should fail on characteristics not discovered', () => {
+      const emit = sinon.spy();
+      const read = sinon.spy();
+
+      noble._peripherals = { peripheralUuid: { emit } };
+      noble._characteristics = { peripheralUuid: { serviceUuid: { char1: { read } } } };
+      noble.readMultiple('peripheralUuid', characteristics, 3);
+
+      assert.notCalled(read);
+      should(emit.firstCall.args[1]).equal(3);
+      should(emit.firstCall.args[2].message).equal('unknown characteristic serviceUuid, char2');
+    });
+  });
+
+  describe('onReadMultiple', () => {
+    it('should emit warning', () => {
+      const warningCallback = sinon.spy();
+      noble.on('warning', warningCallback);
+
+      noble._peripherals = {};
+      noble.onReadMultiple('peripheralUuid', 1, null, 'values');
+
+      assert.calledOnceWithExactly(warningCallback, 'unknown peripheral peripheralUuid read multiple!');
+    });
+
+    it('should emit readMultiple', () => {
+      const warningCallback = sinon.spy();
+      const emit = sinon.spy();
+
+      noble.on('warning', warningCallback);
+
+      noble._peripherals = { peripheralUuid: { emit } };
+      noble.onReadMultiple('peripheralUuid', 1, null, 'values');
+
+      assert.notCalled(warningCallback);
+      assert.calledOnceWithExactly(emit, 'readMultiple', 1, null, 'values');
+    });
+  });
+
   it('write - should delegate to bindings', () => {
     noble._bindings.write = sinon.spy();
     noble.write('peripheralUuid', 'serviceUuid', 'characteristicUuid', 'dataArg', 'isNotification');
@@ -1508,6 +1728,46 @@ describe('noble', () => {
     });
   });
 
+  describe('openL2capChannel', () => {
+    it('should delegate to bindings', () => {
+      noble._bindings.openL2capChannel = sinon.spy();
+
+      noble.openL2capChannel('peripheralUuid', 0x0080, { credits: 4 });
+
+      assert.calledOnceWithExactly(noble._bindings.openL2capChannel, 'peripheralUuid', 0x0080, { credits: 4 });
+    });
+
+    it('should fail on bindings without channels', () => {
+      const emit = sinon.spy();
+      noble._peripherals = { peripheralUuid: { emit } };
+
+      noble.openL2capChannel('peripheralUuid', 0x0080);
+
+      assert.calledOnceWithMatch(emit, 'l2capChannelOpen128', sinon.match.instanceOf(Error), null);
+    });
+  });
+
+  describe('onL2capChannelOpen', () => {
+    it('should emit warning', () => {
+      const warningCallback = sinon.spy();
+      noble.on('warning', warningCallback);
+
+      noble._peripherals = {};
+      noble.onL2capChannelOpen('peripheralUuid', 0x0080, null, 'channel');
+
+      assert.calledOnceWithExactly(warningCallback, 'unknown peripheral peripheralUuid L2CAP channel open!');
+    });
+
+    it('should emit l2capChannelOpen', () => {
+      const emit = sinon.spy();
+
+      noble._peripherals = { peripheralUuid: { emit } };
+      noble.onL2capChannelOpen('peripheralUuid', 0x0080, null, 'channel');
+
+      assert.calledOnceWithExactly(emit, 'l2capChannelOpen128', null, 'channel');
+    });
+  });
+
   it('onMtu - should update peripheral mtu when set before already', () => {
     const peripheral = {
       mtu: 234